@@ -6,6 +6,7 @@ Author: Lucas Berg (@bergolho)
 Script to read and plot the ECG data coming from a MonoAlg3D simulation using Matplotlib.
 ------------------------------------------------------------------------------------------------------------------------------------
 How to use:> python plot_ecg.py <path_to_output_simulation_folder>/ecg.txt
+            (or ecg.bin when binary_output=true on [calc_ecg])
 ====================================================================================================================================
 '''
 
@@ -14,7 +15,12 @@ import numpy as np
 import matplotlib.pyplot as plt
 
 def read_ecg_readings (input_file):
-	data = np.genfromtxt(input_file)
+	if input_file.endswith(".bin"):
+		# uint32 number of leads followed by (time, lead_1, ..., lead_n) doubles for each sample
+		num_leads = int(np.fromfile(input_file, dtype=np.uint32, count=1)[0])
+		data = np.fromfile(input_file, dtype=np.float64, offset=4).reshape(-1, num_leads+1)
+	else:
+		data = np.genfromtxt(input_file)
 	nlin, ncol = np.shape(data)
 	timesteps = data[:,0]
 	currents = data[:,1:]
@@ -0,0 +1,1064 @@
+#!/usr/bin/env python3
+"""
+Generates the code of a MonoAlg3D cell model from a model description file.
+
+Usage: python3 generate_cell_model.py model_file [output_dir]
+
+Writes <name>.h, <name>.c (CPU) and <name>.cu (GPU) in output_dir (default: the directory of the model file).
+
+The CPU code has:
+  - RHS_cpu, used by the adaptive Euler method ([main] adaptive time step of the ODEs).
+  - A fixed step kernel that solves the cells in batches of GENERATED_BATCH_SIZE cells stored as structure of arrays,
+    with the loop over the cells of the batch marked as omp simd. The [ode_solver] option method selects euler
+    (default) or rush_larsen, which uses the exact solution for the gates (see gate and gate_ab below).
+The GPU code solves the fixed step with the Euler method.
+
+The expressions are simplified before the code is written:
+  - Subexpressions that only depend on numbers and parameters are computed by the generator.
+  - pow with the exponents 0.5, 1, 2, 3 and 4 is replaced by sqrt and multiplications.
+  - Repeated subexpressions are computed once.
+  - Only the algebraic variables needed by the rates are computed.
+  - exp is called through safe_exp, which never returns inf, so the code is also valid with -ffast-math.
+
+Model file format (one declaration per line, # starts a comment):
+
+  name mitchell_shaeffer_2003_generated
+  description Mitchell-Shaeffer 2003
+  state V = 0.00000820413566106744 millivolt      (the first state is the transmembrane potential)
+  state h = 0.8789655121804799 dimensionless
+  parameter tau_in = 0.3                           (constant expressions of numbers and previous parameters)
+  J_in = h*(V**2*(1.0 - V))/tau_in                 (algebraic variable)
+  d/dt V = J_in - V/tau_out + stim_current         (rate of a state)
+  d/dt h = gate(h_inf, tau_h)                      (dh/dt = (h_inf - h)/tau_h)
+  d/dt m = gate_ab(alpha_m, beta_m)                (dm/dt = alpha_m*(1 - m) - beta_m*m)
+
+The expressions use the Python syntax (** is the power) with the functions exp, log, log10, sqrt, fabs, pow and
+select(condition, value_if_true, value_if_false). The names stim_current and dt can be used in the expressions.
+"""
+
+import math
+import os
+import re
+import sys
+import ast
+
+FUNCTIONS = {"exp": 1, "log": 1, "log10": 1, "sqrt": 1, "fabs": 1, "pow": 2}
+RESERVED_NAMES = {"stim_current", "dt", "sv", "rDY_", "l", "safe_exp"}
+
+BINARY_OPERATORS = {ast.Add: "+", ast.Sub: "-", ast.Mult: "*", ast.Div: "/"}
+COMPARE_OPERATORS = {ast.Lt: "<", ast.LtE: "<=", ast.Gt: ">", ast.GtE: ">=", ast.Eq: "==", ast.NotEq: "!="}
+
+
+class ModelError(Exception):
+    pass
+
+
+# ---------------------------------------------------------------------------------------------------------------------
+# Expressions are tuples: ("num", value), ("var", name), ("bin", op, a, b), ("neg", a), ("cmp", op, a, b),
+# ("and", a, b), ("or", a, b), ("not", a), ("call", function, args...) and ("select", condition, a, b)
+# ---------------------------------------------------------------------------------------------------------------------
+
+def to_expression(node, line_number):
+    if isinstance(node, ast.Constant) and isinstance(node.value, (int, float)) and not isinstance(node.value, bool):
+        return ("num", float(node.value))
+    if isinstance(node, ast.Name):
+        return ("var", node.id)
+    if isinstance(node, ast.UnaryOp):
+        operand = to_expression(node.operand, line_number)
+        if isinstance(node.op, ast.USub):
+            return ("neg", operand)
+        if isinstance(node.op, ast.UAdd):
+            return operand
+        if isinstance(node.op, ast.Not):
+            return ("not", operand)
+    if isinstance(node, ast.BinOp):
+        a = to_expression(node.left, line_number)
+        b = to_expression(node.right, line_number)
+        if isinstance(node.op, ast.Pow):
+            return ("call", "pow", a, b)
+        if type(node.op) in BINARY_OPERATORS:
+            return ("bin", BINARY_OPERATORS[type(node.op)], a, b)
+    if isinstance(node, ast.Compare) and len(node.ops) == 1 and type(node.ops[0]) in COMPARE_OPERATORS:
+        return ("cmp", COMPARE_OPERATORS[type(node.ops[0])], to_expression(node.left, line_number),
+                to_expression(node.comparators[0], line_number))
+    if isinstance(node, ast.BoolOp):
+        kind = "and" if isinstance(node.op, ast.And) else "or"
+        result = to_expression(node.values[0], line_number)
+        for value in node.values[1:]:
+            result = (kind, result, to_expression(value, line_number))
+        return result
+    if isinstance(node, ast.Call) and isinstance(node.func, ast.Name) and not node.keywords:
+        name = node.func.id
+        args = tuple(to_expression(arg, line_number) for arg in node.args)
+        if name == "select" and len(args) == 3:
+            return ("select",) + args
+        if name in FUNCTIONS and FUNCTIONS[name] == len(args):
+            return ("call", name) + args
+        raise ModelError("line %d: invalid call of %s" % (line_number, name))
+
+    raise ModelError("line %d: unsupported expression %s" % (line_number, ast.dump(node)))
+
+
+def parse_expression(text, line_number):
+    try:
+        tree = ast.parse(text.strip(), mode="eval")
+    except SyntaxError as e:
+        raise ModelError("line %d: %s" % (line_number, e.msg))
+    return to_expression(tree.body, line_number)
+
+
+def children(e):
+    kind = e[0]
+    if kind in ("num", "var"):
+        return ()
+    if kind == "call":
+        return e[2:]
+    if kind in ("bin", "cmp"):
+        return e[2:]
+    return e[1:]
+
+
+def rebuild(e, new_children):
+    kind = e[0]
+    if kind in ("call", "bin", "cmp"):
+        return e[:2] + tuple(new_children)
+    return (kind,) + tuple(new_children)
+
+
+def variables(e, result):
+    if e[0] == "var":
+        result.add(e[1])
+    for c in children(e):
+        variables(c, result)
+    return result
+
+
+def evaluate(e, values):
+    kind = e[0]
+    if kind == "num":
+        return e[1]
+    if kind == "var":
+        return values[e[1]]
+    if kind == "neg":
+        return -evaluate(e[1], values)
+    if kind == "not":
+        return 0.0 if evaluate(e[1], values) else 1.0
+    if kind == "and":
+        return 1.0 if evaluate(e[1], values) and evaluate(e[2], values) else 0.0
+    if kind == "or":
+        return 1.0 if evaluate(e[1], values) or evaluate(e[2], values) else 0.0
+    if kind == "select":
+        return evaluate(e[2], values) if evaluate(e[1], values) else evaluate(e[3], values)
+    if kind == "bin":
+        a, b = evaluate(e[2], values), evaluate(e[3], values)
+        return {"+": lambda: a + b, "-": lambda: a - b, "*": lambda: a * b, "/": lambda: a / b}[e[1]]()
+    if kind == "cmp":
+        a, b = evaluate(e[2], values), evaluate(e[3], values)
+        return 1.0 if {"<": a < b, "<=": a <= b, ">": a > b, ">=": a >= b, "==": a == b, "!=": a != b}[e[1]] else 0.0
+    if kind == "call":
+        args = [evaluate(a, values) for a in e[2:]]
+        return {"exp": math.exp, "log": math.log, "log10": math.log10, "sqrt": math.sqrt, "fabs": math.fabs,
+                "pow": math.pow}[e[1]](*args)
+    raise ModelError("invalid expression")
+
+
+def simplify(e, parameters):
+    """Computes the constant subexpressions and replaces pow by sqrt or multiplications when possible"""
+
+    if e[0] in ("num", "var"):
+        return e
+
+    e = rebuild(e, [simplify(c, parameters) for c in children(e)])
+
+    if all(v in parameters for v in variables(e, set())):
+        try:
+            value = evaluate(e, parameters)
+        except (ValueError, ZeroDivisionError, OverflowError):
+            raise ModelError("invalid constant expression %s" % to_c(e, {}))
+        if math.isfinite(value):
+            return ("num", value)
+
+    # Exact identities: x*1, 1*x, x/1 and -1*x
+    if e[0] == "bin" and e[1] in ("*", "/") and e[3] == ("num", 1.0):
+        return e[2]
+    if e[0] == "bin" and e[1] == "*" and e[2] == ("num", 1.0):
+        return e[3]
+    if e[0] == "bin" and e[1] == "*" and e[2] == ("num", -1.0):
+        return ("neg", e[3])
+
+    if e[0] == "call" and e[1] == "pow" and e[3][0] == "num":
+        base, exponent = e[2], e[3][1]
+        if exponent == 0.5:
+            return ("call", "sqrt", base)
+        if exponent == 1.0:
+            return base
+        if exponent in (2.0, 3.0, 4.0):
+            result = base
+            for _ in range(int(exponent) - 1):
+                result = ("bin", "*", result, base)
+            return result
+
+    return e
+
+
+# ---------------------------------------------------------------------------------------------------------------------
+# C code
+# ---------------------------------------------------------------------------------------------------------------------
+
+def number_to_c(value):
+    if not math.isfinite(value):
+        raise ModelError("invalid number %r" % value)
+    return repr(float(value))
+
+
+def to_c(e, names):
+    """names maps the subexpressions that were already computed to the name of their variable"""
+
+    if e in names:
+        return names[e]
+
+    kind = e[0]
+    if kind == "num":
+        return number_to_c(e[1]) if e[1] >= 0 else "(%s)" % number_to_c(e[1])
+    if kind == "var":
+        return e[1]
+    if kind == "neg":
+        return "(-%s)" % to_c(e[1], names)
+    if kind == "not":
+        return "(!%s)" % to_c(e[1], names)
+    if kind == "and":
+        return "(%s && %s)" % (to_c(e[1], names), to_c(e[2], names))
+    if kind == "or":
+        return "(%s || %s)" % (to_c(e[1], names), to_c(e[2], names))
+    if kind == "select":
+        return "(%s ? %s : %s)" % (to_c(e[1], names), to_c(e[2], names), to_c(e[3], names))
+    if kind in ("bin", "cmp"):
+        return "(%s %s %s)" % (to_c(e[2], names), e[1], to_c(e[3], names))
+    if kind == "call":
+        function = "safe_exp" if e[1] == "exp" else e[1]
+        return "%s(%s)" % (function, ", ".join(strip_outer_parentheses(to_c(a, names)) for a in e[2:]))
+    raise ModelError("invalid expression")
+
+
+def c_type(e):
+    return "bool" if e[0] in ("cmp", "and", "or", "not") else "real"
+
+
+def count_subexpressions(e, counts):
+    if e[0] in ("num", "var") or (e[0] == "neg" and e[1][0] in ("num", "var")):
+        return
+    counts[e] = counts.get(e, 0) + 1
+    if counts[e] == 1:
+        for c in children(e):
+            count_subexpressions(c, counts)
+
+
+class Model:
+
+    def __init__(self):
+        self.name = None
+        self.description = None
+        self.states = []          # (name, initial value, unit)
+        self.parameters = {}      # name -> value
+        self.parameter_order = []
+        self.algebraics = []      # (name, expression)
+        self.rates = {}           # state -> ("rate", e) | ("gate", inf, tau) | ("gate_ab", alpha, beta)
+
+    def state_names(self):
+        return [s[0] for s in self.states]
+
+
+def parse_model(file_name):
+
+    model = Model()
+    defined = set()
+
+    def define(name, line_number):
+        if not re.match(r"^[A-Za-z_][A-Za-z0-9_]*$", name):
+            raise ModelError("line %d: invalid name %s" % (line_number, name))
+        if name in defined or name in RESERVED_NAMES or name in FUNCTIONS or name == "select" or name.startswith("_cse"):
+            raise ModelError("line %d: %s is already defined or reserved" % (line_number, name))
+        defined.add(name)
+
+    with open(file_name) as f:
+        lines = f.readlines()
+
+    for line_number, line in enumerate(lines, 1):
+        line = line.split("#", 1)[0].strip()
+
+        if not line:
+            continue
+
+        keyword = line.split(None, 1)[0]
+        rest = line[len(keyword):].strip()
+
+        if keyword == "name":
+            model.name = rest
+        elif keyword == "description":
+            model.description = rest
+        elif keyword == "state":
+            m = re.match(r"^(\w+)\s*=\s*(\S+)\s*(\S*)$", rest)
+            if not m:
+                raise ModelError("line %d: expected state name = initial_value [unit]" % line_number)
+            define(m.group(1), line_number)
+            float(m.group(2))
+            model.states.append((m.group(1), m.group(2), m.group(3) or "dimensionless"))
+        elif keyword == "parameter":
+            m = re.match(r"^(\w+)\s*=\s*(.+)$", rest)
+            if not m:
+                raise ModelError("line %d: expected parameter name = value" % line_number)
+            define(m.group(1), line_number)
+            e = parse_expression(m.group(2), line_number)
+            unknown = variables(e, set()) - set(model.parameters)
+            if unknown:
+                raise ModelError("line %d: parameter %s depends on %s" % (line_number, m.group(1), ", ".join(sorted(unknown))))
+            model.parameters[m.group(1)] = evaluate(e, model.parameters)
+            model.parameter_order.append(m.group(1))
+        elif line.startswith("d/dt"):
+            m = re.match(r"^d/dt\s+(\w+)\s*=\s*(.+)$", line)
+            if not m or m.group(1) not in model.state_names():
+                raise ModelError("line %d: expected d/dt state = expression" % line_number)
+            if m.group(1) in model.rates:
+                raise ModelError("line %d: the rate of %s is already defined" % (line_number, m.group(1)))
+            model.rates[m.group(1)] = parse_rate_expression(m.group(2), line_number)
+        else:
+            m = re.match(r"^(\w+)\s*=\s*(.+)$", line)
+            if not m:
+                raise ModelError("line %d: invalid declaration" % line_number)
+            define(m.group(1), line_number)
+            model.algebraics.append((m.group(1), parse_expression(m.group(2), line_number)))
+
+    if not model.name or not model.states:
+        raise ModelError("the model needs a name and at least one state")
+
+    for state in model.state_names():
+        if state not in model.rates:
+            raise ModelError("the rate of %s is not defined" % state)
+
+    return model
+
+
+def parse_rate_expression(text, line_number):
+    m = re.match(r"^(gate|gate_ab)\s*\((.*)\)$", text.strip())
+    if m:
+        tree = ast.parse("(%s,)" % m.group(2), mode="eval")
+        if not isinstance(tree.body, ast.Tuple) or len(tree.body.elts) != 2:
+            raise ModelError("line %d: %s needs two arguments" % (line_number, m.group(1)))
+        return (m.group(1),) + tuple(to_expression(a, line_number) for a in tree.body.elts)
+    return ("rate", parse_expression(text, line_number))
+
+
+class Code:
+    """The statements that compute the rates, shared by all the kernels"""
+
+    def __init__(self, model):
+        self.model = model
+        states = model.state_names()
+        parameters = model.parameters
+
+        algebraics = [(name, simplify(e, parameters)) for name, e in model.algebraics]
+
+        # The inf and tau (or alpha and beta) of the gates are algebraic variables named after the state
+        self.rates = {}
+        for state in states:
+            rate = model.rates[state]
+            if rate[0] == "rate":
+                self.rates[state] = ("rate", simplify(rate[1], parameters))
+            else:
+                suffixes = ("_inf", "_tau") if rate[0] == "gate" else ("_alpha", "_beta")
+                arguments = []
+                for suffix, e in zip(suffixes, rate[1:]):
+                    e = simplify(e, parameters)
+                    if e[0] not in ("num", "var"):
+                        name = state + suffix
+                        if name in parameters or name in states or any(a[0] == name for a in algebraics):
+                            raise ModelError("%s is already defined" % name)
+                        algebraics.append((name, e))
+                        e = ("var", name)
+                    arguments.append(e)
+                self.rates[state] = (rate[0],) + tuple(arguments)
+
+        defined = set(states) | set(parameters) | {"stim_current", "dt"}
+        for name, e in algebraics:
+            defined.add(name)
+        for name, e in algebraics:
+            unknown = variables(e, set()) - defined
+            if unknown:
+                raise ModelError("%s depends on the undefined %s" % (name, ", ".join(sorted(unknown))))
+
+        # Algebraic variables can be declared in any order. They are computed after their dependencies
+        by_name = dict(algebraics)
+        order = []
+        visiting = set()
+
+        def visit(name):
+            if name in order or name not in by_name:
+                return
+            if name in visiting:
+                raise ModelError("circular definition of %s" % name)
+            visiting.add(name)
+            for v in sorted(variables(by_name[name], set())):
+                visit(v)
+            visiting.discard(name)
+            order.append(name)
+
+        needed = set()
+        for rate in self.rates.values():
+            for e in rate[1:]:
+                variables(e, needed)
+        for name in [a[0] for a in algebraics]:
+            if name in needed:
+                visit(name)
+
+        self.algebraics = [(name, by_name[name]) for name in order]
+
+        rate_expressions = [self.euler_rate(state) for state in states]
+
+        counts = {}
+        for name, e in self.algebraics:
+            count_subexpressions(e, counts)
+        for e in rate_expressions:
+            count_subexpressions(e, counts)
+        for state in states:
+            if self.rates[state][0] != "rate":
+                count_subexpressions(self.rush_larsen_value(state), counts)
+
+        self.repeated = {e for e, n in counts.items() if n > 1}
+
+        # Statements: (name, C expression)
+        self.names = {}
+        self.statements = []
+        self.cse_count = 0
+
+        for name, e in self.algebraics:
+            self.statements.append((c_type(e), name, self.emit(e, top=True)))
+            if e[0] not in ("num", "var") and e not in self.names:
+                self.names[e] = name
+
+        self.euler = [self.emit(e, top=True) for e in rate_expressions]
+
+        # The statements added by the Rush-Larsen values are only computed by the Rush-Larsen method
+        num_statements = len(self.statements)
+        self.rush_larsen = {}
+        for state in states:
+            if self.rates[state][0] != "rate":
+                self.rush_larsen[state] = self.emit(self.rush_larsen_value(state), top=True)
+        self.rush_larsen_statements = self.statements[num_statements:]
+        self.statements = self.statements[:num_statements]
+
+        used = set()
+        for _, name, c in self.statements + self.rush_larsen_statements:
+            used |= set(re.findall(r"[A-Za-z_][A-Za-z0-9_]*", c))
+        for c in self.euler + list(self.rush_larsen.values()):
+            used |= set(re.findall(r"[A-Za-z_][A-Za-z0-9_]*", c))
+
+        self.used_parameters = [p for p in model.parameter_order if p in used]
+        self.uses_stim = "stim_current" in used
+
+    def euler_rate(self, state):
+        rate = self.rates[state]
+        y = ("var", state)
+        if rate[0] == "rate":
+            return rate[1]
+        if rate[0] == "gate":
+            return ("bin", "/", ("bin", "-", rate[1], y), rate[2])
+        alpha, beta = rate[1], rate[2]
+        return ("bin", "-", ("bin", "*", alpha, ("bin", "-", ("num", 1.0), y)), ("bin", "*", beta, y))
+
+    def rush_larsen_value(self, state):
+        rate = self.rates[state]
+        y = ("var", state)
+        if rate[0] == "gate":
+            inf, decay = rate[1], ("call", "exp", ("bin", "/", ("neg", ("var", "dt")), rate[2]))
+        else:
+            alpha, beta = rate[1], rate[2]
+            total = ("bin", "+", alpha, beta)
+            inf = ("bin", "/", alpha, total)
+            decay = ("call", "exp", ("bin", "*", ("neg", ("var", "dt")), total))
+        return ("bin", "+", inf, ("bin", "*", ("bin", "-", y, inf), decay))
+
+    def emit(self, e, top=False):
+        if e in self.names:
+            return self.names[e]
+
+        if not top and e in self.repeated:
+            c = self.emit(e, top=True)
+            name = "_cse_%d" % self.cse_count
+            self.cse_count += 1
+            self.statements.append((c_type(e), name, c))
+            self.names[e] = name
+            return name
+
+        kind = e[0]
+        if kind in ("num", "var"):
+            return to_c(e, {})
+        if kind == "call":
+            function = "safe_exp" if e[1] == "exp" else e[1]
+            return "%s(%s)" % (function, ", ".join(strip_outer_parentheses(self.emit(a)) for a in e[2:]))
+
+        parts = [self.emit(c) for c in children(e)]
+
+        if kind == "neg":
+            return "(-%s)" % parts[0]
+        if kind == "not":
+            return "(!%s)" % parts[0]
+        if kind == "and":
+            return "(%s && %s)" % tuple(parts)
+        if kind == "or":
+            return "(%s || %s)" % tuple(parts)
+        if kind == "select":
+            return "(%s ? %s : %s)" % tuple(parts)
+        return "(%s %s %s)" % (parts[0], e[1], parts[1])
+
+
+def strip_outer_parentheses(c):
+    if not (c.startswith("(") and c.endswith(")")):
+        return c
+    depth = 0
+    for i, ch in enumerate(c):
+        if ch == "(":
+            depth += 1
+        elif ch == ")":
+            depth -= 1
+            if depth == 0 and i != len(c) - 1:
+                return c
+    return c[1:-1]
+
+
+def body_lines(code, indent, state_reader, stim_reader):
+    """Declarations of the states, parameters and algebraic variables"""
+
+    model = code.model
+    lines = []
+
+    lines.append("// State variables")
+    for i, state in enumerate(model.state_names()):
+        lines.append("const real %s = %s;" % (state, state_reader(i)))
+
+    if code.uses_stim:
+        lines.append("const real stim_current = %s;" % stim_reader)
+
+    if code.used_parameters:
+        lines.append("")
+        lines.append("// Parameters")
+        for p in code.used_parameters:
+            lines.append("const real %s = %s;" % (p, number_to_c(model.parameters[p])))
+
+    if code.statements:
+        lines.append("")
+        lines.append("// Algebraic variables")
+        for c_type_name, name, c in code.statements:
+            lines.append("const %s %s = %s;" % (c_type_name, name, strip_outer_parentheses(c)))
+
+    return [(indent + l) if l else "" for l in lines]
+
+
+HEADER_TEMPLATE = """\
+// Generated by scripts/cell_model_generator/generate_cell_model.py from {model_file}. Do not edit.
+// {description}
+
+#ifndef {guard}
+#define {guard}
+
+#include "{common}"
+
+#define NEQ {neq}
+#define INITIAL_V ({initial_v})
+
+// Number of cells solved together by the fixed step CPU kernel
+#define GENERATED_BATCH_SIZE 8
+
+#ifdef __CUDACC__
+
+#include "{gpu_utils}"
+
+__global__ void kernel_set_model_initial_conditions(real *sv, int num_volumes, size_t pitch);
+
+__global__ void solve_gpu(real dt, real *sv, real *stim_currents, uint32_t *cells_to_solve, uint32_t num_cells_to_solve, int num_steps,
+                          size_t pitch);
+
+inline __device__ void RHS_gpu(real *sv, real *rDY_, real stim_current, int threadID_, real dt, size_t pitch);
+
+#endif
+
+void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt);
+void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int sv_id, struct ode_solver *solver);
+
+#endif // {guard}
+"""
+
+CPU_TEMPLATE = """\
+// Generated by scripts/cell_model_generator/generate_cell_model.py from {model_file}. Do not edit.
+// {description}
+
+#include "{name}.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// exp that never overflows to inf (so the code is also valid with -ffast-math). The results are the same for the
+// arguments where exp is finite
+static inline real safe_exp(real x) {{
+    const real max_x = (sizeof(real) == sizeof(float)) ? (real)88.0 : (real)709.0;
+    return exp(x > max_x ? max_x : x);
+}}
+
+GET_CELL_MODEL_DATA(init_cell_model_data) {{
+
+    if(get_initial_v)
+        cell_model->initial_v = INITIAL_V;
+    if(get_neq)
+        cell_model->number_of_ode_equations = NEQ;
+}}
+
+SET_ODE_INITIAL_CONDITIONS_CPU(set_model_initial_conditions_cpu) {{
+
+    log_info("Using {description} CPU model (generated)\\n");
+
+    uint32_t num_cells = solver->original_num_cells;
+    solver->sv = (real *)malloc(NEQ * num_cells * sizeof(real));
+
+    bool adpt = solver->adaptive;
+
+    if(adpt) {{
+        solver->ode_dt = (real *)malloc(num_cells * sizeof(real));
+
+        OMP(parallel for)
+        for(uint32_t i = 0; i < num_cells; i++) {{
+            solver->ode_dt[i] = solver->min_dt;
+        }}
+
+        solver->ode_previous_dt = (real *)calloc(num_cells, sizeof(real));
+        solver->ode_time_new = (real *)calloc(num_cells, sizeof(real));
+        log_info("Using Adaptive Euler model to solve the ODEs\\n");
+    }}
+
+    OMP(parallel for)
+    for(uint32_t i = 0; i < num_cells; i++) {{
+
+        real *sv = &solver->sv[i * NEQ];
+
+{initial_conditions}
+    }}
+}}
+
+// The [ode_solver] option method selects the fixed step method: euler (default) or rush_larsen
+static bool ode_method_is_rush_larsen(struct string_hash_entry *ode_extra_config) {{
+
+    static bool logged = false;
+    char *method = get_string_parameter(ode_extra_config, "method");
+
+    if(!method || STRINGS_EQUAL(method, "euler")) {{
+        return false;
+    }}
+
+    bool rush_larsen = STRINGS_EQUAL(method, "rush_larsen");
+
+    if(!logged) {{
+        if(rush_larsen) {{
+            log_info("Using the Rush-Larsen method to solve the ODEs on the CPU\\n");
+        }} else {{
+            log_warn("Invalid ODE method %s. Valid methods are euler and rush_larsen. Using euler!\\n", method);
+        }}
+        logged = true;
+    }}
+
+    return rush_larsen;
+}}
+
+void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt) {{
+
+{rhs_body}
+
+    // Rates
+{rhs_rates}
+}}
+
+// Advances the n cells of a batch num_steps steps of dt. sv has the NEQ states of the batch, GENERATED_BATCH_SIZE
+// values for each state
+static void solve_batch_cpu(real dt, real *sv, const real *stim_currents, uint32_t n, uint32_t num_steps, bool rush_larsen) {{
+
+    for(uint32_t step = 0; step < num_steps; step++) {{
+
+        OMP(simd)
+        for(uint32_t l = 0; l < n; l++) {{
+
+{batch_body}
+
+            if(rush_larsen) {{
+{batch_rush_larsen}
+            }} else {{
+{batch_euler}
+            }}
+        }}
+    }}
+}}
+
+SOLVE_MODEL_ODES(solve_model_odes_cpu) {{
+
+    uint32_t *cells_to_solve = ode_solver->cells_to_solve;
+    real *sv = ode_solver->sv;
+    real dt = ode_solver->min_dt;
+    uint32_t num_steps = ode_solver->num_steps;
+
+    bool adpt = ode_solver->adaptive;
+    bool rush_larsen = !adpt && ode_method_is_rush_larsen(ode_extra_config);
+
+    uint32_t partition[MAX_ODE_PARTITIONS + 1];
+    uint32_t num_parts = partition_cells_to_solve(ode_solver, dt, partition);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(uint32_t p = 0; p < num_parts; p++) {{
+
+        if(adpt) {{
+            for(uint32_t i = partition[p]; i < partition[p + 1]; i++) {{
+                uint32_t sv_id = cells_to_solve ? cells_to_solve[i] : i;
+                solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], current_t + dt, sv_id, ode_solver);
+            }}
+            continue;
+        }}
+
+        real batch_sv[NEQ * GENERATED_BATCH_SIZE];
+        uint32_t batch_ids[GENERATED_BATCH_SIZE];
+
+        for(uint32_t first = partition[p]; first < partition[p + 1]; first += GENERATED_BATCH_SIZE) {{
+
+            uint32_t n = partition[p + 1] - first;
+            if(n > GENERATED_BATCH_SIZE) {{
+                n = GENERATED_BATCH_SIZE;
+            }}
+
+            for(uint32_t l = 0; l < n; l++) {{
+                batch_ids[l] = cells_to_solve ? cells_to_solve[first + l] : first + l;
+                for(uint32_t k = 0; k < NEQ; k++) {{
+                    batch_sv[k * GENERATED_BATCH_SIZE + l] = sv[batch_ids[l] * NEQ + k];
+                }}
+            }}
+
+            solve_batch_cpu(dt, batch_sv, stim_currents + first, n, num_steps, rush_larsen);
+
+            for(uint32_t l = 0; l < n; l++) {{
+                for(uint32_t k = 0; k < NEQ; k++) {{
+                    sv[batch_ids[l] * NEQ + k] = batch_sv[k * GENERATED_BATCH_SIZE + l];
+                }}
+            }}
+        }}
+    }}
+}}
+
+void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int sv_id, struct ode_solver *solver) {{
+
+    const real _beta_safety_ = 0.8;
+
+    real rDY[NEQ];
+    real _tolerances_[NEQ];
+    real _aux_tol = 0.0;
+    real edos_old_aux_[NEQ];
+    real edos_new_euler_[NEQ];
+    real _k1__[NEQ];
+    real _k2__[NEQ];
+
+    // initializes the variables
+    solver->ode_previous_dt[sv_id] = solver->ode_dt[sv_id];
+
+    real *dt = &solver->ode_dt[sv_id];
+    real *time_new = &solver->ode_time_new[sv_id];
+    real *previous_dt = &solver->ode_previous_dt[sv_id];
+
+    if(*time_new + *dt > final_time) {{
+        *dt = final_time - *time_new;
+    }}
+
+    RHS_cpu(sv, rDY, stim_curr, *dt);
+    *time_new += *dt;
+
+    for(int i = 0; i < NEQ; i++) {{
+        _k1__[i] = rDY[i];
+    }}
+
+    const real rel_tol = solver->rel_tol;
+    const real abs_tol = solver->abs_tol;
+
+    const real __tiny_ = pow(abs_tol, 2.0);
+
+    real min_dt = solver->min_dt;
+    real max_dt = solver->max_dt;
+
+    while(1) {{
+
+        for(int i = 0; i < NEQ; i++) {{
+            edos_old_aux_[i] = sv[i];
+            edos_new_euler_[i] = _k1__[i] * *dt + edos_old_aux_[i];
+            sv[i] = edos_new_euler_[i];
+        }}
+
+        *time_new += *dt;
+        RHS_cpu(sv, rDY, stim_curr, *dt);
+        *time_new -= *dt; // step back
+
+        double greatestError = 0.0, auxError = 0.0;
+        for(int i = 0; i < NEQ; i++) {{
+            _k2__[i] = rDY[i];
+            _aux_tol = fabs(edos_new_euler_[i]) * rel_tol;
+            _tolerances_[i] = (abs_tol > _aux_tol) ? abs_tol : _aux_tol;
+            auxError = fabs(((*dt / 2.0) * (_k1__[i] - _k2__[i])) / _tolerances_[i]);
+            greatestError = (auxError > greatestError) ? auxError : greatestError;
+        }}
+
+        greatestError += __tiny_;
+        *previous_dt = *dt;
+        *dt = _beta_safety_ * (*dt) * sqrt(1.0f / greatestError);
+
+        if(*dt < min_dt) {{
+            *dt = min_dt;
+        }} else if(*dt > max_dt) {{
+            *dt = max_dt;
+        }}
+
+        if(*time_new + *dt > final_time) {{
+            *dt = final_time - *time_new;
+        }}
+
+        if(greatestError >= 1.0f && *dt > min_dt) {{
+            // rejects the step
+            for(int i = 0; i < NEQ; i++) {{
+                sv[i] = edos_old_aux_[i];
+            }}
+        }} else {{
+            if(greatestError >= 1.0) {{
+                printf("Accepting solution with error > %lf \\n", greatestError);
+            }}
+
+            for(int i = 0; i < NEQ; i++) {{
+                _k1__[i] = _k2__[i];
+                sv[i] = edos_new_euler_[i];
+            }}
+
+            if(*time_new + *previous_dt >= final_time) {{
+                if(final_time == *time_new) {{
+                    break;
+                }} else if(*time_new < final_time) {{
+                    *dt = *previous_dt = final_time - *time_new;
+                    *time_new += *previous_dt;
+                    break;
+                }}
+            }} else {{
+                *time_new += *previous_dt;
+            }}
+        }}
+    }}
+}}
+"""
+
+GPU_TEMPLATE = """\
+// Generated by scripts/cell_model_generator/generate_cell_model.py from {model_file}. Do not edit.
+// {description}
+
+#include "{name}.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define safe_exp exp
+
+extern "C" SET_ODE_INITIAL_CONDITIONS_GPU(set_model_initial_conditions_gpu) {{
+
+    log_info("Using {description} GPU model (generated)\\n");
+
+    uint32_t num_volumes = solver->original_num_cells;
+
+    if(solver->adaptive) {{
+        log_warn("The generated GPU models do not have an adaptive method. Using Euler with dt = %lf\\n", solver->min_dt);
+    }}
+
+    // execution configuration
+    const int GRID = (num_volumes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    size_t size = num_volumes * sizeof(real);
+    size_t pitch_h;
+
+    check_cuda_error(cudaMallocPitch((void **)&(solver->sv), &pitch_h, size, (size_t)NEQ));
+
+    kernel_set_model_initial_conditions<<<GRID, BLOCK_SIZE>>>(solver->sv, num_volumes, pitch_h);
+
+    check_cuda_error(cudaPeekAtLastError());
+    cudaDeviceSynchronize();
+    return pitch_h;
+}}
+
+extern "C" SOLVE_MODEL_ODES(solve_model_odes_gpu) {{
+
+    size_t num_cells_to_solve = ode_solver->num_cells_to_solve;
+    uint32_t *cells_to_solve = ode_solver->cells_to_solve;
+    real *sv = ode_solver->sv;
+    real dt = ode_solver->min_dt;
+    uint32_t num_steps = ode_solver->num_steps;
+
+    // execution configuration
+    const int GRID = ((int)num_cells_to_solve + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    size_t stim_currents_size = sizeof(real) * num_cells_to_solve;
+    size_t cells_to_solve_size = sizeof(uint32_t) * num_cells_to_solve;
+
+    real *stims_currents_device;
+    check_cuda_error(cudaMalloc((void **)&stims_currents_device, stim_currents_size));
+    check_cuda_error(cudaMemcpy(stims_currents_device, stim_currents, stim_currents_size, cudaMemcpyHostToDevice));
+
+    // the array cells to solve is passed when we are using and adaptive mesh
+    uint32_t *cells_to_solve_device = NULL;
+    if(cells_to_solve != NULL) {{
+        check_cuda_error(cudaMalloc((void **)&cells_to_solve_device, cells_to_solve_size));
+        check_cuda_error(cudaMemcpy(cells_to_solve_device, cells_to_solve, cells_to_solve_size, cudaMemcpyHostToDevice));
+    }}
+
+    solve_gpu<<<GRID, BLOCK_SIZE>>>(dt, sv, stims_currents_device, cells_to_solve_device, num_cells_to_solve, num_steps, ode_solver->pitch);
+
+    check_cuda_error(cudaPeekAtLastError());
+
+    check_cuda_error(cudaFree(stims_currents_device));
+    if(cells_to_solve_device)
+        check_cuda_error(cudaFree(cells_to_solve_device));
+}}
+
+__global__ void kernel_set_model_initial_conditions(real *sv, int num_volumes, size_t pitch) {{
+
+    int threadID = blockDim.x * blockIdx.x + threadIdx.x;
+
+    if(threadID < num_volumes) {{
+{gpu_initial_conditions}
+    }}
+}}
+
+// Solving the model for each cell in the tissue matrix ni x nj
+__global__ void solve_gpu(real dt, real *sv, real *stim_currents, uint32_t *cells_to_solve, uint32_t num_cells_to_solve, int num_steps,
+                          size_t pitch) {{
+
+    int threadID = blockDim.x * blockIdx.x + threadIdx.x;
+    int sv_id;
+
+    // Each thread solves one cell model
+    if(threadID < num_cells_to_solve) {{
+        if(cells_to_solve)
+            sv_id = cells_to_solve[threadID];
+        else
+            sv_id = threadID;
+
+        real rDY[NEQ];
+
+        for(int n = 0; n < num_steps; ++n) {{
+
+            RHS_gpu(sv, rDY, stim_currents[threadID], sv_id, dt, pitch);
+
+            for(int i = 0; i < NEQ; i++) {{
+                *((real *)((char *)sv + pitch * i) + sv_id) = dt * rDY[i] + *((real *)((char *)sv + pitch * i) + sv_id);
+            }}
+        }}
+    }}
+}}
+
+inline __device__ void RHS_gpu(real *sv, real *rDY_, real stim_current, int threadID_, real dt, size_t pitch) {{
+
+{gpu_body}
+
+    // Rates
+{gpu_rates}
+}}
+"""
+
+
+def indent_block(lines, indent):
+    return "\n".join((indent + l) if l else "" for l in lines)
+
+
+def generate(model_file, output_dir):
+
+    model = parse_model(model_file)
+    code = Code(model)
+
+    states = model.state_names()
+    name = model.name
+    description = model.description or name
+    relative_model_file = os.path.basename(model_file)
+
+    depth = os.path.relpath(os.path.abspath(output_dir), os.path.abspath(find_models_library(output_dir)))
+    prefix = "../" * (0 if depth == "." else len(depth.split(os.sep)))
+
+    initial_v = model.states[0][1]
+
+    header = HEADER_TEMPLATE.format(model_file=relative_model_file, description=description,
+                                    guard="MONOALG3D_MODEL_%s_H" % name.upper(), common=prefix + "model_common.h",
+                                    gpu_utils=prefix + "../gpu_utils/gpu_utils.h", neq=len(states), initial_v=initial_v)
+
+    initial_conditions = ["sv[%d] = %s; // %s %s" % (i, s[1], s[0], s[2]) for i, s in enumerate(model.states)]
+    gpu_initial_conditions = ["*((real *)((char *)sv + pitch * %d) + threadID) = %s; // %s %s" % (i, s[1], s[0], s[2])
+                              for i, s in enumerate(model.states)]
+
+    rhs_body = body_lines(code, "    ", lambda i: "sv[%d]" % i, "stim_current")
+    # RHS_cpu has stim_current and dt as arguments
+    rhs_body = [l for l in rhs_body if not l.strip().startswith("const real stim_current =")]
+
+    rhs_rates = ["    rDY_[%d] = %s;" % (i, strip_outer_parentheses(c)) for i, c in enumerate(code.euler)]
+
+    batch_body = body_lines(code, "            ", lambda i: "sv[%d * GENERATED_BATCH_SIZE + l]" % i, "stim_currents[l]")
+
+    batch_euler = []
+    batch_rush_larsen = ["                const %s %s = %s;" % (t, n, strip_outer_parentheses(c)) for t, n, c in code.rush_larsen_statements]
+    for i, state in enumerate(states):
+        target = "sv[%d * GENERATED_BATCH_SIZE + l]" % i
+        euler = "%s = dt * %s + %s;" % (target, code.euler[i], state)
+        batch_euler.append("                " + euler)
+        if state in code.rush_larsen:
+            batch_rush_larsen.append("                %s = %s;" % (target, strip_outer_parentheses(code.rush_larsen[state])))
+        else:
+            batch_rush_larsen.append("                " + euler)
+
+    gpu_body = body_lines(code, "    ", lambda i: "*((real *)((char *)sv + pitch * %d) + threadID_)" % i, "stim_current")
+    gpu_body = [l for l in gpu_body if not l.strip().startswith("const real stim_current =")]
+    gpu_rates = ["    rDY_[%d] = %s;" % (i, strip_outer_parentheses(c)) for i, c in enumerate(code.euler)]
+
+    cpu = CPU_TEMPLATE.format(model_file=relative_model_file, description=description, name=name,
+                              initial_conditions=indent_block(initial_conditions, "        "),
+                              rhs_body="\n".join(rhs_body), rhs_rates="\n".join(rhs_rates),
+                              batch_body="\n".join(batch_body), batch_euler="\n".join(batch_euler),
+                              batch_rush_larsen="\n".join(batch_rush_larsen))
+
+    gpu = GPU_TEMPLATE.format(model_file=relative_model_file, description=description, name=name,
+                              gpu_initial_conditions=indent_block(gpu_initial_conditions, "        "),
+                              gpu_body="\n".join(gpu_body), gpu_rates="\n".join(gpu_rates))
+
+    for extension, content in ((".h", header), (".c", cpu), (".cu", gpu)):
+        with open(os.path.join(output_dir, name + extension), "w") as f:
+            f.write(content)
+
+    print("Generated %s.h, %s.c and %s.cu in %s (%d states, %d algebraic variables, %d common subexpressions)" % (
+        name, name, name, output_dir, len(states), len(code.algebraics), code.cse_count))
+
+
+def find_models_library(directory):
+    """The generated code includes model_common.h relative to the directory of the model"""
+    current = os.path.abspath(directory)
+    while True:
+        if os.path.isfile(os.path.join(current, "model_common.h")):
+            return current
+        parent = os.path.dirname(current)
+        if parent == current:
+            raise ModelError("the output directory must be inside src/models_library")
+        current = parent
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        print("Usage: %s model_file [output_dir]" % sys.argv[0])
+        sys.exit(1)
+
+    model_file = sys.argv[1]
+    output_dir = sys.argv[2] if len(sys.argv) == 3 else (os.path.dirname(model_file) or ".")
+
+    try:
+        generate(model_file, output_dir)
+    except ModelError as e:
+        print("Error in %s: %s" % (model_file, e))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
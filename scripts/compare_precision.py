@@ -0,0 +1,131 @@
+# ==============================================================================================================================
+# Compares the activation times, APD90 and conduction velocity of two simulations saved with save_as_text_or_binary
+# (binary=false). It is used to check the accuracy of the single precision ODE kernels ([ode_solver] single_precision=true)
+# against the double precision ones, but any two simulations of the same mesh can be compared.
+# Only the first action potential of each cell is used.
+# ==============================================================================================================================
+import os
+import re
+import sys
+
+ACTIVATION_THRESHOLD = -40.0
+
+def read_simulation (output_dir, prefix, dt):
+    files = []
+    for name in os.listdir(output_dir):
+        match = re.match(r"^%s_it_(\d+)\.txt$" % re.escape(prefix), name)
+        if match:
+            files.append((int(match.group(1)), name))
+    files.sort()
+
+    times = []
+    cells = {}
+    for it, name in files:
+        times.append(it*dt)
+        with open(os.path.join(output_dir, name)) as f:
+            for line in f:
+                values = line.strip().split(",")
+                if len(values) < 4:
+                    continue
+                center = (float(values[0]), float(values[1]), float(values[2]))
+                cells.setdefault(center, []).append(float(values[-1]))
+
+    return times, cells
+
+# Time of the upward and downward crossings of value, linearly interpolated
+def crossing (times, vm, value, start, upward):
+    for i in range(start + 1, len(vm)):
+        if (upward and vm[i-1] < value <= vm[i]) or (not upward and vm[i-1] > value >= vm[i]):
+            return i, times[i-1] + (value - vm[i-1])*(times[i] - times[i-1])/(vm[i] - vm[i-1])
+    return None, None
+
+# Returns the activation time and the APD90 of a cell (None if the cell is not activated or not repolarized)
+def activation_and_apd (times, vm):
+    i_act, t_act = crossing(times, vm, ACTIVATION_THRESHOLD, 0, True)
+    if i_act is None:
+        return None, None
+
+    v_rest = vm[0]
+    v_max = max(vm[i_act:])
+    i_max = i_act + vm[i_act:].index(v_max)
+
+    i_rep, t_rep = crossing(times, vm, v_max - 0.9*(v_max - v_rest), i_max, False)
+    if i_rep is None:
+        return t_act, None
+
+    return t_act, t_rep - t_act
+
+# Least squares fit of the distance from the first activated cell against the activation time. The cells close to
+# the stimulus and to the end of the tissue are not used
+def conduction_velocity (activation):
+    if len(activation) < 2:
+        return None
+
+    first = min(activation, key=activation.get)
+    points = []
+    for center, t in activation.items():
+        d = sum((center[k] - first[k])**2 for k in range(3))**0.5
+        points.append((d, t))
+
+    max_d = max(p[0] for p in points)
+    points = [p for p in points if 0.25*max_d <= p[0] <= 0.75*max_d]
+    if len(points) < 2:
+        return None
+
+    n = len(points)
+    mean_d = sum(p[0] for p in points)/n
+    mean_t = sum(p[1] for p in points)/n
+    var_t = sum((p[1] - mean_t)**2 for p in points)
+    if var_t == 0:
+        return None
+
+    return sum((p[0] - mean_d)*(p[1] - mean_t) for p in points)/var_t
+
+def compare (name, a, b):
+    common = [c for c in a if c in b and a[c] is not None and b[c] is not None]
+    if not common:
+        print("%s: no cells to compare" % name)
+        return
+    errors = [abs(a[c] - b[c]) for c in common]
+    print("%s: max difference %g ms, mean difference %g ms (%d cells)" % (name, max(errors), sum(errors)/len(errors), len(common)))
+
+def main ():
+    if len(sys.argv) < 4:
+        print("----------------------------------------------------------------------------------------------------------------------")
+        print("Usage:> python %s <reference_output_dir> <output_dir> <dt> [file_prefix]" % sys.argv[0])
+        print("----------------------------------------------------------------------------------------------------------------------")
+        print("<reference_output_dir> = Output directory of the reference (double precision) simulation")
+        print("<output_dir> = Output directory of the simulation to be compared")
+        print("<dt> = dt_pde used in the simulations (the time of V_it_N.txt is N*dt)")
+        print("[file_prefix] = file_prefix of [save_result] (default V)")
+        print("----------------------------------------------------------------------------------------------------------------------")
+        return 1
+
+    dt = float(sys.argv[3])
+    prefix = sys.argv[4] if len(sys.argv) > 4 else "V"
+
+    results = []
+    for output_dir in sys.argv[1:3]:
+        times, cells = read_simulation(output_dir, prefix, dt)
+        activation = {}
+        apd = {}
+        for center, vm in cells.items():
+            activation[center], apd[center] = activation_and_apd(times, vm)
+        results.append((activation, apd))
+
+    (act_a, apd_a), (act_b, apd_b) = results
+
+    compare("Activation time", act_a, act_b)
+    compare("APD90", apd_a, apd_b)
+
+    cv_a = conduction_velocity({c: t for c, t in act_a.items() if t is not None})
+    cv_b = conduction_velocity({c: t for c, t in act_b.items() if t is not None})
+
+    if cv_a and cv_b:
+        # The mesh coordinates are in um and the times in ms
+        print("Conduction velocity: %g m/s (reference) %g m/s, relative difference %g %%" % (cv_a*1.0e-3, cv_b*1.0e-3, 100.0*abs(cv_b - cv_a)/cv_a))
+    else:
+        print("Conduction velocity: not enough activated cells")
+
+if __name__ == "__main__":
+    main()
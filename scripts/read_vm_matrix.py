@@ -0,0 +1,89 @@
+# ==============================================================================================================================
+# Reads the Vm_matrix.bin and Vm_matrix_index.bin files written by the save_vm_matrix save function
+# (see src/utils/vm_matrix.h) and prints the time series of a cell or the values of a frame.
+# The files are mapped in memory, so only the requested values are read.
+# ==============================================================================================================================
+import mmap
+import struct
+import sys
+
+HEADER_FORMAT = "<8sIII12x"
+INDEX_HEADER_FORMAT = "<8sI4x"
+FRAME_FORMAT = "<dQQ"
+VALUE_FORMATS = {0: "d", 1: "f", 2: "e"}
+
+class VmMatrix:
+    def __init__ (self, data_file_name, index_file_name):
+        self.data_file = open(data_file_name, "rb")
+        self.index_file = open(index_file_name, "rb")
+        self.data = mmap.mmap(self.data_file.fileno(), 0, access=mmap.ACCESS_READ)
+        index = self.index_file.read()
+
+        magic, version, value_type, self.decimation = struct.unpack_from(HEADER_FORMAT, self.data, 0)
+        index_magic, index_version = struct.unpack_from(INDEX_HEADER_FORMAT, index, 0)
+
+        if magic != b"MAVMDATA" or index_magic != b"MAVMINDX" or version != 1 or index_version != 1:
+            raise ValueError("Invalid Vm matrix files")
+
+        self.value_format = VALUE_FORMATS[value_type]
+        self.value_size = struct.calcsize(self.value_format)
+
+        # Frames that were not completely written are not used
+        self.frames = []
+        offset = struct.calcsize(INDEX_HEADER_FORMAT)
+        frame_size = struct.calcsize(FRAME_FORMAT)
+        while offset + frame_size <= len(index):
+            time, data_offset, num_cells = struct.unpack_from(FRAME_FORMAT, index, offset)
+            if data_offset + num_cells*self.value_size > len(self.data):
+                break
+            self.frames.append((time, data_offset, num_cells))
+            offset += frame_size
+
+    def times (self):
+        return [frame[0] for frame in self.frames]
+
+    def frame (self, i):
+        time, offset, num_cells = self.frames[i]
+        return list(struct.unpack_from("<%d%s" % (num_cells, self.value_format), self.data, offset))
+
+    def cell (self, cell):
+        values = []
+        for time, offset, num_cells in self.frames:
+            if cell < num_cells:
+                values.append((time, struct.unpack_from("<" + self.value_format, self.data, offset + cell*self.value_size)[0]))
+        return values
+
+    def close (self):
+        self.data.close()
+        self.data_file.close()
+        self.index_file.close()
+
+def main ():
+    if len(sys.argv) != 4 or sys.argv[2] not in ("cell", "frame"):
+        print("----------------------------------------------------------------------------------------------------------------------")
+        print("Usage:> python %s <output_dir> cell <cell_index>" % sys.argv[0])
+        print("        python %s <output_dir> frame <frame_index>" % sys.argv[0])
+        print("----------------------------------------------------------------------------------------------------------------------")
+        print("<output_dir> = Output directory of the simulation (with Vm_matrix.bin and Vm_matrix_index.bin)")
+        print("cell = Prints the time and the Vm of the cell in each frame")
+        print("frame = Prints the time of the frame and then the Vm of each cell")
+        print("----------------------------------------------------------------------------------------------------------------------")
+        return 1
+
+    output_dir = sys.argv[1]
+    index = int(sys.argv[3])
+
+    vm_matrix = VmMatrix(output_dir + "/Vm_matrix.bin", output_dir + "/Vm_matrix_index.bin")
+
+    if sys.argv[2] == "cell":
+        for time, value in vm_matrix.cell(index):
+            print("%g %g" % (time, value))
+    else:
+        print("%g" % vm_matrix.frames[index][0])
+        for value in vm_matrix.frame(index):
+            print("%g" % value)
+
+    vm_matrix.close()
+
+if __name__ == "__main__":
+    main()
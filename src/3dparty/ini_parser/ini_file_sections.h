@@ -27,6 +27,7 @@
 #define MODIFICATION_SECTION "modify"
 #define MODIFYDOMAIN_SECTION "modify_current_domain"
 #define CALC_ECG_SECTION "calc_ecg"
+#define ENSEMBLE_SECTION "ensemble"
 #define EXTRA_FUNCTION "extra_function"
 
 #define MATCH_SECTION_AND_NAME(s, n) strcmp(section, s) == 0 && strcmp(name, n) == 0
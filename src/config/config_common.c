@@ -101,6 +101,18 @@ void free_config_data(struct config *cm) {
 
     shfree(cm->config_data);
 
+    n = shlen(cm->value_cache);
+
+    for(size_t i = 0; i < n; i++) {
+        struct config_cached_value *cached = cm->value_cache[i].value;
+        free(cached->raw);
+        free(cached->components);
+        free(cached->component_is_valid);
+        free(cached);
+    }
+
+    shfree(cm->value_cache);
+
     free(cm->library_file_path);
     free(cm->main_function_name);
     free(cm->init_function_name);
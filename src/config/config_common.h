@@ -8,6 +8,26 @@
 #include "../common_types/common_types.h"
 #include <stdbool.h>
 
+// Typed values of a parameter, parsed once by fill_config_value_cache (see config_helpers.h).
+// An entry is used only while config_data still holds the same string, so rewriting a parameter makes it stale.
+struct config_cached_value {
+    char *raw; // copy of the value in config_data that was parsed
+
+    real_cpu number;
+    bool number_is_valid;
+
+    bool boolean;
+
+    int num_components; // components of a vector value ([a, b, c])
+    real_cpu *components;
+    bool *component_is_valid;
+};
+
+struct config_value_cache_entry {
+    char *key;
+    struct config_cached_value *value;
+};
+
 struct config {
     void *handle;
 
@@ -24,6 +44,7 @@ struct config {
     bool library_file_path_was_set;
 
     struct string_hash_entry *config_data;
+    struct config_value_cache_entry *value_cache;
 
     void *persistent_data;
 
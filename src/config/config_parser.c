@@ -12,10 +12,12 @@
 static const char *batch_opt_string = "c:h?";
 static const struct option long_batch_options[] = {{"config_file", required_argument, NULL, 'c'}};
 
-static const char *conversion_opt_string = "i:o:c:h?";
+static const char *conversion_opt_string = "i:o:c:n:h?";
 static const struct option long_conversion_options[] = {{"input", required_argument, NULL, 'i'},
                                                         {"output", required_argument, NULL, 'o'},
-                                                        {"config_file", required_argument, NULL, 'c'}};
+                                                        {"config_file", required_argument, NULL, 'c'},
+                                                        {"num_threads", required_argument, NULL, 'n'},
+                                                        {NULL, no_argument, NULL, 0}};
 
 static const char *fiber_conversion_opt_string = "f:e:n:a:h?";
 static const struct option long_fiber_conversion_options[] = {{"fib", required_argument, NULL, 'f'},
@@ -141,6 +143,7 @@ void display_conversion_usage(char **argv) {
     printf("--input  | -i [input]. Input directory or file. Default NULL.\n");
     printf("--output | -o [output]. Output directory to save the converted files. Default NULL.\n");
     printf("--config_file | -c [configuration_file_path]. ini file used to map alg mesh colums to vtk scalars (optional).\n");
+    printf("--num_threads | -n [num_threads]. Number of files converted in parallel. Default: number of cores.\n");
     printf("--help | -h. Shows this help and exit \n");
     exit(EXIT_FAILURE);
 }
@@ -229,6 +232,7 @@ struct conversion_options *new_conversion_options() {
     options->input = NULL;
     options->output = NULL;
     options->conversion_config_file = NULL;
+    options->num_threads = 0;
     sh_new_arena(options->extra_data_config);
     shdefault(options->extra_data_config, NULL);
     return options;
@@ -336,6 +340,10 @@ struct user_options *new_user_options() {
     sh_new_arena(user_args->ode_extra_config);
     shdefault(user_args->ode_extra_config, NULL);
 
+    user_args->ensemble_config = NULL;
+    sh_new_arena(user_args->ensemble_config);
+    shdefault(user_args->ensemble_config, NULL);
+
     user_args->domain_config = NULL;
     user_args->purkinje_config = NULL;
     user_args->extra_data_config = NULL;
@@ -1055,6 +1063,9 @@ void parse_conversion_options(int argc, char **argv, struct conversion_options *
         case 'c':
             user_args->conversion_config_file = strdup(optarg);
             break;
+        case 'n':
+            user_args->num_threads = (int)strtol(optarg, NULL, 10);
+            break;
         case 'h': /* fall-through is intentional */
         case '?':
             display_conversion_usage(argv);
@@ -1788,6 +1799,8 @@ int parse_config_file(void *user, const char *section, const char *name, const c
 
         set_common_data(pconfig->calc_ecg_config, name, value);
 
+    } else if(MATCH_SECTION(ENSEMBLE_SECTION)) {
+        shput(pconfig->ensemble_config, name, strdup(value));
     }
 
     else {
@@ -1985,6 +1998,12 @@ void options_to_ini_file(struct user_options *config, char *ini_file_path) {
         fprintf(ini_file, "\n");
     }
 
+    if(shlen(config->ensemble_config) > 0) {
+        WRITE_INI_SECTION(ENSEMBLE_SECTION);
+        WRITE_EXTRA_CONFIG(config->ensemble_config);
+        fprintf(ini_file, "\n");
+    }
+
     fclose(ini_file);
 }
 #undef WRITE_INI_SECTION
@@ -158,6 +158,9 @@ struct user_options {
     struct string_hash_entry *ode_extra_config;
     struct string_hash_entry *purkinje_ode_extra_config;
 
+    // [ensemble] section: section|name = list|... or range|... directives (the same syntax of the batch runner)
+    struct string_hash_entry *ensemble_config;
+
     real_cpu max_v, min_v;
 
 };
@@ -187,6 +190,7 @@ struct conversion_options {
     char *input;
     char *output;
     char *conversion_config_file;
+    int num_threads;
     struct string_voidp_hash_entry *extra_data_config;
 };
 
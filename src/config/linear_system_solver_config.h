@@ -15,6 +15,15 @@
                         uint32_t *number_of_iterations, real_cpu *error)
 typedef SOLVE_LINEAR_SYSTEM(linear_system_solver_fn);
 
+// Solves the system for num_rhs right-hand sides with the same matrix. x and b have the num_active_cells values of each
+// right-hand side one after the other (x has the initial guesses and receives the solutions). number_of_iterations
+// and error have one value for each right-hand side
+#define SOLVE_LINEAR_SYSTEM_MULTI_RHS(name)                                                                            \
+              void name(struct time_info *time_info, struct config *config, struct grid *the_grid,                     \
+                        uint32_t num_active_cells, struct cell_node **active_cells, uint32_t num_rhs,                  \
+                        real_cpu *x, const real_cpu *b, uint32_t *number_of_iterations, real_cpu *error)
+typedef SOLVE_LINEAR_SYSTEM_MULTI_RHS(linear_system_solver_multi_rhs_fn);
+
 #define INIT_LINEAR_SYSTEM(name)  void name(struct config *config, struct grid *the_grid, bool is_purkinje)
 typedef INIT_LINEAR_SYSTEM(init_linear_system_solver_fn);
 
@@ -114,4 +114,164 @@ bool get_matrix_parameter(real_cpu **v, const char *parameter, int nlin, int nco
     sdsfreesplitres(components, c);
 
     return true;
-}
\ No newline at end of file
+}
+
+static void free_config_cached_value(struct config_cached_value *cached) {
+    free(cached->raw);
+    free(cached->components);
+    free(cached->component_is_valid);
+    free(cached);
+}
+
+static struct config_cached_value *parse_config_value(const char *raw) {
+
+    struct config_cached_value *cached = malloc(sizeof(struct config_cached_value));
+
+    cached->raw = strdup(raw);
+
+    int expr_parse_error;
+    cached->number = (real_cpu)te_interp(raw, &expr_parse_error);
+    cached->number_is_valid = (expr_parse_error == 0);
+
+    cached->boolean = IS_TRUE(raw);
+
+    int c;
+
+    sds config_value = sdsnew(raw);
+
+    config_value = sdstrim(config_value, "[ ]");
+    sds *components = sdssplit(config_value, ",", &c);
+
+    cached->num_components = c;
+    cached->components = malloc(sizeof(real_cpu) * c);
+    cached->component_is_valid = malloc(sizeof(bool) * c);
+
+    for(int i = 0; i < c; i++) {
+        expr_parse_error = 0;
+        cached->components[i] = (real_cpu)te_interp(components[i], &expr_parse_error);
+        cached->component_is_valid[i] = (expr_parse_error == 0);
+    }
+
+    sdsfreesplitres(components, c);
+    sdsfree(config_value);
+
+    return cached;
+}
+
+void fill_config_value_cache(struct config *config) {
+
+    if(config == NULL) {
+        return;
+    }
+
+    if(config->value_cache == NULL) {
+        sh_new_strdup(config->value_cache);
+        shdefault(config->value_cache, NULL);
+    }
+
+    size_t n = shlen(config->config_data);
+
+    for(size_t i = 0; i < n; i++) {
+        const char *parameter = config->config_data[i].key;
+        const char *raw = config->config_data[i].value;
+
+        if(raw == NULL) {
+            continue;
+        }
+
+        struct config_cached_value *cached = shget(config->value_cache, parameter);
+
+        if(cached) {
+            if(strcmp(cached->raw, raw) == 0) {
+                continue;
+            }
+            free_config_cached_value(cached);
+        }
+
+        shput(config->value_cache, parameter, parse_config_value(raw));
+    }
+}
+
+static struct config_cached_value *get_config_cached_value(struct config *config, const char *parameter, const char *raw) {
+
+    if(config->value_cache == NULL) {
+        return NULL;
+    }
+
+    struct config_cached_value *cached = shget(config->value_cache, parameter);
+
+    // The parameter was rewritten after the cache was filled
+    if(cached && strcmp(cached->raw, raw) != 0) {
+        return NULL;
+    }
+
+    return cached;
+}
+
+bool get_config_number(real_cpu *number, struct config *config, const char *parameter, const char *raw) {
+
+    struct config_cached_value *cached = get_config_cached_value(config, parameter, raw);
+
+    if(cached) {
+        *number = cached->number;
+        return cached->number_is_valid;
+    }
+
+    int expr_parse_error;
+    *number = (real_cpu)te_interp(raw, &expr_parse_error);
+
+    return (expr_parse_error == 0);
+}
+
+bool get_config_boolean(struct config *config, const char *parameter, const char *raw) {
+
+    struct config_cached_value *cached = get_config_cached_value(config, parameter, raw);
+
+    if(cached) {
+        return cached->boolean;
+    }
+
+    return IS_TRUE(raw);
+}
+
+bool get_config_vector_parameter(real_cpu **v, struct config *config, const char *parameter, const char *raw, int n) {
+
+    struct config_cached_value *cached = get_config_cached_value(config, parameter, raw);
+
+    if(cached == NULL) {
+        return get_vector_parameter(v, raw, n);
+    }
+
+    *v = malloc(sizeof(real_cpu) * n);
+
+    for(int i = 0; i < n; i++) {
+        if(i >= cached->num_components || !cached->component_is_valid[i]) {
+            return false;
+        }
+        (*v)[i] = cached->components[i];
+    }
+
+    return true;
+}
+
+bool get_config_vector3_parameter(real_cpu v[3], struct config *config, const char *parameter, const char *raw) {
+
+    struct config_cached_value *cached = get_config_cached_value(config, parameter, raw);
+
+    if(cached == NULL) {
+        return get_vector3_parameter(v, raw);
+    }
+
+    if(cached->num_components != 3) {
+        return false;
+    }
+
+    for(int i = 0; i < 3; i++) {
+        if(!cached->component_is_valid[i]) {
+            return false;
+        }
+        v[i] = cached->components[i];
+    }
+
+    return true;
+}
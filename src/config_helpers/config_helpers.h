@@ -6,6 +6,7 @@
 #define MONOALG3D_CONFIG_HELPERS_H
 #include "../3dparty/tinyexpr/tinyexpr.h"
 #include "../common_types/common_types.h"
+#include "../config/config_common.h"
 #include "../monodomain/constants.h"
 #include <stdbool.h>
 #include <string.h>
@@ -20,6 +21,16 @@ bool get_vector_parameter(real_cpu **v, const char *parameter, int n);
 bool get_vector3_parameter(real_cpu v[3], const char *parameter);
 bool get_matrix_parameter(real_cpu **v, const char *parameter, int nlin, int ncol);
 
+// fill_config_value_cache parses the numeric, boolean and vector values of all parameters of a config once, after the
+// configuration is complete, so the GET_PARAMETER macros can be used in the functions called on every time step.
+// Lookups never modify the cache. A parameter that is missing from the cache, or that was rewritten after the cache was
+// filled, is parsed on each read and not cached.
+void fill_config_value_cache(struct config *config);
+bool get_config_number(real_cpu *number, struct config *config, const char *parameter, const char *raw);
+bool get_config_boolean(struct config *config, const char *parameter, const char *raw);
+bool get_config_vector_parameter(real_cpu **v, struct config *config, const char *parameter, const char *raw, int n);
+bool get_config_vector3_parameter(real_cpu v[3], struct config *config, const char *parameter, const char *raw);
+
 #define STRINGS_EQUAL(str1, str2) (strcmp((str1), (str2)) == 0)
 
 #define IS_TRUE(str) (strcmp((str), "true") == 0 || strcmp((str), "yes") == 0 || strcmp((str), "1") == 0)
@@ -59,31 +70,27 @@ bool get_matrix_parameter(real_cpu **v, const char *parameter, int nlin, int nco
         char *__config_char = get_string_parameter(config->config_data, parameter);                                                                            \
         (__success) = false;                                                                                                                                   \
         if(__config_char) {                                                                                                                                    \
-            int expr_parse_error__;                                                                                                                            \
-            real_cpu expr_parse_result__ = (real_cpu)te_interp(__config_char, &expr_parse_error__);                                                            \
-            (value) = (type)expr_parse_result__;                                                                                                               \
-            if(expr_parse_error__ == 0)                                                                                                                        \
-                (__success) = true;                                                                                                                            \
+            real_cpu __number;                                                                                                                                 \
+            (__success) = get_config_number(&__number, config, parameter, __config_char);                                                                      \
+            (value) = (type)__number;                                                                                                                          \
         }                                                                                                                                                      \
     } while(0)
 
 #define GET_PARAMETER_BOOLEAN_VALUE_OR_USE_DEFAULT(value, config, parameter)                                                                                   \
     do {                                                                                                                                                       \
-        char *value_char = NULL;                                                                                                                               \
-        GET_PARAMETER_STRING_VALUE_OR_USE_DEFAULT(value_char, config, parameter);                                                                              \
-        if(value_char != NULL) {                                                                                                                               \
-            (value) = IS_TRUE(value_char);                                                                                                                     \
+        char *__config_char = get_string_parameter(config->config_data, parameter);                                                                            \
+        if(__config_char) {                                                                                                                                    \
+            (value) = get_config_boolean(config, parameter, __config_char);                                                                                    \
         }                                                                                                                                                      \
-        free(value_char);                                                                                                                                      \
     } while(0)
 
 #define GET_PARAMETER_NUMERIC_VALUE_OR_USE_DEFAULT(type, value, config, parameter)                                                                             \
     do {                                                                                                                                                       \
         char *__config_char = get_string_parameter(config->config_data, parameter);                                                                            \
         if(__config_char) {                                                                                                                                    \
-            int expr_parse_error__;                                                                                                                            \
-            real_cpu expr_parse_result__ = (real_cpu)te_interp(__config_char, &expr_parse_error__);                                                            \
-            (value) = (type)expr_parse_result__;                                                                                                               \
+            real_cpu __number;                                                                                                                                 \
+            get_config_number(&__number, config, parameter, __config_char);                                                                                    \
+            (value) = (type)__number;                                                                                                                          \
         }                                                                                                                                                      \
     } while(0)
 
@@ -108,7 +115,7 @@ bool get_matrix_parameter(real_cpu **v, const char *parameter, int nlin, int nco
     do {                                                                                                                                                       \
         char *__config_char = get_string_parameter(config->config_data, parameter);                                                                            \
         if(__config_char) {                                                                                                                                    \
-            bool __success = get_vector_parameter(&value, __config_char, n);                                                                                   \
+            bool __success = get_config_vector_parameter(&value, config, parameter, __config_char, n);                                                         \
             if(!__success) {                                                                                                                                   \
                 REPORT_ERROR_ON_FUNCTION("Error parsing vector parameter!\n");                                                                                 \
             }                                                                                                                                                  \
@@ -119,7 +126,7 @@ bool get_matrix_parameter(real_cpu **v, const char *parameter, int nlin, int nco
     do {                                                                                                                                                       \
         char *__config_char = get_string_parameter(config->config_data, parameter);                                                                            \
         if(__config_char) {                                                                                                                                    \
-            bool __success = get_vector3_parameter(value, __config_char);                                                                                      \
+            bool __success = get_config_vector3_parameter(value, config, parameter, __config_char);                                                            \
             if(!__success) {                                                                                                                                   \
                 REPORT_ERROR_ON_FUNCTION("Error parsing vector parameter!\n");                                                                                 \
             }                                                                                                                                                  \
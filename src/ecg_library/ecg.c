@@ -182,24 +182,54 @@ static void get_leads(struct config *config) {
     }
 }
 
+// The samples are written using a large stdio buffer. In the binary format the file starts with the number of leads
+// (uint32_t) followed by one record of n_leads + 1 doubles (time and leads) per sample
+#define ECG_OUTPUT_BUFFER_SIZE (1024 * 1024)
+
+static void write_ecg_sample(struct pseudo_bidomain_persistent_data *data, real_cpu current_t) {
+
+    uint32_t n_leads = data->n_leads;
+
+    if(data->binary_output) {
+        double record[n_leads + 1];
+        record[0] = current_t;
+        for(uint32_t i = 0; i < n_leads; i++) {
+            record[i + 1] = -data->scale_factor * data->lead_sums[i];
+        }
+        fwrite(record, sizeof(double), n_leads + 1, data->output_file);
+    } else {
+        fprintf(data->output_file, "%lf ", current_t);
+        for(uint32_t i = 0; i < n_leads; i++) {
+            fprintf(data->output_file, "%lf ", -data->scale_factor * data->lead_sums[i]);
+        }
+        fprintf(data->output_file, "\n");
+    }
+}
+
 INIT_CALC_ECG(init_pseudo_bidomain_cpu) {
     config->persistent_data = CALLOC_ONE_TYPE(struct pseudo_bidomain_persistent_data);
 
-    // The filename for the ECG will be always the "OUTPUT_DIR/ecg.txt"
+    bool binary_output = false;
+    GET_PARAMETER_BOOLEAN_VALUE_OR_USE_DEFAULT(binary_output, config, "binary_output");
+    PSEUDO_BIDOMAIN_DATA->binary_output = binary_output;
+
+    // The filename for the ECG will be always the "OUTPUT_DIR/ecg.txt" (or "OUTPUT_DIR/ecg.bin" for the binary output)
     uint32_t nlen_output_dir = strlen(output_dir);
     char *filename = (char*)malloc(sizeof(char)*nlen_output_dir+10);
-    sprintf(filename, "%s/ecg.txt", output_dir);
+    sprintf(filename, "%s/ecg.%s", output_dir, binary_output ? "bin" : "txt");
     
     char *dir = get_dir_from_path(filename);
     create_dir(dir);
     free(dir);
 
-    PSEUDO_BIDOMAIN_DATA->output_file = fopen(filename, "w");
+    PSEUDO_BIDOMAIN_DATA->output_file = fopen(filename, binary_output ? "wb" : "w");
 
     if(PSEUDO_BIDOMAIN_DATA->output_file == NULL) {
         log_error_and_exit("init_pseudo_bidomain - Unable to open file %s!\n", filename);
     }
 
+    setvbuf(PSEUDO_BIDOMAIN_DATA->output_file, NULL, _IOFBF, ECG_OUTPUT_BUFFER_SIZE);
+
     real_cpu sigma_b = 1.0;
     GET_PARAMETER_NUMERIC_VALUE_OR_REPORT_ERROR(real_cpu, sigma_b, config, "sigma_b");
 
@@ -210,25 +240,27 @@ INIT_CALC_ECG(init_pseudo_bidomain_cpu) {
     PSEUDO_BIDOMAIN_DATA->scale_factor = 1.0 / (4.0 * M_PI * sigma_b);
 
     get_leads(config);
-    PSEUDO_BIDOMAIN_DATA->n_leads = arrlen(PSEUDO_BIDOMAIN_DATA->leads);
+    uint32_t n_leads = arrlen(PSEUDO_BIDOMAIN_DATA->leads);
+    PSEUDO_BIDOMAIN_DATA->n_leads = n_leads;
+
+    if(binary_output) {
+        fwrite(&n_leads, sizeof(uint32_t), 1, PSEUDO_BIDOMAIN_DATA->output_file);
+    }
 
     uint32_t n_active = the_grid->num_active_cells;
     struct cell_node **ac = the_grid->active_cells;
 
-    PSEUDO_BIDOMAIN_DATA->distances = MALLOC_ARRAY_OF_TYPE(real, PSEUDO_BIDOMAIN_DATA->n_leads * n_active);
-
-    PSEUDO_BIDOMAIN_DATA->beta_im = MALLOC_ARRAY_OF_TYPE(real, n_active);
-
-    // calc the distances from each volume to each electrode (r)
-    for(uint32_t i = 0; i < PSEUDO_BIDOMAIN_DATA->n_leads; i++) {
+    PSEUDO_BIDOMAIN_DATA->lead_sums = CALLOC_ARRAY_OF_TYPE(real_cpu, n_leads);
+    PSEUDO_BIDOMAIN_DATA->inv_distances = MALLOC_ARRAY_OF_TYPE(real, (size_t)n_leads * n_active);
 
-        struct point_3d lead = PSEUDO_BIDOMAIN_DATA->leads[i];
-
-        OMP(parallel for)
-        for(int j = 0; j < n_active; j++) {
-            uint32_t index = i * n_active + j;
-            struct point_3d center = ac[j]->center;
-            PSEUDO_BIDOMAIN_DATA->distances[index] = EUCLIDIAN_DISTANCE(lead, center);
+    // calc the distances from each volume to each electrode (r). All the leads of a cell are stored together, so
+    // the contribution of each cell is added to all leads in a single pass
+    OMP(parallel for)
+    for(uint32_t j = 0; j < n_active; j++) {
+        struct point_3d center = ac[j]->center;
+        for(uint32_t i = 0; i < n_leads; i++) {
+            struct point_3d lead = PSEUDO_BIDOMAIN_DATA->leads[i];
+            PSEUDO_BIDOMAIN_DATA->inv_distances[(size_t)j * n_leads + i] = 1.0 / EUCLIDIAN_DISTANCE(lead, center);
         }
     }
 
@@ -239,48 +271,47 @@ INIT_CALC_ECG(init_pseudo_bidomain_cpu) {
 
 CALC_ECG(pseudo_bidomain_cpu) {
     // use the equation described in https://www.ncbi.nlm.nih.gov/pmc/articles/PMC3378475/#FD7
+    // The volume of the cell divides beta_im and multiplies the integral, so it is not used here
     uint32_t n_active = the_grid->num_active_cells;
     struct cell_node **ac = the_grid->active_cells;
 
-    OMP(parallel for)
-    for(uint32_t i = 0; i < n_active; i++) {
-        struct element *cell_elements = ac[i]->elements;
-        size_t max_el = arrlen(cell_elements);
+    const uint32_t n_leads = PSEUDO_BIDOMAIN_DATA->n_leads;
+    const real *inv_distances = PSEUDO_BIDOMAIN_DATA->inv_distances;
+    real_cpu *lead_sums = PSEUDO_BIDOMAIN_DATA->lead_sums;
 
-        struct point_3d d = ac[i]->discretization;
-        real_cpu volume = d.x * d.y * d.z;
+    for(uint32_t i = 0; i < n_leads; i++) {
+        lead_sums[i] = 0.0;
+    }
+
+    OMP(parallel for reduction(+:lead_sums[:n_leads]))
+    for(uint32_t j = 0; j < n_active; j++) {
+        struct element *cell_elements = ac[j]->elements;
+        size_t max_el = arrlen(cell_elements);
 
-        PSEUDO_BIDOMAIN_DATA->beta_im[i] = 0;
+        real_cpu beta_im = 0.0;
 
         for(size_t el = 0; el < max_el; el++) {
-            PSEUDO_BIDOMAIN_DATA->beta_im[i] += cell_elements[el].value_ecg * cell_elements[el].cell->v / volume;
+            beta_im += cell_elements[el].value_ecg * cell_elements[el].cell->v;
         }
-    }
-
-    fprintf(PSEUDO_BIDOMAIN_DATA->output_file, "%lf ", time_info->current_t);
 
-    for(uint32_t i = 0; i < PSEUDO_BIDOMAIN_DATA->n_leads; i++) {
-        real_cpu local_sum = 0.0;
+        const real *cell_inv_distances = inv_distances + (size_t)j * n_leads;
 
-        OMP(parallel for reduction(+:local_sum))
-        for(uint32_t j = 0; j < n_active; j++) {
-            struct point_3d d = ac[j]->discretization;
-            real_cpu volume = d.x * d.y * d.z;
-
-            uint32_t index = i * n_active + j;
-            local_sum += ((PSEUDO_BIDOMAIN_DATA->beta_im[j] / PSEUDO_BIDOMAIN_DATA->distances[index])) * volume;
+        OMP(simd)
+        for(uint32_t i = 0; i < n_leads; i++) {
+            lead_sums[i] += beta_im * cell_inv_distances[i];
         }
-
-        fprintf(PSEUDO_BIDOMAIN_DATA->output_file, "%lf ", -PSEUDO_BIDOMAIN_DATA->scale_factor * local_sum);
     }
 
-    fprintf(PSEUDO_BIDOMAIN_DATA->output_file, "\n");
+    write_ecg_sample(PSEUDO_BIDOMAIN_DATA, time_info->current_t);
 }
 
 END_CALC_ECG(end_pseudo_bidomain_cpu) {
     fclose(PSEUDO_BIDOMAIN_DATA->output_file);
-    free(PSEUDO_BIDOMAIN_DATA->beta_im);
+    free(PSEUDO_BIDOMAIN_DATA->inv_distances);
+    free(PSEUDO_BIDOMAIN_DATA->lead_sums);
     arrfree(PSEUDO_BIDOMAIN_DATA->leads);
+    free(config->persistent_data);
+    config->persistent_data = NULL;
 }
 
 #ifdef COMPILE_CUDA
@@ -295,8 +326,28 @@ INIT_CALC_ECG(init_pseudo_bidomain_gpu) {
         return;
     }
 
-    //This is allocated when using the CPU code, but we do not need it in the gpu version
-    free(PSEUDO_BIDOMAIN_DATA->beta_im);
+    // The GPU version stores the distances of each lead together
+    uint32_t n_leads = PSEUDO_BIDOMAIN_DATA->n_leads;
+    uint32_t n_active = the_grid->num_active_cells;
+    struct cell_node **active_cells = the_grid->active_cells;
+
+    PSEUDO_BIDOMAIN_DATA->distances = MALLOC_ARRAY_OF_TYPE(real, n_leads * n_active);
+
+    for(uint32_t i = 0; i < n_leads; i++) {
+
+        struct point_3d lead = PSEUDO_BIDOMAIN_DATA->leads[i];
+
+        OMP(parallel for)
+        for(int j = 0; j < n_active; j++) {
+            uint32_t index = i * n_active + j;
+            struct point_3d center = active_cells[j]->center;
+            PSEUDO_BIDOMAIN_DATA->distances[index] = EUCLIDIAN_DISTANCE(lead, center);
+        }
+    }
+
+    // This is allocated when using the CPU code, but we do not need it in the gpu version
+    free(PSEUDO_BIDOMAIN_DATA->inv_distances);
+    PSEUDO_BIDOMAIN_DATA->inv_distances = NULL;
 
     check_cublas_error(cusparseCreate(&(PSEUDO_BIDOMAIN_DATA->cusparseHandle)));
     check_cublas_error(cublasCreate(&(PSEUDO_BIDOMAIN_DATA->cublasHandle)));
@@ -400,8 +451,6 @@ CALC_ECG(pseudo_bidomain_gpu) {
 
 #endif
 
-    fprintf(PSEUDO_BIDOMAIN_DATA->output_file, "%lf ", time_info->current_t);
-
     gpu_vec_div_vec(PSEUDO_BIDOMAIN_DATA->beta_im, PSEUDO_BIDOMAIN_DATA->d_volumes, PSEUDO_BIDOMAIN_DATA->beta_im, n_active);
 
     for(int i = 0; i < PSEUDO_BIDOMAIN_DATA->n_leads; i++) {
@@ -418,10 +467,10 @@ CALC_ECG(pseudo_bidomain_gpu) {
             cublasSdot(PSEUDO_BIDOMAIN_DATA->cublasHandle, n_active, PSEUDO_BIDOMAIN_DATA->tmp_data, 1, PSEUDO_BIDOMAIN_DATA->d_volumes, 1, &local_sum));
 #endif
 
-        fprintf(PSEUDO_BIDOMAIN_DATA->output_file, "%lf ", -PSEUDO_BIDOMAIN_DATA->scale_factor * local_sum);
+        PSEUDO_BIDOMAIN_DATA->lead_sums[i] = local_sum;
     }
 
-    fprintf(PSEUDO_BIDOMAIN_DATA->output_file, "\n");
+    write_ecg_sample(PSEUDO_BIDOMAIN_DATA, time_info->current_t);
 
 }
 
@@ -458,6 +507,8 @@ END_CALC_ECG(end_pseudo_bidomain_gpu) {
 
     fclose(persistent_data->output_file);
 
+    free(persistent_data->lead_sums);
+    arrfree(persistent_data->leads);
     free(persistent_data);
 }
 #endif
@@ -8,9 +8,12 @@
 
 struct pseudo_bidomain_persistent_data {
     real *distances;
+    real *inv_distances; // 1/r for each cell and lead, stored as [cell * n_leads + lead] (CPU version)
+    real_cpu *lead_sums;
     real *beta_im;
     struct point_3d *leads;
     FILE *output_file;
+    bool binary_output;
     real_cpu scale_factor;
     uint32_t n_leads;
 
@@ -471,7 +471,8 @@ SET_EXTRA_DATA (set_extra_data_mixed_tt3) {
     return (void*)extra_data;
 }
 
-// Initial condition - 'libToRORd_fkatp_mixed_endo_mid_epi.so' + transmurality + current modifiers (plain and cuboid)
+// Initial condition - 'libToRORd_fkatp_mixed_endo_mid_epi.so' + transmurality + current modifiers (plain and cuboid). The current
+// modifiers can vary per cell (see new_cell_parameter_table)
 SET_EXTRA_DATA(set_extra_data_mixed_torord_fkatp_epi_mid_endo) {
 
     uint32_t num_active_cells = the_grid->num_active_cells;
@@ -485,6 +486,7 @@ SET_EXTRA_DATA(set_extra_data_mixed_torord_fkatp_epi_mid_endo) {
 
     struct extra_data_for_torord *extra_data = NULL;
     extra_data = set_common_torord_data(config, num_active_cells);
+    set_torord_parameter_table(extra_data, config, the_grid);
 
     OMP(parallel for)
     for (int i = 0; i < num_active_cells; i++) {
@@ -4,7 +4,10 @@
 
 #include "helper_functions.h"
 #include <stdlib.h>
+#include "../3dparty/tinyexpr/tinyexpr.h"
+#include "../alg/grid/grid.h"
 #include "../config_helpers/config_helpers.h"
+#include "../logger/logger.h"
 
 
 struct extra_data_for_fibrosis* set_common_schemia_data(struct config *config, uint32_t num_cells) {
@@ -302,6 +305,7 @@ struct extra_data_for_torord * set_common_torord_data (struct config *config, ui
     extra_data->initial_ss_mid[42] = 2.438403e-23;
 
     extra_data->transmurality = MALLOC_ARRAY_OF_TYPE(real, num_cells);
+    extra_data->parameters = NULL;
 
     return extra_data;
 }
@@ -524,6 +528,7 @@ struct extra_data_for_torord * set_common_torord_dyncl_data (struct config *conf
     extra_data->initial_ss_mid[44] = 3.026203e+01;
 
     extra_data->transmurality = MALLOC_ARRAY_OF_TYPE(real, num_cells);
+    extra_data->parameters = NULL;
 
     return extra_data;
 }
@@ -849,4 +854,130 @@ struct extra_data_for_trovato * set_common_trovato_data (struct config *config,
     extra_data->IpCa_Multiplier = IpCa_Multiplier;
 
     return extra_data;
-}
\ No newline at end of file
+}
+
+// Builds a table with the columns names. Each column is read from the parameter of the same name in config:
+//   IKr_Multiplier = 0.5                      uniform value
+//   IKr_Multiplier = 1.0 - 0.5*x/20000.0      expression of the center (x, y, z) of each active cell
+// A column that is not in config has its default value in all cells
+struct cell_parameter_table *new_cell_parameter_table(struct config *config, struct grid *the_grid, uint32_t num_columns, const char *const *names,
+                                                      const real *default_values) {
+
+    uint32_t num_cells = the_grid->num_active_cells;
+    struct cell_node **ac = the_grid->active_cells;
+
+    double x, y, z;
+    te_variable vars[] = {{"x", &x}, {"y", &y}, {"z", &z}};
+
+    te_expr **expressions = MALLOC_ARRAY_OF_TYPE(te_expr *, num_columns);
+    real *uniform_values = MALLOC_ARRAY_OF_TYPE(real, num_columns);
+    uint32_t num_varying_columns = 0;
+
+    for(uint32_t c = 0; c < num_columns; c++) {
+
+        expressions[c] = NULL;
+        uniform_values[c] = default_values[c];
+
+        char *value = get_string_parameter(config->config_data, names[c]);
+
+        if(!value) {
+            continue;
+        }
+
+        int expr_parse_error;
+        double number = te_interp(value, &expr_parse_error);
+
+        if(expr_parse_error == 0) {
+            uniform_values[c] = (real)number;
+            continue;
+        }
+
+        expressions[c] = te_compile(value, vars, 3, &expr_parse_error);
+
+        if(!expressions[c]) {
+            log_error_and_exit("Error parsing %s = %s. The value has to be a number or an expression of x, y and z!\n", names[c], value);
+        }
+
+        num_varying_columns++;
+    }
+
+    size_t size = sizeof(struct cell_parameter_table) + num_columns * sizeof(real) + (size_t)num_varying_columns * num_cells * sizeof(real) +
+                  num_varying_columns * sizeof(uint32_t);
+
+    struct cell_parameter_table *table = (struct cell_parameter_table *)malloc(size);
+
+    table->num_cells = num_cells;
+    table->num_columns = num_columns;
+    table->num_varying_columns = num_varying_columns;
+    table->names = names;
+    table->uniform_values = (real *)(table + 1);
+    table->varying_values = table->uniform_values + num_columns;
+    table->varying_columns = (uint32_t *)(table->varying_values + (size_t)num_varying_columns * num_cells);
+
+    memcpy(table->uniform_values, uniform_values, num_columns * sizeof(real));
+
+    uint32_t v = 0;
+    for(uint32_t c = 0; c < num_columns; c++) {
+
+        if(!expressions[c]) {
+            continue;
+        }
+
+        real *values = table->varying_values + (size_t)v * num_cells;
+        double sum = 0.0;
+
+        // The variables of the expression are shared, so the cells are evaluated serially
+        for(uint32_t i = 0; i < num_cells; i++) {
+            x = ac[i]->center.x;
+            y = ac[i]->center.y;
+            z = ac[i]->center.z;
+            values[i] = (real)te_eval(expressions[c]);
+            sum += values[i];
+        }
+
+        table->varying_columns[v] = c;
+        table->uniform_values[c] = (num_cells > 0) ? (real)(sum / num_cells) : default_values[c];
+
+        log_info("%s varies per cell (mean %g)\n", names[c], table->uniform_values[c]);
+
+        te_free(expressions[c]);
+        v++;
+    }
+
+    free(expressions);
+    free(uniform_values);
+
+    return table;
+}
+
+// In the order of the extra parameters of the ToRORd models
+static const char *const torord_multiplier_names[] = {"INa_Multiplier",  "ICaL_Multiplier",  "Ito_Multiplier",   "INaL_Multiplier",  "IKr_Multiplier",
+                                                      "IKs_Multiplier",  "IK1_Multiplier",   "IKb_Multiplier",   "INaCa_Multiplier", "INaK_Multiplier",
+                                                      "INab_Multiplier", "ICab_Multiplier",  "IpCa_Multiplier",  "ICaCl_Multiplier", "IClb_Multiplier",
+                                                      "Jrel_Multiplier", "Jup_Multiplier"};
+
+#define NUM_TORORD_MULTIPLIERS (sizeof(torord_multiplier_names) / sizeof(torord_multiplier_names[0]))
+
+// The multipliers of the struct are replaced by the uniform values of the table, so the code that does not read the
+// table (the GPU solver and the pre-pacing) uses the mean of the multipliers that vary per cell. Both log a warning for
+// each varying multiplier
+void set_torord_parameter_table(struct extra_data_for_torord *extra_data, struct config *config, struct grid *the_grid) {
+
+    real *multipliers[NUM_TORORD_MULTIPLIERS] = {
+        &extra_data->INa_Multiplier,  &extra_data->ICaL_Multiplier, &extra_data->Ito_Multiplier,   &extra_data->INaL_Multiplier,
+        &extra_data->IKr_Multiplier,  &extra_data->IKs_Multiplier,  &extra_data->IK1_Multiplier,   &extra_data->IKb_Multiplier,
+        &extra_data->INaCa_Multiplier, &extra_data->INaK_Multiplier, &extra_data->INab_Multiplier,  &extra_data->ICab_Multiplier,
+        &extra_data->IpCa_Multiplier, &extra_data->ICaCl_Multiplier, &extra_data->IClb_Multiplier, &extra_data->Jrel_Multiplier,
+        &extra_data->Jup_Multiplier};
+
+    real default_values[NUM_TORORD_MULTIPLIERS];
+    for(uint32_t c = 0; c < NUM_TORORD_MULTIPLIERS; c++) {
+        default_values[c] = 1.0;
+    }
+
+    extra_data->parameters = new_cell_parameter_table(config, the_grid, NUM_TORORD_MULTIPLIERS, torord_multiplier_names, default_values);
+
+    for(uint32_t c = 0; c < NUM_TORORD_MULTIPLIERS; c++) {
+        *multipliers[c] = extra_data->parameters->uniform_values[c];
+    }
+}
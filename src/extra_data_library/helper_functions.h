@@ -5,12 +5,28 @@
 #ifndef MONOALG3D_C_EXTRA_DATA_HELPER_FUNCTIONS_H
 #define MONOALG3D_C_EXTRA_DATA_HELPER_FUNCTIONS_H
 
+#include <string.h>
 #include <unistd.h>
 #include "../common_types/common_types.h"
 #include "../config/config_common.h"
 
 #define SET_EXTRA_DATA_SIZE(value) *extra_data_size = (value)
 
+struct grid;
+
+// Per-cell parameters of a model, stored as columns. A uniform column only has its value in uniform_values. A column
+// that varies has one value for each active cell in varying_values (column after column) and its mean in
+// uniform_values. The table is allocated as a single block, so it can be released with free()
+struct cell_parameter_table {
+    uint32_t num_cells;
+    uint32_t num_columns;
+    uint32_t num_varying_columns;
+    const char *const *names;
+    real *uniform_values;
+    uint32_t *varying_columns;
+    real *varying_values;
+};
+
 struct extra_data_for_fibrosis {
     real atpi;
     real Ko;
@@ -58,6 +74,7 @@ struct extra_data_for_torord {
     real *initial_ss_epi;
     real *initial_ss_mid;
     real *transmurality;
+    struct cell_parameter_table *parameters; // The multipliers above, in the same order
 };
 
 struct extra_data_for_torord_land {
@@ -127,4 +144,21 @@ struct extra_data_for_torord * set_common_torord_dyncl_data (struct config *conf
 struct extra_data_for_torord_land * set_common_torord_Land_data (struct config *config, uint32_t num_cells);
 struct extra_data_for_trovato * set_common_trovato_data (struct config *config, uint32_t num_cells);
 
+struct cell_parameter_table *new_cell_parameter_table(struct config *config, struct grid *the_grid, uint32_t num_columns, const char *const *names,
+                                                      const real *default_values);
+void set_torord_parameter_table(struct extra_data_for_torord *extra_data, struct config *config, struct grid *the_grid);
+
+// Copies the uniform values of all columns to row
+static inline void cell_parameter_table_get_uniform_row(const struct cell_parameter_table *table, real *row) {
+    memcpy(row, table->uniform_values, table->num_columns * sizeof(real));
+}
+
+// Replaces the columns of row that vary per cell by the values of the cell. The other columns are not changed, so
+// row only has to be filled with the uniform values once
+static inline void cell_parameter_table_set_cell_values(const struct cell_parameter_table *table, uint32_t cell, real *row) {
+    for(uint32_t c = 0; c < table->num_varying_columns; c++) {
+        row[table->varying_columns[c]] = table->varying_values[(size_t)c * table->num_cells + cell];
+    }
+}
+
 #endif // MONOALG3D_C_EXTRA_DATA_HELPER_FUNCTIONS_H
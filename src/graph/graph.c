@@ -1,5 +1,7 @@
 #include "graph.h"
 
+#include <string.h>
+
 struct graph* new_graph () {
     struct graph *result = MALLOC_ONE_TYPE(struct graph);
     result->last_node = NULL;
@@ -7,6 +9,7 @@ struct graph* new_graph () {
     result->total_nodes = 0;
     result->total_edges = 0;
     result->has_point_data = false;
+    result->csr = NULL;
 
     return result;
 }
@@ -48,6 +51,7 @@ void free_graph (struct graph *g) {
         free_list_nodes(g);
     }
 
+    free_graph_csr(g->csr);
     free(g);
 }
 
@@ -78,6 +82,9 @@ void insert_edge_graph (struct graph *g, const uint32_t id_1, const uint32_t id_
     n1->num_edges++;
     // Increment the total number of edges from the graph
     g->total_edges++;
+
+    free_graph_csr(g->csr);
+    g->csr = NULL;
 }
 
 void insert_node_graph (struct graph *g, const real_cpu pos[], const real_cpu sigma) {
@@ -93,6 +100,9 @@ void insert_node_graph (struct graph *g, const real_cpu pos[], const real_cpu si
         g->last_node->next = node;
         g->last_node = g->last_node->next;
     }
+
+    free_graph_csr(g->csr);
+    g->csr = NULL;
 }
 
 struct node* new_node (uint32_t id, const real_cpu pos[], const real_cpu sigma) {
@@ -134,63 +144,206 @@ struct node* search_node (struct graph *g, const uint32_t id) {
     return NULL;
 }
 
-double* dijkstra (struct graph *g, const uint32_t src_id) {
+struct graph_csr* get_graph_csr (struct graph *g) {
+    assert(g);
+
+    if (g->csr) {
+        return g->csr;
+    }
 
-    // Initialize the shortest distance array
     uint32_t num_nodes = g->total_nodes;
-    double *dist = (double*)malloc(sizeof(double)*num_nodes);
-    for (uint32_t i = 0; i < num_nodes; i++) dist[i] = __DBL_MAX__;
-    dist[src_id] = 0.0;
-
-    pqueue_t *pq;
-    node_t   *ns;
-    node_t   *n;
-
-    // Initialize the priority queue
-    ns = (struct node_t*)malloc(num_nodes * sizeof(node_t));
-    pq = pqueue_init(num_nodes, cmp_pri, get_pri, set_pri, get_pos, set_pos);
-    if (!(ns && pq)) {
+    struct graph_csr *csr = MALLOC_ONE_TYPE(struct graph_csr);
+
+    csr->num_nodes = num_nodes;
+    csr->offsets = (uint32_t*)malloc(sizeof(uint32_t)*(num_nodes+1));
+    csr->targets = (uint32_t*)malloc(sizeof(uint32_t)*g->total_edges);
+    csr->weights = (real_cpu*)malloc(sizeof(real_cpu)*g->total_edges);
+
+    // The nodes are stored in the list in the order of their ids
+    uint32_t k = 0;
+    struct node *n = g->list_nodes;
+    for (uint32_t i = 0; i < num_nodes; i++) {
+        assert(n && n->id == i);
+        csr->offsets[i] = k;
+
+        struct edge *e = n->list_edges;
+        while (e != NULL) {
+            csr->targets[k] = e->id;
+            csr->weights[k] = e->w;
+            k++;
+            e = e->next;
+        }
+        n = n->next;
+    }
+    csr->offsets[num_nodes] = k;
+
+    g->csr = csr;
+
+    return csr;
+}
+
+void free_graph_csr (struct graph_csr *csr) {
+    if (!csr) return;
+
+    free(csr->offsets);
+    free(csr->targets);
+    free(csr->weights);
+    free(csr);
+}
+
+// Binary min-heap of node ids keyed by dist. pos[v] is the position of v in the heap or UINT32_MAX when v is not in it,
+// so the priority of a node can be decreased in place.
+struct dijkstra_heap {
+    uint32_t size;
+    uint32_t *nodes;
+    uint32_t *pos;
+    const double *dist;
+};
+
+static void heap_move_up (struct dijkstra_heap *h, uint32_t i) {
+    uint32_t v = h->nodes[i];
+    double d = h->dist[v];
+
+    while (i > 0) {
+        uint32_t parent = (i-1)/2;
+        uint32_t p = h->nodes[parent];
+        if (h->dist[p] <= d) break;
+        h->nodes[i] = p;
+        h->pos[p] = i;
+        i = parent;
+    }
+
+    h->nodes[i] = v;
+    h->pos[v] = i;
+}
+
+static void heap_move_down (struct dijkstra_heap *h, uint32_t i) {
+    uint32_t v = h->nodes[i];
+    double d = h->dist[v];
+
+    while (true) {
+        uint32_t child = 2*i+1;
+        if (child >= h->size) break;
+        if (child+1 < h->size && h->dist[h->nodes[child+1]] < h->dist[h->nodes[child]]) child++;
+
+        uint32_t c = h->nodes[child];
+        if (d <= h->dist[c]) break;
+        h->nodes[i] = c;
+        h->pos[c] = i;
+        i = child;
+    }
+
+    h->nodes[i] = v;
+    h->pos[v] = i;
+}
+
+static void heap_push_or_decrease (struct dijkstra_heap *h, uint32_t v) {
+    if (h->pos[v] == UINT32_MAX) {
+        h->nodes[h->size] = v;
+        h->pos[v] = h->size;
+        h->size++;
+    }
+    heap_move_up(h,h->pos[v]);
+}
+
+static uint32_t heap_pop (struct dijkstra_heap *h) {
+    uint32_t top = h->nodes[0];
+    h->pos[top] = UINT32_MAX;
+    h->size--;
+
+    if (h->size > 0) {
+        h->nodes[0] = h->nodes[h->size];
+        heap_move_down(h,0);
+    }
+
+    return top;
+}
+
+// Shortest distance from the nearest of the sources to every node (__DBL_MAX__ for the unreachable ones).
+// The dist array must have csr->num_nodes elements.
+void dijkstra_csr (const struct graph_csr *csr, const uint32_t *src_ids, const uint32_t num_sources, double *dist) {
+
+    uint32_t num_nodes = csr->num_nodes;
+
+    struct dijkstra_heap h;
+    h.size = 0;
+    h.dist = dist;
+    h.nodes = (uint32_t*)malloc(sizeof(uint32_t)*num_nodes);
+    h.pos = (uint32_t*)malloc(sizeof(uint32_t)*num_nodes);
+
+    if (num_nodes > 0 && !(h.nodes && h.pos)) {
         fprintf(stderr,"[graph] ERROR! Could not allocate priority queue!\n");
         exit(EXIT_FAILURE);
     }
 
-    // Enqueue the source node
-    ns[src_id].pri = 0.0;
-    ns[src_id].val = src_id;
-    pqueue_insert(pq, &ns[src_id]);
+    for (uint32_t i = 0; i < num_nodes; i++) {
+        dist[i] = __DBL_MAX__;
+        h.pos[i] = UINT32_MAX;
+    }
+
+    for (uint32_t i = 0; i < num_sources; i++) {
+        uint32_t src = src_ids[i];
+        assert(src < num_nodes);
+        dist[src] = 0.0;
+        heap_push_or_decrease(&h,src);
+    }
+
+    while (h.size > 0) {
 
-    while ((n = (node_t*)pqueue_pop(pq))) {
+        uint32_t u = heap_pop(&h);
+        double d = dist[u];
 
-        double d = n->pri;
-        uint32_t u = n->val;
+        for (uint32_t k = csr->offsets[u]; k < csr->offsets[u+1]; k++) {
+            uint32_t v = csr->targets[k];
+            double new_dist = d + csr->weights[k];
 
-        if (d > dist[u]) {
-            continue;
+            if (new_dist < dist[v]) {
+                dist[v] = new_dist;
+                heap_push_or_decrease(&h,v);
+            }
         }
+    }
+
+    free(h.nodes);
+    free(h.pos);
+}
 
-        struct node *u_node = search_node(g,u);
-        struct edge *tmp = u_node->list_edges;
+double* dijkstra_multi_source (struct graph *g, const uint32_t *src_ids, const uint32_t num_sources) {
+    struct graph_csr *csr = get_graph_csr(g);
 
-        while (tmp != NULL) {
-            uint32_t v = tmp->id;
-            double w = tmp->w;
+    double *dist = (double*)malloc(sizeof(double)*csr->num_nodes);
+    dijkstra_csr(csr,src_ids,num_sources,dist);
 
-            if (dist[u] + w < dist[v]) {
-                dist[v] = dist[u] + w;
+    return dist;
+}
 
-                ns[v].pri = dist[v];
-                ns[v].val = v;
-                pqueue_insert(pq, &ns[v]);
-            }
+double* dijkstra (struct graph *g, const uint32_t src_id) {
+    return dijkstra_multi_source(g,&src_id,1);
+}
 
-            tmp = tmp->next;
+// Shortest distance from the sources to each terminal of the graph. The terminal ids are returned in increasing order
+// and both arrays have num_terminals elements.
+double* dijkstra_terminals (struct graph *g, const uint32_t *src_ids, const uint32_t num_sources, uint32_t **terminal_ids, uint32_t *num_terminals) {
+    struct graph_csr *csr = get_graph_csr(g);
+
+    double *dist = (double*)malloc(sizeof(double)*csr->num_nodes);
+    dijkstra_csr(csr,src_ids,num_sources,dist);
+
+    // Same criteria as is_terminal()
+    uint32_t n = 0;
+    uint32_t *ids = (uint32_t*)malloc(sizeof(uint32_t)*csr->num_nodes);
+    for (uint32_t i = 1; i < csr->num_nodes; i++) {
+        if (csr->offsets[i+1] - csr->offsets[i] == 1) {
+            ids[n] = i;
+            dist[n] = dist[i];
+            n++;
         }
     }
 
-    pqueue_free(pq);
-    free(ns);
+    *terminal_ids = (uint32_t*)realloc(ids,sizeof(uint32_t)*(n > 0 ? n : 1));
+    *num_terminals = n;
 
-    return dist;
+    return (double*)realloc(dist,sizeof(double)*(n > 0 ? n : 1));
 }
 
 void print_graph (struct graph *g) {
@@ -14,10 +14,10 @@
 
 #include "../common_types/common_types.h"
 
-#include "pqueue.h"
 
 struct node;
 struct edge;
+struct graph_csr;
 
 struct node {
     uint32_t id;
@@ -54,11 +54,23 @@ struct graph {
 
     char *pmj_location_filename;
 
+    // Built on demand by get_graph_csr() and released when the graph changes
+    struct graph_csr *csr;
+
     bool has_pmj_location;
     bool has_point_data;
     bool calc_retropropagation;
 };
 
+// Adjacency array (CSR) of the graph. The edges of node i are targets/weights[offsets[i]..offsets[i+1]-1],
+// in the same order as in its list_edges
+struct graph_csr {
+    uint32_t num_nodes;
+    uint32_t *offsets;
+    uint32_t *targets;
+    real_cpu *weights;
+};
+
 struct node* new_node (uint32_t id, const real_cpu pos[], const real_cpu sigma);
 struct edge* new_edge (uint32_t id, real_cpu w, struct node *dest);
 struct graph* new_graph ();
@@ -75,42 +87,14 @@ void free_list_edges (struct node *n);
 real_cpu calc_norm (const real_cpu x1, const real_cpu y1, const real_cpu z1,\
                   const real_cpu x2, const real_cpu y2, const real_cpu z2);
 
+struct graph_csr* get_graph_csr (struct graph *g);
+void free_graph_csr (struct graph_csr *csr);
+
 double* dijkstra (struct graph *g, const uint32_t src_id);
+double* dijkstra_multi_source (struct graph *g, const uint32_t *src_ids, const uint32_t num_sources);
+void dijkstra_csr (const struct graph_csr *csr, const uint32_t *src_ids, const uint32_t num_sources, double *dist);
+double* dijkstra_terminals (struct graph *g, const uint32_t *src_ids, const uint32_t num_sources, uint32_t **terminal_ids, uint32_t *num_terminals);
 
 bool is_terminal (const struct node *n);
 
-// --------------------------------------------------------------------------------
-// PQUEUE library
-typedef struct node_t {
-    pqueue_pri_t pri;
-    uint32_t     val;
-    size_t       pos;
-} node_t;
-
-
-static int cmp_pri(pqueue_pri_t next, pqueue_pri_t curr) {
-    return (next > curr);           // equivalent to std::greater<int>()
-}
-
-
-static pqueue_pri_t get_pri(void *a) {
-    return ((node_t *) a)->pri;
-}
-
-
-static void set_pri(void *a, pqueue_pri_t pri) {
-    ((node_t *) a)->pri = pri;
-}
-
-
-static size_t get_pos(void *a) {
-    return ((node_t *) a)->pos;
-}
-
-
-static void set_pos(void *a, size_t pos) {
-    ((node_t *) a)->pos = pos;
-}
-
-
 #endif //MONOALG3D_GRAPH_H
@@ -10,4 +10,4 @@ fi
 
 CHECK_CUSTOM_FILE
 
-COMPILE_SHARED_LIB "default_linear_system_solver" "linear_system_solver.c ${CUSTOM_FILE}" "gpu_solvers_cublas_12.c gpu_solvers_cublas_11.c gpu_solvers_cublas_10.c" "alg config_helpers utils tinyexpr" "$EXTRA_CUDA_LIBS" "$CUDA_LIBRARY_PATH $CUDA_MATH_LIBRARY_PATH $AMGX_LIBRARY_PATH"
+COMPILE_SHARED_LIB "default_linear_system_solver" "linear_system_solver.c ${CUSTOM_FILE}" "cpu_stencil_solver.c cpu_multi_rhs_solver.c cpu_tree_solver.c gpu_solvers_cublas_12.c gpu_solvers_cublas_11.c gpu_solvers_cublas_10.c" "alg config_helpers utils tinyexpr" "$EXTRA_CUDA_LIBS" "$CUDA_LIBRARY_PATH $CUDA_MATH_LIBRARY_PATH $AMGX_LIBRARY_PATH"
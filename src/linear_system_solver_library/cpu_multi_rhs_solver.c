@@ -0,0 +1,344 @@
+//
+// Conjugate gradient for many right-hand sides with the same matrix (e.g. the members of an ensemble). The values of
+// all right-hand sides of a cell are stored together, so each iteration reads the matrix (the elements of the cells
+// or the matrix-free stencil) only once to multiply all search directions. Each right-hand side has its own alpha,
+// beta and stop criteria, and the ones that converge are not updated anymore.
+//
+
+struct multi_rhs_persistent_data {
+    uint32_t num_cells;
+    uint32_t num_rhs;
+
+    // num_rhs values for each cell. p is indexed by the dense position of the cells when the stencil is used
+    real_cpu *x, *r, *z, *Ap, *p;
+
+    // One value for each right-hand side
+    real_cpu *rTr, *rTz, *r1Tr1, *r1Tz1, *pTAp, *alpha, *beta;
+    uint32_t *active;
+};
+
+static void free_multi_rhs_persistent_data(struct multi_rhs_persistent_data *data) {
+
+    if(!data) return;
+
+    free(data->x);
+    free(data->r);
+    free(data->z);
+    free(data->Ap);
+    free(data->p);
+    free(data->rTr);
+    free(data->rTz);
+    free(data->r1Tr1);
+    free(data->r1Tz1);
+    free(data->pTAp);
+    free(data->alpha);
+    free(data->beta);
+    free(data->active);
+    free(data);
+}
+
+// The arrays are kept between the calls and allocated again only when the number of cells or right-hand sides changes
+static struct multi_rhs_persistent_data *get_multi_rhs_persistent_data(struct multi_rhs_persistent_data *data, struct stencil_persistent_data *stencil,
+                                                                       uint32_t num_cells, uint32_t num_rhs) {
+
+    if(data && data->num_cells == num_cells && data->num_rhs == num_rhs) {
+        return data;
+    }
+
+    free_multi_rhs_persistent_data(data);
+
+    data = CALLOC_ONE_TYPE(struct multi_rhs_persistent_data);
+
+    size_t size = (size_t)num_cells * num_rhs;
+
+    // The dense array of the stencil has a layer of zeros around the mesh
+    size_t p_size = size;
+    if(stencil) {
+        uint64_t sx = stencil->nx + 2 * (stencil->nx > 1), sy = stencil->ny + 2 * (stencil->ny > 1), sz = stencil->nz + 2 * (stencil->nz > 1);
+        p_size = (size_t)(sx * sy * sz) * num_rhs;
+    }
+
+    data->num_cells = num_cells;
+    data->num_rhs = num_rhs;
+    data->x = MALLOC_ARRAY_OF_TYPE(real_cpu, size);
+    data->r = MALLOC_ARRAY_OF_TYPE(real_cpu, size);
+    data->z = MALLOC_ARRAY_OF_TYPE(real_cpu, size);
+    data->Ap = MALLOC_ARRAY_OF_TYPE(real_cpu, size);
+    data->p = CALLOC_ARRAY_OF_TYPE(real_cpu, p_size);
+
+    data->rTr = MALLOC_ARRAY_OF_TYPE(real_cpu, num_rhs);
+    data->rTz = MALLOC_ARRAY_OF_TYPE(real_cpu, num_rhs);
+    data->r1Tr1 = MALLOC_ARRAY_OF_TYPE(real_cpu, num_rhs);
+    data->r1Tz1 = MALLOC_ARRAY_OF_TYPE(real_cpu, num_rhs);
+    data->pTAp = MALLOC_ARRAY_OF_TYPE(real_cpu, num_rhs);
+    data->alpha = MALLOC_ARRAY_OF_TYPE(real_cpu, num_rhs);
+    data->beta = MALLOC_ARRAY_OF_TYPE(real_cpu, num_rhs);
+    data->active = MALLOC_ARRAY_OF_TYPE(uint32_t, num_rhs);
+
+    return data;
+}
+
+// Computes Ap for all right-hand sides and their pTAp, reading the elements of each cell once
+static void elements_spmv_multi_rhs(struct cell_node **cells, struct multi_rhs_persistent_data *data) {
+
+    const uint32_t num_cells = data->num_cells;
+    const uint32_t num_rhs = data->num_rhs;
+    const real_cpu *p = data->p;
+    real_cpu *Ap = data->Ap;
+    real_cpu *pTAp = data->pTAp;
+
+    for(uint32_t k = 0; k < num_rhs; k++) {
+        pTAp[k] = 0.0;
+    }
+
+    OMP(parallel for reduction(+ : pTAp[:num_rhs]))
+    for(uint32_t i = 0; i < num_cells; i++) {
+
+        struct element *cell_elements = cells[i]->elements;
+        size_t max_el = arrlen(cell_elements);
+
+        real_cpu *api = Ap + (size_t)i * num_rhs;
+        const real_cpu *pi = p + (size_t)i * num_rhs;
+
+        for(uint32_t k = 0; k < num_rhs; k++) {
+            api[k] = 0.0;
+        }
+
+        for(size_t el = 0; el < max_el; el++) {
+            const real_cpu value = cell_elements[el].value;
+            const real_cpu *pc = p + (size_t)cell_elements[el].column * num_rhs;
+
+            for(uint32_t k = 0; k < num_rhs; k++) {
+                api[k] += value * pc[k];
+            }
+        }
+
+        for(uint32_t k = 0; k < num_rhs; k++) {
+            pTAp[k] += pi[k] * api[k];
+        }
+    }
+}
+
+// Same as stencil_spmv, for all right-hand sides
+static void stencil_spmv_multi_rhs(struct stencil_persistent_data *stencil, struct multi_rhs_persistent_data *data) {
+
+    const uint32_t num_cells = data->num_cells;
+    const uint32_t num_rhs = data->num_rhs;
+    const uint32_t num_offsets = stencil->num_offsets;
+    const real_cpu *coefficients = stencil->coefficients;
+    const uint32_t *dense_index = stencil->dense_index;
+    const real_cpu *diagonal = stencil->diagonal;
+    const int32_t *irregular_row = stencil->irregular_row;
+    const real_cpu *p = data->p;
+    real_cpu *Ap = data->Ap;
+    real_cpu *pTAp = data->pTAp;
+
+    int64_t offsets[26];
+    for(uint32_t o = 0; o < num_offsets; o++) {
+        offsets[o] = stencil->offsets[o] * num_rhs;
+    }
+
+    for(uint32_t k = 0; k < num_rhs; k++) {
+        pTAp[k] = 0.0;
+    }
+
+    OMP(parallel for reduction(+ : pTAp[:num_rhs]))
+    for(uint32_t i = 0; i < num_cells; i++) {
+
+        const real_cpu *pi = p + (size_t)dense_index[i] * num_rhs;
+        real_cpu *api = Ap + (size_t)i * num_rhs;
+
+        for(uint32_t k = 0; k < num_rhs; k++) {
+            api[k] = diagonal[i] * pi[k];
+        }
+
+        if(irregular_row[i] == -1) {
+            for(uint32_t o = 0; o < num_offsets; o++) {
+                const real_cpu c = coefficients[o];
+                const real_cpu *pn = pi + offsets[o];
+                for(uint32_t k = 0; k < num_rhs; k++) {
+                    api[k] += c * pn[k];
+                }
+            }
+        } else {
+            uint32_t r = (uint32_t)irregular_row[i];
+            for(uint32_t e = stencil->irregular_row_start[r]; e < stencil->irregular_row_start[r + 1]; e++) {
+                const real_cpu value = stencil->irregular_values[e];
+                const real_cpu *pn = p + (size_t)stencil->irregular_columns[e] * num_rhs;
+                for(uint32_t k = 0; k < num_rhs; k++) {
+                    api[k] += value * pn[k];
+                }
+            }
+        }
+
+        for(uint32_t k = 0; k < num_rhs; k++) {
+            pTAp[k] += pi[k] * api[k];
+        }
+    }
+}
+
+// Same algorithm (and stop criteria) as cpu_conjugate_gradient for each right-hand side. cells are the rows of the
+// matrix (in the order of the stencil when it is used) and x and b are indexed by the grid_position of the cells
+static void multi_rhs_conjugate_gradient(struct multi_rhs_persistent_data *data, struct stencil_persistent_data *stencil, struct cell_node **cells,
+                                         real_cpu *x_out, const real_cpu *b_in, uint32_t *number_of_iterations, real_cpu *error) {
+
+    const real_cpu precision = tol;
+    const uint32_t num_cells = data->num_cells;
+    const uint32_t num_rhs = data->num_rhs;
+    const uint32_t *dense_index = stencil ? stencil->dense_index : NULL;
+
+    real_cpu *x = data->x, *r = data->r, *z = data->z, *Ap = data->Ap, *p = data->p;
+    real_cpu *rTr = data->rTr, *rTz = data->rTz, *r1Tr1 = data->r1Tr1, *r1Tz1 = data->r1Tz1;
+    real_cpu *pTAp = data->pTAp, *alpha = data->alpha, *beta = data->beta;
+
+    // Columns that did not converge yet
+    uint32_t *active = data->active;
+    uint32_t num_active = 0;
+
+    OMP(parallel for)
+    for(uint32_t i = 0; i < num_cells; i++) {
+        size_t position = cells[i]->grid_position;
+        real_cpu *pi = p + (size_t)(dense_index ? dense_index[i] : i) * num_rhs;
+
+        for(uint32_t k = 0; k < num_rhs; k++) {
+            x[(size_t)i * num_rhs + k] = x_out[(size_t)k * num_cells + position];
+            pi[k] = x[(size_t)i * num_rhs + k];
+        }
+    }
+
+    if(stencil) {
+        stencil_spmv_multi_rhs(stencil, data);
+    } else {
+        elements_spmv_multi_rhs(cells, data);
+    }
+
+    for(uint32_t k = 0; k < num_rhs; k++) {
+        rTr[k] = 0.0;
+        rTz[k] = 0.0;
+    }
+
+    OMP(parallel for reduction(+ : rTr[:num_rhs], rTz[:num_rhs]))
+    for(uint32_t i = 0; i < num_cells; i++) {
+        size_t position = cells[i]->grid_position;
+        real_cpu *pi = p + (size_t)(dense_index ? dense_index[i] : i) * num_rhs;
+
+        real_cpu value = stencil ? stencil->diagonal[i] : cells[i]->elements[0].value;
+        if(value == 0.0)
+            value = 1.0;
+
+        for(uint32_t k = 0; k < num_rhs; k++) {
+            size_t ik = (size_t)i * num_rhs + k;
+
+            r[ik] = b_in[(size_t)k * num_cells + position] - Ap[ik];
+
+            if(use_preconditioner) {
+                z[ik] = (1.0 / value) * r[ik];
+                rTz[k] += r[ik] * z[ik];
+                pi[k] = z[ik];
+            } else {
+                pi[k] = r[ik];
+            }
+
+            rTr[k] += r[ik] * r[ik];
+        }
+    }
+
+    for(uint32_t k = 0; k < num_rhs; k++) {
+        error[k] = rTr[k];
+        number_of_iterations[k] = 1;
+
+        if(error[k] >= precision) {
+            active[num_active++] = k;
+        }
+    }
+
+    uint32_t iteration = 1;
+
+    while(num_active > 0 && iteration < max_its) {
+
+        if(stencil) {
+            stencil_spmv_multi_rhs(stencil, data);
+        } else {
+            elements_spmv_multi_rhs(cells, data);
+        }
+
+        for(uint32_t k = 0; k < num_rhs; k++) {
+            alpha[k] = use_preconditioner ? rTz[k] / pTAp[k] : rTr[k] / pTAp[k];
+            r1Tr1[k] = 0.0;
+            r1Tz1[k] = 0.0;
+        }
+
+        OMP(parallel for reduction(+ : r1Tr1[:num_rhs], r1Tz1[:num_rhs]))
+        for(uint32_t i = 0; i < num_cells; i++) {
+            const real_cpu *pi = p + (size_t)(dense_index ? dense_index[i] : i) * num_rhs;
+
+            real_cpu value = stencil ? stencil->diagonal[i] : cells[i]->elements[0].value;
+            if(value == 0.0)
+                value = 1.0;
+
+            for(uint32_t a = 0; a < num_active; a++) {
+                uint32_t k = active[a];
+                size_t ik = (size_t)i * num_rhs + k;
+
+                x[ik] += alpha[k] * pi[k];
+                r[ik] -= alpha[k] * Ap[ik];
+
+                if(use_preconditioner) {
+                    z[ik] = (1.0 / value) * r[ik];
+                    r1Tz1[k] += z[ik] * r[ik];
+                }
+                r1Tr1[k] += r[ik] * r[ik];
+            }
+        }
+
+        iteration++;
+
+        uint32_t num_still_active = 0;
+
+        for(uint32_t a = 0; a < num_active; a++) {
+            uint32_t k = active[a];
+
+            beta[k] = use_preconditioner ? r1Tz1[k] / rTz[k] : r1Tr1[k] / rTr[k];
+            error[k] = r1Tr1[k];
+            number_of_iterations[k] = iteration;
+
+            rTz[k] = r1Tz1[k];
+            rTr[k] = r1Tr1[k];
+
+            if(error[k] > precision) {
+                active[num_still_active++] = k;
+            }
+        }
+
+        num_active = num_still_active;
+
+        if(num_active == 0) {
+            break;
+        }
+
+        OMP(parallel for)
+        for(uint32_t i = 0; i < num_cells; i++) {
+            real_cpu *pi = p + (size_t)(dense_index ? dense_index[i] : i) * num_rhs;
+
+            for(uint32_t a = 0; a < num_active; a++) {
+                uint32_t k = active[a];
+                size_t ik = (size_t)i * num_rhs + k;
+
+                if(use_preconditioner) {
+                    pi[k] = z[ik] + beta[k] * pi[k];
+                } else {
+                    pi[k] = r[ik] + beta[k] * pi[k];
+                }
+            }
+        }
+    }
+
+    OMP(parallel for)
+    for(uint32_t i = 0; i < num_cells; i++) {
+        size_t position = cells[i]->grid_position;
+
+        for(uint32_t k = 0; k < num_rhs; k++) {
+            x_out[(size_t)k * num_cells + position] = x[(size_t)i * num_rhs + k];
+        }
+    }
+}
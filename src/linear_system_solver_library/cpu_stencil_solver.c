@@ -0,0 +1,501 @@
+//
+// Matrix-free conjugate gradient for non-adaptive meshes with uniform spacing (e.g. the cuboid domains).
+// The assembled matrix of these meshes is a fixed 7 point (or 19 point for anisotropic conductivities) stencil.
+// The off-diagonal coefficients are applied directly on a dense 3D array of the search direction, where the points
+// outside the mesh or not active (e.g. fibrosis) are always zero and work as the mask of the stencil. The diagonal is
+// stored per cell. The few rows that do not match the stencil (e.g. the one sided derivatives of the anisotropic
+// assembly at the borders) keep their own elements.
+//
+
+// Meshes that fill only a small part of their bounding box are solved using the assembled matrix
+#define STENCIL_MAX_DENSE_RATIO 8
+#define STENCIL_COEFFICIENT_TOLERANCE 1e-10
+#define STENCIL_CENTER 13
+
+struct stencil_persistent_data {
+    uint32_t num_cells;
+    uint32_t nx, ny, nz;
+
+    uint32_t num_offsets;
+    int64_t offsets[26];
+    real_cpu coefficients[26];
+
+    // Cells are ordered by their position in the dense array
+    struct cell_node **cells;
+    uint32_t *dense_index;
+    real_cpu *diagonal;
+
+    // Rows that do not match the stencil. irregular_row[i] is -1 for the regular cells
+    int32_t *irregular_row;
+    uint32_t num_irregular_rows;
+    uint32_t *irregular_row_start;
+    uint32_t *irregular_columns;
+    real_cpu *irregular_values;
+
+    real_cpu *x, *b, *r, *z, *Ap;
+
+    // Dense search direction, including one layer of zeros around the mesh
+    real_cpu *p;
+};
+
+static void free_stencil_persistent_data(struct stencil_persistent_data *data) {
+
+    if(!data) return;
+
+    free(data->cells);
+    free(data->dense_index);
+    free(data->diagonal);
+    free(data->irregular_row);
+    free(data->irregular_row_start);
+    free(data->irregular_columns);
+    free(data->irregular_values);
+    free(data->x);
+    free(data->b);
+    free(data->r);
+    free(data->z);
+    free(data->Ap);
+    free(data->p);
+    free(data);
+}
+
+static inline bool stencil_coefficient_equals(real_cpu a, real_cpu b) {
+    return fabs(a - b) <= STENCIL_COEFFICIENT_TOLERANCE * fmax(fabs(a), fabs(b));
+}
+
+// Returns the position (0 to 26) of the neighbour in the 3x3x3 block around the cell or -1 if it is not a direct neighbour
+static inline int stencil_position(uint64_t cell, uint64_t neighbour, uint64_t sx, uint64_t sy) {
+
+    int64_t di = (int64_t)(neighbour % sx) - (int64_t)(cell % sx);
+    int64_t dj = (int64_t)((neighbour / sx) % sy) - (int64_t)((cell / sx) % sy);
+    int64_t dk = (int64_t)(neighbour / (sx * sy)) - (int64_t)(cell / (sx * sy));
+
+    if(labs(di) > 1 || labs(dj) > 1 || labs(dk) > 1) {
+        return -1;
+    }
+
+    return (int)((di + 1) + 3 * (dj + 1) + 9 * (dk + 1));
+}
+
+// Returns NULL when the mesh or its matrix do not have the structure needed by the matrix-free solver
+static struct stencil_persistent_data *new_stencil_persistent_data(struct grid *the_grid, bool is_purkinje) {
+
+    if(is_purkinje) {
+        return NULL;
+    }
+
+    if(the_grid->adaptive) {
+        log_info("[linear_system_solver] The matrix-free stencil is not available for adaptive meshes. Using the assembled matrix!\n");
+        return NULL;
+    }
+
+    uint32_t num_cells = the_grid->num_active_cells;
+    struct cell_node **active_cells = the_grid->active_cells;
+
+    if(num_cells == 0) {
+        return NULL;
+    }
+
+    struct point_3d d = active_cells[0]->discretization;
+    struct point_3d min = active_cells[0]->center;
+    struct point_3d max = active_cells[0]->center;
+
+    for(uint32_t i = 1; i < num_cells; i++) {
+        struct point_3d dc = active_cells[i]->discretization;
+        struct point_3d c = active_cells[i]->center;
+
+        if(dc.x != d.x || dc.y != d.y || dc.z != d.z) {
+            log_info("[linear_system_solver] The mesh spacing is not uniform. Using the assembled matrix!\n");
+            return NULL;
+        }
+
+        min.x = fmin(min.x, c.x); min.y = fmin(min.y, c.y); min.z = fmin(min.z, c.z);
+        max.x = fmax(max.x, c.x); max.y = fmax(max.y, c.y); max.z = fmax(max.z, c.z);
+    }
+
+    uint32_t nx = (uint32_t)llround((max.x - min.x) / d.x) + 1;
+    uint32_t ny = (uint32_t)llround((max.y - min.y) / d.y) + 1;
+    uint32_t nz = (uint32_t)llround((max.z - min.z) / d.z) + 1;
+
+    // The layer of zeros is only needed in the directions with more than one cell
+    uint64_t hx = nx > 1, hy = ny > 1, hz = nz > 1;
+    uint64_t sx = nx + 2 * hx, sy = ny + 2 * hy, sz = nz + 2 * hz;
+    uint64_t dense_size = sx * sy * sz;
+
+    if(dense_size > (uint64_t)STENCIL_MAX_DENSE_RATIO * num_cells || dense_size > UINT32_MAX) {
+        log_info("[linear_system_solver] The mesh fills only a small part of its bounding box. Using the assembled matrix!\n");
+        return NULL;
+    }
+
+    int64_t *cell_at = malloc(dense_size * sizeof(int64_t));
+    uint32_t *dense_index_of = malloc(num_cells * sizeof(uint32_t));
+    bool structured = true;
+
+    OMP(parallel for)
+    for(uint64_t i = 0; i < dense_size; i++) {
+        cell_at[i] = -1;
+    }
+
+    size_t reference_cell = 0;
+
+    for(uint32_t i = 0; i < num_cells; i++) {
+        struct point_3d c = active_cells[i]->center;
+
+        real_cpu fx = (c.x - min.x) / d.x, fy = (c.y - min.y) / d.y, fz = (c.z - min.z) / d.z;
+        int64_t ix = llround(fx), iy = llround(fy), iz = llround(fz);
+
+        if(fabs(fx - ix) > 1e-3 || fabs(fy - iy) > 1e-3 || fabs(fz - iz) > 1e-3) {
+            structured = false;
+            break;
+        }
+
+        uint64_t index = ((iz + hz) * sy + (iy + hy)) * sx + (ix + hx);
+
+        if(cell_at[index] != -1) {
+            structured = false;
+            break;
+        }
+
+        cell_at[index] = i;
+        dense_index_of[i] = (uint32_t)index;
+
+        if(arrlen(active_cells[i]->elements) > arrlen(active_cells[reference_cell]->elements)) {
+            reference_cell = i;
+        }
+    }
+
+    // The stencil is taken from the row with more elements (an interior cell)
+    int64_t strides[3] = {1, (int64_t)sx, (int64_t)(sx * sy)};
+    bool has_position[27] = {false};
+    real_cpu coefficients[27];
+
+    struct stencil_persistent_data *data = NULL;
+
+    if(structured) {
+
+        struct element *elements = active_cells[reference_cell]->elements;
+
+        for(size_t el = 1; el < arrlen(elements); el++) {
+            uint32_t neighbour = elements[el].column;
+
+            if(neighbour >= num_cells || active_cells[neighbour] != elements[el].cell) {
+                structured = false;
+                break;
+            }
+
+            int position = stencil_position(dense_index_of[reference_cell], dense_index_of[neighbour], sx, sy);
+
+            if(position < 0 || position == STENCIL_CENTER) {
+                structured = false;
+                break;
+            }
+
+            has_position[position] = true;
+            coefficients[position] = elements[el].value;
+        }
+    }
+
+    if(structured) {
+
+        data = CALLOC_ONE_TYPE(struct stencil_persistent_data);
+
+        data->num_cells = num_cells;
+        data->nx = nx;
+        data->ny = ny;
+        data->nz = nz;
+
+        int stencil_index[27];
+
+        for(int o = 0; o < 27; o++) {
+            stencil_index[o] = -1;
+            if(has_position[o]) {
+                int64_t di = o % 3 - 1, dj = (o / 3) % 3 - 1, dk = o / 9 - 1;
+                stencil_index[o] = (int)data->num_offsets;
+                data->offsets[data->num_offsets] = di * strides[0] + dj * strides[1] + dk * strides[2];
+                data->coefficients[data->num_offsets] = coefficients[o];
+                data->num_offsets++;
+            }
+        }
+
+        data->cells = malloc(num_cells * sizeof(struct cell_node *));
+        data->dense_index = malloc(num_cells * sizeof(uint32_t));
+        data->diagonal = malloc(num_cells * sizeof(real_cpu));
+        data->irregular_row = malloc(num_cells * sizeof(int32_t));
+
+        uint32_t k = 0;
+        for(uint64_t i = 0; i < dense_size; i++) {
+            if(cell_at[i] != -1) {
+                struct cell_node *cell = active_cells[cell_at[i]];
+                data->cells[k] = cell;
+                data->dense_index[k] = (uint32_t)i;
+                data->diagonal[k] = cell->elements[0].value;
+                k++;
+            }
+        }
+
+        // A row is regular when it has exactly one element for each active neighbour of the stencil, with the stencil
+        // coefficient. Missing elements between two active cells (e.g. a zero conductivity) also make the row irregular.
+        uint32_t num_irregular_rows = 0;
+        uint32_t num_irregular_elements = 0;
+
+        OMP(parallel for reduction(+ : num_irregular_rows, num_irregular_elements) reduction(&& : structured))
+        for(uint32_t i = 0; i < num_cells; i++) {
+
+            struct element *row = data->cells[i]->elements;
+            size_t max_el = arrlen(row);
+            bool regular = true;
+
+            if(max_el == 0 || row[0].cell != data->cells[i]) {
+                structured = false;
+                continue;
+            }
+
+            for(size_t el = 1; el < max_el; el++) {
+                uint32_t neighbour = row[el].column;
+
+                if(neighbour >= num_cells || active_cells[neighbour] != row[el].cell) {
+                    structured = false;
+                    break;
+                }
+
+                int position = stencil_position(data->dense_index[i], dense_index_of[neighbour], sx, sy);
+
+                if(position < 0 || position == STENCIL_CENTER) {
+                    structured = false;
+                    break;
+                }
+
+                int s = stencil_index[position];
+
+                if(s == -1 || !stencil_coefficient_equals(data->coefficients[s], row[el].value)) {
+                    regular = false;
+                }
+            }
+
+            if(regular) {
+                uint32_t num_neighbours = 0;
+
+                for(uint32_t o = 0; o < data->num_offsets; o++) {
+                    if(cell_at[data->dense_index[i] + data->offsets[o]] != -1) {
+                        num_neighbours++;
+                    }
+                }
+
+                regular = (num_neighbours == max_el - 1);
+            }
+
+            data->irregular_row[i] = regular ? -1 : 0;
+
+            if(!regular) {
+                num_irregular_rows++;
+                num_irregular_elements += (uint32_t)(max_el - 1);
+            }
+        }
+
+        if(structured && num_irregular_rows > num_cells / 2) {
+            structured = false;
+        }
+
+        if(structured) {
+
+            data->num_irregular_rows = num_irregular_rows;
+            data->irregular_row_start = malloc((num_irregular_rows + 1) * sizeof(uint32_t));
+            data->irregular_columns = malloc(num_irregular_elements * sizeof(uint32_t));
+            data->irregular_values = malloc(num_irregular_elements * sizeof(real_cpu));
+
+            uint32_t r = 0, e = 0;
+
+            for(uint32_t i = 0; i < num_cells; i++) {
+
+                if(data->irregular_row[i] == -1) continue;
+
+                struct element *row = data->cells[i]->elements;
+
+                data->irregular_row[i] = (int32_t)r;
+                data->irregular_row_start[r] = e;
+
+                for(size_t el = 1; el < arrlen(row); el++) {
+                    data->irregular_columns[e] = dense_index_of[row[el].column];
+                    data->irregular_values[e] = row[el].value;
+                    e++;
+                }
+
+                r++;
+            }
+
+            data->irregular_row_start[r] = e;
+
+            data->x = malloc(num_cells * sizeof(real_cpu));
+            data->b = malloc(num_cells * sizeof(real_cpu));
+            data->r = malloc(num_cells * sizeof(real_cpu));
+            data->z = malloc(num_cells * sizeof(real_cpu));
+            data->Ap = malloc(num_cells * sizeof(real_cpu));
+            data->p = calloc(dense_size, sizeof(real_cpu));
+        } else {
+            free_stencil_persistent_data(data);
+            data = NULL;
+        }
+    }
+
+    free(cell_at);
+    free(dense_index_of);
+
+    if(data) {
+        log_info("[linear_system_solver] Using the matrix-free %u-point stencil on a %u x %u x %u grid (%u of %u rows use their own elements)\n",
+                 data->num_offsets + 1, nx, ny, nz, data->num_irregular_rows, num_cells);
+    } else {
+        log_info("[linear_system_solver] The matrix does not have a constant stencil. Using the assembled matrix!\n");
+    }
+
+    return data;
+}
+
+// Computes Ap for the dense search direction and returns pTAp
+static inline real_cpu stencil_spmv(struct stencil_persistent_data *data) {
+
+    const uint32_t num_cells = data->num_cells;
+    const uint32_t num_offsets = data->num_offsets;
+    const int64_t *offsets = data->offsets;
+    const real_cpu *coefficients = data->coefficients;
+    const uint32_t *dense_index = data->dense_index;
+    const real_cpu *diagonal = data->diagonal;
+    const int32_t *irregular_row = data->irregular_row;
+    const real_cpu *p = data->p;
+    real_cpu *Ap = data->Ap;
+
+    real_cpu pTAp = 0.0;
+
+    OMP(parallel for reduction(+ : pTAp))
+    for(uint32_t i = 0; i < num_cells; i++) {
+
+        const real_cpu *pi = p + dense_index[i];
+        real_cpu ap = diagonal[i] * pi[0];
+
+        if(irregular_row[i] == -1) {
+            for(uint32_t o = 0; o < num_offsets; o++) {
+                ap += coefficients[o] * pi[offsets[o]];
+            }
+        } else {
+            uint32_t r = (uint32_t)irregular_row[i];
+            for(uint32_t e = data->irregular_row_start[r]; e < data->irregular_row_start[r + 1]; e++) {
+                ap += data->irregular_values[e] * p[data->irregular_columns[e]];
+            }
+        }
+
+        Ap[i] = ap;
+        pTAp += pi[0] * ap;
+    }
+
+    return pTAp;
+}
+
+// Same algorithm (and stop criteria) as cpu_conjugate_gradient
+static void stencil_conjugate_gradient(struct stencil_persistent_data *data, uint32_t *number_of_iterations, real_cpu *error) {
+
+    real_cpu rTr, pTAp, alpha, beta, precision = tol, rTz, r1Tz1;
+
+    const uint32_t num_cells = data->num_cells;
+    struct cell_node **cells = data->cells;
+    const uint32_t *dense_index = data->dense_index;
+    const real_cpu *diagonal = data->diagonal;
+    real_cpu *x = data->x, *b = data->b, *r = data->r, *z = data->z, *Ap = data->Ap, *p = data->p;
+
+    *error = 1.0;
+    *number_of_iterations = 1;
+
+    OMP(parallel for)
+    for(uint32_t i = 0; i < num_cells; i++) {
+        x[i] = cells[i]->v;
+        b[i] = cells[i]->b;
+        p[dense_index[i]] = x[i];
+    }
+
+    stencil_spmv(data);
+
+    rTr = 0.0;
+    rTz = 0.0;
+
+    OMP(parallel for reduction(+ : rTr, rTz))
+    for(uint32_t i = 0; i < num_cells; i++) {
+
+        r[i] = b[i] - Ap[i];
+
+        if(use_preconditioner) {
+            real_cpu value = diagonal[i];
+            if(value == 0.0)
+                value = 1.0;
+            z[i] = (1.0 / value) * r[i];
+            rTz += r[i] * z[i];
+            p[dense_index[i]] = z[i];
+        } else {
+            p[dense_index[i]] = r[i];
+        }
+
+        rTr += r[i] * r[i];
+    }
+
+    *error = rTr;
+
+    if(*error >= precision) {
+        real_cpu r1Tr1;
+        while(*number_of_iterations < max_its) {
+
+            pTAp = stencil_spmv(data);
+
+            if(use_preconditioner) {
+                alpha = rTz / pTAp;
+            } else {
+                alpha = rTr / pTAp;
+            }
+
+            r1Tr1 = 0.0;
+            r1Tz1 = 0.0;
+
+            OMP(parallel for reduction(+ : r1Tr1, r1Tz1))
+            for(uint32_t i = 0; i < num_cells; i++) {
+
+                x[i] += alpha * p[dense_index[i]];
+                r[i] -= alpha * Ap[i];
+
+                if(use_preconditioner) {
+                    real_cpu value = diagonal[i];
+                    if(value == 0.0)
+                        value = 1.0;
+                    z[i] = (1.0 / value) * r[i];
+                    r1Tz1 += z[i] * r[i];
+                }
+                r1Tr1 += r[i] * r[i];
+            }
+
+            if(use_preconditioner) {
+                beta = r1Tz1 / rTz;
+            } else {
+                beta = r1Tr1 / rTr;
+            }
+
+            *error = r1Tr1;
+
+            *number_of_iterations = *number_of_iterations + 1;
+            if(*error <= precision) {
+                break;
+            }
+
+            OMP(parallel for)
+            for(uint32_t i = 0; i < num_cells; i++) {
+                real_cpu *pi = p + dense_index[i];
+                if(use_preconditioner) {
+                    *pi = z[i] + beta * (*pi);
+                } else {
+                    *pi = r[i] + beta * (*pi);
+                }
+            }
+
+            rTz = r1Tz1;
+            rTr = r1Tr1;
+        }
+    }
+
+    OMP(parallel for)
+    for(uint32_t i = 0; i < num_cells; i++) {
+        cells[i]->v = x[i];
+    }
+}
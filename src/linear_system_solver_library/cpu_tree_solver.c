@@ -0,0 +1,286 @@
+//
+// Direct solver for matrices whose graph is a tree (or a forest), as the Purkinje networks and the cable meshes.
+// The cells are eliminated from the leaves to the root, so the LU factorization has no fill-in and both the factorization
+// and each solve are O(n). The matrix is factored once in the init function. When the graph has cycles the conjugate
+// gradient is used instead.
+//
+
+struct tree_solver_persistent_data {
+    uint32_t num_cells;
+    struct cell_node **cells;
+
+    // Elimination order (leaves first). parent[i] is the cell that receives the fill of cell i or -1 for the roots
+    uint32_t *order;
+    int64_t *parent;
+
+    real_cpu *inv_pivot;  // 1 / U(i,i)
+    real_cpu *lower;      // L(parent, i)
+    real_cpu *upper;      // U(i, parent)
+    real_cpu *y;
+};
+
+static void free_tree_solver_persistent_data(struct tree_solver_persistent_data *data) {
+
+    if(!data) return;
+
+    free(data->order);
+    free(data->parent);
+    free(data->inv_pivot);
+    free(data->lower);
+    free(data->upper);
+    free(data->y);
+    free(data);
+}
+
+// Value of the element (row, column). Repeated elements are added
+static real_cpu get_tree_element(struct cell_node *row, uint32_t column) {
+
+    real_cpu value = 0.0;
+    struct element *elements = row->elements;
+    size_t max_el = arrlen(elements);
+
+    for(size_t el = 1; el < max_el; el++) {
+        if(elements[el].column == column) {
+            value += elements[el].value;
+        }
+    }
+
+    return value;
+}
+
+// Returns NULL if the graph of the matrix is not a forest
+static struct tree_solver_persistent_data *new_tree_solver_persistent_data(uint32_t num_cells, struct cell_node **cells) {
+
+    uint32_t *degree = calloc(num_cells, sizeof(uint32_t));
+    bool *eliminated = calloc(num_cells, sizeof(bool));
+    uint32_t *order = malloc(num_cells * sizeof(uint32_t));
+    int64_t *parent = malloc(num_cells * sizeof(int64_t));
+
+    bool valid = true;
+
+    for(uint32_t i = 0; i < num_cells && valid; i++) {
+
+        struct element *elements = cells[i]->elements;
+        size_t max_el = arrlen(elements);
+
+        if(max_el == 0 || elements[0].cell != cells[i]) {
+            valid = false;
+            break;
+        }
+
+        for(size_t el = 1; el < max_el; el++) {
+            uint32_t column = elements[el].column;
+
+            if(column >= num_cells || cells[column] != elements[el].cell || column == i) {
+                valid = false;
+                break;
+            }
+
+            // Repeated elements count as a single edge
+            bool repeated = false;
+            for(size_t el2 = 1; el2 < el; el2++) {
+                if(elements[el2].column == column) {
+                    repeated = true;
+                    break;
+                }
+            }
+
+            if(!repeated) {
+                degree[i]++;
+            }
+        }
+    }
+
+    // The order array is also used as the queue of the cells with at most one neighbour not eliminated
+    uint32_t head = 0, tail = 0;
+
+    if(valid) {
+        for(uint32_t i = 0; i < num_cells; i++) {
+            if(degree[i] <= 1) {
+                order[tail++] = i;
+            }
+        }
+    }
+
+    while(valid && head < tail) {
+
+        uint32_t i = order[head++];
+        eliminated[i] = true;
+        parent[i] = -1;
+
+        struct element *elements = cells[i]->elements;
+        size_t max_el = arrlen(elements);
+
+        for(size_t el = 1; el < max_el; el++) {
+            uint32_t column = elements[el].column;
+
+            if(eliminated[column] || parent[i] == column) {
+                continue;
+            }
+
+            // A second neighbour left or a non symmetric sparsity pattern
+            if(parent[i] != -1 || degree[column] == 0) {
+                valid = false;
+                break;
+            }
+
+            parent[i] = column;
+            degree[column]--;
+
+            // Cells with no neighbours left were already queued and will be the roots
+            if(degree[column] == 1) {
+                order[tail++] = column;
+            }
+        }
+    }
+
+    free(degree);
+    free(eliminated);
+
+    if(!valid || tail != num_cells) {
+        free(order);
+        free(parent);
+        return NULL;
+    }
+
+    struct tree_solver_persistent_data *data = CALLOC_ONE_TYPE(struct tree_solver_persistent_data);
+
+    data->num_cells = num_cells;
+    data->cells = cells;
+    data->order = order;
+    data->parent = parent;
+    data->inv_pivot = malloc(num_cells * sizeof(real_cpu));
+    data->lower = malloc(num_cells * sizeof(real_cpu));
+    data->upper = malloc(num_cells * sizeof(real_cpu));
+    data->y = malloc(num_cells * sizeof(real_cpu));
+
+    real_cpu *pivot = data->inv_pivot;
+
+    for(uint32_t i = 0; i < num_cells; i++) {
+        pivot[i] = cells[i]->elements[0].value;
+    }
+
+    for(uint32_t k = 0; k < num_cells; k++) {
+
+        uint32_t i = order[k];
+
+        if(pivot[i] == 0.0) {
+            log_warn("[linear_system_solver] Zero pivot in the tree factorization. Using the conjugate gradient!\n");
+            free_tree_solver_persistent_data(data);
+            return NULL;
+        }
+
+        if(parent[i] != -1) {
+            uint32_t p = (uint32_t)parent[i];
+            data->lower[i] = get_tree_element(cells[p], i) / pivot[i];
+            data->upper[i] = get_tree_element(cells[i], p);
+            pivot[p] -= data->lower[i] * data->upper[i];
+        } else {
+            data->lower[i] = 0.0;
+            data->upper[i] = 0.0;
+        }
+
+        pivot[i] = 1.0 / pivot[i];
+    }
+
+    return data;
+}
+
+static void tree_direct_solve(struct tree_solver_persistent_data *data, uint32_t *number_of_iterations, real_cpu *error) {
+
+    const uint32_t num_cells = data->num_cells;
+    struct cell_node **cells = data->cells;
+    const uint32_t *order = data->order;
+    const int64_t *parent = data->parent;
+    real_cpu *y = data->y;
+
+    for(uint32_t i = 0; i < num_cells; i++) {
+        y[i] = cells[i]->b;
+    }
+
+    // Forward substitution (L y = b)
+    for(uint32_t k = 0; k < num_cells; k++) {
+        uint32_t i = order[k];
+        if(parent[i] != -1) {
+            y[parent[i]] -= data->lower[i] * y[i];
+        }
+    }
+
+    // Backward substitution (U x = y). The parent is always solved before its children
+    for(int64_t k = (int64_t)num_cells - 1; k >= 0; k--) {
+        uint32_t i = order[k];
+        if(parent[i] != -1) {
+            y[i] -= data->upper[i] * y[parent[i]];
+        }
+        y[i] *= data->inv_pivot[i];
+    }
+
+    real_cpu rTr = 0.0;
+
+    OMP(parallel for)
+    for(uint32_t i = 0; i < num_cells; i++) {
+        cells[i]->v = y[i];
+    }
+
+    OMP(parallel for reduction(+ : rTr))
+    for(uint32_t i = 0; i < num_cells; i++) {
+        struct element *elements = cells[i]->elements;
+        size_t max_el = arrlen(elements);
+
+        real_cpu Ax = 0.0;
+        for(size_t el = 0; el < max_el; el++) {
+            Ax += elements[el].value * elements[el].cell->v;
+        }
+
+        real_cpu r = cells[i]->b - Ax;
+        rTr += r * r;
+    }
+
+    *number_of_iterations = 1;
+    *error = rTr;
+}
+
+INIT_LINEAR_SYSTEM(init_tree_direct_solver) {
+
+    // Used by the conjugate gradient when the matrix is not a tree
+    GET_PARAMETER_NUMERIC_VALUE_OR_USE_DEFAULT(real_cpu, tol, config, "tolerance");
+    GET_PARAMETER_BOOLEAN_VALUE_OR_USE_DEFAULT(use_preconditioner, config, "use_preconditioner");
+    GET_PARAMETER_NUMERIC_VALUE_OR_USE_DEFAULT(int, max_its, config, "max_iterations");
+
+    uint32_t num_cells;
+    struct cell_node **cells;
+
+    if(is_purkinje) {
+        num_cells = the_grid->purkinje->num_active_purkinje_cells;
+        cells = the_grid->purkinje->purkinje_cells;
+    } else {
+        num_cells = the_grid->num_active_cells;
+        cells = the_grid->active_cells;
+    }
+
+    struct tree_solver_persistent_data *data = new_tree_solver_persistent_data(num_cells, cells);
+
+    if(data) {
+        log_info("[linear_system_solver] Using the tree direct solver for %u cells\n", num_cells);
+    } else {
+        log_info("[linear_system_solver] The matrix graph is not a tree. Using the conjugate gradient!\n");
+    }
+
+    config->persistent_data = data;
+}
+
+SOLVE_LINEAR_SYSTEM(tree_direct_solver) {
+
+    struct tree_solver_persistent_data *data = (struct tree_solver_persistent_data *)config->persistent_data;
+
+    if(data && data->num_cells == num_active_cells && data->cells == active_cells) {
+        tree_direct_solve(data, number_of_iterations, error);
+    } else {
+        assembled_conjugate_gradient(num_active_cells, active_cells, number_of_iterations, error);
+    }
+}
+
+END_LINEAR_SYSTEM(end_tree_direct_solver) {
+    free_tree_solver_persistent_data((struct tree_solver_persistent_data *)config->persistent_data);
+    config->persistent_data = NULL;
+}
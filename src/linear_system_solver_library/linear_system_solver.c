@@ -35,16 +35,47 @@ static real_cpu tol = 1e-16;
     #endif
 #endif //COMPILE_CUDA
 
+#include "cpu_stencil_solver.c"
+#include "cpu_multi_rhs_solver.c"
+
+struct cpu_conjugate_gradient_persistent_data {
+    struct stencil_persistent_data *stencil; // Only when matrix_free = true
+    struct multi_rhs_persistent_data *multi_rhs;
+};
+
 INIT_LINEAR_SYSTEM(init_cpu_conjugate_gradient) {
     GET_PARAMETER_NUMERIC_VALUE_OR_USE_DEFAULT(real_cpu, tol, config, "tolerance");
     GET_PARAMETER_BOOLEAN_VALUE_OR_USE_DEFAULT(use_preconditioner, config, "use_preconditioner");
     GET_PARAMETER_NUMERIC_VALUE_OR_USE_DEFAULT(int, max_its, config, "max_iterations");
+
+    bool matrix_free = false;
+    GET_PARAMETER_BOOLEAN_VALUE_OR_USE_DEFAULT(matrix_free, config, "matrix_free");
+
+    struct cpu_conjugate_gradient_persistent_data *persistent_data = CALLOC_ONE_TYPE(struct cpu_conjugate_gradient_persistent_data);
+
+    if(matrix_free) {
+        persistent_data->stencil = new_stencil_persistent_data(the_grid, is_purkinje);
+    }
+
+    config->persistent_data = persistent_data;
 }
 
 END_LINEAR_SYSTEM(end_cpu_conjugate_gradient) {
+
+    struct cpu_conjugate_gradient_persistent_data *persistent_data = (struct cpu_conjugate_gradient_persistent_data *)config->persistent_data;
+
+    if(persistent_data) {
+        free_stencil_persistent_data(persistent_data->stencil);
+        free_multi_rhs_persistent_data(persistent_data->multi_rhs);
+        free(persistent_data);
+    }
+
+    config->persistent_data = NULL;
 }
 
-SOLVE_LINEAR_SYSTEM(cpu_conjugate_gradient) {
+// Conjugate gradient on the assembled matrix of the cells. It only uses the tolerance, max_iterations and
+// use_preconditioner set by the init function, so other solvers can use it as their fallback
+static void assembled_conjugate_gradient(uint32_t num_active_cells, struct cell_node **active_cells, uint32_t *number_of_iterations, real_cpu *error) {
 
     real_cpu rTr, pTAp, alpha, beta, precision = tol, rTz, r1Tz1;
 
@@ -182,6 +213,41 @@ SOLVE_LINEAR_SYSTEM(cpu_conjugate_gradient) {
 
 } // end conjugateGradient() function.
 
+SOLVE_LINEAR_SYSTEM(cpu_conjugate_gradient) {
+
+    struct cpu_conjugate_gradient_persistent_data *persistent_data = (struct cpu_conjugate_gradient_persistent_data *)config->persistent_data;
+    struct stencil_persistent_data *stencil = persistent_data ? persistent_data->stencil : NULL;
+
+    if(stencil && stencil->num_cells == num_active_cells && active_cells == the_grid->active_cells) {
+        stencil_conjugate_gradient(stencil, number_of_iterations, error);
+    } else {
+        assembled_conjugate_gradient(num_active_cells, active_cells, number_of_iterations, error);
+    }
+}
+
+// One CG for each right-hand side, sharing the matrix traversals (see cpu_multi_rhs_solver.c)
+SOLVE_LINEAR_SYSTEM_MULTI_RHS(cpu_conjugate_gradient_multi_rhs) {
+
+    struct cpu_conjugate_gradient_persistent_data *persistent_data = (struct cpu_conjugate_gradient_persistent_data *)config->persistent_data;
+
+    if(!persistent_data) {
+        log_error_and_exit("cpu_conjugate_gradient_multi_rhs needs the init function of the cpu conjugate gradient!\n");
+    }
+
+    struct stencil_persistent_data *stencil = persistent_data->stencil;
+    struct cell_node **cells = active_cells;
+
+    if(stencil && stencil->num_cells == num_active_cells && active_cells == the_grid->active_cells) {
+        cells = stencil->cells;
+    } else {
+        stencil = NULL;
+    }
+
+    persistent_data->multi_rhs = get_multi_rhs_persistent_data(persistent_data->multi_rhs, stencil, num_active_cells, num_rhs);
+
+    multi_rhs_conjugate_gradient(persistent_data->multi_rhs, stencil, cells, x, b, number_of_iterations, error);
+}
+
 SOLVE_LINEAR_SYSTEM(conjugate_gradient) {
 
     bool gpu = false;
@@ -199,6 +265,41 @@ SOLVE_LINEAR_SYSTEM(conjugate_gradient) {
     }
 }
 
+// The GPU solver is called once for each right-hand side
+SOLVE_LINEAR_SYSTEM_MULTI_RHS(conjugate_gradient_multi_rhs) {
+
+    bool gpu = false;
+    GET_PARAMETER_BOOLEAN_VALUE_OR_USE_DEFAULT(gpu, config, "use_gpu");
+
+    if(gpu) {
+#ifdef COMPILE_CUDA
+        for(uint32_t k = 0; k < num_rhs; k++) {
+
+            real_cpu *xk = x + (size_t)k * num_active_cells;
+            const real_cpu *bk = b + (size_t)k * num_active_cells;
+
+            OMP(parallel for)
+            for(uint32_t i = 0; i < num_active_cells; i++) {
+                active_cells[i]->v = xk[active_cells[i]->grid_position];
+                active_cells[i]->b = bk[active_cells[i]->grid_position];
+            }
+
+            gpu_conjugate_gradient(time_info, config, the_grid, num_active_cells, active_cells, &number_of_iterations[k], &error[k]);
+
+            OMP(parallel for)
+            for(uint32_t i = 0; i < num_active_cells; i++) {
+                xk[active_cells[i]->grid_position] = active_cells[i]->v;
+            }
+        }
+        return;
+#else
+        log_warn("Cuda runtime not found in this system. Fallbacking to CPU solver!!\n");
+#endif
+    }
+
+    cpu_conjugate_gradient_multi_rhs(time_info, config, the_grid, num_active_cells, active_cells, num_rhs, x, b, number_of_iterations, error);
+}
+
 INIT_LINEAR_SYSTEM(init_conjugate_gradient) {
     bool gpu = false;
     GET_PARAMETER_BOOLEAN_VALUE_OR_USE_DEFAULT(gpu, config, "use_gpu");
@@ -230,6 +331,8 @@ END_LINEAR_SYSTEM(end_conjugate_gradient) {
     }
 }
 
+#include "cpu_tree_solver.c"
+
 // Berg's code
 SOLVE_LINEAR_SYSTEM(jacobi) {
 
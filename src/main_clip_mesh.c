@@ -2,51 +2,96 @@
 // Script used to clip a section of a mesh and extract the extra data information
 // Version: 29/01/2024
 // Last change: 29/01/2024
+//
+// The input alg mesh (one cell per line, starting with the center of the cell) is read in chunks that are clipped in
+// parallel, and the lines of the cells inside the clipping region are written in the same order of the input. The mesh
+// is not loaded in a grid, so the memory used depends only on the chunk size and on the number of threads.
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <sys/mman.h>
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "3dparty/fast_double_parser.h"
 #include "3dparty/stb_ds.h"
 #include "common_types/common_types.h"
 #include "utils/file_utils.h"
-#include "config/config_common.h"
-#include "config/domain_config.h"
-#include "domains_library/mesh_info_data.h"
-#include "extra_data_library/helper_functions.h"
-
-static const char *expansion_opt_string = "i:o:n:v:h?";
-static const struct option long_expansion_options[] = {{"input", required_argument, NULL, 'i'},
-                                                        {"output", required_argument, NULL, 'o'},
-                                                        {"n_rows", required_argument, NULL, 'n'},
-                                                        {"n_volumes", required_argument, NULL, 'v'}};
-struct expansion_options {
+
+#define CLIP_CHUNK_SIZE (16 * 1024 * 1024)
+
+static const char *clip_opt_string = "i:o:b:p:s:l:n:h?";
+static const struct option long_clip_options[] = {{"input", required_argument, NULL, 'i'},
+                                                  {"output", required_argument, NULL, 'o'},
+                                                  {"box", required_argument, NULL, 'b'},
+                                                  {"plane", required_argument, NULL, 'p'},
+                                                  {"sphere", required_argument, NULL, 's'},
+                                                  {"endo_label_column", required_argument, NULL, 'l'},
+                                                  {"num_threads", required_argument, NULL, 'n'},
+                                                  {NULL, no_argument, NULL, 0}};
+
+// A cell is kept when its center is inside all the regions given
+struct clip_options {
     char *input;
     char *output;
-    int n_rows;
-    char* n_volumes;
+
+    bool clip_with_box;
+    real_cpu min[3], max[3];
+
+    bool clip_with_plane;
+    real_cpu origin[3], normal[3];
+
+    bool clip_with_sphere;
+    real_cpu sphere_center[3], radius;
+
+    // Column (starting from 0) with the DTI transmurality labels. The FAST_ENDO label (3) is changed to ENDO (0)
+    int endo_label_column;
+
+    int num_threads;
 };
 
-static void display_expansion_usage(char **argv) {
+static void display_clip_usage(char **argv) {
 
     printf("Usage: %s [options]\n\n", argv[0]);
     printf("Options:\n");
-    printf("--input  | -i [input]. File. Default NULL.\n");
-    printf("--output | -o [output]. Output file. Default NULL.\n");
-    printf("--n_rows | -n [n_rows]. Number of rows to expand.\n");
-    printf("--n_volumes | -v [n_volumes]. Number of volumes in the mesh\n");
+    printf("--input  | -i [input]. Alg mesh file. Default NULL.\n");
+    printf("--output | -o [output]. Output file. Default clipped_mesh.alg.\n");
+    printf("--box    | -b [min_x,min_y,min_z,max_x,max_y,max_z]. Keeps the cells with the center inside the box.\n");
+    printf("--plane  | -p [origin_x,origin_y,origin_z,normal_x,normal_y,normal_z]. Keeps the cells with the center in the side of the normal.\n");
+    printf("--sphere | -s [center_x,center_y,center_z,radius]. Keeps the cells with the center inside the sphere.\n");
+    printf("--endo_label_column | -l [column]. Changes the FAST_ENDO label (3) to ENDO (0) in this column (optional).\n");
+    printf("--num_threads | -n [num_threads]. Number of chunks clipped in parallel. Default: number of cores.\n");
     printf("--help | -h. Shows this help and exit \n");
     exit(EXIT_FAILURE);
 }
 
+static void parse_values(char **argv, const char *option, const char *values, real_cpu *out, int n) {
+
+    const char *p = values;
 
-static void parse_expansion_options(int argc, char **argv, struct expansion_options *user_args) {
+    for(int i = 0; i < n; i++) {
+        char *end;
+        out[i] = strtod(p, &end);
+
+        if(end == p || (i < n - 1 && *end != ',')) {
+            fprintf(stderr, "Invalid value for --%s: %s. Expected %d comma separated numbers.\n", option, values, n);
+            display_clip_usage(argv);
+        }
+
+        p = end + 1;
+    }
+}
+
+static void parse_clip_options(int argc, char **argv, struct clip_options *user_args) {
 
     int opt = 0;
     int option_index;
 
-    opt = getopt_long_only(argc, argv, expansion_opt_string, long_expansion_options, &option_index);
+    opt = getopt_long_only(argc, argv, clip_opt_string, long_clip_options, &option_index);
 
     while(opt != -1) {
         switch(opt) {
@@ -56,119 +101,291 @@ static void parse_expansion_options(int argc, char **argv, struct expansion_opti
         case 'o':
             user_args->output = strdup(optarg);
             break;
-        case 'n':
-            user_args->n_rows = atoi(optarg);
+        case 'b': {
+            real_cpu box[6];
+            parse_values(argv, "box", optarg, box, 6);
+            memcpy(user_args->min, box, sizeof(user_args->min));
+            memcpy(user_args->max, box + 3, sizeof(user_args->max));
+            user_args->clip_with_box = true;
+            break;
+        }
+        case 'p': {
+            real_cpu plane[6];
+            parse_values(argv, "plane", optarg, plane, 6);
+            memcpy(user_args->origin, plane, sizeof(user_args->origin));
+            memcpy(user_args->normal, plane + 3, sizeof(user_args->normal));
+            user_args->clip_with_plane = true;
             break;
-        case 'v':
-            user_args->n_volumes = strdup(optarg);
+        }
+        case 's': {
+            real_cpu sphere[4];
+            parse_values(argv, "sphere", optarg, sphere, 4);
+            memcpy(user_args->sphere_center, sphere, sizeof(user_args->sphere_center));
+            user_args->radius = sphere[3];
+            user_args->clip_with_sphere = true;
+            break;
+        }
+        case 'l':
+            user_args->endo_label_column = atoi(optarg);
+            break;
+        case 'n':
+            user_args->num_threads = atoi(optarg);
             break;
         case 'h': /* fall-through is intentional */
         case '?':
-            display_expansion_usage(argv);
+            display_clip_usage(argv);
             break;
         default:
             /* You won't actually get here. */
             break;
         }
 
-        opt = getopt_long(argc, argv, expansion_opt_string, long_expansion_options, &option_index);
+        opt = getopt_long(argc, argv, clip_opt_string, long_clip_options, &option_index);
     }
 
-    if(!user_args->input) {
-        display_expansion_usage(argv);
+    if(!user_args->input || !(user_args->clip_with_box || user_args->clip_with_plane || user_args->clip_with_sphere)) {
+        display_clip_usage(argv);
     }
 }
 
-static void expand_scar(const char *input, const char *output, int n_rows, char* n_volumes) {
+struct clip_chunk {
+    // Lines in [start, end)
+    const char *start;
+    const char *end;
+
+    char *output;
+    size_t output_size;
 
-    //set_no_stdout(true);
+    uint64_t num_cells;
+    uint64_t num_kept_cells;
+};
 
-    struct grid *grid = new_grid();
-    struct config *domain_config;
+static inline const char *parse_value(const char *p, const char *line_end, real_cpu *value) {
 
-    domain_config = alloc_and_init_config_data();
-    char *discretization = "300";
-    //char *discretization = "500";
+    double v;
+    const char *end = parse_number(p, &v);
 
-    shput_dup_value(domain_config->config_data, "start_discretization", strdup(discretization));
-    shput_dup_value(domain_config->config_data, "maximum_discretization", strdup(discretization));
-    shput_dup_value(domain_config->config_data, "mesh_file", strdup(input));
+    if(!end) {
+        char *strtod_end;
+        v = strtod(p, &strtod_end);
+        end = (strtod_end == p) ? NULL : strtod_end;
+    }
 
-    domain_config->main_function_name = strdup("initialize_grid_with_dti_mesh");
-    shput_dup_value(domain_config->config_data, "name", "Oxford DTI004 with Transmurality and Fiber orientation");
+    if(!end || end > line_end) {
+        return NULL;
+    }
 
-    //shput(domain_config->config_data, "side_length_x", strdup(discretization));
-    //shput(domain_config->config_data, "side_length_y", strdup(discretization));
-    //shput(domain_config->config_data, "side_length_z", strdup(discretization));
-    shput(domain_config->config_data, "num_volumes", strdup(n_volumes));
-    //shput(domain_config->config_data, "num_extra_fields", "5");
+    *value = v;
+    return end;
+}
 
-    init_config_functions(domain_config, "./shared_libs/libdefault_domains.so", "domain");
+// Copies the line changing the FAST_ENDO label to ENDO in the given column
+static char *copy_line(char *out, const char *line, const char *line_end, int endo_label_column) {
 
-    int success = ((set_spatial_domain_fn*)domain_config->main_function)(domain_config, grid);
+    const char *label = line;
 
-    if(success == 0) {
-        printf("Error loading mesh in %s. Exiting!\n", input);
-        exit(EXIT_FAILURE);
+    for(int c = 0; c < endo_label_column && label; c++) {
+        label = memchr(label, ',', line_end - label);
+        if(label) {
+            label++;
+        }
     }
 
-    struct dti_mesh_info *extra_data = NULL;
-    bool ignore_cell;
-    real_cpu dx, dy, dz;
-    real_cpu min_x, max_x, min_y, max_y, min_z, max_z;
-    real *f, *s, *n;
-    real_cpu transmurality, base_apex_heterogeneity, apicobasal;
-    uint32_t transmurality_labels;
+    if(endo_label_column >= 0 && label && label < line_end && *label == '3' && (label + 1 == line_end || label[1] == ',')) {
+        size_t before = label - line;
+        memcpy(out, line, before);
+        out[before] = '0';
+        memcpy(out + before + 1, label + 1, line_end - label - 1);
+    } else {
+        memcpy(out, line, line_end - line);
+    }
 
-    min_x=76803.6;
-    min_y=51176.3;
-    min_z=8740.9;
-    max_x=96803.6;
-    max_y=71176.3;
-    max_z=28740.9;
+    out += line_end - line;
+    *out++ = '\n';
 
-    FILE *out = fopen(output, "w");
-    FOR_EACH_CELL(grid) {
-        if(cell->active) {
-            
-            f = cell->sigma.fibers.f;
-            s = cell->sigma.fibers.s;
-            n = cell->sigma.fibers.n;
-
-            dx = cell->discretization.x / 2.0;
-            dy = cell->discretization.x / 2.0;
-            dz = cell->discretization.x / 2.0;
-
-            extra_data = (struct dti_mesh_info *)cell->mesh_extra_info;
-            transmurality = extra_data->transmurality;
-            base_apex_heterogeneity = extra_data->base_apex_heterogeneity;
-            apicobasal = extra_data->apicobasal;
-            transmurality_labels = extra_data->dti_transmurality_labels;
-            
-            // Change the FAST_ENDO tag to ENDO
-            if (transmurality_labels == 3) {
-                transmurality_labels = 0;
+    return out;
+}
+
+static void clip_chunk(struct clip_chunk *chunk, const struct clip_options *options) {
+
+    const char *line = chunk->start;
+
+    const char **lines = NULL;
+    real_cpu *x = NULL, *y = NULL, *z = NULL;
+
+    while(line < chunk->end) {
+
+        const char *line_end = memchr(line, '\n', chunk->end - line);
+        if(!line_end) {
+            line_end = chunk->end;
+        }
+
+        real_cpu center[3];
+        const char *p = line;
+        bool valid = true;
+
+        for(int i = 0; i < 3 && valid; i++) {
+            p = parse_value(p, line_end, &center[i]);
+            valid = p != NULL && (i == 2 || *p == ',');
+            if(valid) {
+                p++;
             }
+        }
 
-            ignore_cell = cell->center.x < min_x || cell->center.x > max_x || cell->center.y < min_y || cell->center.y > max_y || cell->center.z < min_z || cell->center.z > max_z;
+        if(valid) {
+            arrput(lines, line);
+            arrput(x, center[0]);
+            arrput(y, center[1]);
+            arrput(z, center[2]);
+        } else if(line_end > line) {
+            fprintf(stderr, "Invalid line in the mesh file: %.*s. Skipping!\n", (int)(line_end - line), line);
+        }
+
+        line = line_end + 1;
+    }
 
-            if(!ignore_cell) {
-                fprintf(out, "%g,%g,%g,%g,%g,%g,%g,%g,%g,%u,%g,%g,%g,%g,%g,%g,%g,%g,%g\n", cell->center.x, cell->center.y, cell->center.z, dx, dy, dz, \
-                                                    transmurality, base_apex_heterogeneity, apicobasal, \
-                                                    transmurality_labels, \
-                                                    f[0], f[1], f[2], s[0], s[1], s[2], n[0], n[1], n[2]);
+    int num_cells = (int)arrlen(lines);
+    uint8_t *keep = MALLOC_ARRAY_OF_TYPE(uint8_t, num_cells);
+    memset(keep, 1, num_cells);
+
+    if(options->clip_with_box) {
+        const real_cpu *min = options->min, *max = options->max;
+
+        OMP(simd)
+        for(int i = 0; i < num_cells; i++) {
+            keep[i] &= (x[i] >= min[0]) & (x[i] <= max[0]) & (y[i] >= min[1]) & (y[i] <= max[1]) & (z[i] >= min[2]) & (z[i] <= max[2]);
+        }
+    }
+
+    if(options->clip_with_plane) {
+        const real_cpu *o = options->origin, *n = options->normal;
+
+        OMP(simd)
+        for(int i = 0; i < num_cells; i++) {
+            keep[i] &= (n[0] * (x[i] - o[0]) + n[1] * (y[i] - o[1]) + n[2] * (z[i] - o[2])) >= 0.0;
+        }
+    }
+
+    if(options->clip_with_sphere) {
+        const real_cpu *c = options->sphere_center;
+        const real_cpu r2 = options->radius * options->radius;
+
+        OMP(simd)
+        for(int i = 0; i < num_cells; i++) {
+            real_cpu dx = x[i] - c[0], dy = y[i] - c[1], dz = z[i] - c[2];
+            keep[i] &= (dx * dx + dy * dy + dz * dz) <= r2;
+        }
+    }
+
+    // The output is never bigger than the input (plus a new line in the last line)
+    chunk->output = malloc(chunk->end - chunk->start + 1);
+    char *out = chunk->output;
+
+    for(int i = 0; i < num_cells; i++) {
+        if(keep[i]) {
+            const char *line_end = memchr(lines[i], '\n', chunk->end - lines[i]);
+            if(!line_end) {
+                line_end = chunk->end;
             }
 
+            out = copy_line(out, lines[i], line_end, options->endo_label_column);
+            chunk->num_kept_cells++;
         }
     }
+
+    chunk->output_size = out - chunk->output;
+    chunk->num_cells = num_cells;
+
+    free(keep);
+    arrfree(lines);
+    arrfree(x);
+    arrfree(y);
+    arrfree(z);
+}
+
+// Start of the first line after offset
+static const char *get_line_start(const char *data, size_t size, size_t offset) {
+
+    if(offset == 0) {
+        return data;
+    }
+
+    if(offset >= size) {
+        return data + size;
+    }
+
+    const char *new_line = memchr(data + offset - 1, '\n', size - offset + 1);
+
+    return new_line ? new_line + 1 : data + size;
+}
+
+static void clip_mesh(const struct clip_options *options, const char *output) {
+
+    size_t size = 0;
+    char *data = read_entire_file_with_mmap(options->input, &size);
+
+    if(!data) {
+        fprintf(stderr, "Error reading the mesh in %s. Exiting!\n", options->input);
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *out = fopen(output, "w");
+
+    if(!out) {
+        fprintf(stderr, "Error opening %s. Exiting!\n", output);
+        exit(EXIT_FAILURE);
+    }
+
+    int num_threads = 1;
+#if defined(_OPENMP)
+    if(options->num_threads > 0) {
+        omp_set_num_threads(options->num_threads);
+    }
+    num_threads = omp_get_max_threads();
+#endif
+
+    size_t num_chunks = (size + CLIP_CHUNK_SIZE - 1) / CLIP_CHUNK_SIZE;
+    struct clip_chunk *batch = MALLOC_ARRAY_OF_TYPE(struct clip_chunk, num_threads);
+
+    uint64_t num_cells = 0, num_kept_cells = 0;
+
+    // Each batch has one chunk per thread, so only num_threads chunks are in memory
+    for(size_t first = 0; first < num_chunks; first += num_threads) {
+
+        int batch_size = (int)((num_chunks - first) < (size_t)num_threads ? (num_chunks - first) : (size_t)num_threads);
+
+        OMP(parallel for schedule(dynamic, 1))
+        for(int c = 0; c < batch_size; c++) {
+            size_t chunk = first + c;
+
+            memset(&batch[c], 0, sizeof(struct clip_chunk));
+            batch[c].start = get_line_start(data, size, chunk * CLIP_CHUNK_SIZE);
+            batch[c].end = get_line_start(data, size, (chunk + 1) * CLIP_CHUNK_SIZE);
+
+            clip_chunk(&batch[c], options);
+        }
+
+        for(int c = 0; c < batch_size; c++) {
+            fwrite(batch[c].output, 1, batch[c].output_size, out);
+            num_cells += batch[c].num_cells;
+            num_kept_cells += batch[c].num_kept_cells;
+            free(batch[c].output);
+        }
+    }
+
     fclose(out);
+    free(batch);
+    munmap(data, size);
+
+    printf("Clipped %s to %s: %lu of %lu cells kept\n", options->input, output, num_kept_cells, num_cells);
 }
 
 int main(int argc, char **argv) {
 
-    struct expansion_options *options  = CALLOC_ONE_TYPE(struct expansion_options);
+    struct clip_options *options = CALLOC_ONE_TYPE(struct clip_options);
+    options->endo_label_column = -1;
 
-    parse_expansion_options(argc, argv, options);
+    parse_clip_options(argc, argv, options);
 
     char *input = options->input;
     char *output = options->output;
@@ -183,11 +400,10 @@ int main(int argc, char **argv) {
     }
 
     if(!output) {
-        output = "expanded_mesh.alg";
+        output = "clipped_mesh.alg";
     }
 
-    expand_scar(input, output, options->n_rows, options->n_volumes);
-
+    clip_mesh(options, output);
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -5,18 +5,64 @@
 #include "3dparty/sds/sds.h"
 #include "3dparty/stb_ds.h"
 #include "3dparty/ini_parser/ini.h"
+#include "common_types/common_types.h"
 #include "config/config_parser.h"
 #include "utils/file_utils.h"
 #include "vtk_utils/vtk_unstructured_grid.h"
 
-static void convert_file(const char *input, const char *output, const char *file_name, struct string_voidp_hash_entry *extra_data_config) {
+// Each thread converts one file at a time, so only one grid per thread is in memory. The grid of the last file
+// converted by the thread is kept to reuse its points and cells when the next file has the same geometry.
+struct converter_thread_data {
+    struct vtk_unstructured_grid *vtk_grid;
+    uint64_t geometry_hash;
 
-    sds full_input_path;
+    // Values of the Ensight files. The points and cells (also the ones of the Purkinje network) are shared with the
+    // geometry read from the .geo file
+    struct vtk_unstructured_grid *ensight_grid;
+};
 
-    static struct vtk_unstructured_grid *vtk_grid = NULL;
-    sds full_output_path;
+static struct vtk_unstructured_grid *new_ensight_values_grid(struct vtk_unstructured_grid *geometry) {
 
-    full_input_path = sdsnew(input);
+    struct vtk_unstructured_grid *grid = new_vtk_unstructured_grid();
+    *grid = *geometry;
+
+    grid->values = NULL;
+    grid->extra_values = NULL;
+    grid->min_extra_value = NULL;
+    grid->max_extra_value = NULL;
+
+    // Each thread reads the Purkinje values into its own grid
+    if(geometry->purkinje) {
+        grid->purkinje = new_ensight_values_grid(geometry->purkinje);
+    }
+
+    return grid;
+}
+
+static void free_ensight_values_grid(struct vtk_unstructured_grid *grid) {
+    if(grid) {
+        free_ensight_values_grid(grid->purkinje);
+        arrfree(grid->values);
+        free(grid);
+    }
+}
+
+static sds get_output_path(const char *output, const char *file_name, const char *ext) {
+
+    sds full_output_path = sdsnew(output);
+
+    if(!ENDS_WITH_SLASH(full_output_path)) {
+        full_output_path = sdscat(full_output_path, "/");
+    }
+
+    return sdscatfmt(full_output_path, "%s%s", file_name, ext);
+}
+
+// ensight_index is the number of the Ensight step (used in the name of the output file)
+static void convert_file(const char *input, const char *output, const char *file_name, struct string_voidp_hash_entry *extra_data_config,
+                         struct vtk_unstructured_grid *ensight_geometry, int ensight_index, struct converter_thread_data *thread_data) {
+
+    sds full_input_path = sdsnew(input);
 
     struct path_information input_file_info;
 
@@ -30,96 +76,141 @@ static void convert_file(const char *input, const char *output, const char *file
 
     get_path_information(full_input_path, &input_file_info);
 
-    static int count = 0;
+    struct vtk_unstructured_grid *vtk_grid = NULL;
+    sds full_output_path = NULL;
+    bool alg = false;
 
-    if(FILE_HAS_EXTENSION(input_file_info, "txt") || FILE_HAS_EXTENSION(input_file_info, "alg") ||
-       FILE_HAS_EXTENSION(input_file_info, "geo") || FILE_HAS_EXTENSION_PREFIX(input_file_info, "Esca")) {
+    if(FILE_HAS_EXTENSION_PREFIX(input_file_info, "Esca")) {
 
-        if(vtk_grid == NULL) {
-            vtk_grid = new_vtk_unstructured_grid_from_file(full_input_path, false);
-            if(FILE_HAS_EXTENSION(input_file_info, "geo")) {
-                return;
+        if(ensight_geometry) {
+            if(!thread_data->ensight_grid) {
+                thread_data->ensight_grid = new_ensight_values_grid(ensight_geometry);
             }
+
+            vtk_grid = thread_data->ensight_grid;
+            set_vtk_grid_values_from_ensight_file(vtk_grid, full_input_path);
+
+            sds base_name = sdscatfmt(sdsempty(), "V_it_%i", ensight_index);
+            full_output_path = get_output_path(output, base_name, ".vtu");
+            sdsfree(base_name);
         }
 
-        if(!vtk_grid) {
-            fprintf(stderr, "%s is not a valid simulation file. Skipping!!\n", full_input_path);
-        } else {
+    } else if(FILE_HAS_EXTENSION(input_file_info, "txt") || FILE_HAS_EXTENSION(input_file_info, "alg")) {
 
-            full_output_path = sdsnew(output);
+        read_vtk_unstructured_grid_reusing_geometry(&thread_data->vtk_grid, &thread_data->geometry_hash, full_input_path);
+        vtk_grid = thread_data->vtk_grid;
 
-            if(!ENDS_WITH_SLASH(full_output_path)) {
-                full_output_path = sdscat(full_output_path, "/");
-            }
+        alg = FILE_HAS_EXTENSION(input_file_info, "alg");
+        full_output_path = get_output_path(output, input_file_info.filename_without_extension, alg ? ".vtk" : ".vtu");
 
-            if(FILE_HAS_EXTENSION_PREFIX(input_file_info, "Esca")) {
-                set_vtk_grid_values_from_ensight_file(vtk_grid, full_input_path);
-            }
+    } else if(FILE_HAS_EXTENSION(input_file_info, "vtu")) {
 
-            char ext[5] = ".vtu\0";
-            bool alg = false;
+        free_vtk_unstructured_grid(thread_data->vtk_grid);
+        thread_data->vtk_grid = NULL;
+        thread_data->geometry_hash = 0;
 
-            if(FILE_HAS_EXTENSION(input_file_info, "alg")) {
-                ext[1] = 'v';
-                ext[2] = 't';
-                ext[3] = 'k';
-                ext[4] = '\0';
-                alg = true;
-            }
+        vtk_grid = new_vtk_unstructured_grid_from_file(full_input_path, false);
+        full_output_path = get_output_path(output, input_file_info.filename_without_extension, ".txt");
 
-            if(FILE_HAS_EXTENSION_PREFIX(input_file_info, "Esca")) {
-                full_output_path = sdscatfmt(full_output_path, "V_it_%i%s", count, ext);
-                count++;
-            } else {
-                full_output_path = sdscat(full_output_path, input_file_info.filename_without_extension);
-                full_output_path = sdscat(full_output_path, ext);
-            }
+    } else {
+        free_path_information(&input_file_info);
+        sdsfree(full_input_path);
+        return;
+    }
 
-            printf("Converting %s to %s\n", full_input_path, full_output_path);
+    if(!vtk_grid) {
+        fprintf(stderr, "%s is not a valid simulation file. Skipping!!\n", full_input_path);
+    } else {
 
-            if(alg){
-                save_vtk_unstructured_grid_as_legacy_vtk(vtk_grid, full_output_path, false, false, extra_data_config);
-            } else {
-                save_vtk_unstructured_grid_as_vtu_compressed(vtk_grid, full_output_path, 6);
-            }
+        printf("Converting %s to %s\n", full_input_path, full_output_path);
 
-            if(FILE_HAS_EXTENSION(input_file_info, "txt") || FILE_HAS_EXTENSION(input_file_info, "alg")) {
-                free_vtk_unstructured_grid(vtk_grid);
-                vtk_grid = NULL;
-            }
+        if(FILE_HAS_EXTENSION(input_file_info, "vtu")) {
+            save_vtk_unstructured_grid_as_alg_file(vtk_grid, full_output_path, false);
+            free_vtk_unstructured_grid(vtk_grid);
+        } else if(alg) {
+            save_vtk_unstructured_grid_as_legacy_vtk(vtk_grid, full_output_path, false, false, extra_data_config);
+        } else {
+            save_vtk_unstructured_grid_as_vtu_compressed(vtk_grid, full_output_path, 6);
+        }
+    }
 
-            sdsfree(full_output_path);
+    sdsfree(full_output_path);
+    free_path_information(&input_file_info);
+    sdsfree(full_input_path);
+}
 
-            free_path_information(&input_file_info);
-            sdsfree(full_input_path);
+// The files are independent, so they are converted in parallel. The dynamic schedule keeps the files being converted
+// close to the order of the list.
+static void convert_files(const char *input, const char *output, string_array files_list, struct string_voidp_hash_entry *extra_data_config,
+                          struct vtk_unstructured_grid *ensight_geometry) {
+
+    int num_files = arrlen(files_list);
+
+    // The Ensight steps are numbered in the order of the list
+    int *ensight_index = MALLOC_ARRAY_OF_TYPE(int, num_files);
+    int count = 0;
+
+    for(int i = 0; i < num_files; i++) {
+        ensight_index[i] = count;
+
+        const char *ext = strrchr(files_list[i], '.');
+        if(ext && FILE_EXTENSION_EQUALS_PREFIX(ext + 1, "Esca")) {
+            count++;
         }
+    }
 
-    } else if(FILE_HAS_EXTENSION(input_file_info, "vtu")) {
+    OMP(parallel)
+    {
+        struct converter_thread_data thread_data = {0};
 
-        vtk_grid = new_vtk_unstructured_grid_from_file(full_input_path, false);
+        OMP(for schedule(dynamic, 1))
+        for(int i = 0; i < num_files; i++) {
+            convert_file(input, output, files_list[i], extra_data_config, ensight_geometry, ensight_index[i], &thread_data);
+        }
 
-        if(!vtk_grid) {
-            fprintf(stderr, "%s is not a valid simulation file. Skipping!!\n", full_input_path);
-        } else {
-            full_output_path = sdsnew(output);
+        free_vtk_unstructured_grid(thread_data.vtk_grid);
+        free_ensight_values_grid(thread_data.ensight_grid);
+    }
 
-            if(!ENDS_WITH_SLASH(full_output_path)) {
-                full_output_path = sdscat(full_output_path, "/");
-            }
+    free(ensight_index);
+}
 
-            full_output_path = sdscat(full_output_path, input_file_info.filename_without_extension);
-            full_output_path = sdscat(full_output_path, ".txt");
+static void convert_dir(const char *input, const char *output, struct string_voidp_hash_entry *extra_data_config) {
 
-            printf("Converting %s to %s\n", full_input_path, full_output_path);
+    string_array geo_file = list_files_from_dir(input, NULL, "geo", NULL, true);
+    string_array files_list = NULL;
+    struct vtk_unstructured_grid *ensight_geometry = NULL;
 
-            save_vtk_unstructured_grid_as_alg_file(vtk_grid, full_output_path, false);
-            free_vtk_unstructured_grid(vtk_grid);
-            sdsfree(full_output_path);
+    if(arrlen(geo_file) > 0) {
+
+        sds geo_path = sdsnew(input);
+        if(!ENDS_WITH_SLASH(geo_path)) {
+            geo_path = sdscat(geo_path, "/");
+        }
+        geo_path = sdscat(geo_path, geo_file[0]);
+
+        ensight_geometry = new_vtk_unstructured_grid_from_file(geo_path, false);
 
-            free_path_information(&input_file_info);
-            sdsfree(full_input_path);
+        if(!ensight_geometry) {
+            fprintf(stderr, "%s is not a valid Ensight geometry file!\n", geo_path);
+            exit(EXIT_FAILURE);
         }
+
+        sdsfree(geo_path);
+
+        files_list = list_files_from_dir(input, "Vm.", NULL, NULL, true);
+    } else {
+        files_list = list_files_from_dir(input, NULL, NULL, NULL, true);
+    }
+
+    if(arrlen(files_list) == 0) {
+        fprintf(stderr, "Directory %s is empty\n", input);
+        exit(EXIT_FAILURE);
     }
+
+    convert_files(input, output, files_list, extra_data_config, ensight_geometry);
+
+    free_vtk_unstructured_grid(ensight_geometry);
 }
 
 #define SET_OUT_DIR(input)                                                                                                                                     \
@@ -156,52 +247,30 @@ int main(int argc, char **argv) {
         return EXIT_FAILURE;
     }
 
-    if(!output) {
+#if defined(_OPENMP)
+    if(options->num_threads > 0) {
+        omp_set_num_threads(options->num_threads);
+    }
+#endif
 
+    if(!output) {
         output = sdsempty();
 
         if(input_info.is_dir) {
-
             SET_OUT_DIR(input);
-
-            string_array geo_file = list_files_from_dir(input, NULL, "geo", NULL, true);
-            string_array files_list = NULL;
-            if(arrlen(geo_file) > 0) {
-
-                convert_file(input, output, geo_file[0], options->extra_data_config);
-                files_list = list_files_from_dir(input, "Vm.", NULL, NULL, true);
-                int num_files = arrlen(files_list);
-
-                if(num_files == 0) {
-                    fprintf(stderr, "Directory %s is empty\n", input);
-                    exit(EXIT_FAILURE);
-                } else {
-                    for(int i = 0; i < num_files; i++) {
-                        convert_file(input, output, files_list[i], options->extra_data_config);
-                    }
-                }
-
-            } else {
-
-                files_list = list_files_from_dir(input, NULL, NULL, NULL, true);
-                int num_files = arrlen(files_list);
-
-                if(num_files == 0) {
-                    fprintf(stderr, "Directory %s is empty\n", input);
-                    exit(EXIT_FAILURE);
-                } else {
-                    for(int i = 0; i < num_files; i++) {
-                        convert_file(input, output, files_list[i], options->extra_data_config);
-                    }
-                }
-            }
         } else {
-
             SET_OUT_DIR(input_info.dir_name);
-
-            create_dir(output);
-            convert_file(input, output, NULL, options->extra_data_config);
         }
+    } else {
+        create_dir(output);
+    }
+
+    if(input_info.is_dir) {
+        convert_dir(input, output, options->extra_data_config);
+    } else {
+        struct converter_thread_data thread_data = {0};
+        convert_file(input, output, NULL, options->extra_data_config, NULL, 0, &thread_data);
+        free_vtk_unstructured_grid(thread_data.vtk_grid);
     }
 
     return EXIT_SUCCESS;
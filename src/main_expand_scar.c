@@ -105,92 +105,92 @@ static void expand_scar(const char *input, const char *output, int n_rows, char*
         exit(EXIT_FAILURE);
     }
 
-    struct cell_node *neighbour;
-    real *extra_info_n;
+    // The scar (extra_info[4] == 1) grows one row of border zone cells (extra_info[4] == 2) per iteration. Only the cells
+    // added in the last iteration (the frontier) can have neighbours not yet in the scar or in the border zone.
+    // The border zone cells of the input mesh start to grow in the second iteration.
+    struct cell_node **frontier = NULL;
+    struct cell_node **initial_border_zone = NULL;
     real *extra_info;
 
-    bool evaluate;
-
-    for (int i = 0; i < n_rows; i++) {
-
-        FOR_EACH_CELL(grid) {
-            cell->visited = false;
+    FOR_EACH_CELL(grid) {
+        if(cell->active) {
+            extra_info = (real *)cell->mesh_extra_info;
+            if(extra_info[4] == 1) {
+                arrput(frontier, cell);
+            } else if(extra_info[4] == 2) {
+                arrput(initial_border_zone, cell);
+            }
         }
+    }
 
-        FOR_EACH_CELL(grid) {
+    const enum transition_direction directions[] = {FRONT, BACK, DOWN, TOP, RIGHT, LEFT};
+    const int num_directions = sizeof(directions) / sizeof(directions[0]);
 
-            extra_info = (real*)cell->mesh_extra_info;
+    struct cell_node **candidates = NULL;
+    struct cell_node **next_frontier = NULL;
 
-            if(i == 0) {
-                evaluate = cell->active && extra_info[4] == 1;
-            } else {
-                evaluate = cell->active && extra_info[4] == 2 && !cell->visited;
-            }
+    for(int i = 0; i < n_rows; i++) {
 
-            if(evaluate) {
+        int frontier_size = (int)arrlen(frontier);
 
-                cell->visited = true;
+        if(frontier_size == 0 && i > 0) {
+            break;
+        }
 
-                neighbour = get_cell_neighbour(cell, cell->neighbours[FRONT]);
+        arrsetlen(candidates, (size_t)frontier_size * num_directions);
 
-                if(neighbour) {
-                    extra_info_n = (real*)neighbour->mesh_extra_info;
-                    if(extra_info_n[4] != 1 && extra_info_n[4] != 2) {
-                        extra_info_n[4] = 2;
-                        neighbour->visited = true;
-                    }
-                }
+        OMP(parallel for)
+        for(int c = 0; c < frontier_size; c++) {
+            struct cell_node *cell = frontier[c];
 
-                neighbour = get_cell_neighbour(cell, cell->neighbours[BACK]);
+            for(int d = 0; d < num_directions; d++) {
+                struct cell_node *neighbour = get_cell_neighbour(cell, cell->neighbours[directions[d]]);
 
                 if(neighbour) {
-                    extra_info_n = (real*)neighbour->mesh_extra_info;
-                    if(extra_info_n[4] != 1 && extra_info_n[4] != 2) {
-                        extra_info_n[4] = 2;
-                        neighbour->visited = true;
+                    real *extra_info_n = (real *)neighbour->mesh_extra_info;
+                    if(extra_info_n[4] == 1 || extra_info_n[4] == 2) {
+                        neighbour = NULL;
                     }
                 }
 
-                neighbour = get_cell_neighbour(cell, cell->neighbours[DOWN]);
-                if(neighbour) {
-                    extra_info_n = (real*)neighbour->mesh_extra_info;
-                    if(extra_info_n[4] != 1 && extra_info_n[4] != 2) {
-                        extra_info_n[4] = 2;
-                        neighbour->visited = true;
-                    }
-                }
+                candidates[c * num_directions + d] = neighbour;
+            }
+        }
 
+        // A cell can be the neighbour of more than one cell of the frontier
+        arrsetlen(next_frontier, 0);
 
-                neighbour = get_cell_neighbour(cell, cell->neighbours[TOP]);
-                if(neighbour) {
-                    extra_info_n = (real*)neighbour->mesh_extra_info;
-                    if(extra_info_n[4] != 1 && extra_info_n[4] != 2) {
-                        extra_info_n[4] = 2;
-                        neighbour->visited = true;
-                    }
-                }
+        for(int c = 0; c < frontier_size * num_directions; c++) {
+            struct cell_node *neighbour = candidates[c];
 
-                neighbour = get_cell_neighbour(cell, cell->neighbours[RIGHT]);
-                if(neighbour) {
-                    extra_info_n = (real*)neighbour->mesh_extra_info;
-                    if(extra_info_n[4] != 1 && extra_info_n[4] != 2) {
-                        extra_info_n[4] = 2;
-                        neighbour->visited = true;
-                    }
-                }
+            if(neighbour) {
+                extra_info = (real *)neighbour->mesh_extra_info;
 
-                neighbour = get_cell_neighbour(cell, cell->neighbours[LEFT]);
-                if(neighbour) {
-                    extra_info_n = (real*)neighbour->mesh_extra_info;
-                    if(extra_info_n[4] != 1 && extra_info_n[4] != 2) {
-                        extra_info_n[4] = 2;
-                        neighbour->visited = true;
+                if(extra_info[4] != 2) {
+                    extra_info[4] = 2;
+                    if(neighbour->active) {
+                        arrput(next_frontier, neighbour);
                     }
                 }
             }
         }
+
+        if(i == 0) {
+            for(int c = 0; c < arrlen(initial_border_zone); c++) {
+                arrput(next_frontier, initial_border_zone[c]);
+            }
+        }
+
+        struct cell_node **tmp = frontier;
+        frontier = next_frontier;
+        next_frontier = tmp;
     }
 
+    arrfree(frontier);
+    arrfree(next_frontier);
+    arrfree(candidates);
+    arrfree(initial_border_zone);
+
     FILE *out = fopen(output, "w");
     real_cpu dx, dy, dz;
 
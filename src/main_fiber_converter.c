@@ -7,6 +7,7 @@
 #include "3dparty/stb_ds.h"
 #include "common_types/common_types.h"
 #include "config/config_parser.h"
+#include "utils/bucket_grid.h"
 #include "utils/file_utils.h"
 
 struct elem {
@@ -16,55 +17,6 @@ struct elem {
     struct point_3d n4;
 };
 
-int closest_node(struct elem *elements, struct point_3d alg_node) {
-
-    int n = arrlen(elements);
-    int nt = omp_get_max_threads();
-
-    double min_local[nt];
-    int index_local[nt];
-
-    for(int i = 0; i < nt; i++) {
-        min_local[i] = FLT_MAX;
-    }
-
-    int index = 0;
-
-    OMP(parallel for)
-    for(int element_index = 0; element_index < n; element_index++) {
-
-        int tid = omp_get_thread_num();
-
-        double dist;
-        double x[4] = {elements[element_index].n1.x, elements[element_index].n2.x, elements[element_index].n3.x, elements[element_index].n4.x};
-        double y[4] = {elements[element_index].n1.y, elements[element_index].n2.y, elements[element_index].n3.y, elements[element_index].n4.y};
-        double z[4] = {elements[element_index].n1.z, elements[element_index].n2.z, elements[element_index].n3.z, elements[element_index].n4.z};
-
-        struct point_3d centroid;
-
-        centroid.x = (x[0] + x[1] + x[2] + x[3]) / 4.0;
-        centroid.y = (y[0] + y[1] + y[2] + y[3]) / 4.0;
-        centroid.z = (z[0] + z[1] + z[2] + z[3]) / 4.0;
-
-        dist = sqrt(pow(alg_node.x - centroid.x, 2) + pow(alg_node.y - centroid.y, 2) + pow(alg_node.z - centroid.z, 2));
-
-        if(dist < min_local[tid]) {
-            min_local[tid] = dist;
-            index_local[tid] = element_index;
-        }
-    }
-
-    double min = FLT_MAX;
-    for(int i = 0; i < nt; i++) {
-        if(min_local[i] < min) {
-            min = min_local[i];
-            index = index_local[i];
-        }
-    }
-
-    return index;
-}
-
 void convert_fibers(struct fibers_conversion_options *options) {
 
     FILE *fibers_file = open_file_or_exit(options->fibers_file, "r");
@@ -193,7 +145,8 @@ void convert_fibers(struct fibers_conversion_options *options) {
 
     printf("Reading ALG mesh\n");
 
-    int count = 0;
+    point3d_array alg_centers = NULL;
+
     while((getline(&line, &len, alg_file)) != -1) {
         points = sdssplit(line, ",", &split_count);
         x = strtod(points[0], NULL);
@@ -201,18 +154,40 @@ void convert_fibers(struct fibers_conversion_options *options) {
         z = strtod(points[2], NULL);
 
         sdsfreesplitres(points, split_count);
-        struct point_3d alg_center = POINT3D(x, y, z);
-        int closest_index = closest_node(elements, alg_center);
-
-        arrput(alg_fiber_coords, fiber_coords[closest_index]);
-        count++;
-        if(count % 2500 == 0) {
-            printf("%d lines processed\n", count);
-        }
+        arrput(alg_centers, POINT3D(x, y, z));
     }
 
     free(line);
 
+    printf("Building the spatial index of the elements\n");
+
+    int num_elements = arrlen(elements);
+    struct point_3d *centroids = malloc(num_elements * sizeof(struct point_3d));
+
+    for(int i = 0; i < num_elements; i++) {
+        centroids[i].x = (elements[i].n1.x + elements[i].n2.x + elements[i].n3.x + elements[i].n4.x) / 4.0;
+        centroids[i].y = (elements[i].n1.y + elements[i].n2.y + elements[i].n3.y + elements[i].n4.y) / 4.0;
+        centroids[i].z = (elements[i].n1.z + elements[i].n2.z + elements[i].n3.z + elements[i].n4.z) / 4.0;
+    }
+
+    // The queries return the same element as a brute force search (the closest one, the lowest index in a tie)
+    struct bucket_grid *index = new_bucket_grid(centroids, num_elements, 0.0);
+
+    int num_alg_centers = arrlen(alg_centers);
+    arrsetlen(alg_fiber_coords, num_alg_centers);
+
+    printf("Mapping the fibers to %d ALG cells\n", num_alg_centers);
+
+    OMP(parallel for schedule(dynamic, 1024))
+    for(int i = 0; i < num_alg_centers; i++) {
+        uint32_t closest_index = bucket_grid_nearest_point(index, alg_centers[i], NULL);
+        alg_fiber_coords[i] = fiber_coords[closest_index];
+    }
+
+    free_bucket_grid(index);
+    free(centroids);
+    arrfree(alg_centers);
+
     for(int i = 0; i < arrlen(alg_fiber_coords); i++) {
         fprintf(outfile, "%.10lf %.10lf %.10lf %.10lf %.10lf %.10lf %.10lf %.10lf %.10lf\n", alg_fiber_coords[i].f[0], alg_fiber_coords[i].f[1],
                 alg_fiber_coords[i].f[2], alg_fiber_coords[i].s[0], alg_fiber_coords[i].s[1], alg_fiber_coords[i].s[2], alg_fiber_coords[i].n[0],
@@ -1,3 +1,6 @@
+#include <sys/stat.h>
+#include <unistd.h>
+
 static struct element fill_element(uint32_t position, enum transition_direction direction, real_cpu dx, real_cpu dy, real_cpu dz, real_cpu sigma_x,
                                    real_cpu sigma_y, real_cpu sigma_z, struct element *cell_elements, struct cell_node *cell);
 
@@ -905,18 +908,21 @@ static void fill_discretization_matrix_elements_aniso(struct cell_node *grid_cel
         }
     }
 
+    // Each row only has elements for the cell itself and its active neighbours, and it is only written by its own cell,
+    // so reserving it here avoids the reallocations when the elements are added
+    arrsetcap(grid_cell->elements, arrlen(grid_cell->elements) + n);
+
     fill_elements_aniso(grid_cell, neighbours);
 }
 
-static void fill_discretization_matrix_elements(struct cell_node *grid_cell, void *neighbour_grid_cell, enum transition_direction direction) {
+// When neighbour_grid_cell is a transition node, looks for the next neighbour cell which is a cell node.
+// Returns NULL if there is no active neighbour in this direction
+static struct cell_node *get_discretization_neighbour(struct cell_node *grid_cell, void *neighbour_grid_cell) {
 
     bool has_found;
 
     struct transition_node *white_neighbor_cell;
-    struct cell_node *black_neighbor_cell;
 
-    /* When neighbour_grid_cell is a transition node, looks for the next neighbor
-     * cell which is a cell node. */
     uint16_t neighbour_grid_cell_level = ((struct basic_cell_data *)(neighbour_grid_cell))->level;
     enum cell_type neighbour_grid_cell_type = ((struct basic_cell_data *)(neighbour_grid_cell))->type;
 
@@ -958,93 +964,177 @@ static void fill_discretization_matrix_elements(struct cell_node *grid_cell, voi
 
     // We care only with the interior points
     if(neighbour_grid_cell_type == CELL_NODE) {
+        struct cell_node *black_neighbor_cell = (struct cell_node *)(neighbour_grid_cell);
+        if(black_neighbor_cell->active) {
+            return black_neighbor_cell;
+        }
+    }
 
-        black_neighbor_cell = (struct cell_node *)(neighbour_grid_cell);
+    return NULL;
+}
 
-        if(black_neighbor_cell->active) {
+// Adds the flux between grid_cell and black_neighbor_cell (found from grid_cell in the given direction) to the row
+// of row_cell, which is one of the two cells. column_cell is the other one. Nothing is done if the element already exists.
+static void add_face_element(struct cell_node *grid_cell, struct cell_node *black_neighbor_cell, enum transition_direction direction,
+                             struct cell_node *row_cell, struct cell_node *column_cell) {
 
-            uint32_t position;
-            real_cpu dx, dy, dz;
+    real_cpu dx, dy, dz;
 
-            real_cpu sigma_x1 = grid_cell->sigma.x;
-            real_cpu sigma_x2 = black_neighbor_cell->sigma.x;
-            real_cpu sigma_x = 0.0;
+    real_cpu sigma_x1 = grid_cell->sigma.x;
+    real_cpu sigma_x2 = black_neighbor_cell->sigma.x;
+    real_cpu sigma_x = 0.0;
 
-            if(sigma_x1 != 0.0 && sigma_x2 != 0.0) {
-                sigma_x = (2.0f * sigma_x1 * sigma_x2) / (sigma_x1 + sigma_x2);
-            }
+    if(sigma_x1 != 0.0 && sigma_x2 != 0.0) {
+        sigma_x = (2.0f * sigma_x1 * sigma_x2) / (sigma_x1 + sigma_x2);
+    }
 
-            real_cpu sigma_y1 = grid_cell->sigma.y;
-            real_cpu sigma_y2 = black_neighbor_cell->sigma.y;
-            real_cpu sigma_y = 0.0;
+    real_cpu sigma_y1 = grid_cell->sigma.y;
+    real_cpu sigma_y2 = black_neighbor_cell->sigma.y;
+    real_cpu sigma_y = 0.0;
 
-            if(sigma_y1 != 0.0 && sigma_y2 != 0.0) {
-                sigma_y = (2.0f * sigma_y1 * sigma_y2) / (sigma_y1 + sigma_y2);
-            }
+    if(sigma_y1 != 0.0 && sigma_y2 != 0.0) {
+        sigma_y = (2.0f * sigma_y1 * sigma_y2) / (sigma_y1 + sigma_y2);
+    }
 
-            real_cpu sigma_z1 = grid_cell->sigma.z;
-            real_cpu sigma_z2 = black_neighbor_cell->sigma.z;
-            real_cpu sigma_z = 0.0;
+    real_cpu sigma_z1 = grid_cell->sigma.z;
+    real_cpu sigma_z2 = black_neighbor_cell->sigma.z;
+    real_cpu sigma_z = 0.0;
 
-            if(sigma_z1 != 0.0 && sigma_z2 != 0.0) {
-                sigma_z = (2.0f * sigma_z1 * sigma_z2) / (sigma_z1 + sigma_z2);
-            }
+    if(sigma_z1 != 0.0 && sigma_z2 != 0.0) {
+        sigma_z = (2.0f * sigma_z1 * sigma_z2) / (sigma_z1 + sigma_z2);
+    }
 
-            if(black_neighbor_cell->cell_data.level > grid_cell->cell_data.level) {
-                dx = black_neighbor_cell->discretization.x;
-                dy = black_neighbor_cell->discretization.y;
-                dz = black_neighbor_cell->discretization.z;
-            } else {
-                dx = grid_cell->discretization.x;
-                dy = grid_cell->discretization.y;
-                dz = grid_cell->discretization.z;
-            }
+    if(black_neighbor_cell->cell_data.level > grid_cell->cell_data.level) {
+        dx = black_neighbor_cell->discretization.x;
+        dy = black_neighbor_cell->discretization.y;
+        dz = black_neighbor_cell->discretization.z;
+    } else {
+        dx = grid_cell->discretization.x;
+        dy = grid_cell->discretization.y;
+        dz = grid_cell->discretization.z;
+    }
+
+    struct element *cell_elements = row_cell->elements;
+    uint32_t position = column_cell->grid_position;
+
+    size_t max_elements = arrlen(cell_elements);
 
-            lock_cell_node(grid_cell);
+    for(size_t i = 1; i < max_elements; i++) {
+        if(cell_elements[i].column == position) {
+            return;
+        }
+    }
 
-            struct element *cell_elements = grid_cell->elements;
-            position = black_neighbor_cell->grid_position;
+    struct element new_element = fill_element(position, direction, dx, dy, dz, sigma_x, sigma_y, sigma_z, cell_elements, column_cell);
+    arrput(row_cell->elements, new_element);
+}
 
-            size_t max_elements = arrlen(cell_elements);
-            bool insert = true;
+static void fill_discretization_matrix_elements(struct cell_node *grid_cell, void *neighbour_grid_cell, enum transition_direction direction) {
 
-            for(size_t i = 1; i < max_elements; i++) {
-                if(cell_elements[i].column == position) {
-                    insert = false;
-                    break;
-                }
-            }
+    struct cell_node *black_neighbor_cell = get_discretization_neighbour(grid_cell, neighbour_grid_cell);
 
-            if(insert) {
-                struct element new_element = fill_element(position, direction, dx, dy, dz, sigma_x, sigma_y, sigma_z, cell_elements, black_neighbor_cell);
-                //new_element.cell = black_neighbor_cell;
-                arrput(grid_cell->elements, new_element);
-            }
-            unlock_cell_node(grid_cell);
+    if(black_neighbor_cell) {
+
+        lock_cell_node(grid_cell);
+        add_face_element(grid_cell, black_neighbor_cell, direction, grid_cell, black_neighbor_cell);
+        unlock_cell_node(grid_cell);
 
-            lock_cell_node(black_neighbor_cell);
-            cell_elements = black_neighbor_cell->elements;
-            position = grid_cell->grid_position;
+        lock_cell_node(black_neighbor_cell);
+        add_face_element(grid_cell, black_neighbor_cell, direction, black_neighbor_cell, grid_cell);
+        unlock_cell_node(black_neighbor_cell);
+    }
+}
 
-            max_elements = arrlen(cell_elements);
+#define NUM_FACE_DIRECTIONS 6
+static const enum transition_direction face_directions[NUM_FACE_DIRECTIONS] = {BACK, FRONT, TOP, DOWN, RIGHT, LEFT};
 
-            insert = true;
-            for(size_t i = 1; i < max_elements; i++) {
-                if(cell_elements[i].column == position) {
-                    insert = false;
-                    break;
-                }
+struct incoming_face {
+    uint32_t source;
+    uint8_t direction;
+};
+
+// Same matrix as calling fill_discretization_matrix_elements for the BACK, FRONT, TOP, DOWN, RIGHT and LEFT faces of
+// all active cells (in this order) with one thread, but without locks. The neighbours of each face are found first
+// and the faces are grouped by the cell whose row they change. Then each row is filled (in parallel) only by its owner,
+// with its final size already reserved, applying the faces in the same order as the sequential loop.
+static void fill_discretization_matrix_elements_two_pass(struct grid *the_grid) {
+
+    uint32_t num_active_cells = the_grid->num_active_cells;
+    struct cell_node **ac = the_grid->active_cells;
+
+    struct cell_node **face_neighbours = MALLOC_ARRAY_OF_TYPE(struct cell_node *, (size_t)num_active_cells * NUM_FACE_DIRECTIONS);
+    uint32_t *incoming_start = CALLOC_ARRAY_OF_TYPE(uint32_t, num_active_cells + 1);
+
+    OMP(parallel for)
+    for(uint32_t i = 0; i < num_active_cells; i++) {
+        for(int d = 0; d < NUM_FACE_DIRECTIONS; d++) {
+            face_neighbours[(size_t)i * NUM_FACE_DIRECTIONS + d] = get_discretization_neighbour(ac[i], ac[i]->neighbours[face_directions[d]]);
+        }
+    }
+
+    for(size_t f = 0; f < (size_t)num_active_cells * NUM_FACE_DIRECTIONS; f++) {
+        if(face_neighbours[f]) {
+            incoming_start[face_neighbours[f]->grid_position + 1]++;
+        }
+    }
+
+    for(uint32_t i = 0; i < num_active_cells; i++) {
+        incoming_start[i + 1] += incoming_start[i];
+    }
+
+    struct incoming_face *incoming = MALLOC_ARRAY_OF_TYPE(struct incoming_face, incoming_start[num_active_cells]);
+    uint32_t *next = MALLOC_ARRAY_OF_TYPE(uint32_t, num_active_cells);
+    memcpy(next, incoming_start, num_active_cells * sizeof(uint32_t));
+
+    // Sequential, so the faces of each row stay sorted by the cell that owns them
+    for(uint32_t i = 0; i < num_active_cells; i++) {
+        for(int d = 0; d < NUM_FACE_DIRECTIONS; d++) {
+            struct cell_node *neighbour = face_neighbours[(size_t)i * NUM_FACE_DIRECTIONS + d];
+            if(neighbour) {
+                struct incoming_face face = {.source = i, .direction = (uint8_t)d};
+                incoming[next[neighbour->grid_position]++] = face;
             }
+        }
+    }
+
+    free(next);
+
+    OMP(parallel for schedule(dynamic, 1024))
+    for(uint32_t i = 0; i < num_active_cells; i++) {
+
+        struct cell_node *row_cell = ac[i];
+
+        uint32_t own_faces = 0;
+        for(int d = 0; d < NUM_FACE_DIRECTIONS; d++) {
+            own_faces += (face_neighbours[(size_t)i * NUM_FACE_DIRECTIONS + d] != NULL);
+        }
+
+        arrsetcap(row_cell->elements, arrlen(row_cell->elements) + own_faces + incoming_start[i + 1] - incoming_start[i]);
+
+        uint32_t f = incoming_start[i];
+
+        // Faces owned by the cells that come before this one
+        for(; f < incoming_start[i + 1] && incoming[f].source < i; f++) {
+            struct cell_node *source = ac[incoming[f].source];
+            add_face_element(source, row_cell, face_directions[incoming[f].direction], row_cell, source);
+        }
 
-            if(insert) {
-                struct element new_element = fill_element(position, direction, dx, dy, dz, sigma_x, sigma_y, sigma_z, cell_elements, grid_cell);
-                //new_element.cell = grid_cell;
-                arrput(black_neighbor_cell->elements, new_element);
+        for(int d = 0; d < NUM_FACE_DIRECTIONS; d++) {
+            struct cell_node *neighbour = face_neighbours[(size_t)i * NUM_FACE_DIRECTIONS + d];
+            if(neighbour) {
+                add_face_element(row_cell, neighbour, face_directions[d], row_cell, neighbour);
             }
+        }
 
-            unlock_cell_node(black_neighbor_cell);
+        for(; f < incoming_start[i + 1]; f++) {
+            struct cell_node *source = ac[incoming[f].source];
+            add_face_element(source, row_cell, face_directions[incoming[f].direction], row_cell, source);
         }
     }
+
+    free(face_neighbours);
+    free(incoming_start);
+    free(incoming);
 }
 
 static int rand_range(int n) {
@@ -1145,83 +1235,303 @@ static inline void normalize(real_cpu v[3]) {
     v[2] = v[2] / m;
 }
 
-static struct fiber_coords *read_fibers(char *fiber_file_path, bool normalize_vector) {
+// Binary fiber files have this header followed by the f, s and n (and x, for the scale files) arrays, each one with
+// 3 * num_elements float32 or float64 values. A float64 copy of each text fiber file is written next to it (with the
+// FIBER_CACHE_EXTENSION) and used while the size and modification time of the text file do not change.
+#define FIBER_BINARY_MAGIC "MAFIBERS"
+#define FIBER_BINARY_VERSION 1
+#define FIBER_CACHE_EXTENSION ".cache.bin"
+
+struct fiber_binary_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_vectors; // 3 (f, s, n) or 4 (f, s, n, x)
+    uint32_t value_size;  // 4 (float32) or 8 (float64)
+    uint32_t reserved;
+    uint64_t num_elements;
+    uint64_t source_size; // Size and modification time of the text file. Zero if the file is not a cache
+    int64_t source_mtime;
+    uint64_t checksum; // FNV-1a of the arrays
+};
+
+static uint64_t fiber_binary_checksum(const unsigned char *data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
 
-    FILE *fibers_file = open_file_or_exit(fiber_file_path, "r");
+// Returns the values of each element in the order of the text file (f, s, n[, x]) or NULL if the content is not a valid
+// binary fiber file. When source is not NULL the file is only valid if it was created from this source.
+static real_cpu *parse_fiber_binary(const char *content, size_t size, uint32_t num_vectors, const struct stat *source, uint64_t *num_elements) {
 
-    struct fiber_coords *fibers = NULL;
-    char *line = NULL;
-    size_t len;
+    struct fiber_binary_header header;
+
+    if(size < sizeof(header)) {
+        return NULL;
+    }
+
+    memcpy(&header, content, sizeof(header));
+
+    if(memcmp(header.magic, FIBER_BINARY_MAGIC, sizeof(header.magic)) != 0 || header.version != FIBER_BINARY_VERSION ||
+       header.num_vectors != num_vectors || (header.value_size != 4 && header.value_size != 8)) {
+        return NULL;
+    }
+
+    if(source && (header.source_size != (uint64_t)source->st_size || header.source_mtime != (int64_t)source->st_mtime)) {
+        return NULL;
+    }
+
+    uint64_t n = header.num_elements;
+    size_t element_size = (size_t)num_vectors * 3 * header.value_size;
+
+    if(n > (size - sizeof(header)) / element_size) {
+        return NULL;
+    }
+
+    size_t data_size = n * element_size;
+
+    if(size - sizeof(header) != data_size) {
+        return NULL;
+    }
 
-    while((getline(&line, &len, fibers_file)) != -1) {
+    const unsigned char *data = (const unsigned char *)content + sizeof(header);
 
-        int split_count;
-        sds *points = sdssplit(line, " ", &split_count);
-        struct fiber_coords f_coords;
+    if(fiber_binary_checksum(data, data_size) != header.checksum) {
+        return NULL;
+    }
+
+    const uint32_t num_values = num_vectors * 3;
+    real_cpu *values = (real_cpu *)malloc(sizeof(real_cpu) * n * num_values);
+
+    OMP(parallel for)
+    for(uint64_t i = 0; i < n; i++) {
+        for(uint32_t v = 0; v < num_vectors; v++) {
+            for(uint32_t k = 0; k < 3; k++) {
+                size_t pos = (v * n + i) * 3 + k;
+                if(header.value_size == 8) {
+                    double value;
+                    memcpy(&value, data + pos * 8, 8);
+                    values[i * num_values + v * 3 + k] = (real_cpu)value;
+                } else {
+                    float value;
+                    memcpy(&value, data + pos * 4, 4);
+                    values[i * num_values + v * 3 + k] = (real_cpu)value;
+                }
+            }
+        }
+    }
 
-        f_coords.f[0] = strtod(points[0], NULL);
-        f_coords.f[1] = strtod(points[1], NULL);
-        f_coords.f[2] = strtod(points[2], NULL);
+    *num_elements = n;
+    return values;
+}
 
-        f_coords.s[0] = strtod(points[3], NULL);
-        f_coords.s[1] = strtod(points[4], NULL);
-        f_coords.s[2] = strtod(points[5], NULL);
+static void write_fiber_binary_cache(const char *cache_path, const real_cpu *values, uint64_t n, uint32_t num_vectors, const struct stat *source) {
 
-        f_coords.n[0] = strtod(points[6], NULL);
-        f_coords.n[1] = strtod(points[7], NULL);
-        f_coords.n[2] = strtod(points[8], NULL);
+    const uint32_t num_values = num_vectors * 3;
+    size_t data_size = n * num_values * sizeof(double);
+    double *data = (double *)malloc(data_size > 0 ? data_size : 1);
 
-        if(normalize_vector) {
-            normalize(f_coords.f);
-            normalize(f_coords.s);
-            normalize(f_coords.n);
+    OMP(parallel for)
+    for(uint64_t i = 0; i < n; i++) {
+        for(uint32_t v = 0; v < num_vectors; v++) {
+            for(uint32_t k = 0; k < 3; k++) {
+                data[(v * n + i) * 3 + k] = (double)values[i * num_values + v * 3 + k];
+            }
         }
+    }
 
-        arrput(fibers, f_coords);
-        sdsfreesplitres(points, split_count);
+    struct fiber_binary_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FIBER_BINARY_MAGIC, sizeof(header.magic));
+    header.version = FIBER_BINARY_VERSION;
+    header.num_vectors = num_vectors;
+    header.value_size = sizeof(double);
+    header.num_elements = n;
+    header.source_size = (uint64_t)source->st_size;
+    header.source_mtime = (int64_t)source->st_mtime;
+    header.checksum = fiber_binary_checksum((const unsigned char *)data, data_size);
+
+    // Written to a temporary file first, so a partial cache is never read
+    sds tmp_path = sdscatprintf(sdsempty(), "%s.%d.tmp", cache_path, (int)getpid());
+    FILE *f = fopen(tmp_path, "wb");
+
+    bool written = false;
+
+    if(f) {
+        written = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(data, 1, data_size, f) == data_size;
+        written = (fclose(f) == 0) && written;
     }
 
-    free(line);
+    if(written && rename(tmp_path, cache_path) == 0) {
+        log_info("Fiber cache written to %s\n", cache_path);
+    } else {
+        log_warn("Could not write the fiber cache %s\n", cache_path);
+        remove(tmp_path);
+    }
 
-    return fibers;
+    sdsfree(tmp_path);
+    free(data);
 }
 
-// Albert`s code
-static struct fiber_coords_scale *read_fibers_scale(char *fiber_file_path) {
+// Parses the text fiber file (one element per line with its values separated by spaces). The lines are parsed in
+// parallel, but each value is converted in the same way as splitting the line on " " and calling strtod on each part,
+// so the values are the same as the ones of the serial reader. Missing values are read as zero and empty lines are ignored.
+static real_cpu *parse_fiber_text(char *content, size_t size, uint32_t num_values, uint64_t *num_elements) {
 
-    FILE *fibers_file = open_file_or_exit(fiber_file_path, "r");
+    uint64_t *line_start = NULL;
 
-    struct fiber_coords_scale *fibers = NULL;
-    char *line = NULL;
-    size_t len;
+    size_t pos = 0;
+    while(pos < size) {
+        char *end = memchr(content + pos, '\n', size - pos);
+        size_t line_end = end ? (size_t)(end - content) : size;
+
+        if(line_end > pos) {
+            arrput(line_start, pos);
+        }
+
+        content[line_end] = '\0';
+        pos = line_end + 1;
+    }
+
+    uint64_t n = arrlen(line_start);
+    real_cpu *values = (real_cpu *)malloc(sizeof(real_cpu) * (n * num_values + 1));
+
+    OMP(parallel for)
+    for(uint64_t i = 0; i < n; i++) {
+
+        char *token = content + line_start[i];
+        real_cpu *element_values = values + i * num_values;
+        uint32_t v = 0;
+
+        while(v < num_values) {
+            char *separator = strchr(token, ' ');
+            if(separator) {
+                *separator = '\0';
+            }
+
+            element_values[v++] = strtod(token, NULL);
 
-    while((getline(&line, &len, fibers_file)) != -1) {
+            if(!separator) {
+                break;
+            }
+            token = separator + 1;
+        }
+
+        for(; v < num_values; v++) {
+            element_values[v] = 0.0;
+        }
+    }
+
+    arrfree(line_start);
 
-        int split_count;
-        sds *points = sdssplit(line, " ", &split_count);
-        struct fiber_coords_scale f_coords;
+    *num_elements = n;
+    return values;
+}
 
-        f_coords.f[0] = strtod(points[0], NULL);
-        f_coords.f[1] = strtod(points[1], NULL);
-        f_coords.f[2] = strtod(points[2], NULL);
+// Reads a text or binary fiber file with num_vectors vectors per element. The values of each element are returned
+// contiguously, in the same layout as struct fiber_coords (or struct fiber_coords_scale).
+static real_cpu *read_fiber_file(char *fiber_file_path, uint32_t num_vectors, uint64_t *num_elements) {
 
-        f_coords.s[0] = strtod(points[3], NULL);
-        f_coords.s[1] = strtod(points[4], NULL);
-        f_coords.s[2] = strtod(points[5], NULL);
+    struct stat source;
+
+    if(stat(fiber_file_path, &source) != 0) {
+        fprintf(stderr, "Error! Could not open %s!\n", fiber_file_path);
+        exit(EXIT_FAILURE);
+    }
 
-        f_coords.n[0] = strtod(points[6], NULL);
-        f_coords.n[1] = strtod(points[7], NULL);
-        f_coords.n[2] = strtod(points[8], NULL);
+    size_t size = 0;
+    char *content = read_entire_file(fiber_file_path, &size);
 
-        f_coords.x[0] = strtod(points[9], NULL);
-        f_coords.x[1] = strtod(points[10], NULL);
-        f_coords.x[2] = strtod(points[11], NULL);
+    if(!content && size > 0) {
+        fprintf(stderr, "Error! Could not open %s!\n", fiber_file_path);
+        exit(EXIT_FAILURE);
+    }
+
+    real_cpu *values = NULL;
+
+    // The file given in the configuration is already a binary fiber file
+    if(size >= sizeof(FIBER_BINARY_MAGIC) - 1 && memcmp(content, FIBER_BINARY_MAGIC, sizeof(FIBER_BINARY_MAGIC) - 1) == 0) {
+        values = parse_fiber_binary(content, size, num_vectors, NULL, num_elements);
+        free(content);
+
+        if(!values) {
+            log_error_and_exit("Invalid binary fiber file %s!\n", fiber_file_path);
+        }
+
+        return values;
+    }
+
+    sds cache_path = sdscatprintf(sdsempty(), "%s%s", fiber_file_path, FIBER_CACHE_EXTENSION);
+
+    size_t cache_size = 0;
+    char *cache_content = read_entire_file(cache_path, &cache_size);
+
+    if(cache_content) {
+        values = parse_fiber_binary(cache_content, cache_size, num_vectors, &source, num_elements);
+        free(cache_content);
+
+        if(values) {
+            log_info("Using the fiber cache %s\n", cache_path);
+        }
+    }
+
+    if(!values) {
+        content = (char *)realloc(content, size + 1);
+        content[size] = '\0';
+
+        values = parse_fiber_text(content, size, num_vectors * 3, num_elements);
+        write_fiber_binary_cache(cache_path, values, *num_elements, num_vectors, &source);
+    }
+
+    free(content);
+    sdsfree(cache_path);
+
+    return values;
+}
+
+static struct fiber_coords *read_fibers(char *fiber_file_path, bool normalize_vector) {
+
+    uint64_t num_elements = 0;
+    real_cpu *values = read_fiber_file(fiber_file_path, 3, &num_elements);
+
+    struct fiber_coords *fibers = NULL;
+
+    if(num_elements > 0) {
+        arrsetlen(fibers, num_elements);
+        memcpy(fibers, values, num_elements * sizeof(struct fiber_coords));
+    }
+
+    free(values);
+
+    if(normalize_vector) {
+        OMP(parallel for)
+        for(uint64_t i = 0; i < num_elements; i++) {
+            normalize(fibers[i].f);
+            normalize(fibers[i].s);
+            normalize(fibers[i].n);
+        }
+    }
+
+    return fibers;
+}
+
+// Albert`s code
+static struct fiber_coords_scale *read_fibers_scale(char *fiber_file_path) {
+
+    uint64_t num_elements = 0;
+    real_cpu *values = read_fiber_file(fiber_file_path, 4, &num_elements);
+
+    struct fiber_coords_scale *fibers = NULL;
 
-        arrput(fibers, f_coords);
-        sdsfreesplitres(points, split_count);
+    if(num_elements > 0) {
+        arrsetlen(fibers, num_elements);
+        memcpy(fibers, values, num_elements * sizeof(struct fiber_coords_scale));
     }
 
-    free(line);
+    free(values);
 
     return fibers;
 }
@@ -362,27 +362,8 @@ ASSEMBLY_MATRIX(homogeneous_sigma_assembly_matrix) {
         // sigma_initialized = true;
     }
 
-    OMP(parallel for)
-    for(i = 0; i < num_active_cells; i++) {
-
-        // Computes and designates the flux due to south cells.
-        fill_discretization_matrix_elements(ac[i], ac[i]->neighbours[BACK], BACK);
-
-        // Computes and designates the flux due to north cells.
-        fill_discretization_matrix_elements(ac[i], ac[i]->neighbours[FRONT], FRONT);
-
-        // Computes and designates the flux due to east cells.
-        fill_discretization_matrix_elements(ac[i], ac[i]->neighbours[TOP], TOP);
-
-        // Computes and designates the flux due to west cells.
-        fill_discretization_matrix_elements(ac[i], ac[i]->neighbours[DOWN], DOWN);
-
-        // Computes and designates the flux due to front cells.
-        fill_discretization_matrix_elements(ac[i], ac[i]->neighbours[RIGHT], RIGHT);
-
-        // Computes and designates the flux due to back cells.
-        fill_discretization_matrix_elements(ac[i], ac[i]->neighbours[LEFT], LEFT);
-    }
+    // Computes and designates the flux due to the south, north, east, west, front and back cells.
+    fill_discretization_matrix_elements_two_pass(the_grid);
 
 }
 
@@ -740,6 +721,200 @@ ASSEMBLY_MATRIX(heterogenous_sigma_with_factor_assembly_matrix) {
     }
 }
 
+// Rectangles (in the xy plane) of the fibrotic regions that reduce the conductivity, stored in a uniform grid of buckets.
+// Each region is in all the buckets it overlaps, so a point only needs to be tested against the regions of its bucket.
+struct fibrotic_region {
+    real_cpu x_min, x_max;
+    real_cpu y_min, y_max;
+};
+
+struct fibrotic_region_buckets {
+    struct fibrotic_region *regions;
+    uint32_t nx, ny;
+    real_cpu x_min, y_min;
+    real_cpu inv_hx, inv_hy;
+    uint32_t *offsets; // regions of bucket b: region_ids[offsets[b]..offsets[b+1]-1]
+    uint32_t *region_ids;
+};
+
+#define MAX_FIBROTIC_REGION_BUCKETS_PER_DIM 2048
+
+static uint32_t get_fibrotic_region_bucket(real_cpu x, real_cpu min, real_cpu inv_h, uint32_t n) {
+    real_cpu pos = (x - min) * inv_h;
+
+    if(pos <= 0.0) {
+        return 0;
+    }
+
+    if(pos >= (real_cpu)n) {
+        return n - 1;
+    }
+
+    return (uint32_t)pos;
+}
+
+static void free_fibrotic_region_buckets(struct fibrotic_region_buckets *buckets) {
+    arrfree(buckets->regions);
+    free(buckets->offsets);
+    free(buckets->region_ids);
+    free(buckets);
+}
+
+// Each line of the file is center_x,center_y,center_z,half_dx,half_dy,half_dz,active. Only the regions with active == 0
+// change the conductivity. Returns NULL if the file can not be read.
+static struct fibrotic_region_buckets *new_fibrotic_region_buckets_from_file(const char *fib_file, int expected_size) {
+
+    size_t size = 0;
+    char *content = read_entire_file(fib_file, &size);
+
+    if(!content) {
+        return NULL;
+    }
+
+    content = (char *)realloc(content, size + 1);
+    content[size] = '\0';
+
+    struct fibrotic_region_buckets *buckets = CALLOC_ONE_TYPE(struct fibrotic_region_buckets);
+
+    if(expected_size > 0) {
+        arrsetcap(buckets->regions, expected_size);
+    }
+
+    char *line = content;
+
+    while(true) {
+
+        real_cpu values[7];
+        int num_values = 0;
+
+        while(num_values < 7) {
+            char *end;
+            values[num_values] = strtod(line, &end);
+            if(end == line) {
+                break;
+            }
+            num_values++;
+            line = end;
+            while(*line == ',' || *line == ' ' || *line == '\t' || *line == '\r' || *line == '\n') {
+                line++;
+            }
+        }
+
+        if(num_values < 7) {
+            break;
+        }
+
+        if((bool)(values[6]) == 0) {
+            // Same bounds that were used by the linear search: the cell is inside when min < center < max
+            struct fibrotic_region r;
+            r.y_max = values[1] + values[4];
+            r.y_min = values[1] - values[4];
+            r.x_max = values[0] + values[3];
+            r.x_min = values[0] - values[3];
+            arrput(buckets->regions, r);
+        }
+    }
+
+    free(content);
+
+    uint32_t num_regions = arrlen(buckets->regions);
+
+    buckets->nx = buckets->ny = 1;
+    buckets->inv_hx = buckets->inv_hy = 0.0;
+
+    if(num_regions > 0) {
+
+        real_cpu x_min = buckets->regions[0].x_min, x_max = buckets->regions[0].x_max;
+        real_cpu y_min = buckets->regions[0].y_min, y_max = buckets->regions[0].y_max;
+        real_cpu mean_dx = 0.0, mean_dy = 0.0;
+
+        for(uint32_t i = 0; i < num_regions; i++) {
+            struct fibrotic_region *r = &buckets->regions[i];
+            x_min = fmin(x_min, r->x_min);
+            x_max = fmax(x_max, r->x_max);
+            y_min = fmin(y_min, r->y_min);
+            y_max = fmax(y_max, r->y_max);
+            mean_dx += r->x_max - r->x_min;
+            mean_dy += r->y_max - r->y_min;
+        }
+
+        mean_dx /= num_regions;
+        mean_dy /= num_regions;
+
+        // Buckets with about the size of a region
+        if(mean_dx > 0.0 && x_max > x_min) {
+            buckets->nx = (uint32_t)fmin(ceil((x_max - x_min) / mean_dx), MAX_FIBROTIC_REGION_BUCKETS_PER_DIM);
+            buckets->inv_hx = buckets->nx / (x_max - x_min);
+        }
+
+        if(mean_dy > 0.0 && y_max > y_min) {
+            buckets->ny = (uint32_t)fmin(ceil((y_max - y_min) / mean_dy), MAX_FIBROTIC_REGION_BUCKETS_PER_DIM);
+            buckets->inv_hy = buckets->ny / (y_max - y_min);
+        }
+
+        buckets->x_min = x_min;
+        buckets->y_min = y_min;
+    }
+
+    uint32_t num_buckets = buckets->nx * buckets->ny;
+    buckets->offsets = (uint32_t *)calloc(num_buckets + 1, sizeof(uint32_t));
+
+    // Counts the regions of each bucket and then fills them
+    for(int pass = 0; pass < 2; pass++) {
+
+        for(uint32_t i = 0; i < num_regions; i++) {
+            struct fibrotic_region *r = &buckets->regions[i];
+
+            uint32_t bx_min = get_fibrotic_region_bucket(r->x_min, buckets->x_min, buckets->inv_hx, buckets->nx);
+            uint32_t bx_max = get_fibrotic_region_bucket(r->x_max, buckets->x_min, buckets->inv_hx, buckets->nx);
+            uint32_t by_min = get_fibrotic_region_bucket(r->y_min, buckets->y_min, buckets->inv_hy, buckets->ny);
+            uint32_t by_max = get_fibrotic_region_bucket(r->y_max, buckets->y_min, buckets->inv_hy, buckets->ny);
+
+            for(uint32_t by = by_min; by <= by_max; by++) {
+                for(uint32_t bx = bx_min; bx <= bx_max; bx++) {
+                    uint32_t b = by * buckets->nx + bx;
+                    if(pass == 0) {
+                        buckets->offsets[b + 1]++;
+                    } else {
+                        buckets->region_ids[buckets->offsets[b]++] = i;
+                    }
+                }
+            }
+        }
+
+        if(pass == 0) {
+            for(uint32_t b = 0; b < num_buckets; b++) {
+                buckets->offsets[b + 1] += buckets->offsets[b];
+            }
+            buckets->region_ids = (uint32_t *)malloc(sizeof(uint32_t) * (buckets->offsets[num_buckets] + 1));
+        } else {
+            // The fill moved each offset to the start of the next bucket
+            for(uint32_t b = num_buckets; b > 0; b--) {
+                buckets->offsets[b] = buckets->offsets[b - 1];
+            }
+            buckets->offsets[0] = 0;
+        }
+    }
+
+    return buckets;
+}
+
+static bool is_inside_fibrotic_region(const struct fibrotic_region_buckets *buckets, real_cpu x, real_cpu y) {
+
+    uint32_t bx = get_fibrotic_region_bucket(x, buckets->x_min, buckets->inv_hx, buckets->nx);
+    uint32_t by = get_fibrotic_region_bucket(y, buckets->y_min, buckets->inv_hy, buckets->ny);
+    uint32_t b = by * buckets->nx + bx;
+
+    for(uint32_t k = buckets->offsets[b]; k < buckets->offsets[b + 1]; k++) {
+        const struct fibrotic_region *r = &buckets->regions[buckets->region_ids[k]];
+        if(x > r->x_min && x < r->x_max && y > r->y_min && y < r->y_max) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 // This function will read the fibrotic regions and for each cell that is inside the region we will
 // reduce its conductivity value based on the 'sigma_factor'.
 ASSEMBLY_MATRIX(heterogenous_sigma_with_factor_assembly_matrix_from_file) {
@@ -781,78 +956,25 @@ ASSEMBLY_MATRIX(heterogenous_sigma_with_factor_assembly_matrix_from_file) {
     }
 
     // Reading the fibrotic regions from the input file
-    FILE *file = fopen(fib_file, "r");
+    struct fibrotic_region_buckets *buckets = new_fibrotic_region_buckets_from_file(fib_file, fib_size);
 
-    if(!file) {
+    if(!buckets) {
         printf("Error opening file %s!!\n", fib_file);
         exit(0);
     }
 
-    real_cpu **scar_mesh = (real_cpu **)malloc(sizeof(real_cpu *) * fib_size);
-
-    for(int i = 0; i < fib_size; i++) {
-        scar_mesh[i] = (real_cpu *)malloc(sizeof(real_cpu) * 7);
-        if(scar_mesh[i] == NULL) {
-            printf("Failed to allocate memory\n");
-            exit(0);
-        }
-    }
-
-    uint32_t i = 0;
-    while(fscanf(file, "%lf,%lf,%lf,%lf,%lf,%lf,%lf\n", &scar_mesh[i][0], &scar_mesh[i][1], &scar_mesh[i][2], &scar_mesh[i][3], &scar_mesh[i][4],
-                 &scar_mesh[i][5], &scar_mesh[i][6]) != EOF) {
-        i++;
-    }
-
-    fclose(file);
-
-    uint32_t num_fibrotic_regions = i;
-
-    // Pass through all the cells of the grid and check if its center is inside the current
-    // fibrotic region
+    // Check if the center of each cell is inside one of the fibrotic regions of its bucket
     OMP(parallel for)
-    for(uint32_t j = 0; j < num_fibrotic_regions; j++) {
-
-        struct cell_node *grid_cell = the_grid->first_cell;
-
-        real_cpu b_center_x = scar_mesh[j][0];
-        real_cpu b_center_y = scar_mesh[j][1];
-
-        real_cpu b_h_dx = scar_mesh[j][3];
-        real_cpu b_h_dy = scar_mesh[j][4];
-
-        bool active = (bool)(scar_mesh[j][6]);
-
-        while(grid_cell != 0) {
-            if(grid_cell->active) {
-                real_cpu center_x = grid_cell->center.x;
-                real_cpu center_y = grid_cell->center.y;
-                //               real_cpu half_dx = grid_cell->discretization.x/2.0;
-                //                real_cpu half_dy = grid_cell->discretization.y/2.0;
-
-                struct point_3d p;
-                struct point_3d q;
-
-                p.x = b_center_y + b_h_dy;
-                p.y = b_center_y - b_h_dy;
-
-                q.x = b_center_x + b_h_dx;
-                q.y = b_center_x - b_h_dx;
-
-                // Check if the current cell is inside the fibrotic region
-                if(center_x > q.y && center_x < q.x && center_y > p.y && center_y < p.x) {
-                    if(active == 0) {
-                        grid_cell->sigma.x = sigma_x * sigma_factor;
-                        grid_cell->sigma.y = sigma_y * sigma_factor;
-                        grid_cell->sigma.z = sigma_z * sigma_factor;
-                    }
-                }
-            }
-
-            grid_cell = grid_cell->next;
+    for(uint32_t j = 0; j < num_active_cells; j++) {
+        if(is_inside_fibrotic_region(buckets, ac[j]->center.x, ac[j]->center.y)) {
+            ac[j]->sigma.x = sigma_x * sigma_factor;
+            ac[j]->sigma.y = sigma_y * sigma_factor;
+            ac[j]->sigma.z = sigma_z * sigma_factor;
         }
     }
 
+    free_fibrotic_region_buckets(buckets);
+
     OMP(parallel for)
     for(uint32_t i = 0; i < num_active_cells; i++) {
 
@@ -875,11 +997,6 @@ ASSEMBLY_MATRIX(heterogenous_sigma_with_factor_assembly_matrix_from_file) {
         fill_discretization_matrix_elements(ac[i], ac[i]->neighbours[LEFT], LEFT);
     }
 
-    for(int k = 0; k < fib_size; k++) {
-        free(scar_mesh[k]);
-    }
-
-    free(scar_mesh);
 }
 
 // This function will generate the fibrotic region file for the 120um x 120um grid by reescaling
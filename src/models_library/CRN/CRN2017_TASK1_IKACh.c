@@ -124,7 +124,6 @@ SOLVE_MODEL_ODES(solve_model_odes_cpu) {
 
     uint32_t sv_id;
 
-    size_t num_cells_to_solve = ode_solver->num_cells_to_solve;
     uint32_t * cells_to_solve = ode_solver->cells_to_solve;
     real *sv = ode_solver->sv;
     real dt = ode_solver->min_dt;
@@ -142,25 +141,29 @@ SOLVE_MODEL_ODES(solve_model_odes_cpu) {
         log_error_and_exit("You need to specify a mask function when using this mixed model!\n");
     }
 
-    #pragma omp parallel for private(sv_id)
-    for (int i = 0; i < num_cells_to_solve; i++) 
-    {
-        int mapping = extra_parameters[i+offset];
+    uint32_t partition[MAX_ODE_PARTITIONS + 1];
+    uint32_t num_parts = partition_cells_to_solve(ode_solver, dt, partition);
 
-        if(cells_to_solve)
-            sv_id = cells_to_solve[i];
-        else
-            sv_id = i;
+    #pragma omp parallel for private(sv_id) schedule(dynamic, 1)
+    for(uint32_t p = 0; p < num_parts; p++) {
+        for (u_int32_t i = partition[p]; i < partition[p + 1]; i++) {
+            int mapping = extra_parameters[i+offset];
 
-        if(adpt) 
-        {
-            solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], current_t + dt, sv_id, ode_solver->ode_extra_data, mapping);
-        }
-        else 
-        {
-            for (int j = 0; j < num_steps; ++j) 
+            if(cells_to_solve)
+                sv_id = cells_to_solve[i];
+            else
+                sv_id = i;
+
+            if(adpt) 
+            {
+                solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], current_t + dt, sv_id, ode_solver->ode_extra_data, mapping);
+            }
+            else 
             {
-                solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], ode_solver->ode_extra_data, mapping);
+                for (int j = 0; j < num_steps; ++j) 
+                {
+                    solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], ode_solver->ode_extra_data, mapping);
+                }
             }
         }
     }
@@ -183,8 +186,6 @@ void solve_model_ode_cpu(real dt, real *sv, real stim_current, real *extra_param
 void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int sv_id, real *extra_parameters, int mapping) 
 {
 
-    real rDY[NEQ];
-
     real _tolerances_[NEQ];
     real _aux_tol = 0.0;
     //initializes the variables
@@ -194,8 +195,11 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
 
     real edos_old_aux_[NEQ];
     real edos_new_euler_[NEQ];
-    real *_k1__ = (real*) malloc(sizeof(real)*NEQ);
-    real *_k2__ = (real*) malloc(sizeof(real)*NEQ);
+    // _k1__ and _k2__ point to the rates at the start and at the end of the step
+    real _k1_rates__[NEQ];
+    real _k2_rates__[NEQ];
+    real *_k1__ = _k1_rates__;
+    real *_k2__ = _k2_rates__;
     real *_k_aux__;
 
     const real _beta_safety_ = 0.8;
@@ -206,13 +210,9 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
        dt = final_time - time_new;
     }
 
-    RHS_cpu(sv, rDY, stim_curr, dt, extra_parameters, mapping);
+    RHS_cpu(sv, _k1__, stim_curr, dt, extra_parameters, mapping);
     time_new += dt;
 
-    for(int i = 0; i < NEQ; i++){
-        _k1__[i] = rDY[i];
-    }
-
     int count = 0;
 
     int count_limit = (final_time - time_new)/min_step;
@@ -235,13 +235,11 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
         }
 
         time_new += dt;
-        RHS_cpu(sv, rDY, stim_curr, dt, extra_parameters, mapping);
+        RHS_cpu(sv, _k2__, stim_curr, dt, extra_parameters, mapping);
         time_new -= dt;//step back
 
         double greatestError = 0.0, auxError = 0.0;
         for(int i = 0; i < NEQ; i++) {
-            // stores the new evaluation
-            _k2__[i] = rDY[i];
             _aux_tol = fabs(edos_new_euler_[i]) * reltol;
             _tolerances_[i] = (abstol > _aux_tol) ? abstol : _aux_tol;
 
@@ -315,9 +313,6 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
     ode_dt[sv_id] = dt;
     ode_time_new[sv_id] = time_new;
     ode_previous_dt[sv_id] = previous_dt;
-    
-    free(_k1__);
-    free(_k2__);
 }
 
 void RHS_cpu(const real *sv, real *rDY, real stim_current, real dt, real *extra_parameters, int mapping) {
@@ -1,4 +1,5 @@
 #include "ToRORd_Land_mixed_endo_mid_epi.h"
+#include "../adaptive_rush_larsen.h"
 #include <stdlib.h>
 
 GET_CELL_MODEL_DATA(init_cell_model_data) {
@@ -28,6 +29,7 @@ SET_ODE_INITIAL_CONDITIONS_CPU(set_model_initial_conditions_cpu) {
         solver->ode_previous_dt = (real*)calloc(num_cells, sizeof(real));
         solver->ode_time_new    = (real*)calloc(num_cells, sizeof(real));
         log_info("Using Adaptive timestep model to solve the ODEs\n");
+        solver->adaptive_rush_larsen = adaptive_method_is_rush_larsen(ode_extra_config, false);
     } else {
         log_info("Using Fixed timestep to solve the ODEs\n");
     }
@@ -227,12 +229,12 @@ SOLVE_MODEL_ODES(solve_model_odes_cpu) {
 
     uint32_t sv_id;
 
-    size_t num_cells_to_solve = ode_solver->num_cells_to_solve;
     uint32_t * cells_to_solve = ode_solver->cells_to_solve;
     real *sv = ode_solver->sv;
     real dt = ode_solver->min_dt;
     uint32_t num_steps = ode_solver->num_steps;
     bool adpt = ode_solver->adaptive;
+    bool adaptive_rush_larsen = adpt && ode_solver->adaptive_rush_larsen;
 
     // Get the extra parameters
     int num_extra_parameters = 20;
@@ -273,29 +275,40 @@ SOLVE_MODEL_ODES(solve_model_odes_cpu) {
     }
 
     // Solve the ODEs
-    OMP(parallel for private(sv_id))
-    for (u_int32_t i = 0; i < num_cells_to_solve; i++) {
+    uint32_t partition[MAX_ODE_PARTITIONS + 1];
+    uint32_t num_parts = partition_cells_to_solve(ode_solver, dt, partition);
 
-        if(cells_to_solve)
-            sv_id = cells_to_solve[i];
-        else
-            sv_id = i;
+    OMP(parallel for private(sv_id) schedule(dynamic, 1))
+    for(uint32_t p = 0; p < num_parts; p++) {
+        for (u_int32_t i = partition[p]; i < partition[p + 1]; i++) {
 
-        if(adpt) {
-            if (ode_solver->ode_extra_data) {
-                solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], transmurality[i], current_t + dt, sv_id, ode_solver, extra_par);
-            }
-            else {
-                solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], 0.0, current_t + dt, sv_id, ode_solver, extra_par);
-            }
-        }
-        else {
-            for (int j = 0; j < num_steps; ++j) {
+            if(cells_to_solve)
+                sv_id = cells_to_solve[i];
+            else
+                sv_id = i;
+
+            if(adpt) {
                 if (ode_solver->ode_extra_data) {
-                    solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], transmurality[i], extra_par);
+                    if(adaptive_rush_larsen)
+                        solve_rush_larsen_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], transmurality[i], current_t + dt, sv_id, ode_solver, extra_par);
+                    else
+                        solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], transmurality[i], current_t + dt, sv_id, ode_solver, extra_par);
                 }
                 else {
-                    solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], 0.0, extra_par);
+                    if(adaptive_rush_larsen)
+                        solve_rush_larsen_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], 0.0, current_t + dt, sv_id, ode_solver, extra_par);
+                    else
+                        solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], 0.0, current_t + dt, sv_id, ode_solver, extra_par);
+                }
+            }
+            else {
+                for (int j = 0; j < num_steps; ++j) {
+                    if (ode_solver->ode_extra_data) {
+                        solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], transmurality[i], extra_par);
+                    }
+                    else {
+                        solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], 0.0, extra_par);
+                    }
                 }
             }
         }
@@ -375,17 +388,18 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real transmurality,
     const real _beta_safety_ = 0.8;
     int numEDO = NEQ;
 
-    real rDY[numEDO];
-
-    real _tolerances_[numEDO];
+    real _tolerances_[NEQ];
     real _aux_tol = 0.0;
     // initializes the variables
     solver->ode_previous_dt[sv_id] = solver->ode_dt[sv_id];
 
-    real edos_old_aux_[numEDO];
-    real edos_new_euler_[numEDO];
-    real *_k1__ = (real *)malloc(sizeof(real) * numEDO);
-    real *_k2__ = (real *)malloc(sizeof(real) * numEDO);
+    real edos_old_aux_[NEQ];
+    real edos_new_euler_[NEQ];
+    // _k1__ and _k2__ point to the rates at the start and at the end of the step
+    real _k1_rates__[NEQ];
+    real _k2_rates__[NEQ];
+    real *_k1__ = _k1_rates__;
+    real *_k2__ = _k2_rates__;
     real *_k_aux__;
 
     real *dt = &solver->ode_dt[sv_id];
@@ -397,13 +411,9 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real transmurality,
         *dt = final_time - *time_new;
     }
 
-    RHS_cpu(sv, rDY, stim_curr, *dt, transmurality, extra_params);
+    RHS_cpu(sv, _k1__, stim_curr, *dt, transmurality, extra_params);
     *time_new += *dt;
 
-    for(int i = 0; i < numEDO; i++) {
-        _k1__[i] = rDY[i];
-    }
-
     const real rel_tol = solver->rel_tol;
     const real abs_tol = solver->abs_tol;
     
@@ -424,13 +434,11 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real transmurality,
         }
 
         *time_new += *dt;
-        RHS_cpu(sv, rDY, stim_curr, *dt, transmurality, extra_params);
+        RHS_cpu(sv, _k2__, stim_curr, *dt, transmurality, extra_params);
         *time_new -= *dt; // step back
 
         double greatestError = 0.0, auxError = 0.0;
         for(int i = 0; i < numEDO; i++) {
-            // stores the new evaluation
-            _k2__[i] = rDY[i];
             _aux_tol = fabs(edos_new_euler_[i]) * rel_tol;
             _tolerances_[i] = (abs_tol > _aux_tol) ? abs_tol : _aux_tol;
             // finds the greatest error between  the steps
@@ -488,9 +496,19 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real transmurality,
             }
         }
     }
+}
 
-    free(_k1__);
-    free(_k2__);
+// State variables solved with the Rush-Larsen method by solve_rush_larsen_cpu_adpt
+#define ADAPTIVE_RUSH_LARSEN_GATES {0, 0, 0, 0, 0, 0, 0, 0, 0, 1,  \
+                                    1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  \
+                                    1, 1, 1, 1, 1, 1, 1, 1, 1, 0,  \
+                                    0, 1, 1, 1, 1, 1, 0, 0, 0, 0,  \
+                                    0, 0, 1, 0, 0, 0, 0, 0, 0}
+
+void solve_rush_larsen_cpu_adpt(real *sv, real stim_curr, real transmurality, real final_time, int sv_id, struct ode_solver *solver, real const *extra_params) {
+    #define ADAPTIVE_RUSH_LARSEN_RHS(a, b, y, rates, dt) RHS_RL_cpu(a, b, y, rates, stim_curr, dt, transmurality, extra_params)
+    #include "../adaptive_rush_larsen.common.c"
+    #undef ADAPTIVE_RUSH_LARSEN_RHS
 }
 
 void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt, real transmurality, real const *extra_params) {
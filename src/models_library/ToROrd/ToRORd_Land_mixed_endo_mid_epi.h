@@ -22,32 +22,9 @@
 
 #define SOLVE_EQUATION_EULER_CPU(id) sv[id] = dt * rDY[id] + rY[id]
 
-#define SOLVE_EQUATION_RUSH_LARSEN_CPU(id) sv[id] = (abs(a[id]) < TOLERANCE) ? rY[id] + dt * (rY[id] * a[id] + b[id]) : \
+#define SOLVE_EQUATION_RUSH_LARSEN_CPU(id) sv[id] = (fabs(a[id]) < TOLERANCE) ? rY[id] + dt * (rY[id] * a[id] + b[id]) : \
                                         exp(a[id] * dt)*(rY[id] + (b[id] / a[id])) - (b[id] / a[id] )
 
-#define SOLVE_EQUATION_ADAPT_RUSH_LARSEN_CONSTANT_CPU(id) sv[id] = rDY[id];
-                                                    
-#define SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(id) edos_old_aux_[id] = sv[id]; \
-                                                 edos_new_euler_[id] = _k1__[id] * *dt + edos_old_aux_[id]; \
-                                                 sv[id] = edos_new_euler_[id]
-
-#define SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(id) edos_old_aux_[id] = sv[id]; \
-                                                 edos_new_euler_[id] = (fabs(a_[id]) < abs_tol) ? edos_old_aux_[id] + (edos_old_aux_[id] * a_[id] + b_[id])*(*dt) : exp(a_[id]*(*dt))*(edos_old_aux_[id] + (b_[id] / a_[id])) - (b_[id] / a_[id]); \
-                                                 sv[id] = edos_new_euler_[id]
-
-#define SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(id) _k2__[id] = rDY[id]; \
-                                                    f = (_k1__[id] + _k2__[id]) * 0.5; \
-                                                    y_2nd_order = edos_old_aux_[id] + (*dt) * f; \
-                                                    auxError = (fabs(y_2nd_order) < abs_tol) ? fabs(edos_new_euler_[id] - abs_tol) : fabs( (y_2nd_order - edos_new_euler_[id])/(y_2nd_order) ); \
-                                                    greatestError = (auxError > greatestError) ? auxError : greatestError
-
-#define SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(id)    _k2__[id] = rDY[id]; \
-                                                    as = (a_[id] + a_new[id]) * 0.5; \
-                                                    bs = (b_[id] + b_new[id]) * 0.5; \
-                                                    y_2nd_order = (fabs(as) < abs_tol) ? edos_old_aux_[id] + (*dt) * (edos_old_aux_[id]*as + bs) : exp(as*(*dt))*(edos_old_aux_[id] + (bs/as)) - (bs/as); \
-                                                    auxError = (fabs(y_2nd_order) < abs_tol) ? fabs(edos_new_euler_[id] - abs_tol) : fabs( (y_2nd_order - edos_new_euler_[id])/(y_2nd_order) ); \
-                                                    greatestError = (auxError > greatestError) ? auxError : greatestError
-
 // GPU macros
 #define SOLVE_EQUATION_CONSTANT_GPU(id) *((real *)((char *)sv + pitch * id) + sv_id) = *((real *)((char *)sv + pitch * id) + sv_id)
 
@@ -101,6 +78,7 @@ inline __device__ void solve_forward_euler_gpu_adpt(real *sv, real stim_curr, re
 void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt, real transmurality, real const *extra_params);
 void RHS_RL_cpu (real *a_, real *b_, const real *sv, real *rDY_, real stim_current, real dt, real transmurality, real const *extra_params);
 void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real transmurality, real final_time, int sv_id, struct ode_solver *solver, real const *extra_params);
+void solve_rush_larsen_cpu_adpt(real *sv, real stim_curr, real transmurality, real final_time, int sv_id, struct ode_solver *solver, real const *extra_params);
 void solve_model_ode_cpu(real dt, real *sv, real stim_current, real transmurality, real const *extra_params);
 
 #endif //MONOALG3D_MODEL_TORORD_LAND_MIXED_ENDO_MID_EPI_H
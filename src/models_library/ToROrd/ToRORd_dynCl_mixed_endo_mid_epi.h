@@ -18,30 +18,9 @@
 // CPU macros
 #define SOLVE_EQUATION_EULER_CPU(id) sv[id] = dt * rDY[id] + rY[id]
 
-#define SOLVE_EQUATION_RUSH_LARSEN_CPU(id) sv[id] = (abs(a[id]) < TOLERANCE) ? rY[id] + dt * (rY[id] * a[id] + b[id]) : \
+#define SOLVE_EQUATION_RUSH_LARSEN_CPU(id) sv[id] = (fabs(a[id]) < TOLERANCE) ? rY[id] + dt * (rY[id] * a[id] + b[id]) : \
                                         exp(a[id] * dt)*(rY[id] + (b[id] / a[id])) - (b[id] / a[id] )
 
-#define SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(id) edos_old_aux_[id] = sv[id]; \
-                                                 edos_new_euler_[id] = _k1__[id] * *dt + edos_old_aux_[id]; \
-                                                 sv[id] = edos_new_euler_[id]
-
-#define SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(id) edos_old_aux_[id] = sv[id]; \
-                                                 edos_new_euler_[id] = (fabs(a_[id]) < abs_tol) ? edos_old_aux_[id] + (edos_old_aux_[id] * a_[id] + b_[id])*(*dt) : exp(a_[id]*(*dt))*(edos_old_aux_[id] + (b_[id] / a_[id])) - (b_[id] / a_[id]); \
-                                                 sv[id] = edos_new_euler_[id]
-
-#define SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(id) _k2__[id] = rDY[id]; \
-                                                    f = (_k1__[id] + _k2__[id]) * 0.5; \
-                                                    y_2nd_order = edos_old_aux_[id] + (*dt) * f; \
-                                                    auxError = (fabs(y_2nd_order) < abs_tol) ? fabs(edos_new_euler_[id] - abs_tol) : fabs( (y_2nd_order - edos_new_euler_[id])/(y_2nd_order) ); \
-                                                    greatestError = (auxError > greatestError) ? auxError : greatestError
-
-#define SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(id)    _k2__[id] = rDY[id]; \
-                                                    as = (a_[id] + a_new[id]) * 0.5; \
-                                                    bs = (b_[id] + b_new[id]) * 0.5; \
-                                                    y_2nd_order = (fabs(as) < abs_tol) ? edos_old_aux_[id] + (*dt) * (edos_old_aux_[id]*as + bs) : exp(as*(*dt))*(edos_old_aux_[id] + (bs/as)) - (bs/as); \
-                                                    auxError = (fabs(y_2nd_order) < abs_tol) ? fabs(edos_new_euler_[id] - abs_tol) : fabs( (y_2nd_order - edos_new_euler_[id])/(y_2nd_order) ); \
-                                                    greatestError = (auxError > greatestError) ? auxError : greatestError
-
 // GPU macros
 #define SOLVE_EQUATION_EULER_GPU(id) *((real *)((char *)sv + pitch * id) + sv_id) = *((real *)((char *)sv + pitch * id) + sv_id) + dt * rDY[id]
 
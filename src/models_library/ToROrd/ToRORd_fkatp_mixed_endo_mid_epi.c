@@ -1,5 +1,131 @@
 #include "ToRORd_fkatp_mixed_endo_mid_epi.h"
+#include "../adaptive_rush_larsen.h"
 #include <stdlib.h>
+#include <string.h>
+#include "../lookup_table.h"
+#include "../multirate.h"
+#include "../prepacing.h"
+
+// The Hodgkin-Huxley gates (10 to 31, 39 and 40) store (inf, exp(-dt/tau)). Only the time constants of iF, iS, iFp and iSp
+// depend on the celltype, so the EPI values of exp(-dt/tau) for these gates are stored in the last 4 columns
+#define NUM_LOOKUP_TABLE_GATES 24
+#define NUM_LOOKUP_TABLE_COLUMNS (2*NUM_LOOKUP_TABLE_GATES + 4)
+
+static void fill_gates_lookup_table_row(real v, real celltype, real dt, real *row) {
+
+    #include "ToRORd_fkatp_mixed_endo_mid_epi_gates.common.c"
+
+    row[0]  = mss;     // m
+    row[1]  = exp(-dt/tm);
+    row[2]  = hss;     // h
+    row[3]  = exp(-dt/tauh);
+    row[4]  = jss;     // j
+    row[5]  = exp(-dt/tauj);
+    row[6]  = hssp;    // hp
+    row[7]  = exp(-dt/tauh);
+    row[8]  = jss;     // jp
+    row[9]  = exp(-dt/taujp);
+    row[10] = mLss;    // mL
+    row[11] = exp(-dt/tmL);
+    row[12] = hLss;    // hL
+    row[13] = exp(-dt/thL);
+    row[14] = hLssp;   // hLp
+    row[15] = exp(-dt/thLp);
+    row[16] = ass;     // a
+    row[17] = exp(-dt/ta);
+    row[18] = iss;     // iF
+    row[19] = exp(-dt/tiF);
+    row[20] = iss;     // iS
+    row[21] = exp(-dt/tiS);
+    row[22] = assp;    // ap
+    row[23] = exp(-dt/ta);
+    row[24] = iss;     // iFp
+    row[25] = exp(-dt/tiFp);
+    row[26] = iss;     // iSp
+    row[27] = exp(-dt/tiSp);
+    row[28] = dss;     // d
+    row[29] = exp(-dt/td);
+    row[30] = fss;     // ff
+    row[31] = exp(-dt/tff);
+    row[32] = fss;     // fs
+    row[33] = exp(-dt/tfs);
+    row[34] = fcass;   // fcaf
+    row[35] = exp(-dt/tfcaf);
+    row[36] = fcass;   // fcas
+    row[37] = exp(-dt/tfcas);
+    row[38] = jcass;   // jca
+    row[39] = exp(-dt/tjca);
+    row[40] = fss;     // ffp
+    row[41] = exp(-dt/tffp);
+    row[42] = fcass;   // fcafp
+    row[43] = exp(-dt/tfcafp);
+    row[44] = xs1ss;   // xs1
+    row[45] = exp(-dt/txs1);
+    row[46] = xs2ss;   // xs2
+    row[47] = exp(-dt/txs2);
+}
+
+static LOOKUP_TABLE_ROW(gates_lookup_table_row) {
+
+    real epi_row[2*NUM_LOOKUP_TABLE_GATES];
+
+    fill_gates_lookup_table_row(v, ENDO, dt, row);
+    fill_gates_lookup_table_row(v, EPI, dt, epi_row);
+
+    row[48] = epi_row[19]; // iF
+    row[49] = epi_row[21]; // iS
+    row[50] = epi_row[25]; // iFp
+    row[51] = epi_row[27]; // iSp
+}
+
+#define NUM_EXTRA_PARAMETERS 17
+
+// Fills the current multipliers used by the RHS (all 1.0 without extra data)
+static void get_extra_parameters(const void *ode_extra_data, real *extra_par) {
+
+    if (ode_extra_data) {
+        const struct extra_data_for_torord *extra_data = (const struct extra_data_for_torord*)ode_extra_data;
+        extra_par[0]  = extra_data->INa_Multiplier;
+        extra_par[1]  = extra_data->ICaL_Multiplier;
+        extra_par[2]  = extra_data->Ito_Multiplier;
+        extra_par[3]  = extra_data->INaL_Multiplier;
+        extra_par[4]  = extra_data->IKr_Multiplier;
+        extra_par[5]  = extra_data->IKs_Multiplier;
+        extra_par[6]  = extra_data->IK1_Multiplier;
+        extra_par[7]  = extra_data->IKb_Multiplier;
+        extra_par[8]  = extra_data->INaCa_Multiplier;
+        extra_par[9]  = extra_data->INaK_Multiplier;
+        extra_par[10] = extra_data->INab_Multiplier;
+        extra_par[11] = extra_data->ICab_Multiplier;
+        extra_par[12] = extra_data->IpCa_Multiplier;
+        extra_par[13] = extra_data->ICaCl_Multiplier;
+        extra_par[14] = extra_data->IClb_Multiplier;
+        extra_par[15] = extra_data->Jrel_Multiplier;
+        extra_par[16] = extra_data->Jup_Multiplier;
+    }
+    else {
+        for (int i = 0; i < NUM_EXTRA_PARAMETERS; i++) {
+            extra_par[i] = 1.0;
+        }
+    }
+}
+
+// Stimulus of the single cell action potential used to check the multi-rate error
+#define MULTIRATE_CHECK_STIM (-53.0)
+
+// label is the celltype and data the current multipliers
+static MULTIRATE_STEPS(multirate_steps) {
+    solve_model_ode_multirate_cpu(dt, sv, stim_current, label, (const real *)data, num_steps, ratio);
+}
+
+// Stimulus of the pre-pacing (see prepacing.h), the same one used by the multi-rate check
+#define PREPACING_STIM MULTIRATE_CHECK_STIM
+
+static PREPACING_STEPS(prepacing_steps) {
+    for(uint32_t i = 0; i < num_steps; i++) {
+        solve_model_ode_cpu(dt, sv, stim_current, label, parameters);
+    }
+}
 
 GET_CELL_MODEL_DATA(init_cell_model_data) {
 
@@ -28,10 +154,12 @@ SET_ODE_INITIAL_CONDITIONS_CPU(set_model_initial_conditions_cpu) {
         solver->ode_previous_dt = (real*)calloc(num_cells, sizeof(real));
         solver->ode_time_new    = (real*)calloc(num_cells, sizeof(real));
         log_info("Using Adaptive timestep model to solve the ODEs\n");
+        solver->adaptive_rush_larsen = adaptive_method_is_rush_larsen(ode_extra_config, false);
     } else {
         log_info("Using Fixed timestep to solve the ODEs\n");
     }
 
+    real prepaced_endo[NEQ], prepaced_mid[NEQ], prepaced_epi[NEQ];
     real *initial_endo = NULL;
     real *initial_epi = NULL;
     real *initial_mid = NULL;
@@ -43,6 +171,41 @@ SET_ODE_INITIAL_CONDITIONS_CPU(set_model_initial_conditions_cpu) {
         initial_mid = extra_data->initial_ss_mid;
         transmurality = extra_data->transmurality;
 
+        // One cell of each celltype in the mesh is pre-paced and its state is used by all the cells of this celltype
+        if(prepacing_enabled(ode_extra_config)) {
+            real extra_par[NUM_EXTRA_PARAMETERS];
+            get_extra_parameters(extra_data, extra_par);
+
+            struct cell_parameter_table *table = extra_data->parameters;
+            for(uint32_t v = 0; table && v < table->num_varying_columns; v++) {
+                uint32_t c = table->varying_columns[v];
+                log_warn("%s varies per cell, but the pre-pacing uses its mean (%g)!\n", table->names[c], table->uniform_values[c]);
+            }
+
+            const real celltypes[3] = {ENDO, MID, EPI};
+            real *initial[3] = {prepaced_endo, prepaced_mid, prepaced_epi};
+            memcpy(prepaced_endo, initial_endo, NEQ*sizeof(real));
+            memcpy(prepaced_mid, initial_mid, NEQ*sizeof(real));
+            memcpy(prepaced_epi, initial_epi, NEQ*sizeof(real));
+
+            bool used[3] = {false, false, false};
+            for(uint32_t i = 0; i < num_cells; i++) {
+                used[(transmurality[i] == ENDO) ? 0 : (transmurality[i] == EPI) ? 2 : 1] = true;
+            }
+
+            OMP(parallel for schedule(dynamic, 1))
+            for(int c = 0; c < 3; c++) {
+                if(used[c]) {
+                    prepace_cell(ode_extra_config, solver->min_dt, initial[c], NEQ, celltypes[c], extra_par, NUM_EXTRA_PARAMETERS, PREPACING_STIM,
+                                 prepacing_steps, "ToRORd_fkatp");
+                }
+            }
+
+            initial_endo = prepaced_endo;
+            initial_mid = prepaced_mid;
+            initial_epi = prepaced_epi;
+        }
+
         OMP(parallel for)
         for(uint32_t i = 0; i < num_cells; i++){
             
@@ -159,90 +322,130 @@ SET_ODE_INITIAL_CONDITIONS_CPU(set_model_initial_conditions_cpu) {
             sv[41] = 5.421027e-24;
             sv[42] = 6.407933e-23;
         }
-    }        
+
+        if(prepacing_enabled(ode_extra_config)) {
+            real extra_par[NUM_EXTRA_PARAMETERS];
+            get_extra_parameters(NULL, extra_par);
+
+            memcpy(prepaced_endo, solver->sv, NEQ*sizeof(real));
+
+            if(prepace_cell(ode_extra_config, solver->min_dt, prepaced_endo, NEQ, ENDO, extra_par, NUM_EXTRA_PARAMETERS, PREPACING_STIM,
+                            prepacing_steps, "ToRORd_fkatp")) {
+                OMP(parallel for)
+                for(uint32_t i = 0; i < num_cells; i++) {
+                    memcpy(&solver->sv[i * NEQ], prepaced_endo, NEQ*sizeof(real));
+                }
+            }
+        }
+    }
+
+    if(lookup_table_enabled(ode_extra_config, adpt)) {
+        solver->lookup_table = new_lookup_table_from_config(ode_extra_config, solver->min_dt, NUM_LOOKUP_TABLE_COLUMNS, gates_lookup_table_row, NULL,
+                                                            "ToRORd_fkatp");
+    }
+
+    // The lookup table already avoids the cost of the gating kinetics, so the multi-rate solver is only used without it.
+    // The error is checked for the three celltypes, or only for ENDO when all the cells are ENDO
+    if(!solver->lookup_table) {
+        real extra_par[NUM_EXTRA_PARAMETERS];
+        get_extra_parameters(solver->ode_extra_data, extra_par);
+
+        const real celltypes[3] = {ENDO, MID, EPI};
+        real check_sv[3 * NEQ];
+        uint32_t num_celltypes = 1;
+
+        if(initial_endo) {
+            memcpy(check_sv, initial_endo, NEQ*sizeof(real));
+            memcpy(check_sv + NEQ, initial_mid, NEQ*sizeof(real));
+            memcpy(check_sv + 2*NEQ, initial_epi, NEQ*sizeof(real));
+            num_celltypes = 3;
+        } else {
+            memcpy(check_sv, solver->sv, NEQ*sizeof(real));
+        }
+
+        solver->multirate_ratio = multirate_ratio_from_config(ode_extra_config, adpt, solver->min_dt, check_sv, celltypes, num_celltypes, NEQ,
+                                                              MULTIRATE_CHECK_STIM, multirate_steps, extra_par, "ToRORd_fkatp");
+    }
 }
 
 SOLVE_MODEL_ODES(solve_model_odes_cpu) {
 
     uint32_t sv_id;
 
-    size_t num_cells_to_solve = ode_solver->num_cells_to_solve;
     uint32_t * cells_to_solve = ode_solver->cells_to_solve;
     real *sv = ode_solver->sv;
     real dt = ode_solver->min_dt;
     uint32_t num_steps = ode_solver->num_steps;
     bool adpt = ode_solver->adaptive;
+    bool adaptive_rush_larsen = adpt && ode_solver->adaptive_rush_larsen;
+    const struct lookup_table *table = ode_solver->lookup_table;
+    uint32_t multirate_ratio = ode_solver->multirate_ratio;
 
     // Get the extra parameters
-    int num_extra_parameters = 17;
-    real extra_par[num_extra_parameters];
+    real extra_par[NUM_EXTRA_PARAMETERS];
     real *transmurality = NULL;
+    const struct cell_parameter_table *parameters = NULL;
+    get_extra_parameters(ode_solver->ode_extra_data, extra_par);
     if (ode_solver->ode_extra_data) {
-        struct extra_data_for_torord *extra_data = (struct extra_data_for_torord*)ode_solver->ode_extra_data;
-        extra_par[0]  = extra_data->INa_Multiplier; 
-        extra_par[1]  = extra_data->ICaL_Multiplier;
-        extra_par[2]  = extra_data->Ito_Multiplier;
-        extra_par[3]  = extra_data->INaL_Multiplier;
-        extra_par[4]  = extra_data->IKr_Multiplier; 
-        extra_par[5]  = extra_data->IKs_Multiplier; 
-        extra_par[6]  = extra_data->IK1_Multiplier; 
-        extra_par[7]  = extra_data->IKb_Multiplier; 
-        extra_par[8]  = extra_data->INaCa_Multiplier;
-        extra_par[9]  = extra_data->INaK_Multiplier;  
-        extra_par[9]  = extra_data->INab_Multiplier;  
-        extra_par[10] = extra_data->ICab_Multiplier;  
-        extra_par[11] = extra_data->IpCa_Multiplier;  
-        extra_par[12] = extra_data->ICaCl_Multiplier;
-        extra_par[13] = extra_data->IClb_Multiplier; 
-        extra_par[15] = extra_data->Jrel_Multiplier; 
-        extra_par[16] = extra_data->Jup_Multiplier;
-        transmurality = extra_data->transmurality;
-    }
-    else {
-        extra_par[0]  = 1.0; 
-        extra_par[1]  = 1.0;
-        extra_par[2]  = 1.0;
-        extra_par[3]  = 1.0;
-        extra_par[4]  = 1.0;
-        extra_par[5]  = 1.0;
-        extra_par[6]  = 1.0; 
-        extra_par[7]  = 1.0; 
-        extra_par[8]  = 1.0;
-        extra_par[9]  = 1.0;
-        extra_par[9]  = 1.0; 
-        extra_par[10] = 1.0;  
-        extra_par[11] = 1.0; 
-        extra_par[12] = 1.0;
-        extra_par[13] = 1.0;
-        extra_par[15] = 1.0;
-        extra_par[16] = 1.0;
+        transmurality = ((struct extra_data_for_torord*)ode_solver->ode_extra_data)->transmurality;
+        parameters = ((struct extra_data_for_torord*)ode_solver->ode_extra_data)->parameters;
     }
 
-    OMP(parallel for private(sv_id))
-    for (u_int32_t i = 0; i < num_cells_to_solve; i++) {
+    // Only the multipliers that vary per cell are replaced for each cell
+    bool heterogeneous = parameters && parameters->num_varying_columns > 0;
 
-        if(cells_to_solve)
-            sv_id = cells_to_solve[i];
-        else
-            sv_id = i;
+    uint32_t partition[MAX_ODE_PARTITIONS + 1];
+    uint32_t num_parts = partition_cells_to_solve(ode_solver, dt, partition);
 
-        if(adpt) {
-            if (ode_solver->ode_extra_data) {
-                solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], transmurality[i], current_t + dt, sv_id, ode_solver, extra_par);
-                //solve_rush_larsen_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], transmurality[i], current_t + dt, sv_id, ode_solver, extra_par);
-            }
-            else {
-                solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], 0.0, current_t + dt, sv_id, ode_solver, extra_par);
-                //solve_rush_larsen_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], 0.0, current_t + dt, sv_id, ode_solver, extra_par);
+    OMP(parallel for private(sv_id) schedule(dynamic, 1))
+    for(uint32_t p = 0; p < num_parts; p++) {
+
+        real cell_extra_par[NUM_EXTRA_PARAMETERS];
+        memcpy(cell_extra_par, extra_par, sizeof(cell_extra_par));
+
+        for (u_int32_t i = partition[p]; i < partition[p + 1]; i++) {
+
+            if(cells_to_solve)
+                sv_id = cells_to_solve[i];
+            else
+                sv_id = i;
+
+            if(heterogeneous) {
+                cell_parameter_table_set_cell_values(parameters, i, cell_extra_par);
             }
-        }
-        else {
-            for (int j = 0; j < num_steps; ++j) {
+
+            if(adpt) {
                 if (ode_solver->ode_extra_data) {
-                    solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], transmurality[i], extra_par);
+                    if(adaptive_rush_larsen)
+                        solve_rush_larsen_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], transmurality[i], current_t + dt, sv_id, ode_solver, cell_extra_par);
+                    else
+                        solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], transmurality[i], current_t + dt, sv_id, ode_solver, cell_extra_par);
                 }
                 else {
-                    solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], 0.0, extra_par);
+                    if(adaptive_rush_larsen)
+                        solve_rush_larsen_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], 0.0, current_t + dt, sv_id, ode_solver, cell_extra_par);
+                    else
+                        solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], 0.0, current_t + dt, sv_id, ode_solver, cell_extra_par);
+                }
+            }
+            else if(table) {
+                real celltype = (ode_solver->ode_extra_data) ? transmurality[i] : 0.0;
+                for (int j = 0; j < num_steps; ++j) {
+                    solve_model_ode_lookup_table_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], celltype, cell_extra_par, table);
+                }
+            }
+            else if(multirate_ratio > 1) {
+                real celltype = (ode_solver->ode_extra_data) ? transmurality[i] : 0.0;
+                solve_model_ode_multirate_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], celltype, cell_extra_par, num_steps, multirate_ratio);
+            }
+            else {
+                for (int j = 0; j < num_steps; ++j) {
+                    if (ode_solver->ode_extra_data) {
+                        solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], transmurality[i], cell_extra_par);
+                    }
+                    else {
+                        solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], 0.0, cell_extra_par);
+                    }
                 }
             }
         }
@@ -309,22 +512,154 @@ void solve_model_ode_cpu(real dt, real *sv, real stim_current, real transmuralit
     SOLVE_EQUATION_RUSH_LARSEN_CPU(42); // Jrel_p
 }
 
+// Same as solve_model_ode_cpu, but the Hodgkin-Huxley gates are updated using the precomputed voltage lookup table
+void solve_model_ode_lookup_table_cpu(real dt, real *sv, real stim_current, real transmurality, real const *extra_params, const struct lookup_table *table) {
+
+    const real TOLERANCE = 1e-8;
+    real rY[NEQ], rDY[NEQ];
+    real gates[NUM_LOOKUP_TABLE_COLUMNS];
+
+    for(int i = 0; i < NEQ; i++)
+        rY[i] = sv[i];
+
+    lookup_table_interpolate(table, rY[0], gates);
+
+    // Only the 'a', 'b' coefficients of Jrel_np and Jrel_p are computed
+    real a[NEQ], b[NEQ];
+    RHS_RL_currents_cpu(a, b, sv, rDY, stim_current, dt, transmurality, extra_params);
+
+    for(int i = 0; i <= 9; i++) {
+        SOLVE_EQUATION_EULER_CPU(i);
+    }
+
+    for(int i = 32; i <= 38; i++) {
+        SOLVE_EQUATION_EULER_CPU(i);
+    }
+
+    if(transmurality == EPI) {
+        gates[19] = gates[48];
+        gates[21] = gates[49];
+        gates[25] = gates[50];
+        gates[27] = gates[51];
+    }
+
+    for(int k = 0; k < NUM_LOOKUP_TABLE_GATES; k++) {
+        const int i = (k < 22) ? k + 10 : k + 17;
+        const real inf = gates[2*k];
+        sv[i] = inf - (inf - rY[i])*gates[2*k + 1];
+    }
+
+    SOLVE_EQUATION_RUSH_LARSEN_CPU(41); // Jrel_np
+    SOLVE_EQUATION_RUSH_LARSEN_CPU(42); // Jrel_p
+}
+
+// Multi-rate version of solve_model_ode_cpu for num_steps steps. The slow variables (nai, ki, the inactivation gates of
+// INaL, Ito and ICaL and the IKs gates) are advanced once every 'ratio' steps, using the rates of the first step. The fast
+// steps keep them fixed, so they skip the slow gating kinetics and the reversal potentials. nai and ki are advanced with
+// the sum of their derivatives over the fast steps. A slow step does not cross the end of the call, so it is never
+// longer than num_steps steps.
+void solve_model_ode_multirate_cpu(real dt, real *sv, real stim_current, real transmurality, real const *extra_params, uint32_t num_steps,
+                                   uint32_t ratio) {
+
+    const real TOLERANCE = 1e-8;
+    real rY[NEQ], rDY[NEQ];
+    real a[NEQ], b[NEQ];
+    real reversal_potentials[3];
+
+    for(uint32_t step = 0; step < num_steps; step += ratio) {
+
+        const uint32_t num_fast_steps = (num_steps - step < ratio) ? num_steps - step : ratio;
+        real sum_dnai = 0.0;
+        real sum_dki = 0.0;
+
+        for(uint32_t k = 0; k < num_fast_steps; k++) {
+
+            for(int i = 0; i < NEQ; i++)
+                rY[i] = sv[i];
+
+            if(k == 0) {
+                RHS_RL_slow_cpu(a, b, sv, rDY, stim_current, dt, transmurality, extra_params, reversal_potentials);
+            } else {
+                RHS_RL_fast_cpu(a, b, sv, rDY, stim_current, dt, transmurality, extra_params, reversal_potentials);
+            }
+
+            sum_dnai += rDY[3];
+            sum_dki += rDY[5];
+
+            SOLVE_EQUATION_EULER_CPU(0);        // v
+            SOLVE_EQUATION_EULER_CPU(1);        // CaMKt
+            SOLVE_EQUATION_EULER_CPU(2);        // cass
+            SOLVE_EQUATION_EULER_CPU(4);        // nass
+            SOLVE_EQUATION_EULER_CPU(6);        // kss
+            SOLVE_EQUATION_EULER_CPU(7);        // cansr
+            SOLVE_EQUATION_EULER_CPU(8);        // cajsr
+            SOLVE_EQUATION_EULER_CPU(9);        // cai
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(10); // m
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(11); // h
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(12); // j
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(13); // hp
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(14); // jp
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(15); // mL
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(18); // a
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(21); // ap
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(24); // d
+            SOLVE_EQUATION_EULER_CPU(32);       // nca
+            SOLVE_EQUATION_EULER_CPU(33);       // nca_i
+            SOLVE_EQUATION_EULER_CPU(34);       // ikr_c0
+            SOLVE_EQUATION_EULER_CPU(35);       // ikr_c1
+            SOLVE_EQUATION_EULER_CPU(36);       // ikr_c2
+            SOLVE_EQUATION_EULER_CPU(37);       // ikr_i
+            SOLVE_EQUATION_EULER_CPU(38);       // ikr_o
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(41); // Jrel_np
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(42); // Jrel_p
+        }
+
+        // The slow variables were not changed by the fast steps, so rY still has their values at the start of the slow step
+        sv[3] = dt * sum_dnai + rY[3];
+        sv[5] = dt * sum_dki + rY[5];
+
+        {
+            // The 'a', 'b' coefficients of the slow gates were computed in the first step. SOLVE_EQUATION_RUSH_LARSEN_CPU
+            // uses dt, so it is redefined here as the length of the slow step
+            const real dt_slow = num_fast_steps * dt;
+            const real dt = dt_slow;
+
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(16); // hL
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(17); // hLp
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(19); // iF
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(20); // iS
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(22); // iFp
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(23); // iSp
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(25); // ff
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(26); // fs
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(27); // fcaf
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(28); // fcas
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(29); // jca
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(30); // ffp
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(31); // fcafp
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(39); // xs1
+            SOLVE_EQUATION_RUSH_LARSEN_CPU(40); // xs2
+        }
+    }
+}
+
 void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real transmurality, real final_time, int sv_id, struct ode_solver *solver, real const *extra_params) {
 
     const real _beta_safety_ = 0.8;
     int numEDO = NEQ;
 
-    real rDY[numEDO];
-
-    real _tolerances_[numEDO];
+    real _tolerances_[NEQ];
     real _aux_tol = 0.0;
     // initializes the variables
     solver->ode_previous_dt[sv_id] = solver->ode_dt[sv_id];
 
-    real edos_old_aux_[numEDO];
-    real edos_new_euler_[numEDO];
-    real *_k1__ = (real *)malloc(sizeof(real) * numEDO);
-    real *_k2__ = (real *)malloc(sizeof(real) * numEDO);
+    real edos_old_aux_[NEQ];
+    real edos_new_euler_[NEQ];
+    // _k1__ and _k2__ point to the rates at the start and at the end of the step
+    real _k1_rates__[NEQ];
+    real _k2_rates__[NEQ];
+    real *_k1__ = _k1_rates__;
+    real *_k2__ = _k2_rates__;
     real *_k_aux__;
 
     real *dt = &solver->ode_dt[sv_id];
@@ -336,13 +671,9 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real transmurality,
         *dt = final_time - *time_new;
     }
 
-    RHS_cpu(sv, rDY, stim_curr, *dt, transmurality, extra_params);
+    RHS_cpu(sv, _k1__, stim_curr, *dt, transmurality, extra_params);
     *time_new += *dt;
 
-    for(int i = 0; i < numEDO; i++) {
-        _k1__[i] = rDY[i];
-    }
-
     const real rel_tol = solver->rel_tol;
     const real abs_tol = solver->abs_tol;
 
@@ -363,13 +694,11 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real transmurality,
         }
 
         *time_new += *dt;
-        RHS_cpu(sv, rDY, stim_curr, *dt, transmurality, extra_params);
+        RHS_cpu(sv, _k2__, stim_curr, *dt, transmurality, extra_params);
         *time_new -= *dt; // step back
 
         double greatestError = 0.0, auxError = 0.0;
         for(int i = 0; i < numEDO; i++) {
-            // stores the new evaluation
-            _k2__[i] = rDY[i];
             _aux_tol = fabs(edos_new_euler_[i]) * rel_tol;
             _tolerances_[i] = (abs_tol > _aux_tol) ? abs_tol : _aux_tol;
             // finds the greatest error between  the steps
@@ -427,220 +756,252 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real transmurality,
             }
         }
     }
-
-    free(_k1__);
-    free(_k2__);
 }
 
-void solve_rush_larsen_cpu_adpt(real *sv, real stim_curr, real transmurality, real final_time, int sv_id, struct ode_solver *solver, real const *extra_params) {
-    
-    int numEDO = NEQ;
-    real rDY[numEDO];
-
-    // initializes the variables
-    solver->ode_previous_dt[sv_id] = solver->ode_dt[sv_id];
-
-    real edos_old_aux_[numEDO];
-    real edos_new_euler_[numEDO];
-    real *_k1__ = (real *)malloc(sizeof(real) * numEDO);
-    real *_k2__ = (real *)malloc(sizeof(real) * numEDO);
-    real *a_ = (real *)malloc(sizeof(real) * numEDO);
-    real *b_ = (real *)malloc(sizeof(real) * numEDO);
-    real *a_new = (real *)malloc(sizeof(real) * numEDO);
-    real *b_new = (real *)malloc(sizeof(real) * numEDO);
-    real *_k_aux__, *_a_aux__, *_b_aux__;
-
-    real *dt = &solver->ode_dt[sv_id];
-    real *time_new = &solver->ode_time_new[sv_id];
-    real *previous_dt = &solver->ode_previous_dt[sv_id];
+// State variables solved with the Rush-Larsen method by solve_rush_larsen_cpu_adpt
+#define ADAPTIVE_RUSH_LARSEN_GATES {0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  \
+                                    1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  \
+                                    1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  \
+                                    1, 1, 0, 0, 0, 0, 0, 0, 0, 1,  \
+                                    1, 1, 1}
 
-    // Keep 'dt' inside the adaptive interval
-    if(*time_new + *dt > final_time) {
-        *dt = final_time - *time_new;
-    }
+void solve_rush_larsen_cpu_adpt(real *sv, real stim_curr, real transmurality, real final_time, int sv_id, struct ode_solver *solver, real const *extra_params) {
+    #define ADAPTIVE_RUSH_LARSEN_RHS(a, b, y, rates, dt) RHS_RL_cpu(a, b, y, rates, stim_curr, dt, transmurality, extra_params)
+    #include "../adaptive_rush_larsen.common.c"
+    #undef ADAPTIVE_RUSH_LARSEN_RHS
+}
 
-    RHS_RL_cpu(a_, b_, sv, rDY, stim_curr, *dt, transmurality, extra_params);
-    *time_new += *dt;
+void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt, real transmurality, real const *extra_params) {
 
-    for(int i = 0; i < numEDO; i++) {
-        _k1__[i] = rDY[i];
-    }
+    // Current modifiers
+    real INa_Multiplier   = extra_params[0]; 
+    real ICaL_Multiplier  = extra_params[1];
+    real Ito_Multiplier   = extra_params[2];
+    real INaL_Multiplier  = extra_params[3];
+    real IKr_Multiplier   = extra_params[4]; 
+    real IKs_Multiplier   = extra_params[5]; 
+    real IK1_Multiplier   = extra_params[6]; 
+    real IKb_Multiplier   = extra_params[7]; 
+    real INaCa_Multiplier = extra_params[8];
+    real INaK_Multiplier  = extra_params[9];  
+    real INab_Multiplier  = extra_params[10];  
+    real ICab_Multiplier  = extra_params[11];  
+    real IpCa_Multiplier  = extra_params[12];  
+    real ICaCl_Multiplier = extra_params[13];
+    real IClb_Multiplier  = extra_params[14]; 
+    real Jrel_Multiplier  = extra_params[15]; 
+    real Jup_Multiplier   = extra_params[16];
 
-    const real rel_tol = solver->rel_tol;
-    const real abs_tol = solver->abs_tol;
+    // Get the celltype for the current cell
+    real celltype = transmurality;
 
-    const real __tiny_ = pow(abs_tol, 2.0);
+    // Get the stimulus current from the current cell
+    real calc_I_stim = stim_current;
 
-    real min_dt = solver->min_dt;
-    real max_dt = solver->max_dt;
+    // State variables
+    real v = sv[0];
+    real CaMKt = sv[1];
+    real cass = sv[2];
+    real nai = sv[3];
+    real nass = sv[4];
+    real ki = sv[5];
+    real kss = sv[6];
+    real cansr = sv[7];
+    real cajsr = sv[8];
+    real cai = sv[9];
+    real m = sv[10];
+    real h = sv[11];
+    real j = sv[12];
+    real hp = sv[13];
+    real jp = sv[14];
+    real mL = sv[15];
+    real hL = sv[16];
+    real hLp = sv[17];
+    real a = sv[18];
+    real iF = sv[19];
+    real iS = sv[20];
+    real ap = sv[21];
+    real iFp = sv[22];
+    real iSp = sv[23];
+    real d = sv[24];
+    real ff = sv[25];
+    real fs = sv[26];
+    real fcaf = sv[27];
+    real fcas = sv[28];
+    real jca = sv[29];
+    real ffp = sv[30];
+    real fcafp = sv[31];
+    real nca = sv[32];
+    real nca_i = sv[33];
+    real ikr_c0 = sv[34];
+    real ikr_c1 = sv[35];
+    real ikr_c2 = sv[36];
+    real ikr_i = sv[37];
+    real ikr_o = sv[38];
+    real xs1 = sv[39];
+    real xs2 = sv[40];
+    real Jrel_np = sv[41];
+    real Jrel_p = sv[42];
 
-    while(1) {
+    #include "ToRORd_fkatp_mixed_endo_mid_epi.common.c"
+}
 
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(0);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(1);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(2);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(3);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(4);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(5);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(6);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(7);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(8);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(9);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(10);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(11);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(12);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(13);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(14);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(15);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(16);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(17);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(18);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(19);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(20);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(21);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(22);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(23);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(24);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(25);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(26);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(27);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(28);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(29);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(30);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(31);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(32);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(33);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(34);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(35);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(36);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(37);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_EULER_CPU(38);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(39);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(40);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(41);
-        SOLVE_EQUATION_ADAPT_RUSH_LARSEN_RL_CPU(42);
+void RHS_RL_cpu(real *a_, real *b_, const real *sv, real *rDY_, real stim_current, real dt, real transmurality, real const *extra_params) {
 
-        *time_new += *dt;
-        RHS_RL_cpu(a_new, b_new, sv, rDY, stim_curr, *dt, transmurality, extra_params);
-        *time_new -= *dt; // step back
+    // Current modifiers
+    real INa_Multiplier   = extra_params[0]; 
+    real ICaL_Multiplier  = extra_params[1];
+    real Ito_Multiplier   = extra_params[2];
+    real INaL_Multiplier  = extra_params[3];
+    real IKr_Multiplier   = extra_params[4]; 
+    real IKs_Multiplier   = extra_params[5]; 
+    real IK1_Multiplier   = extra_params[6]; 
+    real IKb_Multiplier   = extra_params[7]; 
+    real INaCa_Multiplier = extra_params[8];
+    real INaK_Multiplier  = extra_params[9];  
+    real INab_Multiplier  = extra_params[10];  
+    real ICab_Multiplier  = extra_params[11];  
+    real IpCa_Multiplier  = extra_params[12];  
+    real ICaCl_Multiplier = extra_params[13];
+    real IClb_Multiplier  = extra_params[14]; 
+    real Jrel_Multiplier  = extra_params[15]; 
+    real Jup_Multiplier   = extra_params[16];
 
-        // Compute errors
-        double greatestError = 0.0, auxError = 0.0;
-        real as, bs, f, y_2nd_order;
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(0);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(1);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(2);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(3);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(4);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(5);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(6);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(7);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(8);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(9);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(10);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(11);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(12);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(13);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(14);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(15);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(16);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(17);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(18);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(19);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(20);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(21);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(22);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(23);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(24);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(25);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(26);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(27);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(28);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(29);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(30);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(31);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(32);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(33);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(34);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(35);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(36);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(37);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_EULER_CPU(38);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(39);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(40);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(41);
-        SOLVE_ERROR_ADAPT_RUSH_LARSEN_RL_CPU(42);
-    
-        /// adapt the time step
-        greatestError += __tiny_;
-        *previous_dt = *dt;
-        /// adapt the time step
-        *dt = (*dt) * sqrt(0.5 * rel_tol / greatestError);            // Jhonny`s formula
+    // Get the celltype for the current cell
+    real celltype = transmurality;
 
-        if(*dt < min_dt) {
-            *dt = min_dt;
-        } else if(*dt > max_dt) {
-            *dt = max_dt;
-        }
+    // Get the stimulus current from the current cell
+    real calc_I_stim = stim_current;
 
-        if(*time_new + *dt > final_time) {
-            *dt = final_time - *time_new;
-        }
+    // State variables
+    real v = sv[0];
+    real CaMKt = sv[1];
+    real cass = sv[2];
+    real nai = sv[3];
+    real nass = sv[4];
+    real ki = sv[5];
+    real kss = sv[6];
+    real cansr = sv[7];
+    real cajsr = sv[8];
+    real cai = sv[9];
+    real m = sv[10];
+    real h = sv[11];
+    real j = sv[12];
+    real hp = sv[13];
+    real jp = sv[14];
+    real mL = sv[15];
+    real hL = sv[16];
+    real hLp = sv[17];
+    real a = sv[18];
+    real iF = sv[19];
+    real iS = sv[20];
+    real ap = sv[21];
+    real iFp = sv[22];
+    real iSp = sv[23];
+    real d = sv[24];
+    real ff = sv[25];
+    real fs = sv[26];
+    real fcaf = sv[27];
+    real fcas = sv[28];
+    real jca = sv[29];
+    real ffp = sv[30];
+    real fcafp = sv[31];
+    real nca = sv[32];
+    real nca_i = sv[33];
+    real ikr_c0 = sv[34];
+    real ikr_c1 = sv[35];
+    real ikr_c2 = sv[36];
+    real ikr_i = sv[37];
+    real ikr_o = sv[38];
+    real xs1 = sv[39];
+    real xs2 = sv[40];
+    real Jrel_np = sv[41];
+    real Jrel_p = sv[42];
 
-        // it doesn't accept the solution
-        if(greatestError >= 1.0f && *dt > min_dt) {
-            // restore the old values to do it again
-            for(int i = 0; i < numEDO; i++) {
-                sv[i] = edos_old_aux_[i];
-            }
-            // throw the results away and compute again
-        } else {
-            // it accepts the solutions
-            if(greatestError >= 1.0) {
-                printf("Accepting solution with error > %lf \n", greatestError);
-            }
+    #include "ToRORd_fkatp_mixed_endo_mid_epi_RL.common.c"
+}
 
-            // Swap pointers
-            _k_aux__ = _k2__;
-            _k2__ = _k1__;
-            _k1__ = _k_aux__;
+// Same as RHS_RL_cpu, but the gating kinetics (and their 'a', 'b' coefficients) are not computed. They come from the lookup table
+void RHS_RL_currents_cpu(real *a_, real *b_, const real *sv, real *rDY_, real stim_current, real dt, real transmurality, real const *extra_params) {
 
-            _a_aux__ = a_;
-            a_ = a_new;
-            a_new = _a_aux__;
+    // Current modifiers
+    real INa_Multiplier   = extra_params[0]; 
+    real ICaL_Multiplier  = extra_params[1];
+    real Ito_Multiplier   = extra_params[2];
+    real INaL_Multiplier  = extra_params[3];
+    real IKr_Multiplier   = extra_params[4]; 
+    real IKs_Multiplier   = extra_params[5]; 
+    real IK1_Multiplier   = extra_params[6]; 
+    real IKb_Multiplier   = extra_params[7]; 
+    real INaCa_Multiplier = extra_params[8];
+    real INaK_Multiplier  = extra_params[9];  
+    real INab_Multiplier  = extra_params[10];  
+    real ICab_Multiplier  = extra_params[11];  
+    real IpCa_Multiplier  = extra_params[12];  
+    real ICaCl_Multiplier = extra_params[13];
+    real IClb_Multiplier  = extra_params[14]; 
+    real Jrel_Multiplier  = extra_params[15]; 
+    real Jup_Multiplier   = extra_params[16];
 
-            _b_aux__ = b_;
-            b_ = b_new;
-            b_new = _b_aux__;
+    // Get the celltype for the current cell
+    real celltype = transmurality;
 
-            // it steps the method ahead, with euler solution
-            for(int i = 0; i < numEDO; i++) {
-                sv[i] = edos_new_euler_[i];
-            }
+    // Get the stimulus current from the current cell
+    real calc_I_stim = stim_current;
 
-            if(*time_new + *previous_dt >= final_time) {
-                if(final_time == *time_new) {
-                    break;
-                } else if(*time_new < final_time) {
-                    *dt = *previous_dt = final_time - *time_new;
-                    *time_new += *previous_dt;
-                    break;
-                }
-            } else {
-                *time_new += *previous_dt;
-            }
-        }
-    }
+    // State variables
+    real v = sv[0];
+    real CaMKt = sv[1];
+    real cass = sv[2];
+    real nai = sv[3];
+    real nass = sv[4];
+    real ki = sv[5];
+    real kss = sv[6];
+    real cansr = sv[7];
+    real cajsr = sv[8];
+    real cai = sv[9];
+    real m = sv[10];
+    real h = sv[11];
+    real j = sv[12];
+    real hp = sv[13];
+    real jp = sv[14];
+    real mL = sv[15];
+    real hL = sv[16];
+    real hLp = sv[17];
+    real a = sv[18];
+    real iF = sv[19];
+    real iS = sv[20];
+    real ap = sv[21];
+    real iFp = sv[22];
+    real iSp = sv[23];
+    real d = sv[24];
+    real ff = sv[25];
+    real fs = sv[26];
+    real fcaf = sv[27];
+    real fcas = sv[28];
+    real jca = sv[29];
+    real ffp = sv[30];
+    real fcafp = sv[31];
+    real nca = sv[32];
+    real nca_i = sv[33];
+    real ikr_c0 = sv[34];
+    real ikr_c1 = sv[35];
+    real ikr_c2 = sv[36];
+    real ikr_i = sv[37];
+    real ikr_o = sv[38];
+    real xs1 = sv[39];
+    real xs2 = sv[40];
+    real Jrel_np = sv[41];
+    real Jrel_p = sv[42];
 
-    free(_k1__);
-    free(_k2__);
-    free(a_);
-    free(b_);
-    free(a_new);
-    free(b_new);
+    #define GATES_FROM_LOOKUP_TABLE
+    #include "ToRORd_fkatp_mixed_endo_mid_epi_RL.common.c"
+    #undef GATES_FROM_LOOKUP_TABLE
 }
 
-void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt, real transmurality, real const *extra_params) {
+// Same as RHS_RL_cpu, but also returns the reversal potentials used by the fast steps of the multi-rate solver
+void RHS_RL_slow_cpu(real *a_, real *b_, const real *sv, real *rDY_, real stim_current, real dt, real transmurality, real const *extra_params,
+                     real *reversal_potentials) {
 
     // Current modifiers
     real INa_Multiplier   = extra_params[0]; 
@@ -712,10 +1073,15 @@ void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt, real transm
     real Jrel_np = sv[41];
     real Jrel_p = sv[42];
 
-    #include "ToRORd_fkatp_mixed_endo_mid_epi.common.c"
+    #define MULTIRATE_SLOW_STEP
+    #include "ToRORd_fkatp_mixed_endo_mid_epi_RL.common.c"
+    #undef MULTIRATE_SLOW_STEP
 }
 
-void RHS_RL_cpu(real *a_, real *b_, const real *sv, real *rDY_, real stim_current, real dt, real transmurality, real const *extra_params) {
+// Fast step of the multi-rate solver. The slow gates (and their 'a', 'b' coefficients) are not computed and the reversal
+// potentials come from the last slow step
+void RHS_RL_fast_cpu(real *a_, real *b_, const real *sv, real *rDY_, real stim_current, real dt, real transmurality, real const *extra_params,
+                     const real *reversal_potentials) {
 
     // Current modifiers
     real INa_Multiplier   = extra_params[0]; 
@@ -787,5 +1153,7 @@ void RHS_RL_cpu(real *a_, real *b_, const real *sv, real *rDY_, real stim_curren
     real Jrel_np = sv[41];
     real Jrel_p = sv[42];
 
+    #define MULTIRATE_FAST_STEP
     #include "ToRORd_fkatp_mixed_endo_mid_epi_RL.common.c"
+    #undef MULTIRATE_FAST_STEP
 }
@@ -172,6 +172,14 @@ extern "C" SET_ODE_INITIAL_CONDITIONS_GPU(set_model_initial_conditions_gpu) {
         initial_conditions_epi = extra_data->initial_ss_epi;
         initial_conditions_mid = extra_data->initial_ss_mid;
         transmurality = extra_data->transmurality;
+
+        // The kernels only read the scalar multipliers of the extra data, which hold the mean of the varying columns
+        struct cell_parameter_table *table = extra_data->parameters;
+        for(uint32_t v = 0; table && v < table->num_varying_columns; v++) {
+            uint32_t c = table->varying_columns[v];
+            log_warn("%s varies per cell, but the GPU model uses its mean (%g)!\n", table->names[c], table->uniform_values[c]);
+        }
+
         check_cuda_error(cudaMalloc((void **)&initial_conditions_endo_device, sizeof(real)*NEQ));
         check_cuda_error(cudaMemcpy(initial_conditions_endo_device, initial_conditions_endo, sizeof(real)*NEQ, cudaMemcpyHostToDevice));
         check_cuda_error(cudaMalloc((void **)&initial_conditions_epi_device, sizeof(real)*NEQ));
@@ -251,11 +259,11 @@ extern "C" SOLVE_MODEL_ODES(solve_model_odes_gpu) {
         extra_par[7]  = extra_data->IKb_Multiplier; 
         extra_par[8]  = extra_data->INaCa_Multiplier;
         extra_par[9]  = extra_data->INaK_Multiplier;  
-        extra_par[9]  = extra_data->INab_Multiplier;  
-        extra_par[10] = extra_data->ICab_Multiplier;  
-        extra_par[11] = extra_data->IpCa_Multiplier;  
-        extra_par[12] = extra_data->ICaCl_Multiplier;
-        extra_par[13] = extra_data->IClb_Multiplier; 
+        extra_par[10] = extra_data->INab_Multiplier;  
+        extra_par[11] = extra_data->ICab_Multiplier;  
+        extra_par[12] = extra_data->IpCa_Multiplier;  
+        extra_par[13] = extra_data->ICaCl_Multiplier;
+        extra_par[14] = extra_data->IClb_Multiplier; 
         extra_par[15] = extra_data->Jrel_Multiplier; 
         extra_par[16] = extra_data->Jup_Multiplier;
         transmurality = extra_data->transmurality;
@@ -277,11 +285,11 @@ extern "C" SOLVE_MODEL_ODES(solve_model_odes_gpu) {
         extra_par[7]  = 1.0; 
         extra_par[8]  = 1.0;
         extra_par[9]  = 1.0;
-        extra_par[9]  = 1.0; 
-        extra_par[10] = 1.0;  
-        extra_par[11] = 1.0; 
-        extra_par[12] = 1.0;
+        extra_par[10] = 1.0; 
+        extra_par[11] = 1.0;  
+        extra_par[12] = 1.0; 
         extra_par[13] = 1.0;
+        extra_par[14] = 1.0;
         extra_par[15] = 1.0;
         extra_par[16] = 1.0;
 
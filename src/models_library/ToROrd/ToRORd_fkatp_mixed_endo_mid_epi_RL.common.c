@@ -62,11 +62,22 @@ real CaMKb=CaMKo*(1.0-CaMKt)/(1.0+KmCaM/cass);
 real CaMKa=CaMKb+CaMKt;
 real dCaMKt=aCaMK*CaMKb*(CaMKb+CaMKt)-bCaMK*CaMKt;      // Euler
 
-// reversal potentials
+// reversal potentials. They depend only on nai and ki, which the multi-rate solver keeps fixed in its fast steps
+#ifdef MULTIRATE_FAST_STEP
+real ENa=reversal_potentials[0];
+real EK=reversal_potentials[1];
+real EKs=reversal_potentials[2];
+#else
 real ENa=(R*T/F)*log(nao/nai);
 real EK=(R*T/F)*log(ko/ki);
 real PKNa=0.01833;
 real EKs=(R*T/F)*log((ko+PKNa*nao)/(ki+PKNa*nai));
+#endif
+#ifdef MULTIRATE_SLOW_STEP
+reversal_potentials[0]=ENa;
+reversal_potentials[1]=EK;
+reversal_potentials[2]=EKs;
+#endif
 
 real K_o_n = 5.0;
 real A_atp = 2.0;
@@ -87,72 +98,26 @@ real fICaLp=(1.0/(1.0+KmCaMK/CaMKa));
 // INa formulations
 // The Grandi implementation updated with INa phosphorylation.
 // m gate
-real mss = 1 / (pow(1 + exp( -(56.86 + v) / 9.03 ),2));
-real taum = 0.1292 * exp(-pow((v+45.79)/15.54,2)) + 0.06487 * exp(-pow((v-4.823)/51.12,2));
-real dm = (mss - m) / taum;                     // Rush-Larsen
 
 // h gate
-real ah = (v >= -40) ? (0) : (0.057 * exp( -(v + 80) / 6.8 ));
-real bh = (v >= -40) ? (0.77 / (0.13*(1 + exp( -(v + 10.66) / 11.1 )))) : ((2.7 * exp( 0.079 * v) + 3.1*pow(10,5) * exp(0.3485 * v)));
-real tauh = 1 / (ah + bh);
-real hss = 1 / (pow(1 + exp( (v + 71.55)/7.43 ),2));
-real dh = (hss - h) / tauh;                     // Rush-Larsen
 // j gate
-real aj = (v >= -40) ? (0) : (((-2.5428 * pow(10,4)*exp(0.2444*v) - 6.948*pow(10,-6) * exp(-0.04391*v)) * (v + 37.78)) / (1 + exp( 0.311 * (v + 79.23) )));
-real bj = (v >= -40) ? ((0.6 * exp( 0.057 * v)) / (1 + exp( -0.1 * (v + 32) ))) : ((0.02424 * exp( -0.01052 * v )) / (1 + exp( -0.1378 * (v + 40.14) )));
-real tauj = 1 / (aj + bj);
-real jss = 1 / pow((1 + exp( (v + 71.55)/7.43 )),2);
-real dj = (jss - j) / tauj;                     // Rush-Larsen
 
 // h phosphorylated
-real hssp = 1 / pow((1 + exp( (v + 71.55 + 6)/7.43 )),2);
-real dhp = (hssp - hp) / tauh;                  // Rush-Larsen
 // j phosphorylated
-real taujp = 1.46 * tauj;
-real djp = (jss - jp) / taujp;                  // Rush-Larsen
 real GNa = 11.7802;
 real INa=INa_Multiplier * GNa*(v-ENa)*pow(m,3.0)*((1.0-fINap)*h*j+fINap*hp*jp);
 
 // INaL
 // calculate INaL
-real mLss=1.0/(1.0+exp((-(v+42.85))/5.264));
-real tm = 0.1292 * exp(-pow(((v+45.79)/15.54),2)) + 0.06487 * exp(-pow(((v-4.823)/51.12),2)); 
-real tmL=tm;
-real dmL=(mLss-mL)/tmL;                                         // Rush-Larsen
-real hLss=1.0/(1.0+exp((v+87.61)/7.488));
-real thL=200.0;
-real dhL=(hLss-hL)/thL;                                         // Rush-Larsen
-real hLssp=1.0/(1.0+exp((v+93.81)/7.488));
-real thLp=3.0*thL;
-real dhLp=(hLssp-hLp)/thLp;                                     // Rush-Larsen
 real GNaL=0.0279 * INaL_Multiplier;
 if (celltype==EPI) GNaL=GNaL*0.6;
 real INaL=GNaL*(v-ENa)*mL*((1.0-fINaLp)*hL+fINaLp*hLp);
 
 // ITo
 // calculate Ito
-real ass=1.0/(1.0+exp((-(v-14.34))/14.82));
-real ta=1.0515/(1.0/(1.2089*(1.0+exp(-(v-18.4099)/29.3814)))+3.5/(1.0+exp((v+100.0)/29.3814)));
-real da=(ass-a)/ta;                                                         // Rush-Larsen
-real iss=1.0/(1.0+exp((v+43.94)/5.711));
-real delta_epi = (celltype == EPI) ? 1.0-(0.95/(1.0+exp((v+70.0)/5.0))) : 1.0;
-real tiF=4.562+1/(0.3933*exp((-(v+100.0))/100.0)+0.08004*exp((v+50.0)/16.59));
-real tiS=23.62+1/(0.001416*exp((-(v+96.52))/59.05)+1.780e-8*exp((v+114.1)/8.079));
-tiF=tiF*delta_epi;
-tiS=tiS*delta_epi;
 real AiF=1.0/(1.0+exp((v-213.6)/151.2));
 real AiS=1.0-AiF;
-real diF=(iss-iF)/tiF;                                                      // Rush-Larsen
-real diS=(iss-iS)/tiS;                                                      // Rush-Larsen
 real i=AiF*iF+AiS*iS;
-real assp=1.0/(1.0+exp((-(v-24.34))/14.82));
-real dap=(assp-ap)/ta;                                                     // Rush-Larsen
-real dti_develop=1.354+1.0e-4/(exp((v-167.4)/15.89)+exp(-(v-12.23)/0.2154));
-real dti_recover=1.0-0.5/(1.0+exp((v+70.0)/20.0));
-real tiFp=dti_develop*dti_recover*tiF;
-real tiSp=dti_develop*dti_recover*tiS;
-real diFp=(iss-iFp)/tiFp;                                                   // Rush-Larsen
-real diSp=(iss-iSp)/tiSp;                                                   // Rush-Larsen
 real ip=AiF*iFp+AiS*iSp;
 real Gto=0.16 * Ito_Multiplier;
 Gto = (celltype == EPI || celltype == MID) ? Gto*2.0 : Gto;
@@ -163,36 +128,15 @@ real Ito=Gto*(v-EK)*((1.0-fItop)*a*i+fItop*ap*ip);
 // it computes both ICaL in subspace and myoplasm (_i)
 
 // calculate ICaL, ICaNa, ICaK
-real dss=1.0763*exp(-1.0070*exp(-0.0829*(v)));  // magyar
-if(v >31.4978) dss = 1; // activation cannot be greater than 1
-real td= 0.6+1.0/(exp(-0.05*(v+6.0))+exp(0.09*(v+14.0)));
-real dd=(dss-d)/td;                                                                     // Rush-Larsen
-real fss=1.0/(1.0+exp((v+19.58)/3.696));
-real tff=7.0+1.0/(0.0045*exp(-(v+20.0)/10.0)+0.0045*exp((v+20.0)/10.0));
-real tfs=1000.0+1.0/(0.000035*exp(-(v+5.0)/4.0)+0.000035*exp((v+5.0)/6.0));
 real Aff=0.6;
 real Afs=1.0-Aff;
-real dff=(fss-ff)/tff;                                                                  // Rush-Larsen
-real dfs=(fss-fs)/tfs;                                                                  // Rush-Larsen
 real f=Aff*ff+Afs*fs;
-real fcass=fss;
-real tfcaf=7.0+1.0/(0.04*exp(-(v-4.0)/7.0)+0.04*exp((v-4.0)/7.0));
-real tfcas=100.0+1.0/(0.00012*exp(-v/3.0)+0.00012*exp(v/7.0));
 
 real Afcaf=0.3+0.6/(1.0+exp((v-10.0)/10.0));
 real Afcas=1.0-Afcaf;
-real dfcaf=(fcass-fcaf)/tfcaf;                                                          // Rush-Larsen
-real dfcas=(fcass-fcas)/tfcas;                                                          // Rush-Larsen
 real fca=Afcaf*fcaf+Afcas*fcas;
 
-real tjca = 75;
-real jcass = 1.0/(1.0+exp((v+18.08)/(2.7916)));   
-real djca=(jcass-jca)/tjca;                                                                  // Rush-Larsen
-real tffp=2.5*tff;
-real dffp=(fss-ffp)/tffp;                                                                    // Rush-Larsen
 real fp=Aff*ffp+Afs*fs;
-real tfcafp=2.5*tfcaf;
-real dfcafp=(fcass-fcafp)/tfcafp;                                                           // Rush-Larsen
 real fcap=Afcaf*fcafp+Afcas*fcas;
 
 // SS nca
@@ -332,12 +276,6 @@ else if (celltype==MID)
 real IKr = GKr * o  * (v-EK);
 
 // calculate IKs
-real xs1ss=1.0/(1.0+exp((-(v+11.60))/8.932));
-real txs1=817.3+1.0/(2.326e-4*exp((v+48.28)/17.80)+0.001292*exp((-(v+210.0))/230.0));
-real dxs1=(xs1ss-xs1)/txs1;                              // Rush-Larsen
-real xs2ss=xs1ss;
-real txs2=1.0/(0.01*exp((v-50.0)/20.0)+0.0193*exp((-(v+66.54))/31.0));
-real dxs2=(xs2ss-xs2)/txs2;                               // Rush-Larsen
 real KsCa=1.0+0.6/(1.0+pow((3.8e-5/cai),1.4));
 real GKs= 0.0011 * IKs_Multiplier;
 if (celltype==EPI)
@@ -653,6 +591,49 @@ real dcansr=Jup-Jtr*vjsr/vnsr;
 real Bcajsr=1.0/(1.0+csqnmax*kmcsqn/pow((kmcsqn+cajsr),2.0));
 real dcajsr=Bcajsr*(Jtr-Jrel);
 
+// Compute 'a' coefficients for the Hodkin-Huxley variables
+a_[41] = -1.0 / tau_rel;
+a_[42] = -1.0 / tau_relp;    
+
+// Compute 'b' coefficients for the Hodkin-Huxley variables
+b_[41] = Jrel_inf / tau_rel;
+b_[42] = Jrel_infp / tau_relp;
+
+// Right-hand side
+rDY_[0]  = dv;
+rDY_[1]  = dCaMKt;
+rDY_[2]  = dcass;
+rDY_[3]  = dnai;
+rDY_[4]  = dnass;
+rDY_[5]  = dki;
+rDY_[6]  = dkss;
+rDY_[7]  = dcansr;
+rDY_[8]  = dcajsr;
+rDY_[9]  = dcai;
+rDY_[32] = dnca;
+rDY_[33] = dnca_i;
+rDY_[34] = dc0;
+rDY_[35] = dc1;
+rDY_[36] = dc2;
+rDY_[37] = di;
+rDY_[38] = delta_o;
+rDY_[41] = dJrelnp;
+rDY_[42] = dJrelp;
+
+#ifndef GATES_FROM_LOOKUP_TABLE
+// Voltage dependent gates. When the lookup table is used they are updated directly by the CPU solver
+#include "ToRORd_fkatp_mixed_endo_mid_epi_gates.common.c"
+
+real dm = (mss - m) / tm;                       // Rush-Larsen
+real dh = (hss - h) / tauh;                     // Rush-Larsen
+real dj = (jss - j) / tauj;                     // Rush-Larsen
+real dhp = (hssp - hp) / tauh;                  // Rush-Larsen
+real djp = (jss - jp) / taujp;                  // Rush-Larsen
+real dmL=(mLss-mL)/tmL;                                         // Rush-Larsen
+real da=(ass-a)/ta;                                                         // Rush-Larsen
+real dap=(assp-ap)/ta;                                                     // Rush-Larsen
+real dd=(dss-d)/td;                                                                     // Rush-Larsen
+
 // Compute 'a' coefficients for the Hodkin-Huxley variables
 a_[10] = -1.0 / tm;
 a_[11] = -1.0 / tauh;
@@ -660,15 +641,56 @@ a_[12] = -1.0 / tauj;
 a_[13] = -1.0 / tauh;
 a_[14] = -1.0 / taujp;
 a_[15] = -1.0 / tmL;
+a_[18] = -1.0 / ta;
+a_[21] = -1.0 / ta;
+a_[24] = -1.0 / td;
+
+// Compute 'b' coefficients for the Hodkin-Huxley variables
+b_[10] = mss / tm;
+b_[11] = hss / tauh;
+b_[12] = jss / tauj;
+b_[13] = hssp / tauh;
+b_[14] = jss / taujp;
+b_[15] = mLss / tmL;
+b_[18] = ass / ta;
+b_[21] = assp / ta;
+b_[24] = dss / td;
+
+// Right-hand side
+rDY_[10] = dm;
+rDY_[11] = dh;
+rDY_[12] = dj;
+rDY_[13] = dhp;
+rDY_[14] = djp;
+rDY_[15] = dmL;
+rDY_[18] = da;
+rDY_[21] = dap;
+rDY_[24] = dd;
+
+#ifndef MULTIRATE_FAST_STEP
+// Slow gates. The multi-rate solver only updates them in its slow steps
+real dhL=(hLss-hL)/thL;                                         // Rush-Larsen
+real dhLp=(hLssp-hLp)/thLp;                                     // Rush-Larsen
+real diF=(iss-iF)/tiF;                                                      // Rush-Larsen
+real diS=(iss-iS)/tiS;                                                      // Rush-Larsen
+real diFp=(iss-iFp)/tiFp;                                                   // Rush-Larsen
+real diSp=(iss-iSp)/tiSp;                                                   // Rush-Larsen
+real dff=(fss-ff)/tff;                                                                  // Rush-Larsen
+real dfs=(fss-fs)/tfs;                                                                  // Rush-Larsen
+real dfcaf=(fcass-fcaf)/tfcaf;                                                          // Rush-Larsen
+real dfcas=(fcass-fcas)/tfcas;                                                          // Rush-Larsen
+real djca=(jcass-jca)/tjca;                                                                  // Rush-Larsen
+real dffp=(fss-ffp)/tffp;                                                                    // Rush-Larsen
+real dfcafp=(fcass-fcafp)/tfcafp;                                                           // Rush-Larsen
+real dxs1=(xs1ss-xs1)/txs1;                              // Rush-Larsen
+real dxs2=(xs2ss-xs2)/txs2;                               // Rush-Larsen
+
 a_[16] = -1.0 / thL;
 a_[17] = -1.0 / thLp;
-a_[18] = -1.0 / ta;
 a_[19] = -1.0 / tiF;
 a_[20] = -1.0 / tiS;
-a_[21] = -1.0 / ta;
 a_[22] = -1.0 / tiFp;
 a_[23] = -1.0 / tiSp;
-a_[24] = -1.0 / td;
 a_[25] = -1.0 / tff;
 a_[26] = -1.0 / tfs;
 a_[27] = -1.0 / tfcaf;
@@ -678,25 +700,13 @@ a_[30] = -1.0 / tffp;
 a_[31] = -1.0 / tfcafp;
 a_[39] = -1.0 / txs1;
 a_[40] = -1.0 / txs2;
-a_[41] = -1.0 / tau_rel;
-a_[42] = -1.0 / tau_relp;    
 
-// Compute 'b' coefficients for the Hodkin-Huxley variables
-b_[10] = mss / tm;
-b_[11] = hss / tauh;
-b_[12] = jss / tauj;
-b_[13] = hssp / tauh;
-b_[14] = jss / taujp;
-b_[15] = mLss / tmL;
 b_[16] = hLss / thL;
 b_[17] = hLssp / thLp;
-b_[18] = ass / ta;
 b_[19] = iss / tiF;
 b_[20] = iss / tiS;
-b_[21] = assp / ta;
 b_[22] = iss / tiFp;
 b_[23] = iss / tiSp;
-b_[24] = dss / td;
 b_[25] = fss / tff;
 b_[26] = fss / tfs;
 b_[27] = fcass / tfcaf;
@@ -706,35 +716,13 @@ b_[30] = fss / tffp;
 b_[31] = fcass / tfcafp;
 b_[39] = xs1ss / txs1;
 b_[40] = xs2ss / txs2;
-b_[41] = Jrel_inf / tau_rel;
-b_[42] = Jrel_infp / tau_relp;
 
-// Right-hand side
-rDY_[0]  = dv;
-rDY_[1]  = dCaMKt;
-rDY_[2]  = dcass;
-rDY_[3]  = dnai;
-rDY_[4]  = dnass;
-rDY_[5]  = dki;
-rDY_[6]  = dkss;
-rDY_[7]  = dcansr;
-rDY_[8]  = dcajsr;
-rDY_[9]  = dcai;
-rDY_[10] = dm;
-rDY_[11] = dh;
-rDY_[12] = dj;
-rDY_[13] = dhp;
-rDY_[14] = djp;
-rDY_[15] = dmL;
 rDY_[16] = dhL;
 rDY_[17] = dhLp;
-rDY_[18] = da;
 rDY_[19] = diF;
 rDY_[20] = diS;
-rDY_[21] = dap;
 rDY_[22] = diFp;
 rDY_[23] = diSp;
-rDY_[24] = dd;
 rDY_[25] = dff;
 rDY_[26] = dfs;
 rDY_[27] = dfcaf;
@@ -742,14 +730,7 @@ rDY_[28] = dfcas;
 rDY_[29] = djca;
 rDY_[30] = dffp;
 rDY_[31] = dfcafp;
-rDY_[32] = dnca;
-rDY_[33] = dnca_i;
-rDY_[34] = dc0;
-rDY_[35] = dc1;
-rDY_[36] = dc2;
-rDY_[37] = di;
-rDY_[38] = delta_o;
 rDY_[39] = dxs1;
 rDY_[40] = dxs2;
-rDY_[41] = dJrelnp;
-rDY_[42] = dJrelp;
\ No newline at end of file
+#endif
+#endif
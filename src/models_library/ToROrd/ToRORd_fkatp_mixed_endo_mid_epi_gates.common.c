@@ -0,0 +1,76 @@
+// Steady states and time constants of the Hodgkin-Huxley gates. They depend only on v and celltype.
+// The slow gates (inactivation of INaL, Ito and ICaL and the IKs gates) are not computed in the fast steps of the multi-rate solver
+
+// m gate
+real mss = 1 / (pow(1 + exp( -(56.86 + v) / 9.03 ),2));
+
+// h gate
+real ah = (v >= -40) ? (0) : (0.057 * exp( -(v + 80) / 6.8 ));
+real bh = (v >= -40) ? (0.77 / (0.13*(1 + exp( -(v + 10.66) / 11.1 )))) : ((2.7 * exp( 0.079 * v) + 3.1*pow(10,5) * exp(0.3485 * v)));
+real tauh = 1 / (ah + bh);
+real hss = 1 / (pow(1 + exp( (v + 71.55)/7.43 ),2));
+
+// j gate
+real aj = (v >= -40) ? (0) : (((-2.5428 * pow(10,4)*exp(0.2444*v) - 6.948*pow(10,-6) * exp(-0.04391*v)) * (v + 37.78)) / (1 + exp( 0.311 * (v + 79.23) )));
+real bj = (v >= -40) ? ((0.6 * exp( 0.057 * v)) / (1 + exp( -0.1 * (v + 32) ))) : ((0.02424 * exp( -0.01052 * v )) / (1 + exp( -0.1378 * (v + 40.14) )));
+real tauj = 1 / (aj + bj);
+real jss = 1 / pow((1 + exp( (v + 71.55)/7.43 )),2);
+
+// h phosphorylated
+real hssp = 1 / pow((1 + exp( (v + 71.55 + 6)/7.43 )),2);
+
+// j phosphorylated
+real taujp = 1.46 * tauj;
+
+// INaL
+real mLss=1.0/(1.0+exp((-(v+42.85))/5.264));
+real tm = 0.1292 * exp(-pow(((v+45.79)/15.54),2)) + 0.06487 * exp(-pow(((v-4.823)/51.12),2));
+real tmL=tm;
+#ifndef MULTIRATE_FAST_STEP
+real hLss=1.0/(1.0+exp((v+87.61)/7.488));
+real thL=200.0;
+real hLssp=1.0/(1.0+exp((v+93.81)/7.488));
+real thLp=3.0*thL;
+#endif
+
+// Ito
+real ass=1.0/(1.0+exp((-(v-14.34))/14.82));
+real ta=1.0515/(1.0/(1.2089*(1.0+exp(-(v-18.4099)/29.3814)))+3.5/(1.0+exp((v+100.0)/29.3814)));
+real assp=1.0/(1.0+exp((-(v-24.34))/14.82));
+#ifndef MULTIRATE_FAST_STEP
+real iss=1.0/(1.0+exp((v+43.94)/5.711));
+real delta_epi = (celltype == EPI) ? 1.0-(0.95/(1.0+exp((v+70.0)/5.0))) : 1.0;
+real tiF=4.562+1/(0.3933*exp((-(v+100.0))/100.0)+0.08004*exp((v+50.0)/16.59));
+real tiS=23.62+1/(0.001416*exp((-(v+96.52))/59.05)+1.780e-8*exp((v+114.1)/8.079));
+tiF=tiF*delta_epi;
+tiS=tiS*delta_epi;
+real dti_develop=1.354+1.0e-4/(exp((v-167.4)/15.89)+exp(-(v-12.23)/0.2154));
+real dti_recover=1.0-0.5/(1.0+exp((v+70.0)/20.0));
+real tiFp=dti_develop*dti_recover*tiF;
+real tiSp=dti_develop*dti_recover*tiS;
+#endif
+
+// ICaL
+real dss=1.0763*exp(-1.0070*exp(-0.0829*(v)));  // magyar
+if(v >31.4978) dss = 1; // activation cannot be greater than 1
+real td= 0.6+1.0/(exp(-0.05*(v+6.0))+exp(0.09*(v+14.0)));
+#ifndef MULTIRATE_FAST_STEP
+real fss=1.0/(1.0+exp((v+19.58)/3.696));
+real tff=7.0+1.0/(0.0045*exp(-(v+20.0)/10.0)+0.0045*exp((v+20.0)/10.0));
+real tfs=1000.0+1.0/(0.000035*exp(-(v+5.0)/4.0)+0.000035*exp((v+5.0)/6.0));
+real fcass=fss;
+real tfcaf=7.0+1.0/(0.04*exp(-(v-4.0)/7.0)+0.04*exp((v-4.0)/7.0));
+real tfcas=100.0+1.0/(0.00012*exp(-v/3.0)+0.00012*exp(v/7.0));
+real tjca = 75;
+real jcass = 1.0/(1.0+exp((v+18.08)/(2.7916)));
+real tffp=2.5*tff;
+real tfcafp=2.5*tfcaf;
+#endif
+
+// IKs
+#ifndef MULTIRATE_FAST_STEP
+real xs1ss=1.0/(1.0+exp((-(v+11.60))/8.932));
+real txs1=817.3+1.0/(2.326e-4*exp((v+48.28)/17.80)+0.001292*exp((-(v+210.0))/230.0));
+real xs2ss=xs1ss;
+real txs2=1.0/(0.01*exp((v-50.0)/20.0)+0.0193*exp((-(v+66.54))/31.0));
+#endif
@@ -6,22 +6,22 @@ COMMON_HEADERS="ToRORd_fkatp_endo.h"
 COMPILE_MODEL_LIB "ToRORd_fkatp_endo" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS"
 
 ############## ToRORd fkatp Mixed ENDO_MID_EPI ##############################
-MODEL_FILE_CPU="ToRORd_fkatp_mixed_endo_mid_epi.c"
+MODEL_FILE_CPU="ToRORd_fkatp_mixed_endo_mid_epi.c ../lookup_table.c ../multirate.c ../prepacing.c"
 MODEL_FILE_GPU="ToRORd_fkatp_mixed_endo_mid_epi.cu"
-COMMON_HEADERS="ToRORd_fkatp_mixed_endo_mid_epi.h"
+COMMON_HEADERS="ToRORd_fkatp_mixed_endo_mid_epi.h ../lookup_table.h ../multirate.h ../prepacing.h ../adaptive_rush_larsen.h ../adaptive_rush_larsen.common.c"
 
 COMPILE_MODEL_LIB "ToRORd_fkatp_mixed_endo_mid_epi" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS"
 
 ############## ToRORd dynCl Mixed ENDO_MID_EPI ##############################
 MODEL_FILE_CPU="ToRORd_dynCl_mixed_endo_mid_epi.c"
 MODEL_FILE_GPU="ToRORd_dynCl_mixed_endo_mid_epi.cu"
-COMMON_HEADERS="ToRORd_dynCl_mixed_endo_mid_epi.h"
+COMMON_HEADERS="ToRORd_dynCl_mixed_endo_mid_epi.h ../adaptive_rush_larsen.h ../adaptive_rush_larsen.common.c"
 
 COMPILE_MODEL_LIB "ToRORd_dynCl_mixed_endo_mid_epi" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS"
 
 ############## ToRORd Land Mixed ENDO_MID_EPI ##############################
 MODEL_FILE_CPU="ToRORd_Land_mixed_endo_mid_epi.c"
 MODEL_FILE_GPU="ToRORd_Land_mixed_endo_mid_epi.cu"
-COMMON_HEADERS="ToRORd_Land_mixed_endo_mid_epi.h"
+COMMON_HEADERS="ToRORd_Land_mixed_endo_mid_epi.h ../adaptive_rush_larsen.h ../adaptive_rush_larsen.common.c"
 
 COMPILE_MODEL_LIB "ToRORd_Land_mixed_endo_mid_epi" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS"
@@ -0,0 +1,129 @@
+//
+// Body of the solve_rush_larsen_cpu_adpt function of the CPU models (see adaptive_rush_larsen.h). The function has the
+// parameters sv, final_time, sv_id and solver, and the model defines NEQ, ADAPTIVE_RUSH_LARSEN_GATES and
+// ADAPTIVE_RUSH_LARSEN_RHS before including it.
+//
+{
+    static const bool is_gate[NEQ] = ADAPTIVE_RUSH_LARSEN_GATES;
+
+    // The rates and the coefficients at the start of the step are in [start] and the ones at the end in [1 - start].
+    // When a step is accepted, start changes, so the RHS at the end of the step is reused by the next one
+    real rates[2][NEQ];
+    real a[2][NEQ];
+    real b[2][NEQ];
+    real y_old[NEQ];
+    real y_new[NEQ];
+    int start = 0;
+
+    // initializes the variables
+    solver->ode_previous_dt[sv_id] = solver->ode_dt[sv_id];
+
+    real *dt = &solver->ode_dt[sv_id];
+    real *time_new = &solver->ode_time_new[sv_id];
+    real *previous_dt = &solver->ode_previous_dt[sv_id];
+
+    // Keep 'dt' inside the adaptive interval
+    if(*time_new + *dt > final_time) {
+        *dt = final_time - *time_new;
+    }
+
+    ADAPTIVE_RUSH_LARSEN_RHS(a[start], b[start], sv, rates[start], *dt);
+    *time_new += *dt;
+
+    const real rel_tol = solver->rel_tol;
+    const real abs_tol = solver->abs_tol;
+
+    const real tiny = pow(abs_tol, 2.0);
+
+    const real min_dt = solver->min_dt;
+    const real max_dt = solver->max_dt;
+
+    while(1) {
+
+        const real *k1 = rates[start];
+        const real *a1 = a[start];
+        const real *b1 = b[start];
+
+        real *k2 = rates[1 - start];
+        real *a2 = a[1 - start];
+        real *b2 = b[1 - start];
+
+        // Rush-Larsen for the gates and Euler for the other state variables
+        for(int i = 0; i < NEQ; i++) {
+            y_old[i] = sv[i];
+            if(is_gate[i]) {
+                y_new[i] = (fabs(a1[i]) < abs_tol) ? y_old[i] + (y_old[i] * a1[i] + b1[i]) * (*dt)
+                                                   : exp(a1[i] * (*dt)) * (y_old[i] + (b1[i] / a1[i])) - (b1[i] / a1[i]);
+            } else {
+                y_new[i] = k1[i] * *dt + y_old[i];
+            }
+            sv[i] = y_new[i];
+        }
+
+        *time_new += *dt;
+        ADAPTIVE_RUSH_LARSEN_RHS(a2, b2, sv, k2, *dt);
+        *time_new -= *dt; // step back
+
+        // The error is the difference to the second order solution that uses the mean of the rates (and of the
+        // coefficients) at the start and at the end of the step. It is relative, except for the values below abs_tol
+        double greatest_error = 0.0, aux_error = 0.0;
+        real as, bs, f, y_2nd_order;
+
+        for(int i = 0; i < NEQ; i++) {
+            if(is_gate[i]) {
+                as = (a1[i] + a2[i]) * 0.5;
+                bs = (b1[i] + b2[i]) * 0.5;
+                y_2nd_order = (fabs(as) < abs_tol) ? y_old[i] + (*dt) * (y_old[i] * as + bs) : exp(as * (*dt)) * (y_old[i] + (bs / as)) - (bs / as);
+            } else {
+                f = (k1[i] + k2[i]) * 0.5;
+                y_2nd_order = y_old[i] + (*dt) * f;
+            }
+            aux_error = (fabs(y_2nd_order) < abs_tol) ? fabs(y_2nd_order - y_new[i]) : fabs((y_2nd_order - y_new[i]) / (y_2nd_order));
+            greatest_error = (aux_error > greatest_error) ? aux_error : greatest_error;
+        }
+
+        /// adapt the time step
+        greatest_error += tiny;
+        *previous_dt = *dt;
+        *dt = (*dt) * sqrt(0.5 * rel_tol / greatest_error); // Jhonny`s formula
+
+        if(*dt < min_dt) {
+            *dt = min_dt;
+        } else if(*dt > max_dt) {
+            *dt = max_dt;
+        }
+
+        if(*time_new + *dt > final_time) {
+            *dt = final_time - *time_new;
+        }
+
+        if(greatest_error >= 1.0f && *dt > min_dt) {
+            // rejects the step
+            for(int i = 0; i < NEQ; i++) {
+                sv[i] = y_old[i];
+            }
+        } else {
+            if(greatest_error >= 1.0) {
+                printf("Accepting solution with error > %lf \n", greatest_error);
+            }
+
+            start = 1 - start;
+
+            for(int i = 0; i < NEQ; i++) {
+                sv[i] = y_new[i];
+            }
+
+            if(*time_new + *previous_dt >= final_time) {
+                if(final_time == *time_new) {
+                    break;
+                } else if(*time_new < final_time) {
+                    *dt = *previous_dt = final_time - *time_new;
+                    *time_new += *previous_dt;
+                    break;
+                }
+            } else {
+                *time_new += *previous_dt;
+            }
+        }
+    }
+}
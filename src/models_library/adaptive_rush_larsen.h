@@ -0,0 +1,47 @@
+//
+// Adaptive Rush-Larsen method shared by the CPU models that have a RHS_RL_cpu. The gates are advanced with the
+// Rush-Larsen method and the other state variables with the Euler method, and the step is adapted with the error of
+// the second order solution. The model writes its solve_rush_larsen_cpu_adpt as:
+//
+// #define ADAPTIVE_RUSH_LARSEN_GATES {0, 0, 1, 1, ...}     (NEQ values, 1 for the gates)
+//
+// void solve_rush_larsen_cpu_adpt(real *sv, real stim_curr, real final_time, int sv_id, struct ode_solver *solver) {
+//     #define ADAPTIVE_RUSH_LARSEN_RHS(a, b, y, rates, dt) RHS_RL_cpu(a, b, y, rates, stim_curr, dt)
+//     #include "../adaptive_rush_larsen.common.c"
+//     #undef ADAPTIVE_RUSH_LARSEN_RHS
+// }
+//
+// The work arrays have NEQ elements and are kept on the stack, and the RHS is evaluated once per step (the rates at
+// the end of an accepted step are the ones at the start of the next step).
+//
+
+#ifndef MONOALG3D_C_ADAPTIVE_RUSH_LARSEN_H
+#define MONOALG3D_C_ADAPTIVE_RUSH_LARSEN_H
+
+#include "model_common.h"
+
+// The [ode_solver] option adaptive_method selects the adaptive method: rush_larsen or euler. Without it (or with an
+// invalid value), the model default is used (the method the model used before the option existed). The models call it
+// once in set_model_initial_conditions_cpu and keep the result in ode_solver->adaptive_rush_larsen.
+static inline bool adaptive_method_is_rush_larsen(struct string_hash_entry *ode_extra_config, bool rush_larsen_by_default) {
+
+    char *method = get_string_parameter(ode_extra_config, "adaptive_method");
+    bool rush_larsen = rush_larsen_by_default;
+
+    if(method) {
+        if(STRINGS_EQUAL(method, "rush_larsen")) {
+            rush_larsen = true;
+        } else if(STRINGS_EQUAL(method, "euler")) {
+            rush_larsen = false;
+        } else {
+            log_warn("Invalid adaptive ODE method %s. Valid methods are rush_larsen and euler. Using %s!\n", method,
+                     rush_larsen_by_default ? "rush_larsen" : "euler");
+        }
+    }
+
+    log_info("Using the adaptive %s method to solve the ODEs on the CPU\n", rush_larsen ? "Rush-Larsen" : "Euler");
+
+    return rush_larsen;
+}
+
+#endif // MONOALG3D_C_ADAPTIVE_RUSH_LARSEN_H
@@ -9,7 +9,7 @@ COMPILE_MODEL_LIB "courtemanche_ramirez_nattel_1998" "$MODEL_FILE_CPU" "$MODEL_F
 ############## CRN_RL ##############################
 MODEL_FILE_CPU="courtemanche_ramirez_nattel_1998_RL.c"
 MODEL_FILE_GPU="courtemanche_ramirez_nattel_1998_RL.cu"
-COMMON_HEADERS="courtemanche_ramirez_nattel_1998_RL.h"
+COMMON_HEADERS="courtemanche_ramirez_nattel_1998_RL.h ../adaptive_rush_larsen.h ../adaptive_rush_larsen.common.c"
 
 COMPILE_MODEL_LIB "courtemanche_ramirez_nattel_1998_RL" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS"
 ##########################################################
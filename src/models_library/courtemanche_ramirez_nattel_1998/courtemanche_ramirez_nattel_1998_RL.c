@@ -1,4 +1,5 @@
 #include "courtemanche_ramirez_nattel_1998_RL.h"
+#include "../adaptive_rush_larsen.h"
 #include <stdlib.h>
 
 SET_ODE_INITIAL_CONDITIONS_CPU(set_model_initial_conditions_cpu) {
@@ -20,7 +21,8 @@ SET_ODE_INITIAL_CONDITIONS_CPU(set_model_initial_conditions_cpu) {
 
         solver->ode_previous_dt = (real*)calloc(num_cells, sizeof(real));
         solver->ode_time_new    = (real*)calloc(num_cells, sizeof(real));
-        log_info("Using Adaptive Euler model to solve the ODEs\n");
+        log_info("Using Adaptive timestep model to solve the ODEs\n");
+        solver->adaptive_rush_larsen = adaptive_method_is_rush_larsen(ode_extra_config, true);
     } else {
         log_info("Using Rush-Larsen/Euler model to solve the ODEs\n");
     }
@@ -66,28 +68,36 @@ SOLVE_MODEL_ODES(solve_model_odes_cpu) {
 
     uint32_t sv_id;
 
-    size_t num_cells_to_solve = ode_solver->num_cells_to_solve;
     uint32_t * cells_to_solve = ode_solver->cells_to_solve;
     real *sv = ode_solver->sv;
     real dt = ode_solver->min_dt;
     uint32_t num_steps = ode_solver->num_steps;
 
     bool adpt = ode_solver->adaptive;
+    bool adaptive_rush_larsen = adpt && ode_solver->adaptive_rush_larsen;
 
-    #pragma omp parallel for private(sv_id)
-    for (u_int32_t i = 0; i < num_cells_to_solve; i++) {
+    uint32_t partition[MAX_ODE_PARTITIONS + 1];
+    uint32_t num_parts = partition_cells_to_solve(ode_solver, dt, partition);
 
-        if(cells_to_solve)
-            sv_id = cells_to_solve[i];
-        else
-            sv_id = i;
+    #pragma omp parallel for private(sv_id) schedule(dynamic, 1)
+    for(uint32_t p = 0; p < num_parts; p++) {
+        for (u_int32_t i = partition[p]; i < partition[p + 1]; i++) {
 
-        if(adpt) {
-            solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], current_t + dt, sv_id, ode_solver);
-        }
-        else {
-            for (int j = 0; j < num_steps; ++j) {
-                solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i]);
+            if(cells_to_solve)
+                sv_id = cells_to_solve[i];
+            else
+                sv_id = i;
+
+            if(adpt) {
+                if(adaptive_rush_larsen)
+                    solve_rush_larsen_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], current_t + dt, sv_id, ode_solver);
+                else
+                    solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], current_t + dt, sv_id, ode_solver);
+            }
+            else {
+                for (int j = 0; j < num_steps; ++j) {
+                    solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i]);
+                }
             }
         }
     }
@@ -134,19 +144,23 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
     const real _beta_safety_ = 0.8;
     int numEDO = NEQ;
 
-    real rDY[numEDO];
-
-    real _tolerances_[numEDO];
+    real _tolerances_[NEQ];
     real _aux_tol = 0.0;
     // initializes the variables
     solver->ode_previous_dt[sv_id] = solver->ode_dt[sv_id];
 
-    real edos_old_aux_[numEDO];
-    real edos_new_euler_[numEDO];
-    real *_k1__ = (real *)malloc(sizeof(real) * numEDO);
-    real *_k2__ = (real *)malloc(sizeof(real) * numEDO);
+    real edos_old_aux_[NEQ];
+    real edos_new_euler_[NEQ];
+    // _k1__ and _k2__ point to the rates at the start and at the end of the step
+    real _k1_rates__[NEQ];
+    real _k2_rates__[NEQ];
+    real *_k1__ = _k1_rates__;
+    real *_k2__ = _k2_rates__;
     real *_k_aux__;
 
+    // RHS_cpu gives the Rush-Larsen update of the gates, so the rates come from RHS_RL_cpu
+    real a_[NEQ], b_[NEQ];
+
     real *dt = &solver->ode_dt[sv_id];
     real *time_new = &solver->ode_time_new[sv_id];
     real *previous_dt = &solver->ode_previous_dt[sv_id];
@@ -155,13 +169,9 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
         *dt = final_time - *time_new;
     }
 
-    RHS_cpu(sv, rDY, stim_curr, *dt);
+    RHS_RL_cpu(a_, b_, sv, _k1__, stim_curr, *dt);
     *time_new += *dt;
 
-    for(int i = 0; i < numEDO; i++) {
-        _k1__[i] = rDY[i];
-    }
-
     const real rel_tol = solver->rel_tol;
     const real abs_tol = solver->abs_tol;
 
@@ -182,13 +192,11 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
         }
 
         *time_new += *dt;
-        RHS_cpu(sv, rDY, stim_curr, *dt);
+        RHS_RL_cpu(a_, b_, sv, _k2__, stim_curr, *dt);
         *time_new -= *dt; // step back
 
         double greatestError = 0.0, auxError = 0.0;
         for(int i = 0; i < numEDO; i++) {
-            // stores the new evaluation
-            _k2__[i] = rDY[i];
             _aux_tol = fabs(edos_new_euler_[i]) * rel_tol;
             _tolerances_[i] = (abs_tol > _aux_tol) ? abs_tol : _aux_tol;
             // finds the greatest error between  the steps
@@ -247,9 +255,17 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
             }
         }
     }
+}
+
+// State variables solved with the Rush-Larsen method by solve_rush_larsen_cpu_adpt
+#define ADAPTIVE_RUSH_LARSEN_GATES {0, 1, 1, 1, 1, 1, 1, 1, 1, 1,  \
+                                    1, 1, 1, 1, 1, 1, 0, 0, 0, 0,  \
+                                    0}
 
-    free(_k1__);
-    free(_k2__);
+void solve_rush_larsen_cpu_adpt(real *sv, real stim_curr, real final_time, int sv_id, struct ode_solver *solver) {
+    #define ADAPTIVE_RUSH_LARSEN_RHS(a, b, y, rates, dt) RHS_RL_cpu(a, b, y, rates, stim_curr, dt)
+    #include "../adaptive_rush_larsen.common.c"
+    #undef ADAPTIVE_RUSH_LARSEN_RHS
 }
 
 void RHS_cpu(const real *sv, real *rDY, real stim_current, real dt) {
@@ -279,3 +295,34 @@ void RHS_cpu(const real *sv, real *rDY, real stim_current, real dt) {
 
     #include "courtemanche_ramirez_nattel_1998_RL_common.inc.c"
 }
+
+// Same as RHS_cpu, but gives the derivatives of the gates and their coefficients 'a' and 'b' (dy/dt = a*y + b)
+void RHS_RL_cpu(real *a_, real *b_, const real *sv, real *rDY, real stim_current, real dt) {
+
+    //State variables
+    const real V_old_ = sv[0];
+    const real m_old_ = sv[1];
+    const real h_old_ = sv[2];
+    const real j_old_ = sv[3];
+    const real oa_old_ = sv[4];
+    const real oi_old_ = sv[5];
+    const real ua_old_ = sv[6];
+    const real ui_old_ = sv[7];
+    const real xr_old_ = sv[8];
+    const real xs_old_ = sv[9];
+    const real d_old_ = sv[10];
+    const real f_old_ = sv[11];
+    const real f_Ca_old_ = sv[12];
+    const real u_old_ = sv[13];
+    const real v_old_ = sv[14];
+    const real w_old_ = sv[15];
+    const real Na_i_old_ = sv[16];
+    const real K_i_old_ = sv[17];
+    const real Ca_i_old_ = sv[18];
+    const real Ca_up_old_ = sv[19];
+    const real Ca_rel_old_ = sv[20];
+
+    #define RHS_RL_COEFFICIENTS
+    #include "courtemanche_ramirez_nattel_1998_RL_common.inc.c"
+    #undef RHS_RL_COEFFICIENTS
+}
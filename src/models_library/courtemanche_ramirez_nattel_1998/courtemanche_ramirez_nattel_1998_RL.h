@@ -22,7 +22,9 @@ __global__ void solve_gpu(real cur_time, real dt, real *sv, real* stim_currents,
 #endif
 
 void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt);
+void RHS_RL_cpu(real *a_, real *b_, const real *sv, real *rDY_, real stim_current, real dt);
 inline void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int thread_id, struct ode_solver *solver);
+void solve_rush_larsen_cpu_adpt(real *sv, real stim_curr, real final_time, int sv_id, struct ode_solver *solver);
 
 void solve_model_ode_cpu(real dt, real *sv, real stim_current);
 
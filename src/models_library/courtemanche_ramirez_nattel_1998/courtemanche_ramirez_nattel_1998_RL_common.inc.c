@@ -168,6 +168,56 @@ real calc_v_infinity = (1.000000000000000e+00-pow((1.000000000000000e+00+exp(((-
 // Euler + Rush-Larsen
 rDY[0] = ((-(calc_i_Na+calc_i_K1+calc_i_to+calc_i_Kur+calc_i_Kr+calc_i_Ks+calc_i_B_Na+calc_i_B_Ca+calc_i_NaK+calc_i_CaP+calc_i_NaCa+calc_i_Ca_L+stim_current))/Cm);
 
+#ifdef RHS_RL_COEFFICIENTS
+// Hodgkin-Huxley coefficients 'a' and 'b' of the gates (dy/dt = a*y + b) and their derivatives
+a_[1] = -1.0/calc_tau_m;
+a_[2] = -1.0/calc_tau_h;
+a_[3] = -1.0/calc_tau_j;
+a_[4] = -1.0/calc_tau_oa;
+a_[5] = -1.0/calc_tau_oi;
+a_[6] = -1.0/calc_tau_ua;
+a_[7] = -1.0/calc_tau_ui;
+a_[8] = -1.0/calc_tau_xr;
+a_[9] = -1.0/calc_tau_xs;
+a_[10] = -1.0/calc_tau_d;
+a_[11] = -1.0/calc_tau_f;
+a_[12] = -1.0/calc_tau_f_Ca;
+a_[13] = -1.0/calc_tau_u;
+a_[14] = -1.0/calc_tau_v;
+a_[15] = -1.0/calc_tau_w;
+
+b_[1] = calc_m_inf/calc_tau_m;
+b_[2] = calc_h_inf/calc_tau_h;
+b_[3] = calc_j_inf/calc_tau_j;
+b_[4] = calc_oa_infinity/calc_tau_oa;
+b_[5] = calc_oi_infinity/calc_tau_oi;
+b_[6] = calc_ua_infinity/calc_tau_ua;
+b_[7] = calc_ui_infinity/calc_tau_ui;
+b_[8] = calc_xr_infinity/calc_tau_xr;
+b_[9] = calc_xs_infinity/calc_tau_xs;
+b_[10] = calc_d_infinity/calc_tau_d;
+b_[11] = calc_f_infinity/calc_tau_f;
+b_[12] = calc_f_Ca_infinity/calc_tau_f_Ca;
+b_[13] = calc_u_infinity/calc_tau_u;
+b_[14] = calc_v_infinity/calc_tau_v;
+b_[15] = calc_w_infinity/calc_tau_w;
+
+rDY[1] = ((calc_m_inf-m_old_)/calc_tau_m);
+rDY[2] = ((calc_h_inf-h_old_)/calc_tau_h);
+rDY[3] = ((calc_j_inf-j_old_)/calc_tau_j);
+rDY[4] = ((calc_oa_infinity-oa_old_)/calc_tau_oa);
+rDY[5] = ((calc_oi_infinity-oi_old_)/calc_tau_oi);
+rDY[6] = ((calc_ua_infinity-ua_old_)/calc_tau_ua);
+rDY[7] = ((calc_ui_infinity-ui_old_)/calc_tau_ui);
+rDY[8] = ((calc_xr_infinity-xr_old_)/calc_tau_xr);
+rDY[9] = ((calc_xs_infinity-xs_old_)/calc_tau_xs);
+rDY[10] = ((calc_d_infinity-d_old_)/calc_tau_d);
+rDY[11] = ((calc_f_infinity-f_old_)/calc_tau_f);
+rDY[12] = ((calc_f_Ca_infinity-f_Ca_old_)/calc_tau_f_Ca);
+rDY[13] = ((calc_u_infinity-u_old_)/calc_tau_u);
+rDY[14] = ((calc_v_infinity-v_old_)/calc_tau_v);
+rDY[15] = ((calc_w_infinity-w_old_)/calc_tau_w);
+#else
 rDY[1] = calc_m_inf + (m_old_-calc_m_inf)*exp(-dt/calc_tau_m);
 rDY[2] = calc_h_inf + (h_old_-calc_h_inf)*exp(-dt/calc_tau_h);
 rDY[3] = calc_j_inf + (j_old_-calc_j_inf)*exp(-dt/calc_tau_j);
@@ -183,6 +233,7 @@ rDY[12] = calc_f_Ca_infinity + (f_Ca_old_-calc_f_Ca_infinity)*exp(-dt/calc_tau_f
 rDY[13] = calc_u_infinity + (u_old_-calc_u_infinity)*exp(-dt/calc_tau_u);
 rDY[14] = calc_v_infinity + (v_old_-calc_v_infinity)*exp(-dt/calc_tau_v);
 rDY[15] = calc_w_infinity + (w_old_-calc_w_infinity)*exp(-dt/calc_tau_w);
+#endif
 
 rDY[16] = ((((-3.000000000000000e+00)*calc_i_NaK)-((3.000000000000000e+00*calc_i_NaCa)+calc_i_B_Na+calc_i_Na))/(calc_V_i*F));
 rDY[17] = (((2.000000000000000e+00*calc_i_NaK)-(calc_i_K1+calc_i_to+calc_i_Kur+calc_i_Kr+calc_i_Ks+calc_i_B_K))/(calc_V_i*F));
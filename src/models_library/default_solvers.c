@@ -6,36 +6,72 @@ GET_CELL_MODEL_DATA(init_cell_model_data) {
     cell_model->number_of_ode_equations = NEQ;
 }
 
+// The [ode_solver] option method selects the CPU integrator: euler (default) or rosenbrock
+static bool ode_method_is_rosenbrock(struct string_hash_entry *ode_extra_config) {
+
+    static bool logged = false;
+    char *method = get_string_parameter(ode_extra_config, "method");
+
+    if(!method || STRINGS_EQUAL(method, "euler")) {
+        return false;
+    }
+
+    bool rosenbrock = STRINGS_EQUAL(method, "rosenbrock");
+
+    if(!logged) {
+        if(rosenbrock) {
+            log_info("Using the Rosenbrock method to solve the ODEs on the CPU\n");
+        } else {
+            log_warn("Invalid ODE method %s. Valid methods are euler and rosenbrock. Using euler!\n", method);
+        }
+        logged = true;
+    }
+
+    return rosenbrock;
+}
+
 SOLVE_MODEL_ODES(solve_model_odes_cpu) {
 
     uint32_t sv_id;
 
-    size_t num_cells_to_solve = ode_solver->num_cells_to_solve;
     uint32_t * cells_to_solve = ode_solver->cells_to_solve;
     real *sv = ode_solver->sv;
     real dt = ode_solver->min_dt;
     uint32_t num_steps = ode_solver->num_steps;
 
     bool adpt = ode_solver->adaptive;
+    bool rosenbrock = ode_method_is_rosenbrock(ode_extra_config);
 
-#pragma omp parallel for private(sv_id)
-    for (u_int32_t i = 0; i < num_cells_to_solve; i++) {
+    uint32_t partition[MAX_ODE_PARTITIONS + 1];
+    uint32_t num_parts = partition_cells_to_solve(ode_solver, dt, partition);
 
-        if(cells_to_solve)
-            sv_id = cells_to_solve[i];
-        else
-            sv_id = i;
+    #pragma omp parallel for private(sv_id) schedule(dynamic, 1)
+    for(uint32_t p = 0; p < num_parts; p++) {
+        for (u_int32_t i = partition[p]; i < partition[p + 1]; i++) {
 
-        if(adpt) {
-            solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], current_t + dt, sv_id, ode_solver);
-        }
-        else {
-            for (int j = 0; j < num_steps; ++j) {
-                solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i]);
+            if(cells_to_solve)
+                sv_id = cells_to_solve[i];
+            else
+                sv_id = i;
+
+            if(rosenbrock) {
+                if(adpt) {
+                    solve_rosenbrock_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], current_t + dt, sv_id, ode_solver);
+                } else {
+                    solve_rosenbrock_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], num_steps);
+                }
             }
+            else if(adpt) {
+                solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], current_t + dt, sv_id, ode_solver);
+            }
+            else {
+                for (int j = 0; j < num_steps; ++j) {
+                    solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i]);
+                }
 
-        }
+            }
 
+        }
     }
 }
 
@@ -57,17 +93,18 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
     const real _beta_safety_ = 0.8;
     int numEDO = NEQ;
 
-    real rDY[numEDO];
-
-    real _tolerances_[numEDO];
+    real _tolerances_[NEQ];
     real _aux_tol = 0.0;
     // initializes the variables
     solver->ode_previous_dt[sv_id] = solver->ode_dt[sv_id];
 
-    real edos_old_aux_[numEDO];
-    real edos_new_euler_[numEDO];
-    real *_k1__ = (real *)malloc(sizeof(real) * numEDO);
-    real *_k2__ = (real *)malloc(sizeof(real) * numEDO);
+    real edos_old_aux_[NEQ];
+    real edos_new_euler_[NEQ];
+    // _k1__ and _k2__ point to the rates at the start and at the end of the step
+    real _k1_rates__[NEQ];
+    real _k2_rates__[NEQ];
+    real *_k1__ = _k1_rates__;
+    real *_k2__ = _k2_rates__;
     real *_k_aux__;
 
     real *dt = &solver->ode_dt[sv_id];
@@ -78,13 +115,9 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
         *dt = final_time - *time_new;
     }
 
-    RHS_cpu(sv, rDY, stim_curr, *dt);
+    RHS_cpu(sv, _k1__, stim_curr, *dt);
     *time_new += *dt;
 
-    for(int i = 0; i < numEDO; i++) {
-        _k1__[i] = rDY[i];
-    }
-
     const real rel_tol = solver->rel_tol;
     const real abs_tol = solver->abs_tol;
 
@@ -105,13 +138,11 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
         }
 
         *time_new += *dt;
-        RHS_cpu(sv, rDY, stim_curr, *dt);
+        RHS_cpu(sv, _k2__, stim_curr, *dt);
         *time_new -= *dt; // step back
 
         double greatestError = 0.0, auxError = 0.0;
         for(int i = 0; i < numEDO; i++) {
-            // stores the new evaluation
-            _k2__[i] = rDY[i];
             _aux_tol = fabs(edos_new_euler_[i]) * rel_tol;
             _tolerances_[i] = (abs_tol > _aux_tol) ? abs_tol : _aux_tol;
             // finds the greatest error between  the steps
@@ -170,8 +201,312 @@ void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int
             }
         }
     }
+}
+
+// Rosenbrock-W method of order 2 with an embedded order 3 error estimate (Shampine and Reichelt, The MATLAB ODE Suite,
+// 1997), L-stable, so stiff models can be integrated with steps limited only by the accuracy. The stimulus is constant
+// during each call, so the system is autonomous. Being a W-method, the order does not depend on the matrix used in
+// W = I - h * d * J, which is a finite difference approximation of the Jacobian of RHS_cpu. All the work arrays are in
+// the stack.
+#define ROSENBROCK_D (1.0 / (2.0 + M_SQRT2))
+#define ROSENBROCK_E32 (6.0 + M_SQRT2)
+#define ROSENBROCK_MAX_EXPLICIT_STEPS 4
+#define ROSENBROCK_KEEP_STEP 1.2
+
+static void rosenbrock_jacobian(const real *sv, const real *f0, real stim_current, real dt, real *jacobian) {
+
+    const real sqrt_eps = sqrt(REAL_EPS);
+
+    real y[NEQ], f[NEQ];
+
+    for(int i = 0; i < NEQ; i++) {
+        y[i] = sv[i];
+    }
+
+    // jacobian[i * NEQ + j] = dfi/dyj
+    for(int j = 0; j < NEQ; j++) {
+        real delta = sqrt_eps * fmax(fabs(sv[j]), 1e-5);
+        y[j] = sv[j] + delta;
+        delta = y[j] - sv[j];
+
+        RHS_cpu(y, f, stim_current, dt);
+
+        for(int i = 0; i < NEQ; i++) {
+            jacobian[i * NEQ + j] = (f[i] - f0[i]) / delta;
+        }
+
+        y[j] = sv[j];
+    }
+}
+
+// LU factorization with partial pivoting of W = I - h * d * J. Returns false if W is singular.
+static bool rosenbrock_factor(const real *jacobian, real h, real *w, int *pivot) {
+
+    const real hd = h * ROSENBROCK_D;
+
+    for(int i = 0; i < NEQ * NEQ; i++) {
+        w[i] = -hd * jacobian[i];
+    }
+
+    for(int i = 0; i < NEQ; i++) {
+        w[i * NEQ + i] += 1.0;
+    }
+
+    for(int k = 0; k < NEQ; k++) {
+
+        int p = k;
+        real max = fabs(w[k * NEQ + k]);
+
+        for(int i = k + 1; i < NEQ; i++) {
+            if(fabs(w[i * NEQ + k]) > max) {
+                max = fabs(w[i * NEQ + k]);
+                p = i;
+            }
+        }
+
+        if(max == 0.0) {
+            return false;
+        }
+
+        pivot[k] = p;
+
+        if(p != k) {
+            for(int j = 0; j < NEQ; j++) {
+                real aux = w[k * NEQ + j];
+                w[k * NEQ + j] = w[p * NEQ + j];
+                w[p * NEQ + j] = aux;
+            }
+        }
+
+        const real inv_pivot = 1.0 / w[k * NEQ + k];
+
+        for(int i = k + 1; i < NEQ; i++) {
+            real l = w[i * NEQ + k] * inv_pivot;
+            w[i * NEQ + k] = l;
+
+            if(l != 0.0) {
+                for(int j = k + 1; j < NEQ; j++) {
+                    w[i * NEQ + j] -= l * w[k * NEQ + j];
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// Solves W x = b in place. Without a Jacobian (w == NULL) W is the identity.
+static void rosenbrock_solve(const real *w, const int *pivot, real *b) {
+
+    if(!w) {
+        return;
+    }
+
+    for(int k = 0; k < NEQ; k++) {
+        int p = pivot[k];
+        if(p != k) {
+            real aux = b[k];
+            b[k] = b[p];
+            b[p] = aux;
+        }
+
+        for(int i = k + 1; i < NEQ; i++) {
+            b[i] -= w[i * NEQ + k] * b[k];
+        }
+    }
+
+    for(int i = NEQ - 1; i >= 0; i--) {
+        real sum = b[i];
+        for(int j = i + 1; j < NEQ; j++) {
+            sum -= w[i * NEQ + j] * b[j];
+        }
+        b[i] = sum / w[i * NEQ + i];
+    }
+}
+
+// One step of size h from sv (f0 = RHS(sv)). Returns the new state in y_new, RHS(y_new) in f_new and, if error is not
+// NULL, the local error estimate.
+static void rosenbrock_step(const real *sv, const real *f0, const real *w, const int *pivot, real h, real stim_current, real dt, real *y_new,
+                            real *f_new, real *error) {
+
+    real k1[NEQ], k2[NEQ], k3[NEQ], y[NEQ], f1[NEQ];
+
+    for(int i = 0; i < NEQ; i++) {
+        k1[i] = f0[i];
+    }
+    rosenbrock_solve(w, pivot, k1);
+
+    for(int i = 0; i < NEQ; i++) {
+        y[i] = sv[i] + 0.5 * h * k1[i];
+    }
+    RHS_cpu(y, f1, stim_current, dt);
+
+    for(int i = 0; i < NEQ; i++) {
+        k2[i] = f1[i] - k1[i];
+    }
+    rosenbrock_solve(w, pivot, k2);
+
+    for(int i = 0; i < NEQ; i++) {
+        k2[i] += k1[i];
+        y_new[i] = sv[i] + h * k2[i];
+    }
+    RHS_cpu(y_new, f_new, stim_current, dt);
+
+    if(!error) {
+        return;
+    }
+
+    for(int i = 0; i < NEQ; i++) {
+        k3[i] = f_new[i] - ROSENBROCK_E32 * (k2[i] - f1[i]) - 2.0 * (k1[i] - f0[i]);
+    }
+    rosenbrock_solve(w, pivot, k3);
+
+    for(int i = 0; i < NEQ; i++) {
+        error[i] = (h / 6.0) * (k1[i] - 2.0 * k2[i] + k3[i]);
+    }
+}
+
+// Fixed steps of size dt. W is factored once for all the steps of the call.
+void solve_rosenbrock_cpu(real dt, real *sv, real stim_current, uint32_t num_steps) {
+
+    real f0[NEQ], y_new[NEQ];
+    real jacobian[NEQ * NEQ], w[NEQ * NEQ];
+    int pivot[NEQ];
+
+    RHS_cpu(sv, f0, stim_current, dt);
+    rosenbrock_jacobian(sv, f0, stim_current, dt, jacobian);
+
+    if(!rosenbrock_factor(jacobian, dt, w, pivot)) {
+        for(uint32_t j = 0; j < num_steps; ++j) {
+            solve_model_ode_cpu(dt, sv, stim_current);
+        }
+        return;
+    }
 
-    free(_k1__);
-    free(_k2__);
+    for(uint32_t j = 0; j < num_steps; ++j) {
+        rosenbrock_step(sv, f0, w, pivot, dt, stim_current, dt, y_new, f0, NULL);
+
+        for(int i = 0; i < NEQ; i++) {
+            sv[i] = y_new[i];
+        }
+    }
 }
 
+// Error controlled steps from ode_time_new[sv_id] to final_time, starting with the step size of the last call (ode_dt).
+// Each call starts with J = 0 (an explicit step, as cheap as the adaptive Euler for the cells at rest) and the Jacobian is
+// only computed, once per call, after a rejected step (an explicit step at min_dt is never accepted without it). W is only factored again when the step size changes.
+// RHS(y_new) of an accepted step is the f0 of the next one.
+void solve_rosenbrock_cpu_adpt(real *sv, real stim_curr, real final_time, int sv_id, struct ode_solver *solver) {
+
+    real f0[NEQ], f_new[NEQ], y_new[NEQ], error[NEQ];
+    real jacobian[NEQ * NEQ], w[NEQ * NEQ];
+    int pivot[NEQ];
+
+    const real rel_tol = solver->rel_tol;
+    const real abs_tol = solver->abs_tol;
+    const real min_dt = solver->min_dt;
+    const real max_dt = solver->max_dt;
+
+    real *dt = &solver->ode_dt[sv_id];
+    real *time_new = &solver->ode_time_new[sv_id];
+    real *previous_dt = &solver->ode_previous_dt[sv_id];
+
+    real t = *time_new;
+    real h = *dt;
+
+    bool has_jacobian = false;
+    bool use_jacobian = true;
+    int explicit_steps = 0;
+    bool factored = false;
+    real factored_step = 0.0;
+
+    RHS_cpu(sv, f0, stim_curr, h);
+
+    while(final_time - t > 0.0) {
+
+        bool last = (t + h >= final_time);
+        real step = last ? final_time - t : h;
+
+        bool singular = false;
+
+        if(has_jacobian && (!factored || step != factored_step)) {
+            factored = rosenbrock_factor(jacobian, step, w, pivot);
+            factored_step = step;
+            singular = !factored;
+        }
+
+        double greatest_error = REAL_MAX;
+
+        if(!singular) {
+            rosenbrock_step(sv, f0, has_jacobian ? w : NULL, pivot, step, stim_curr, step, y_new, f_new, error);
+
+            greatest_error = 0.0;
+            for(int i = 0; i < NEQ; i++) {
+                real tol = fmax(abs_tol, rel_tol * fmax(fabs(sv[i]), fabs(y_new[i])));
+                double aux = fabs(error[i]) / tol;
+                greatest_error = (aux > greatest_error) ? aux : greatest_error;
+            }
+
+            if(isnan(greatest_error)) {
+                greatest_error = REAL_MAX;
+            }
+        }
+
+        // At min_dt a step is accepted regardless of the error estimate, but only once the Jacobian is in use (or W was
+        // found singular). An explicit step at min_dt can still be unstable, so it is rejected to form the Jacobian.
+        bool force_accept = step <= min_dt && !singular && (has_jacobian || !use_jacobian);
+
+        if(greatest_error <= 1.0 || force_accept) {
+
+            for(int i = 0; i < NEQ; i++) {
+                sv[i] = y_new[i];
+                f0[i] = f_new[i];
+            }
+
+            t = last ? final_time : t + step;
+            *previous_dt = step;
+
+            // A last step shortened to reach final_time does not reduce the step size of the next call. Small increases
+            // are not taken, so the factorization of W can be reused.
+            double factor = 0.8 * pow(greatest_error + REAL_EPS, -1.0 / 3.0);
+            real h_new = step * fmin(5.0, fmax(0.2, factor));
+
+            if(last && step < h) {
+                h = fmax(h, h_new);
+            } else if(!(has_jacobian && h_new > h && h_new < ROSENBROCK_KEEP_STEP * h)) {
+                h = h_new;
+            }
+
+            // Many explicit steps mean the step size is limited by the stability, not by the accuracy
+            if(!has_jacobian && use_jacobian && ++explicit_steps >= ROSENBROCK_MAX_EXPLICIT_STEPS) {
+                rosenbrock_jacobian(sv, f0, stim_curr, h, jacobian);
+                has_jacobian = true;
+                factored = false;
+            }
+
+        } else {
+
+            // If W is singular the rest of the call uses explicit steps
+            if(singular) {
+                has_jacobian = false;
+                use_jacobian = false;
+            } else if(!has_jacobian && use_jacobian) {
+                rosenbrock_jacobian(sv, f0, stim_curr, step, jacobian);
+                has_jacobian = true;
+                factored = false;
+            }
+
+            double factor = singular ? 0.5 : 0.8 * pow(greatest_error, -1.0 / 3.0);
+            h = step * fmax(0.1, fmin(0.5, factor));
+        }
+
+        if(h < min_dt) {
+            h = min_dt;
+        } else if(h > max_dt) {
+            h = max_dt;
+        }
+    }
+
+    *dt = h;
+    *time_new = final_time;
+}
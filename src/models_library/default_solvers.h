@@ -19,3 +19,6 @@ void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt);
 inline void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int thread_id, struct ode_solver *solver);
 
 void solve_model_ode_cpu(real dt, real *sv, real stim_current);
+
+void solve_rosenbrock_cpu(real dt, real *sv, real stim_current, uint32_t num_steps);
+void solve_rosenbrock_cpu_adpt(real *sv, real stim_curr, real final_time, int sv_id, struct ode_solver *solver);
@@ -0,0 +1,169 @@
+//
+// Voltage lookup tables for the gating kinetics of the Rush-Larsen CPU models.
+//
+
+#include "lookup_table.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Jumps smaller than this are treated as part of the regular interpolation error
+#define LOOKUP_TABLE_MIN_DISCONTINUITY 1e-6
+
+struct lookup_table *new_lookup_table(real v_min, real v_max, real dv, real dt, uint32_t num_columns, lookup_table_row_fn *fill_row,
+                                      const void *data) {
+
+    if(v_max <= v_min || dv <= 0.0 || num_columns == 0) {
+        return NULL;
+    }
+
+    uint32_t num_rows = (uint32_t)ceil((v_max - v_min) / dv) + 1;
+    size_t num_values = (size_t)num_rows * num_columns;
+
+    struct lookup_table *table = (struct lookup_table *)malloc(sizeof(struct lookup_table) + num_values * sizeof(real));
+
+    if(!table) {
+        return NULL;
+    }
+
+    table->v_min = v_min;
+    table->dv = dv;
+    table->inv_dv = 1.0 / dv;
+    table->v_max = v_min + (num_rows - 1) * dv;
+    table->dt = dt;
+    table->num_rows = num_rows;
+    table->num_columns = num_columns;
+    table->values = (real *)(table + 1);
+
+    OMP(parallel for)
+    for(uint32_t i = 0; i < num_rows; i++) {
+        fill_row(v_min + i * dv, dt, data, table->values + (size_t)i * num_columns);
+    }
+
+    return table;
+}
+
+// Compares the interpolated values with the analytic ones inside each interval of the table and returns the maximum
+// absolute error over all columns. The piecewise kinetics of some gates (e.g. h and j for v < -40 mV) are not continuous.
+// Across such a jump the linear error is not symmetric inside the interval (or changes sign), so these intervals are
+// not considered in the error and are only counted in num_discontinuities.
+real lookup_table_max_error(const struct lookup_table *table, lookup_table_row_fn *fill_row, const void *data, uint32_t *num_discontinuities) {
+
+    const uint32_t nc = table->num_columns;
+    real max_error = 0.0;
+    uint32_t discontinuities = 0;
+
+    OMP(parallel for reduction(max: max_error) reduction(+: discontinuities))
+    for(uint32_t i = 0; i < table->num_rows - 1; i++) {
+
+        real analytic[3][nc];
+        real interpolated[3][nc];
+
+        for(int k = 0; k < 3; k++) {
+            real v = table->v_min + (i + 0.25 * (k + 1)) * table->dv;
+            fill_row(v, table->dt, data, analytic[k]);
+            lookup_table_interpolate(table, v, interpolated[k]);
+        }
+
+        bool discontinuous = false;
+        real interval_error = 0.0;
+
+        for(uint32_t j = 0; j < nc; j++) {
+            real e_first = analytic[0][j] - interpolated[0][j];
+            real e_mid = fabs(analytic[1][j] - interpolated[1][j]);
+            real e_last = analytic[2][j] - interpolated[2][j];
+
+            real e_max = fmax(e_mid, fmax(fabs(e_first), fabs(e_last)));
+
+            if(fabs(e_first - e_last) > 0.5 * fmax(fabs(e_first), fabs(e_last)) && e_max > LOOKUP_TABLE_MIN_DISCONTINUITY) {
+                discontinuous = true;
+                continue;
+            }
+
+            interval_error = fmax(interval_error, e_max);
+        }
+
+        if(discontinuous) {
+            discontinuities++;
+        }
+
+        if(interval_error > max_error) {
+            max_error = interval_error;
+        }
+    }
+
+    if(num_discontinuities) {
+        *num_discontinuities = discontinuities;
+    }
+
+    return max_error;
+}
+
+static real get_lookup_table_parameter(struct string_hash_entry *ode_extra_config, const char *parameter, real default_value) {
+
+    char *value = get_string_parameter(ode_extra_config, parameter);
+
+    if(value) {
+        int expr_parse_error;
+        real result = (real)te_interp(value, &expr_parse_error);
+        if(expr_parse_error == 0) {
+            return result;
+        }
+        log_warn("Error parsing %s = %s. Using the default value %lf\n", parameter, value, default_value);
+    }
+
+    return default_value;
+}
+
+bool lookup_table_enabled(struct string_hash_entry *ode_extra_config, bool adaptive) {
+
+    char *value = get_string_parameter(ode_extra_config, "use_lookup_tables");
+
+    if(!value || !IS_TRUE(value)) {
+        return false;
+    }
+
+    if(adaptive) {
+        log_warn("Lookup tables are only available with a fixed ODE time step. Using the analytic gating kinetics!\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Builds the table using the [ode_solver] options lookup_table_v_min, lookup_table_v_max, lookup_table_dv and
+// checks it against the analytic path. The table is discarded if the error is greater than lookup_table_tolerance.
+struct lookup_table *new_lookup_table_from_config(struct string_hash_entry *ode_extra_config, real dt, uint32_t num_columns,
+                                                  lookup_table_row_fn *fill_row, const void *data, const char *model_name) {
+
+    real v_min = get_lookup_table_parameter(ode_extra_config, "lookup_table_v_min", LOOKUP_TABLE_DEFAULT_V_MIN);
+    real v_max = get_lookup_table_parameter(ode_extra_config, "lookup_table_v_max", LOOKUP_TABLE_DEFAULT_V_MAX);
+    real dv = get_lookup_table_parameter(ode_extra_config, "lookup_table_dv", LOOKUP_TABLE_DEFAULT_DV);
+    real tolerance = get_lookup_table_parameter(ode_extra_config, "lookup_table_tolerance", LOOKUP_TABLE_DEFAULT_TOLERANCE);
+
+    struct lookup_table *table = new_lookup_table(v_min, v_max, dv, dt, num_columns, fill_row, data);
+
+    if(!table) {
+        log_warn("Invalid lookup table range for the %s model (v_min = %lf, v_max = %lf, dv = %lf). Using the analytic gating kinetics!\n", model_name,
+                 v_min, v_max, dv);
+        return NULL;
+    }
+
+    uint32_t num_discontinuities = 0;
+    real error = lookup_table_max_error(table, fill_row, data, &num_discontinuities);
+
+    if(error > tolerance) {
+        log_warn("The %s lookup table error (%e) is greater than the tolerance (%e). Using the analytic gating kinetics!\n", model_name, error, tolerance);
+        free(table);
+        return NULL;
+    }
+
+    log_info("Using lookup tables for the %s gating kinetics: Vm in [%lf, %lf], dV = %lf, %u rows x %u columns, max error %e\n", model_name,
+             table->v_min, table->v_max, dv, table->num_rows, num_columns, error);
+
+    if(num_discontinuities) {
+        log_info("%u lookup table interval(s) contain a discontinuity of the analytic kinetics\n", num_discontinuities);
+    }
+
+    return table;
+}
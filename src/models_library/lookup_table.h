@@ -0,0 +1,67 @@
+//
+// Voltage lookup tables for the gating kinetics of the Rush-Larsen CPU models.
+//
+
+#ifndef MONOALG3D_C_LOOKUP_TABLE_H
+#define MONOALG3D_C_LOOKUP_TABLE_H
+
+#include "model_common.h"
+
+#define LOOKUP_TABLE_DEFAULT_V_MIN (-100.0)
+#define LOOKUP_TABLE_DEFAULT_V_MAX (100.0)
+#define LOOKUP_TABLE_DEFAULT_DV (0.01)
+#define LOOKUP_TABLE_DEFAULT_TOLERANCE (1e-3)
+
+// Fills one row of the table: all the quantities that depend only on v (and dt)
+#define LOOKUP_TABLE_ROW(name) void name(real v, real dt, const void *data, real *row)
+typedef LOOKUP_TABLE_ROW(lookup_table_row_fn);
+
+// The table and its values are allocated as a single block, so it can be released with free()
+struct lookup_table {
+    real v_min;
+    real v_max;
+    real dv;
+    real inv_dv;
+    real dt;
+    uint32_t num_rows;
+    uint32_t num_columns;
+    real *values;
+};
+
+struct lookup_table *new_lookup_table(real v_min, real v_max, real dv, real dt, uint32_t num_columns, lookup_table_row_fn *fill_row,
+                                      const void *data);
+
+real lookup_table_max_error(const struct lookup_table *table, lookup_table_row_fn *fill_row, const void *data, uint32_t *num_discontinuities);
+
+struct lookup_table *new_lookup_table_from_config(struct string_hash_entry *ode_extra_config, real dt, uint32_t num_columns,
+                                                  lookup_table_row_fn *fill_row, const void *data, const char *model_name);
+
+bool lookup_table_enabled(struct string_hash_entry *ode_extra_config, bool adaptive);
+
+// Linear interpolation of all columns of the table at v. Values outside the table range are clamped to the borders.
+static inline void lookup_table_interpolate(const struct lookup_table *table, real v, real *out) {
+
+    real pos = (v - table->v_min) * table->inv_dv;
+
+    if(pos < 0.0) {
+        pos = 0.0;
+    } else if(pos > (real)(table->num_rows - 1)) {
+        pos = (real)(table->num_rows - 1);
+    }
+
+    uint32_t row = (uint32_t)pos;
+    if(row == table->num_rows - 1) {
+        row--;
+    }
+
+    const real w = pos - (real)row;
+    const uint32_t nc = table->num_columns;
+    const real *lower = table->values + (size_t)row * nc;
+    const real *upper = lower + nc;
+
+    for(uint32_t i = 0; i < nc; i++) {
+        out[i] = lower[i] + w * (upper[i] - lower[i]);
+    }
+}
+
+#endif // MONOALG3D_C_LOOKUP_TABLE_H
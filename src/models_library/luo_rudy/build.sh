@@ -4,4 +4,11 @@ MODEL_FILE_GPU="luo_rudy_1991.cu"
 COMMON_HEADERS="luo_rudy_1991.h"
 
 COMPILE_MODEL_LIB "luo_rudy_1991" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS"
-##########################################################
\ No newline at end of file
+##########################################################
+############### LUO RUDY 1991 (GENERATED) ##############################
+MODEL_FILE_CPU="luo_rudy_1991_generated.c"
+MODEL_FILE_GPU="luo_rudy_1991_generated.cu"
+COMMON_HEADERS="luo_rudy_1991_generated.h"
+
+COMPILE_MODEL_LIB "luo_rudy_1991_generated" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS"
+##########################################################
@@ -0,0 +1,411 @@
+// Generated by scripts/cell_model_generator/generate_cell_model.py from luo_rudy_1991_generated.model. Do not edit.
+// Luo-Rudy 1991
+
+#include "luo_rudy_1991_generated.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// exp that never overflows to inf (so the code is also valid with -ffast-math). The results are the same for the
+// arguments where exp is finite
+static inline real safe_exp(real x) {
+    const real max_x = (sizeof(real) == sizeof(float)) ? (real)88.0 : (real)709.0;
+    return exp(x > max_x ? max_x : x);
+}
+
+GET_CELL_MODEL_DATA(init_cell_model_data) {
+
+    if(get_initial_v)
+        cell_model->initial_v = INITIAL_V;
+    if(get_neq)
+        cell_model->number_of_ode_equations = NEQ;
+}
+
+SET_ODE_INITIAL_CONDITIONS_CPU(set_model_initial_conditions_cpu) {
+
+    log_info("Using Luo-Rudy 1991 CPU model (generated)\n");
+
+    uint32_t num_cells = solver->original_num_cells;
+    solver->sv = (real *)malloc(NEQ * num_cells * sizeof(real));
+
+    bool adpt = solver->adaptive;
+
+    if(adpt) {
+        solver->ode_dt = (real *)malloc(num_cells * sizeof(real));
+
+        OMP(parallel for)
+        for(uint32_t i = 0; i < num_cells; i++) {
+            solver->ode_dt[i] = solver->min_dt;
+        }
+
+        solver->ode_previous_dt = (real *)calloc(num_cells, sizeof(real));
+        solver->ode_time_new = (real *)calloc(num_cells, sizeof(real));
+        log_info("Using Adaptive Euler model to solve the ODEs\n");
+    }
+
+    OMP(parallel for)
+    for(uint32_t i = 0; i < num_cells; i++) {
+
+        real *sv = &solver->sv[i * NEQ];
+
+        sv[0] = -84.380111; // V millivolt
+        sv[1] = 0.001713; // m dimensionless
+        sv[2] = 0.982661; // h dimensionless
+        sv[3] = 0.989108; // j dimensionless
+        sv[4] = 0.003021; // d dimensionless
+        sv[5] = 0.999968; // f dimensionless
+        sv[6] = 0.041760; // X dimensionless
+        sv[7] = 0.000179; // Cai millimolar
+    }
+}
+
+// The [ode_solver] option method selects the fixed step method: euler (default) or rush_larsen
+static bool ode_method_is_rush_larsen(struct string_hash_entry *ode_extra_config) {
+
+    static bool logged = false;
+    char *method = get_string_parameter(ode_extra_config, "method");
+
+    if(!method || STRINGS_EQUAL(method, "euler")) {
+        return false;
+    }
+
+    bool rush_larsen = STRINGS_EQUAL(method, "rush_larsen");
+
+    if(!logged) {
+        if(rush_larsen) {
+            log_info("Using the Rush-Larsen method to solve the ODEs on the CPU\n");
+        } else {
+            log_warn("Invalid ODE method %s. Valid methods are euler and rush_larsen. Using euler!\n", method);
+        }
+        logged = true;
+    }
+
+    return rush_larsen;
+}
+
+void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt) {
+
+    // State variables
+    const real V = sv[0];
+    const real m = sv[1];
+    const real h = sv[2];
+    const real j = sv[3];
+    const real d = sv[4];
+    const real f = sv[5];
+    const real X = sv[6];
+    const real Cai = sv[7];
+
+    // Parameters
+    const real g_Na = 23.0;
+    const real g_Kp = 0.0183;
+    const real g_b = 0.03921;
+    const real E_b = -59.87;
+
+    // Algebraic variables
+    const real _cse_0 = V + 47.13;
+    const real alpha_m = (0.32 * _cse_0) / (1.0 - safe_exp((-0.1) * _cse_0));
+    const real beta_m = 0.08 * safe_exp((-V) / 11.0);
+    const bool _cse_1 = V < (-40.0);
+    const real alpha_h = _cse_1 ? (0.135 * safe_exp((80.0 + V) / (-6.8))) : 0.0;
+    const real beta_h = _cse_1 ? ((3.56 * safe_exp(0.079 * V)) + (310000.0 * safe_exp(0.35 * V))) : (1.0 / (0.13 * (1.0 + safe_exp((V + 10.66) / (-11.1)))));
+    const real alpha_j = _cse_1 ? (((((-127140.0) * safe_exp(0.2444 * V)) - (3.474e-05 * safe_exp((-0.04391) * V))) * (V + 37.78)) / (1.0 + safe_exp(0.311 * (V + 79.23)))) : 0.0;
+    const real beta_j = _cse_1 ? ((0.1212 * safe_exp((-0.01052) * V)) / (1.0 + safe_exp((-0.1378) * (V + 40.14)))) : ((0.3 * safe_exp((-2.535e-07) * V)) / (1.0 + safe_exp((-0.1) * (V + 32.0))));
+    const real E_Na = 54.79446393509185;
+    const real i_Na = (((g_Na * ((m * m) * m)) * h) * j) * (V - E_Na);
+    const real _cse_2 = V - 5.0;
+    const real alpha_d = (0.095 * safe_exp((-0.01) * _cse_2)) / (1.0 + safe_exp((-0.072) * _cse_2));
+    const real _cse_3 = V + 44.0;
+    const real beta_d = (0.07 * safe_exp((-0.017) * _cse_3)) / (1.0 + safe_exp(0.05 * _cse_3));
+    const real _cse_4 = V + 28.0;
+    const real alpha_f = (0.012 * safe_exp((-0.008) * _cse_4)) / (1.0 + safe_exp(0.15 * _cse_4));
+    const real _cse_5 = V + 30.0;
+    const real beta_f = (0.0065 * safe_exp((-0.02) * _cse_5)) / (1.0 + safe_exp((-0.2) * _cse_5));
+    const real E_si = 7.7 - (13.0287 * log(Cai));
+    const real i_si = ((0.09 * d) * f) * (V - E_si);
+    const real _cse_6 = V + 50.0;
+    const real alpha_X = (0.0005 * safe_exp(0.083 * _cse_6)) / (1.0 + safe_exp(0.057 * _cse_6));
+    const real _cse_7 = V + 20.0;
+    const real beta_X = (0.0013 * safe_exp((-0.06) * _cse_7)) / (1.0 + safe_exp((-0.04) * _cse_7));
+    const real E_K = -77.56758438531939;
+    const real _cse_8 = V + 77.0;
+    const real Xi = (V > (-100.0)) ? ((2.837 * (safe_exp(0.04 * _cse_8) - 1.0)) / (_cse_8 * safe_exp(0.04 * (V + 35.0)))) : 1.0;
+    const real g_K = 0.282;
+    const real i_K = ((g_K * X) * Xi) * (V - E_K);
+    const real E_K1 = -87.8929017138025;
+    const real _cse_9 = V - E_K1;
+    const real alpha_K1 = 1.02 / (1.0 + safe_exp(0.2385 * (_cse_9 - 59.215)));
+    const real beta_K1 = ((0.49124 * safe_exp(0.08032 * ((V + 5.476) - E_K1))) + safe_exp(0.06175 * (V - (E_K1 + 594.31)))) / (1.0 + safe_exp((-0.5143) * (_cse_9 + 4.753)));
+    const real K1_infinity = alpha_K1 / (alpha_K1 + beta_K1);
+    const real g_K1 = 0.6047;
+    const real i_K1 = (g_K1 * K1_infinity) * _cse_9;
+    const real Kp = 1.0 / (1.0 + safe_exp((7.488 - V) / 5.98));
+    const real i_Kp = (g_Kp * Kp) * _cse_9;
+    const real i_b = g_b * (V - E_b);
+
+    // Rates
+    rDY_[0] = -((((((stim_current + i_Na) + i_si) + i_K) + i_K1) + i_Kp) + i_b);
+    rDY_[1] = (alpha_m * (1.0 - m)) - (beta_m * m);
+    rDY_[2] = (alpha_h * (1.0 - h)) - (beta_h * h);
+    rDY_[3] = (alpha_j * (1.0 - j)) - (beta_j * j);
+    rDY_[4] = (alpha_d * (1.0 - d)) - (beta_d * d);
+    rDY_[5] = (alpha_f * (1.0 - f)) - (beta_f * f);
+    rDY_[6] = (alpha_X * (1.0 - X)) - (beta_X * X);
+    rDY_[7] = ((-0.0001) * i_si) + (0.07 * (0.0001 - Cai));
+}
+
+// Advances the n cells of a batch num_steps steps of dt. sv has the NEQ states of the batch, GENERATED_BATCH_SIZE
+// values for each state
+static void solve_batch_cpu(real dt, real *sv, const real *stim_currents, uint32_t n, uint32_t num_steps, bool rush_larsen) {
+
+    for(uint32_t step = 0; step < num_steps; step++) {
+
+        OMP(simd)
+        for(uint32_t l = 0; l < n; l++) {
+
+            // State variables
+            const real V = sv[0 * GENERATED_BATCH_SIZE + l];
+            const real m = sv[1 * GENERATED_BATCH_SIZE + l];
+            const real h = sv[2 * GENERATED_BATCH_SIZE + l];
+            const real j = sv[3 * GENERATED_BATCH_SIZE + l];
+            const real d = sv[4 * GENERATED_BATCH_SIZE + l];
+            const real f = sv[5 * GENERATED_BATCH_SIZE + l];
+            const real X = sv[6 * GENERATED_BATCH_SIZE + l];
+            const real Cai = sv[7 * GENERATED_BATCH_SIZE + l];
+            const real stim_current = stim_currents[l];
+
+            // Parameters
+            const real g_Na = 23.0;
+            const real g_Kp = 0.0183;
+            const real g_b = 0.03921;
+            const real E_b = -59.87;
+
+            // Algebraic variables
+            const real _cse_0 = V + 47.13;
+            const real alpha_m = (0.32 * _cse_0) / (1.0 - safe_exp((-0.1) * _cse_0));
+            const real beta_m = 0.08 * safe_exp((-V) / 11.0);
+            const bool _cse_1 = V < (-40.0);
+            const real alpha_h = _cse_1 ? (0.135 * safe_exp((80.0 + V) / (-6.8))) : 0.0;
+            const real beta_h = _cse_1 ? ((3.56 * safe_exp(0.079 * V)) + (310000.0 * safe_exp(0.35 * V))) : (1.0 / (0.13 * (1.0 + safe_exp((V + 10.66) / (-11.1)))));
+            const real alpha_j = _cse_1 ? (((((-127140.0) * safe_exp(0.2444 * V)) - (3.474e-05 * safe_exp((-0.04391) * V))) * (V + 37.78)) / (1.0 + safe_exp(0.311 * (V + 79.23)))) : 0.0;
+            const real beta_j = _cse_1 ? ((0.1212 * safe_exp((-0.01052) * V)) / (1.0 + safe_exp((-0.1378) * (V + 40.14)))) : ((0.3 * safe_exp((-2.535e-07) * V)) / (1.0 + safe_exp((-0.1) * (V + 32.0))));
+            const real E_Na = 54.79446393509185;
+            const real i_Na = (((g_Na * ((m * m) * m)) * h) * j) * (V - E_Na);
+            const real _cse_2 = V - 5.0;
+            const real alpha_d = (0.095 * safe_exp((-0.01) * _cse_2)) / (1.0 + safe_exp((-0.072) * _cse_2));
+            const real _cse_3 = V + 44.0;
+            const real beta_d = (0.07 * safe_exp((-0.017) * _cse_3)) / (1.0 + safe_exp(0.05 * _cse_3));
+            const real _cse_4 = V + 28.0;
+            const real alpha_f = (0.012 * safe_exp((-0.008) * _cse_4)) / (1.0 + safe_exp(0.15 * _cse_4));
+            const real _cse_5 = V + 30.0;
+            const real beta_f = (0.0065 * safe_exp((-0.02) * _cse_5)) / (1.0 + safe_exp((-0.2) * _cse_5));
+            const real E_si = 7.7 - (13.0287 * log(Cai));
+            const real i_si = ((0.09 * d) * f) * (V - E_si);
+            const real _cse_6 = V + 50.0;
+            const real alpha_X = (0.0005 * safe_exp(0.083 * _cse_6)) / (1.0 + safe_exp(0.057 * _cse_6));
+            const real _cse_7 = V + 20.0;
+            const real beta_X = (0.0013 * safe_exp((-0.06) * _cse_7)) / (1.0 + safe_exp((-0.04) * _cse_7));
+            const real E_K = -77.56758438531939;
+            const real _cse_8 = V + 77.0;
+            const real Xi = (V > (-100.0)) ? ((2.837 * (safe_exp(0.04 * _cse_8) - 1.0)) / (_cse_8 * safe_exp(0.04 * (V + 35.0)))) : 1.0;
+            const real g_K = 0.282;
+            const real i_K = ((g_K * X) * Xi) * (V - E_K);
+            const real E_K1 = -87.8929017138025;
+            const real _cse_9 = V - E_K1;
+            const real alpha_K1 = 1.02 / (1.0 + safe_exp(0.2385 * (_cse_9 - 59.215)));
+            const real beta_K1 = ((0.49124 * safe_exp(0.08032 * ((V + 5.476) - E_K1))) + safe_exp(0.06175 * (V - (E_K1 + 594.31)))) / (1.0 + safe_exp((-0.5143) * (_cse_9 + 4.753)));
+            const real K1_infinity = alpha_K1 / (alpha_K1 + beta_K1);
+            const real g_K1 = 0.6047;
+            const real i_K1 = (g_K1 * K1_infinity) * _cse_9;
+            const real Kp = 1.0 / (1.0 + safe_exp((7.488 - V) / 5.98));
+            const real i_Kp = (g_Kp * Kp) * _cse_9;
+            const real i_b = g_b * (V - E_b);
+
+            if(rush_larsen) {
+                const real _cse_10 = alpha_m + beta_m;
+                const real _cse_11 = alpha_m / _cse_10;
+                const real _cse_12 = alpha_h + beta_h;
+                const real _cse_13 = alpha_h / _cse_12;
+                const real _cse_14 = alpha_j + beta_j;
+                const real _cse_15 = alpha_j / _cse_14;
+                const real _cse_16 = alpha_d + beta_d;
+                const real _cse_17 = alpha_d / _cse_16;
+                const real _cse_18 = alpha_f + beta_f;
+                const real _cse_19 = alpha_f / _cse_18;
+                const real _cse_20 = alpha_X + beta_X;
+                const real _cse_21 = alpha_X / _cse_20;
+                sv[0 * GENERATED_BATCH_SIZE + l] = dt * (-((((((stim_current + i_Na) + i_si) + i_K) + i_K1) + i_Kp) + i_b)) + V;
+                sv[1 * GENERATED_BATCH_SIZE + l] = _cse_11 + ((m - _cse_11) * safe_exp((-dt) * _cse_10));
+                sv[2 * GENERATED_BATCH_SIZE + l] = _cse_13 + ((h - _cse_13) * safe_exp((-dt) * _cse_12));
+                sv[3 * GENERATED_BATCH_SIZE + l] = _cse_15 + ((j - _cse_15) * safe_exp((-dt) * _cse_14));
+                sv[4 * GENERATED_BATCH_SIZE + l] = _cse_17 + ((d - _cse_17) * safe_exp((-dt) * _cse_16));
+                sv[5 * GENERATED_BATCH_SIZE + l] = _cse_19 + ((f - _cse_19) * safe_exp((-dt) * _cse_18));
+                sv[6 * GENERATED_BATCH_SIZE + l] = _cse_21 + ((X - _cse_21) * safe_exp((-dt) * _cse_20));
+                sv[7 * GENERATED_BATCH_SIZE + l] = dt * (((-0.0001) * i_si) + (0.07 * (0.0001 - Cai))) + Cai;
+            } else {
+                sv[0 * GENERATED_BATCH_SIZE + l] = dt * (-((((((stim_current + i_Na) + i_si) + i_K) + i_K1) + i_Kp) + i_b)) + V;
+                sv[1 * GENERATED_BATCH_SIZE + l] = dt * ((alpha_m * (1.0 - m)) - (beta_m * m)) + m;
+                sv[2 * GENERATED_BATCH_SIZE + l] = dt * ((alpha_h * (1.0 - h)) - (beta_h * h)) + h;
+                sv[3 * GENERATED_BATCH_SIZE + l] = dt * ((alpha_j * (1.0 - j)) - (beta_j * j)) + j;
+                sv[4 * GENERATED_BATCH_SIZE + l] = dt * ((alpha_d * (1.0 - d)) - (beta_d * d)) + d;
+                sv[5 * GENERATED_BATCH_SIZE + l] = dt * ((alpha_f * (1.0 - f)) - (beta_f * f)) + f;
+                sv[6 * GENERATED_BATCH_SIZE + l] = dt * ((alpha_X * (1.0 - X)) - (beta_X * X)) + X;
+                sv[7 * GENERATED_BATCH_SIZE + l] = dt * (((-0.0001) * i_si) + (0.07 * (0.0001 - Cai))) + Cai;
+            }
+        }
+    }
+}
+
+SOLVE_MODEL_ODES(solve_model_odes_cpu) {
+
+    uint32_t *cells_to_solve = ode_solver->cells_to_solve;
+    real *sv = ode_solver->sv;
+    real dt = ode_solver->min_dt;
+    uint32_t num_steps = ode_solver->num_steps;
+
+    bool adpt = ode_solver->adaptive;
+    bool rush_larsen = !adpt && ode_method_is_rush_larsen(ode_extra_config);
+
+    uint32_t partition[MAX_ODE_PARTITIONS + 1];
+    uint32_t num_parts = partition_cells_to_solve(ode_solver, dt, partition);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(uint32_t p = 0; p < num_parts; p++) {
+
+        if(adpt) {
+            for(uint32_t i = partition[p]; i < partition[p + 1]; i++) {
+                uint32_t sv_id = cells_to_solve ? cells_to_solve[i] : i;
+                solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], current_t + dt, sv_id, ode_solver);
+            }
+            continue;
+        }
+
+        real batch_sv[NEQ * GENERATED_BATCH_SIZE];
+        uint32_t batch_ids[GENERATED_BATCH_SIZE];
+
+        for(uint32_t first = partition[p]; first < partition[p + 1]; first += GENERATED_BATCH_SIZE) {
+
+            uint32_t n = partition[p + 1] - first;
+            if(n > GENERATED_BATCH_SIZE) {
+                n = GENERATED_BATCH_SIZE;
+            }
+
+            for(uint32_t l = 0; l < n; l++) {
+                batch_ids[l] = cells_to_solve ? cells_to_solve[first + l] : first + l;
+                for(uint32_t k = 0; k < NEQ; k++) {
+                    batch_sv[k * GENERATED_BATCH_SIZE + l] = sv[batch_ids[l] * NEQ + k];
+                }
+            }
+
+            solve_batch_cpu(dt, batch_sv, stim_currents + first, n, num_steps, rush_larsen);
+
+            for(uint32_t l = 0; l < n; l++) {
+                for(uint32_t k = 0; k < NEQ; k++) {
+                    sv[batch_ids[l] * NEQ + k] = batch_sv[k * GENERATED_BATCH_SIZE + l];
+                }
+            }
+        }
+    }
+}
+
+void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int sv_id, struct ode_solver *solver) {
+
+    const real _beta_safety_ = 0.8;
+
+    real rDY[NEQ];
+    real _tolerances_[NEQ];
+    real _aux_tol = 0.0;
+    real edos_old_aux_[NEQ];
+    real edos_new_euler_[NEQ];
+    real _k1__[NEQ];
+    real _k2__[NEQ];
+
+    // initializes the variables
+    solver->ode_previous_dt[sv_id] = solver->ode_dt[sv_id];
+
+    real *dt = &solver->ode_dt[sv_id];
+    real *time_new = &solver->ode_time_new[sv_id];
+    real *previous_dt = &solver->ode_previous_dt[sv_id];
+
+    if(*time_new + *dt > final_time) {
+        *dt = final_time - *time_new;
+    }
+
+    RHS_cpu(sv, rDY, stim_curr, *dt);
+    *time_new += *dt;
+
+    for(int i = 0; i < NEQ; i++) {
+        _k1__[i] = rDY[i];
+    }
+
+    const real rel_tol = solver->rel_tol;
+    const real abs_tol = solver->abs_tol;
+
+    const real __tiny_ = pow(abs_tol, 2.0);
+
+    real min_dt = solver->min_dt;
+    real max_dt = solver->max_dt;
+
+    while(1) {
+
+        for(int i = 0; i < NEQ; i++) {
+            edos_old_aux_[i] = sv[i];
+            edos_new_euler_[i] = _k1__[i] * *dt + edos_old_aux_[i];
+            sv[i] = edos_new_euler_[i];
+        }
+
+        *time_new += *dt;
+        RHS_cpu(sv, rDY, stim_curr, *dt);
+        *time_new -= *dt; // step back
+
+        double greatestError = 0.0, auxError = 0.0;
+        for(int i = 0; i < NEQ; i++) {
+            _k2__[i] = rDY[i];
+            _aux_tol = fabs(edos_new_euler_[i]) * rel_tol;
+            _tolerances_[i] = (abs_tol > _aux_tol) ? abs_tol : _aux_tol;
+            auxError = fabs(((*dt / 2.0) * (_k1__[i] - _k2__[i])) / _tolerances_[i]);
+            greatestError = (auxError > greatestError) ? auxError : greatestError;
+        }
+
+        greatestError += __tiny_;
+        *previous_dt = *dt;
+        *dt = _beta_safety_ * (*dt) * sqrt(1.0f / greatestError);
+
+        if(*dt < min_dt) {
+            *dt = min_dt;
+        } else if(*dt > max_dt) {
+            *dt = max_dt;
+        }
+
+        if(*time_new + *dt > final_time) {
+            *dt = final_time - *time_new;
+        }
+
+        if(greatestError >= 1.0f && *dt > min_dt) {
+            // rejects the step
+            for(int i = 0; i < NEQ; i++) {
+                sv[i] = edos_old_aux_[i];
+            }
+        } else {
+            if(greatestError >= 1.0) {
+                printf("Accepting solution with error > %lf \n", greatestError);
+            }
+
+            for(int i = 0; i < NEQ; i++) {
+                _k1__[i] = _k2__[i];
+                sv[i] = edos_new_euler_[i];
+            }
+
+            if(*time_new + *previous_dt >= final_time) {
+                if(final_time == *time_new) {
+                    break;
+                } else if(*time_new < final_time) {
+                    *dt = *previous_dt = final_time - *time_new;
+                    *time_new += *previous_dt;
+                    break;
+                }
+            } else {
+                *time_new += *previous_dt;
+            }
+        }
+    }
+}
@@ -0,0 +1,180 @@
+// Generated by scripts/cell_model_generator/generate_cell_model.py from luo_rudy_1991_generated.model. Do not edit.
+// Luo-Rudy 1991
+
+#include "luo_rudy_1991_generated.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define safe_exp exp
+
+extern "C" SET_ODE_INITIAL_CONDITIONS_GPU(set_model_initial_conditions_gpu) {
+
+    log_info("Using Luo-Rudy 1991 GPU model (generated)\n");
+
+    uint32_t num_volumes = solver->original_num_cells;
+
+    if(solver->adaptive) {
+        log_warn("The generated GPU models do not have an adaptive method. Using Euler with dt = %lf\n", solver->min_dt);
+    }
+
+    // execution configuration
+    const int GRID = (num_volumes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    size_t size = num_volumes * sizeof(real);
+    size_t pitch_h;
+
+    check_cuda_error(cudaMallocPitch((void **)&(solver->sv), &pitch_h, size, (size_t)NEQ));
+
+    kernel_set_model_initial_conditions<<<GRID, BLOCK_SIZE>>>(solver->sv, num_volumes, pitch_h);
+
+    check_cuda_error(cudaPeekAtLastError());
+    cudaDeviceSynchronize();
+    return pitch_h;
+}
+
+extern "C" SOLVE_MODEL_ODES(solve_model_odes_gpu) {
+
+    size_t num_cells_to_solve = ode_solver->num_cells_to_solve;
+    uint32_t *cells_to_solve = ode_solver->cells_to_solve;
+    real *sv = ode_solver->sv;
+    real dt = ode_solver->min_dt;
+    uint32_t num_steps = ode_solver->num_steps;
+
+    // execution configuration
+    const int GRID = ((int)num_cells_to_solve + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    size_t stim_currents_size = sizeof(real) * num_cells_to_solve;
+    size_t cells_to_solve_size = sizeof(uint32_t) * num_cells_to_solve;
+
+    real *stims_currents_device;
+    check_cuda_error(cudaMalloc((void **)&stims_currents_device, stim_currents_size));
+    check_cuda_error(cudaMemcpy(stims_currents_device, stim_currents, stim_currents_size, cudaMemcpyHostToDevice));
+
+    // the array cells to solve is passed when we are using and adaptive mesh
+    uint32_t *cells_to_solve_device = NULL;
+    if(cells_to_solve != NULL) {
+        check_cuda_error(cudaMalloc((void **)&cells_to_solve_device, cells_to_solve_size));
+        check_cuda_error(cudaMemcpy(cells_to_solve_device, cells_to_solve, cells_to_solve_size, cudaMemcpyHostToDevice));
+    }
+
+    solve_gpu<<<GRID, BLOCK_SIZE>>>(dt, sv, stims_currents_device, cells_to_solve_device, num_cells_to_solve, num_steps, ode_solver->pitch);
+
+    check_cuda_error(cudaPeekAtLastError());
+
+    check_cuda_error(cudaFree(stims_currents_device));
+    if(cells_to_solve_device)
+        check_cuda_error(cudaFree(cells_to_solve_device));
+}
+
+__global__ void kernel_set_model_initial_conditions(real *sv, int num_volumes, size_t pitch) {
+
+    int threadID = blockDim.x * blockIdx.x + threadIdx.x;
+
+    if(threadID < num_volumes) {
+        *((real *)((char *)sv + pitch * 0) + threadID) = -84.380111; // V millivolt
+        *((real *)((char *)sv + pitch * 1) + threadID) = 0.001713; // m dimensionless
+        *((real *)((char *)sv + pitch * 2) + threadID) = 0.982661; // h dimensionless
+        *((real *)((char *)sv + pitch * 3) + threadID) = 0.989108; // j dimensionless
+        *((real *)((char *)sv + pitch * 4) + threadID) = 0.003021; // d dimensionless
+        *((real *)((char *)sv + pitch * 5) + threadID) = 0.999968; // f dimensionless
+        *((real *)((char *)sv + pitch * 6) + threadID) = 0.041760; // X dimensionless
+        *((real *)((char *)sv + pitch * 7) + threadID) = 0.000179; // Cai millimolar
+    }
+}
+
+// Solving the model for each cell in the tissue matrix ni x nj
+__global__ void solve_gpu(real dt, real *sv, real *stim_currents, uint32_t *cells_to_solve, uint32_t num_cells_to_solve, int num_steps,
+                          size_t pitch) {
+
+    int threadID = blockDim.x * blockIdx.x + threadIdx.x;
+    int sv_id;
+
+    // Each thread solves one cell model
+    if(threadID < num_cells_to_solve) {
+        if(cells_to_solve)
+            sv_id = cells_to_solve[threadID];
+        else
+            sv_id = threadID;
+
+        real rDY[NEQ];
+
+        for(int n = 0; n < num_steps; ++n) {
+
+            RHS_gpu(sv, rDY, stim_currents[threadID], sv_id, dt, pitch);
+
+            for(int i = 0; i < NEQ; i++) {
+                *((real *)((char *)sv + pitch * i) + sv_id) = dt * rDY[i] + *((real *)((char *)sv + pitch * i) + sv_id);
+            }
+        }
+    }
+}
+
+inline __device__ void RHS_gpu(real *sv, real *rDY_, real stim_current, int threadID_, real dt, size_t pitch) {
+
+    // State variables
+    const real V = *((real *)((char *)sv + pitch * 0) + threadID_);
+    const real m = *((real *)((char *)sv + pitch * 1) + threadID_);
+    const real h = *((real *)((char *)sv + pitch * 2) + threadID_);
+    const real j = *((real *)((char *)sv + pitch * 3) + threadID_);
+    const real d = *((real *)((char *)sv + pitch * 4) + threadID_);
+    const real f = *((real *)((char *)sv + pitch * 5) + threadID_);
+    const real X = *((real *)((char *)sv + pitch * 6) + threadID_);
+    const real Cai = *((real *)((char *)sv + pitch * 7) + threadID_);
+
+    // Parameters
+    const real g_Na = 23.0;
+    const real g_Kp = 0.0183;
+    const real g_b = 0.03921;
+    const real E_b = -59.87;
+
+    // Algebraic variables
+    const real _cse_0 = V + 47.13;
+    const real alpha_m = (0.32 * _cse_0) / (1.0 - safe_exp((-0.1) * _cse_0));
+    const real beta_m = 0.08 * safe_exp((-V) / 11.0);
+    const bool _cse_1 = V < (-40.0);
+    const real alpha_h = _cse_1 ? (0.135 * safe_exp((80.0 + V) / (-6.8))) : 0.0;
+    const real beta_h = _cse_1 ? ((3.56 * safe_exp(0.079 * V)) + (310000.0 * safe_exp(0.35 * V))) : (1.0 / (0.13 * (1.0 + safe_exp((V + 10.66) / (-11.1)))));
+    const real alpha_j = _cse_1 ? (((((-127140.0) * safe_exp(0.2444 * V)) - (3.474e-05 * safe_exp((-0.04391) * V))) * (V + 37.78)) / (1.0 + safe_exp(0.311 * (V + 79.23)))) : 0.0;
+    const real beta_j = _cse_1 ? ((0.1212 * safe_exp((-0.01052) * V)) / (1.0 + safe_exp((-0.1378) * (V + 40.14)))) : ((0.3 * safe_exp((-2.535e-07) * V)) / (1.0 + safe_exp((-0.1) * (V + 32.0))));
+    const real E_Na = 54.79446393509185;
+    const real i_Na = (((g_Na * ((m * m) * m)) * h) * j) * (V - E_Na);
+    const real _cse_2 = V - 5.0;
+    const real alpha_d = (0.095 * safe_exp((-0.01) * _cse_2)) / (1.0 + safe_exp((-0.072) * _cse_2));
+    const real _cse_3 = V + 44.0;
+    const real beta_d = (0.07 * safe_exp((-0.017) * _cse_3)) / (1.0 + safe_exp(0.05 * _cse_3));
+    const real _cse_4 = V + 28.0;
+    const real alpha_f = (0.012 * safe_exp((-0.008) * _cse_4)) / (1.0 + safe_exp(0.15 * _cse_4));
+    const real _cse_5 = V + 30.0;
+    const real beta_f = (0.0065 * safe_exp((-0.02) * _cse_5)) / (1.0 + safe_exp((-0.2) * _cse_5));
+    const real E_si = 7.7 - (13.0287 * log(Cai));
+    const real i_si = ((0.09 * d) * f) * (V - E_si);
+    const real _cse_6 = V + 50.0;
+    const real alpha_X = (0.0005 * safe_exp(0.083 * _cse_6)) / (1.0 + safe_exp(0.057 * _cse_6));
+    const real _cse_7 = V + 20.0;
+    const real beta_X = (0.0013 * safe_exp((-0.06) * _cse_7)) / (1.0 + safe_exp((-0.04) * _cse_7));
+    const real E_K = -77.56758438531939;
+    const real _cse_8 = V + 77.0;
+    const real Xi = (V > (-100.0)) ? ((2.837 * (safe_exp(0.04 * _cse_8) - 1.0)) / (_cse_8 * safe_exp(0.04 * (V + 35.0)))) : 1.0;
+    const real g_K = 0.282;
+    const real i_K = ((g_K * X) * Xi) * (V - E_K);
+    const real E_K1 = -87.8929017138025;
+    const real _cse_9 = V - E_K1;
+    const real alpha_K1 = 1.02 / (1.0 + safe_exp(0.2385 * (_cse_9 - 59.215)));
+    const real beta_K1 = ((0.49124 * safe_exp(0.08032 * ((V + 5.476) - E_K1))) + safe_exp(0.06175 * (V - (E_K1 + 594.31)))) / (1.0 + safe_exp((-0.5143) * (_cse_9 + 4.753)));
+    const real K1_infinity = alpha_K1 / (alpha_K1 + beta_K1);
+    const real g_K1 = 0.6047;
+    const real i_K1 = (g_K1 * K1_infinity) * _cse_9;
+    const real Kp = 1.0 / (1.0 + safe_exp((7.488 - V) / 5.98));
+    const real i_Kp = (g_Kp * Kp) * _cse_9;
+    const real i_b = g_b * (V - E_b);
+
+    // Rates
+    rDY_[0] = -((((((stim_current + i_Na) + i_si) + i_K) + i_K1) + i_Kp) + i_b);
+    rDY_[1] = (alpha_m * (1.0 - m)) - (beta_m * m);
+    rDY_[2] = (alpha_h * (1.0 - h)) - (beta_h * h);
+    rDY_[3] = (alpha_j * (1.0 - j)) - (beta_j * j);
+    rDY_[4] = (alpha_d * (1.0 - d)) - (beta_d * d);
+    rDY_[5] = (alpha_f * (1.0 - f)) - (beta_f * f);
+    rDY_[6] = (alpha_X * (1.0 - X)) - (beta_X * X);
+    rDY_[7] = ((-0.0001) * i_si) + (0.07 * (0.0001 - Cai));
+}
@@ -4,4 +4,11 @@ MODEL_FILE_GPU="mitchell_shaeffer_2003.cu"
 COMMON_HEADERS="mitchell_shaeffer_2003.h"
 
 COMPILE_MODEL_LIB "mitchell_shaeffer_2003" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS"
-#########################################################
\ No newline at end of file
+#########################################################
+############## MITCHELL SHAEFFER 2003 (GENERATED) ##############################
+MODEL_FILE_CPU="mitchell_shaeffer_2003_generated.c"
+MODEL_FILE_GPU="mitchell_shaeffer_2003_generated.cu"
+COMMON_HEADERS="mitchell_shaeffer_2003_generated.h"
+
+COMPILE_MODEL_LIB "mitchell_shaeffer_2003_generated" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS"
+##########################################################
@@ -0,0 +1,297 @@
+// Generated by scripts/cell_model_generator/generate_cell_model.py from mitchell_shaeffer_2003_generated.model. Do not edit.
+// Mitchell-Shaeffer 2003
+
+#include "mitchell_shaeffer_2003_generated.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// exp that never overflows to inf (so the code is also valid with -ffast-math). The results are the same for the
+// arguments where exp is finite
+static inline real safe_exp(real x) {
+    const real max_x = (sizeof(real) == sizeof(float)) ? (real)88.0 : (real)709.0;
+    return exp(x > max_x ? max_x : x);
+}
+
+GET_CELL_MODEL_DATA(init_cell_model_data) {
+
+    if(get_initial_v)
+        cell_model->initial_v = INITIAL_V;
+    if(get_neq)
+        cell_model->number_of_ode_equations = NEQ;
+}
+
+SET_ODE_INITIAL_CONDITIONS_CPU(set_model_initial_conditions_cpu) {
+
+    log_info("Using Mitchell-Shaeffer 2003 CPU model (generated)\n");
+
+    uint32_t num_cells = solver->original_num_cells;
+    solver->sv = (real *)malloc(NEQ * num_cells * sizeof(real));
+
+    bool adpt = solver->adaptive;
+
+    if(adpt) {
+        solver->ode_dt = (real *)malloc(num_cells * sizeof(real));
+
+        OMP(parallel for)
+        for(uint32_t i = 0; i < num_cells; i++) {
+            solver->ode_dt[i] = solver->min_dt;
+        }
+
+        solver->ode_previous_dt = (real *)calloc(num_cells, sizeof(real));
+        solver->ode_time_new = (real *)calloc(num_cells, sizeof(real));
+        log_info("Using Adaptive Euler model to solve the ODEs\n");
+    }
+
+    OMP(parallel for)
+    for(uint32_t i = 0; i < num_cells; i++) {
+
+        real *sv = &solver->sv[i * NEQ];
+
+        sv[0] = 0.00000820413566106744; // V millivolt
+        sv[1] = 0.8789655121804799; // h dimensionless
+    }
+}
+
+// The [ode_solver] option method selects the fixed step method: euler (default) or rush_larsen
+static bool ode_method_is_rush_larsen(struct string_hash_entry *ode_extra_config) {
+
+    static bool logged = false;
+    char *method = get_string_parameter(ode_extra_config, "method");
+
+    if(!method || STRINGS_EQUAL(method, "euler")) {
+        return false;
+    }
+
+    bool rush_larsen = STRINGS_EQUAL(method, "rush_larsen");
+
+    if(!logged) {
+        if(rush_larsen) {
+            log_info("Using the Rush-Larsen method to solve the ODEs on the CPU\n");
+        } else {
+            log_warn("Invalid ODE method %s. Valid methods are euler and rush_larsen. Using euler!\n", method);
+        }
+        logged = true;
+    }
+
+    return rush_larsen;
+}
+
+void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt) {
+
+    // State variables
+    const real V = sv[0];
+    const real h = sv[1];
+
+    // Parameters
+    const real tau_in = 0.3;
+    const real tau_out = 6.0;
+    const real V_gate = 0.13;
+    const real tau_open = 120.0;
+    const real tau_close = 150.0;
+
+    // Algebraic variables
+    const real J_in = (h * ((V * V) * (1.0 - V))) / tau_in;
+    const real J_out = -(V / tau_out);
+    const bool _cse_0 = V < V_gate;
+    const real h_inf = _cse_0 ? 1.0 : 0.0;
+    const real h_tau = _cse_0 ? tau_open : tau_close;
+
+    // Rates
+    rDY_[0] = (J_out + J_in) + stim_current;
+    rDY_[1] = (h_inf - h) / h_tau;
+}
+
+// Advances the n cells of a batch num_steps steps of dt. sv has the NEQ states of the batch, GENERATED_BATCH_SIZE
+// values for each state
+static void solve_batch_cpu(real dt, real *sv, const real *stim_currents, uint32_t n, uint32_t num_steps, bool rush_larsen) {
+
+    for(uint32_t step = 0; step < num_steps; step++) {
+
+        OMP(simd)
+        for(uint32_t l = 0; l < n; l++) {
+
+            // State variables
+            const real V = sv[0 * GENERATED_BATCH_SIZE + l];
+            const real h = sv[1 * GENERATED_BATCH_SIZE + l];
+            const real stim_current = stim_currents[l];
+
+            // Parameters
+            const real tau_in = 0.3;
+            const real tau_out = 6.0;
+            const real V_gate = 0.13;
+            const real tau_open = 120.0;
+            const real tau_close = 150.0;
+
+            // Algebraic variables
+            const real J_in = (h * ((V * V) * (1.0 - V))) / tau_in;
+            const real J_out = -(V / tau_out);
+            const bool _cse_0 = V < V_gate;
+            const real h_inf = _cse_0 ? 1.0 : 0.0;
+            const real h_tau = _cse_0 ? tau_open : tau_close;
+
+            if(rush_larsen) {
+                sv[0 * GENERATED_BATCH_SIZE + l] = dt * ((J_out + J_in) + stim_current) + V;
+                sv[1 * GENERATED_BATCH_SIZE + l] = h_inf + ((h - h_inf) * safe_exp((-dt) / h_tau));
+            } else {
+                sv[0 * GENERATED_BATCH_SIZE + l] = dt * ((J_out + J_in) + stim_current) + V;
+                sv[1 * GENERATED_BATCH_SIZE + l] = dt * ((h_inf - h) / h_tau) + h;
+            }
+        }
+    }
+}
+
+SOLVE_MODEL_ODES(solve_model_odes_cpu) {
+
+    uint32_t *cells_to_solve = ode_solver->cells_to_solve;
+    real *sv = ode_solver->sv;
+    real dt = ode_solver->min_dt;
+    uint32_t num_steps = ode_solver->num_steps;
+
+    bool adpt = ode_solver->adaptive;
+    bool rush_larsen = !adpt && ode_method_is_rush_larsen(ode_extra_config);
+
+    uint32_t partition[MAX_ODE_PARTITIONS + 1];
+    uint32_t num_parts = partition_cells_to_solve(ode_solver, dt, partition);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(uint32_t p = 0; p < num_parts; p++) {
+
+        if(adpt) {
+            for(uint32_t i = partition[p]; i < partition[p + 1]; i++) {
+                uint32_t sv_id = cells_to_solve ? cells_to_solve[i] : i;
+                solve_forward_euler_cpu_adpt(sv + (sv_id * NEQ), stim_currents[i], current_t + dt, sv_id, ode_solver);
+            }
+            continue;
+        }
+
+        real batch_sv[NEQ * GENERATED_BATCH_SIZE];
+        uint32_t batch_ids[GENERATED_BATCH_SIZE];
+
+        for(uint32_t first = partition[p]; first < partition[p + 1]; first += GENERATED_BATCH_SIZE) {
+
+            uint32_t n = partition[p + 1] - first;
+            if(n > GENERATED_BATCH_SIZE) {
+                n = GENERATED_BATCH_SIZE;
+            }
+
+            for(uint32_t l = 0; l < n; l++) {
+                batch_ids[l] = cells_to_solve ? cells_to_solve[first + l] : first + l;
+                for(uint32_t k = 0; k < NEQ; k++) {
+                    batch_sv[k * GENERATED_BATCH_SIZE + l] = sv[batch_ids[l] * NEQ + k];
+                }
+            }
+
+            solve_batch_cpu(dt, batch_sv, stim_currents + first, n, num_steps, rush_larsen);
+
+            for(uint32_t l = 0; l < n; l++) {
+                for(uint32_t k = 0; k < NEQ; k++) {
+                    sv[batch_ids[l] * NEQ + k] = batch_sv[k * GENERATED_BATCH_SIZE + l];
+                }
+            }
+        }
+    }
+}
+
+void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int sv_id, struct ode_solver *solver) {
+
+    const real _beta_safety_ = 0.8;
+
+    real rDY[NEQ];
+    real _tolerances_[NEQ];
+    real _aux_tol = 0.0;
+    real edos_old_aux_[NEQ];
+    real edos_new_euler_[NEQ];
+    real _k1__[NEQ];
+    real _k2__[NEQ];
+
+    // initializes the variables
+    solver->ode_previous_dt[sv_id] = solver->ode_dt[sv_id];
+
+    real *dt = &solver->ode_dt[sv_id];
+    real *time_new = &solver->ode_time_new[sv_id];
+    real *previous_dt = &solver->ode_previous_dt[sv_id];
+
+    if(*time_new + *dt > final_time) {
+        *dt = final_time - *time_new;
+    }
+
+    RHS_cpu(sv, rDY, stim_curr, *dt);
+    *time_new += *dt;
+
+    for(int i = 0; i < NEQ; i++) {
+        _k1__[i] = rDY[i];
+    }
+
+    const real rel_tol = solver->rel_tol;
+    const real abs_tol = solver->abs_tol;
+
+    const real __tiny_ = pow(abs_tol, 2.0);
+
+    real min_dt = solver->min_dt;
+    real max_dt = solver->max_dt;
+
+    while(1) {
+
+        for(int i = 0; i < NEQ; i++) {
+            edos_old_aux_[i] = sv[i];
+            edos_new_euler_[i] = _k1__[i] * *dt + edos_old_aux_[i];
+            sv[i] = edos_new_euler_[i];
+        }
+
+        *time_new += *dt;
+        RHS_cpu(sv, rDY, stim_curr, *dt);
+        *time_new -= *dt; // step back
+
+        double greatestError = 0.0, auxError = 0.0;
+        for(int i = 0; i < NEQ; i++) {
+            _k2__[i] = rDY[i];
+            _aux_tol = fabs(edos_new_euler_[i]) * rel_tol;
+            _tolerances_[i] = (abs_tol > _aux_tol) ? abs_tol : _aux_tol;
+            auxError = fabs(((*dt / 2.0) * (_k1__[i] - _k2__[i])) / _tolerances_[i]);
+            greatestError = (auxError > greatestError) ? auxError : greatestError;
+        }
+
+        greatestError += __tiny_;
+        *previous_dt = *dt;
+        *dt = _beta_safety_ * (*dt) * sqrt(1.0f / greatestError);
+
+        if(*dt < min_dt) {
+            *dt = min_dt;
+        } else if(*dt > max_dt) {
+            *dt = max_dt;
+        }
+
+        if(*time_new + *dt > final_time) {
+            *dt = final_time - *time_new;
+        }
+
+        if(greatestError >= 1.0f && *dt > min_dt) {
+            // rejects the step
+            for(int i = 0; i < NEQ; i++) {
+                sv[i] = edos_old_aux_[i];
+            }
+        } else {
+            if(greatestError >= 1.0) {
+                printf("Accepting solution with error > %lf \n", greatestError);
+            }
+
+            for(int i = 0; i < NEQ; i++) {
+                _k1__[i] = _k2__[i];
+                sv[i] = edos_new_euler_[i];
+            }
+
+            if(*time_new + *previous_dt >= final_time) {
+                if(final_time == *time_new) {
+                    break;
+                } else if(*time_new < final_time) {
+                    *dt = *previous_dt = final_time - *time_new;
+                    *time_new += *previous_dt;
+                    break;
+                }
+            } else {
+                *time_new += *previous_dt;
+            }
+        }
+    }
+}
@@ -0,0 +1,129 @@
+// Generated by scripts/cell_model_generator/generate_cell_model.py from mitchell_shaeffer_2003_generated.model. Do not edit.
+// Mitchell-Shaeffer 2003
+
+#include "mitchell_shaeffer_2003_generated.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define safe_exp exp
+
+extern "C" SET_ODE_INITIAL_CONDITIONS_GPU(set_model_initial_conditions_gpu) {
+
+    log_info("Using Mitchell-Shaeffer 2003 GPU model (generated)\n");
+
+    uint32_t num_volumes = solver->original_num_cells;
+
+    if(solver->adaptive) {
+        log_warn("The generated GPU models do not have an adaptive method. Using Euler with dt = %lf\n", solver->min_dt);
+    }
+
+    // execution configuration
+    const int GRID = (num_volumes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    size_t size = num_volumes * sizeof(real);
+    size_t pitch_h;
+
+    check_cuda_error(cudaMallocPitch((void **)&(solver->sv), &pitch_h, size, (size_t)NEQ));
+
+    kernel_set_model_initial_conditions<<<GRID, BLOCK_SIZE>>>(solver->sv, num_volumes, pitch_h);
+
+    check_cuda_error(cudaPeekAtLastError());
+    cudaDeviceSynchronize();
+    return pitch_h;
+}
+
+extern "C" SOLVE_MODEL_ODES(solve_model_odes_gpu) {
+
+    size_t num_cells_to_solve = ode_solver->num_cells_to_solve;
+    uint32_t *cells_to_solve = ode_solver->cells_to_solve;
+    real *sv = ode_solver->sv;
+    real dt = ode_solver->min_dt;
+    uint32_t num_steps = ode_solver->num_steps;
+
+    // execution configuration
+    const int GRID = ((int)num_cells_to_solve + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    size_t stim_currents_size = sizeof(real) * num_cells_to_solve;
+    size_t cells_to_solve_size = sizeof(uint32_t) * num_cells_to_solve;
+
+    real *stims_currents_device;
+    check_cuda_error(cudaMalloc((void **)&stims_currents_device, stim_currents_size));
+    check_cuda_error(cudaMemcpy(stims_currents_device, stim_currents, stim_currents_size, cudaMemcpyHostToDevice));
+
+    // the array cells to solve is passed when we are using and adaptive mesh
+    uint32_t *cells_to_solve_device = NULL;
+    if(cells_to_solve != NULL) {
+        check_cuda_error(cudaMalloc((void **)&cells_to_solve_device, cells_to_solve_size));
+        check_cuda_error(cudaMemcpy(cells_to_solve_device, cells_to_solve, cells_to_solve_size, cudaMemcpyHostToDevice));
+    }
+
+    solve_gpu<<<GRID, BLOCK_SIZE>>>(dt, sv, stims_currents_device, cells_to_solve_device, num_cells_to_solve, num_steps, ode_solver->pitch);
+
+    check_cuda_error(cudaPeekAtLastError());
+
+    check_cuda_error(cudaFree(stims_currents_device));
+    if(cells_to_solve_device)
+        check_cuda_error(cudaFree(cells_to_solve_device));
+}
+
+__global__ void kernel_set_model_initial_conditions(real *sv, int num_volumes, size_t pitch) {
+
+    int threadID = blockDim.x * blockIdx.x + threadIdx.x;
+
+    if(threadID < num_volumes) {
+        *((real *)((char *)sv + pitch * 0) + threadID) = 0.00000820413566106744; // V millivolt
+        *((real *)((char *)sv + pitch * 1) + threadID) = 0.8789655121804799; // h dimensionless
+    }
+}
+
+// Solving the model for each cell in the tissue matrix ni x nj
+__global__ void solve_gpu(real dt, real *sv, real *stim_currents, uint32_t *cells_to_solve, uint32_t num_cells_to_solve, int num_steps,
+                          size_t pitch) {
+
+    int threadID = blockDim.x * blockIdx.x + threadIdx.x;
+    int sv_id;
+
+    // Each thread solves one cell model
+    if(threadID < num_cells_to_solve) {
+        if(cells_to_solve)
+            sv_id = cells_to_solve[threadID];
+        else
+            sv_id = threadID;
+
+        real rDY[NEQ];
+
+        for(int n = 0; n < num_steps; ++n) {
+
+            RHS_gpu(sv, rDY, stim_currents[threadID], sv_id, dt, pitch);
+
+            for(int i = 0; i < NEQ; i++) {
+                *((real *)((char *)sv + pitch * i) + sv_id) = dt * rDY[i] + *((real *)((char *)sv + pitch * i) + sv_id);
+            }
+        }
+    }
+}
+
+inline __device__ void RHS_gpu(real *sv, real *rDY_, real stim_current, int threadID_, real dt, size_t pitch) {
+
+    // State variables
+    const real V = *((real *)((char *)sv + pitch * 0) + threadID_);
+    const real h = *((real *)((char *)sv + pitch * 1) + threadID_);
+
+    // Parameters
+    const real tau_in = 0.3;
+    const real tau_out = 6.0;
+    const real V_gate = 0.13;
+    const real tau_open = 120.0;
+    const real tau_close = 150.0;
+
+    // Algebraic variables
+    const real J_in = (h * ((V * V) * (1.0 - V))) / tau_in;
+    const real J_out = -(V / tau_out);
+    const bool _cse_0 = V < V_gate;
+    const real h_inf = _cse_0 ? 1.0 : 0.0;
+    const real h_tau = _cse_0 ? tau_open : tau_close;
+
+    // Rates
+    rDY_[0] = (J_out + J_in) + stim_current;
+    rDY_[1] = (h_inf - h) / h_tau;
+}
@@ -0,0 +1,31 @@
+// Generated by scripts/cell_model_generator/generate_cell_model.py from mitchell_shaeffer_2003_generated.model. Do not edit.
+// Mitchell-Shaeffer 2003
+
+#ifndef MONOALG3D_MODEL_MITCHELL_SHAEFFER_2003_GENERATED_H
+#define MONOALG3D_MODEL_MITCHELL_SHAEFFER_2003_GENERATED_H
+
+#include "../model_common.h"
+
+#define NEQ 2
+#define INITIAL_V (0.00000820413566106744)
+
+// Number of cells solved together by the fixed step CPU kernel
+#define GENERATED_BATCH_SIZE 8
+
+#ifdef __CUDACC__
+
+#include "../../gpu_utils/gpu_utils.h"
+
+__global__ void kernel_set_model_initial_conditions(real *sv, int num_volumes, size_t pitch);
+
+__global__ void solve_gpu(real dt, real *sv, real *stim_currents, uint32_t *cells_to_solve, uint32_t num_cells_to_solve, int num_steps,
+                          size_t pitch);
+
+inline __device__ void RHS_gpu(real *sv, real *rDY_, real stim_current, int threadID_, real dt, size_t pitch);
+
+#endif
+
+void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt);
+void solve_forward_euler_cpu_adpt(real *sv, real stim_curr, real final_time, int sv_id, struct ode_solver *solver);
+
+#endif // MONOALG3D_MODEL_MITCHELL_SHAEFFER_2003_GENERATED_H
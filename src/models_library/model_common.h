@@ -31,4 +31,87 @@
     #include "set_single_precision.h"
 #endif
 
+// Floating point literal of model code shared by the double and the single precision kernels. Only the single
+// precision CPU blocks (see single_precision_cpu_begin.h) make it a float literal, so the other builds are unchanged.
+#define REAL_LIT(x) x
+
+#ifndef __CUDACC__
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#define MAX_ODE_PARTITIONS 1024
+
+// Splits the cells to solve in parts of about the same cost, solved by the threads with schedule(dynamic, 1). With
+// adaptive time steps the cost of a cell is the number of steps needed to advance dt with its last time step (ode_dt),
+// so the cells in the wavefront, which take many more steps than the resting ones, are spread between the threads.
+// partition needs MAX_ODE_PARTITIONS + 1 elements. The cells of the part p are [partition[p], partition[p + 1]).
+static inline uint32_t partition_cells_to_solve(const struct ode_solver *solver, real dt, uint32_t *partition) {
+
+    uint32_t num_cells = solver->num_cells_to_solve;
+    const uint32_t *cells_to_solve = solver->cells_to_solve;
+
+    uint32_t num_parts = 1;
+#if defined(_OPENMP)
+    int num_threads = omp_get_max_threads();
+    if(num_threads > 1) {
+        num_parts = 4 * num_threads;
+    }
+#endif
+
+    if(num_parts > MAX_ODE_PARTITIONS) {
+        num_parts = MAX_ODE_PARTITIONS;
+    }
+
+    if(num_parts > num_cells) {
+        num_parts = num_cells > 0 ? num_cells : 1;
+    }
+
+    partition[0] = 0;
+
+    if(!solver->adaptive || num_parts == 1) {
+        for(uint32_t p = 1; p <= num_parts; p++) {
+            partition[p] = (uint32_t)(((uint64_t)num_cells * p) / num_parts);
+        }
+        return num_parts;
+    }
+
+    const real *ode_dt = solver->ode_dt;
+    double total_cost = 0.0;
+
+    for(uint32_t i = 0; i < num_cells; i++) {
+        uint32_t sv_id = cells_to_solve ? cells_to_solve[i] : i;
+        total_cost += 1.0 + dt / ode_dt[sv_id];
+    }
+
+    double cost = 0.0;
+    uint32_t p = 1;
+
+    for(uint32_t i = 0; i < num_cells && p < num_parts; i++) {
+        uint32_t sv_id = cells_to_solve ? cells_to_solve[i] : i;
+        cost += 1.0 + dt / ode_dt[sv_id];
+
+        while(p < num_parts && cost >= (total_cost * p) / num_parts) {
+            partition[p++] = i + 1;
+        }
+    }
+
+    while(p <= num_parts) {
+        partition[p++] = num_cells;
+    }
+
+    return num_parts;
+}
+
+// [ode_solver] single_precision=true selects the single precision kernels (see single_precision_cpu_begin.h) of the CPU
+// models that have them. The state vectors are still stored in double precision, so the cells are converted to float
+// at the beginning of each solve and back at the end.
+static inline bool single_precision_enabled(struct string_hash_entry *ode_extra_config) {
+    char *value = get_string_parameter(ode_extra_config, "single_precision");
+    return value && IS_TRUE(value);
+}
+
+#endif
+
 #endif // MONOALG3D_C_MODEL_COMMON_H
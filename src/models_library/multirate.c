@@ -0,0 +1,115 @@
+//
+// Multi-rate time stepping for the fixed time step CPU models.
+//
+
+#include "multirate.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Simulates one action potential (stimulated during the first MULTIRATE_CHECK_STIM_DURATION ms) with the single-rate
+// and the multi-rate solvers and returns the maximum difference of Vm. Both solvers are called with the same steps, so
+// Vm is compared at the end of each slow step.
+real multirate_max_error(real dt, const real *initial_sv, uint32_t neq, real stim_current, real check_time, uint32_t ratio, real label,
+                         multirate_steps_fn *steps, const void *data) {
+
+    real *reference = MALLOC_ARRAY_OF_TYPE(real, neq);
+    real *multirate = MALLOC_ARRAY_OF_TYPE(real, neq);
+
+    memcpy(reference, initial_sv, neq * sizeof(real));
+    memcpy(multirate, initial_sv, neq * sizeof(real));
+
+    real max_error = 0.0;
+    uint32_t num_calls = (uint32_t)ceil(check_time / (ratio * dt));
+
+    for(uint32_t i = 0; i < num_calls; i++) {
+
+        real t = i * ratio * dt;
+        real stim = (t < MULTIRATE_CHECK_STIM_DURATION) ? stim_current : 0.0;
+
+        steps(dt, reference, stim, ratio, 1, label, data);
+        steps(dt, multirate, stim, ratio, ratio, label, data);
+
+        real error = fabs(reference[0] - multirate[0]);
+
+        if(isnan(error)) {
+            max_error = INFINITY;
+            break;
+        }
+
+        if(error > max_error) {
+            max_error = error;
+        }
+    }
+
+    free(reference);
+    free(multirate);
+
+    return max_error;
+}
+
+static real get_multirate_parameter(struct string_hash_entry *ode_extra_config, const char *parameter, real default_value) {
+
+    char *value = get_string_parameter(ode_extra_config, parameter);
+
+    if(value) {
+        int expr_parse_error;
+        real result = (real)te_interp(value, &expr_parse_error);
+        if(expr_parse_error == 0) {
+            return result;
+        }
+        log_warn("Error parsing %s = %s. Using the default value %lf\n", parameter, value, default_value);
+    }
+
+    return default_value;
+}
+
+// Reads the [ode_solver] option multirate_ratio (1 = single-rate). The ratio is halved until the Vm error of a
+// single cell action potential is within multirate_tolerance (mV) for each one of the num_labels labels. The initial
+// state of the cell with labels[k] is initial_sv + k*neq. The action potential is simulated for multirate_check_time ms.
+uint32_t multirate_ratio_from_config(struct string_hash_entry *ode_extra_config, bool adaptive, real dt, const real *initial_sv, const real *labels,
+                                     uint32_t num_labels, uint32_t neq, real stim_current, multirate_steps_fn *steps, const void *data,
+                                     const char *model_name) {
+
+    real ratio_value = get_multirate_parameter(ode_extra_config, "multirate_ratio", 1.0);
+
+    if(ratio_value < 2.0) {
+        return 1;
+    }
+
+    if(adaptive) {
+        log_warn("Multi-rate time stepping is only available with a fixed ODE time step. Using the single-rate solver!\n");
+        return 1;
+    }
+
+    uint32_t ratio = (uint32_t)ratio_value;
+    real tolerance = get_multirate_parameter(ode_extra_config, "multirate_tolerance", MULTIRATE_DEFAULT_TOLERANCE);
+    real check_time = get_multirate_parameter(ode_extra_config, "multirate_check_time", MULTIRATE_DEFAULT_CHECK_TIME);
+
+    while(ratio > 1) {
+
+        real error = 0.0;
+
+        for(uint32_t k = 0; k < num_labels; k++) {
+            real label_error = multirate_max_error(dt, initial_sv + k * neq, neq, stim_current, check_time, ratio, labels[k], steps, data);
+            if(label_error > error) {
+                error = label_error;
+            }
+        }
+
+        if(error <= tolerance) {
+            log_info("Using multi-rate time stepping for the %s model: %u fast steps per slow step, max Vm error %e mV\n", model_name, ratio, error);
+            return ratio;
+        }
+
+        log_warn("The %s multi-rate Vm error with %u fast steps per slow step (%e mV) is greater than the tolerance (%e mV)\n", model_name, ratio,
+                 error, tolerance);
+
+        ratio /= 2;
+    }
+
+    log_warn("Using the single-rate solver for the %s model!\n", model_name);
+
+    return 1;
+}
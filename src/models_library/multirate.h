@@ -0,0 +1,27 @@
+//
+// Multi-rate time stepping for the fixed time step CPU models. The slow state variables are advanced once every
+// 'ratio' steps of the fast ones.
+//
+
+#ifndef MONOALG3D_C_MULTIRATE_H
+#define MONOALG3D_C_MULTIRATE_H
+
+#include "model_common.h"
+
+#define MULTIRATE_DEFAULT_TOLERANCE (1.0)
+#define MULTIRATE_DEFAULT_CHECK_TIME (500.0)
+#define MULTIRATE_CHECK_STIM_DURATION (1.0)
+
+// Advances one cell num_steps steps of size dt, using 'ratio' fast steps for each slow step. label (the celltype, for
+// example) and data are the ones given to multirate_ratio_from_config
+#define MULTIRATE_STEPS(name) void name(real dt, real *sv, real stim_current, uint32_t num_steps, uint32_t ratio, real label, const void *data)
+typedef MULTIRATE_STEPS(multirate_steps_fn);
+
+real multirate_max_error(real dt, const real *initial_sv, uint32_t neq, real stim_current, real check_time, uint32_t ratio, real label,
+                         multirate_steps_fn *steps, const void *data);
+
+uint32_t multirate_ratio_from_config(struct string_hash_entry *ode_extra_config, bool adaptive, real dt, const real *initial_sv, const real *labels,
+                                     uint32_t num_labels, uint32_t neq, real stim_current, multirate_steps_fn *steps, const void *data,
+                                     const char *model_name);
+
+#endif // MONOALG3D_C_MULTIRATE_H
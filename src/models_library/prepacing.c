@@ -0,0 +1,237 @@
+//
+// Pre-pacing of the initial conditions of the CPU models.
+//
+
+#include "prepacing.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../utils/file_utils.h"
+
+// Each cache file has this header followed by the neq values of the pre-paced state. The name of the file is built from
+// the model name and the key, so different parameters, labels or initial states use different files
+#define PREPACING_CACHE_MAGIC "MAPREPAC"
+#define PREPACING_CACHE_VERSION 1
+
+struct prepacing_cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t neq;
+    uint32_t value_size;
+    uint32_t num_beats;
+    uint64_t key;      // FNV-1a of everything that changes the result of the pre-pacing
+    uint64_t checksum; // FNV-1a of the state
+};
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for(size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static real get_prepacing_parameter(struct string_hash_entry *ode_extra_config, const char *parameter, real default_value) {
+
+    char *value = get_string_parameter(ode_extra_config, parameter);
+
+    if(value) {
+        int expr_parse_error;
+        real result = (real)te_interp(value, &expr_parse_error);
+        if(expr_parse_error == 0) {
+            return result;
+        }
+        log_warn("Error parsing %s = %s. Using the default value %lf\n", parameter, value, default_value);
+    }
+
+    return default_value;
+}
+
+// [ode_solver] prepacing_beats > 0 enables the pre-pacing
+bool prepacing_enabled(struct string_hash_entry *ode_extra_config) {
+    return get_prepacing_parameter(ode_extra_config, "prepacing_beats", 0.0) >= 1.0;
+}
+
+// The model name is used in the file name with the characters that are not letters or digits replaced by '_'
+static char *cache_file_name(const char *cache_dir, const char *model_name, uint64_t key) {
+
+    size_t size = strlen(cache_dir) + strlen(model_name) + 32;
+    char *file_name = MALLOC_ARRAY_OF_TYPE(char, size);
+
+    int prefix_len = snprintf(file_name, size, "%s/", cache_dir);
+    snprintf(file_name + prefix_len, size - prefix_len, "%s_%016llx.bin", model_name, (unsigned long long)key);
+
+    for(size_t i = 0; i < strlen(model_name); i++) {
+        if(!isalnum((unsigned char)file_name[prefix_len + i])) {
+            file_name[prefix_len + i] = '_';
+        }
+    }
+
+    return file_name;
+}
+
+static bool read_cache(const char *file_name, real *sv, uint32_t neq, uint32_t num_beats, uint64_t key) {
+
+    FILE *f = fopen(file_name, "rb");
+
+    if(!f) {
+        return false;
+    }
+
+    struct prepacing_cache_header header;
+    real *values = MALLOC_ARRAY_OF_TYPE(real, neq);
+
+    bool valid = fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.magic, PREPACING_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == PREPACING_CACHE_VERSION && header.neq == neq && header.value_size == sizeof(real) &&
+                 header.num_beats == num_beats && header.key == key && fread(values, sizeof(real), neq, f) == neq &&
+                 fnv1a(14695981039346656037ULL, values, neq * sizeof(real)) == header.checksum;
+
+    fclose(f);
+
+    if(valid) {
+        memcpy(sv, values, neq * sizeof(real));
+    }
+
+    free(values);
+
+    return valid;
+}
+
+// The state is written to a temporary file that is renamed at the end, so simulations that start at the same time
+// never read a partial file
+static void write_cache(const char *cache_dir, const char *file_name, const real *sv, uint32_t neq, uint32_t num_beats, uint64_t key) {
+
+    create_dir((char *)cache_dir);
+
+    struct prepacing_cache_header header = {0};
+    memcpy(header.magic, PREPACING_CACHE_MAGIC, sizeof(header.magic));
+    header.version = PREPACING_CACHE_VERSION;
+    header.neq = neq;
+    header.value_size = sizeof(real);
+    header.num_beats = num_beats;
+    header.key = key;
+    header.checksum = fnv1a(14695981039346656037ULL, sv, neq * sizeof(real));
+
+    size_t tmp_size = strlen(file_name) + 32;
+    char *tmp_file_name = MALLOC_ARRAY_OF_TYPE(char, tmp_size);
+    snprintf(tmp_file_name, tmp_size, "%s.%d.tmp", file_name, (int)getpid());
+
+    FILE *f = fopen(tmp_file_name, "wb");
+
+    if(!f) {
+        log_warn("Unable to write the pre-pacing cache file %s\n", tmp_file_name);
+        free(tmp_file_name);
+        return;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(sv, sizeof(real), neq, f) == neq;
+    ok = (fclose(f) == 0) && ok;
+
+    if(!ok || rename(tmp_file_name, file_name) != 0) {
+        log_warn("Unable to write the pre-pacing cache file %s\n", file_name);
+        remove(tmp_file_name);
+    }
+
+    free(tmp_file_name);
+}
+
+// Paces a single cell with the given label and parameters, starting from sv, and replaces sv by its state at the end
+// of the last beat. Each beat has prepacing_bcl ms (default PREPACING_DEFAULT_BCL) and starts with a stimulus of
+// prepacing_stim_current (default stim_current) during prepacing_stim_duration ms. The steps are taken with the ODE
+// dt. Unless prepacing_cache=false, the result is stored in prepacing_cache_dir (default PREPACING_DEFAULT_CACHE_DIR)
+// and reused by the simulations with the same model, dt, pacing protocol, label, parameters and initial state.
+// Returns false (and keeps sv) if the pre-pacing is not enabled or diverges.
+bool prepace_cell(struct string_hash_entry *ode_extra_config, real dt, real *sv, uint32_t neq, real label, const real *parameters,
+                  uint32_t num_parameters, real stim_current, prepacing_steps_fn *steps, const char *model_name) {
+
+    if(!prepacing_enabled(ode_extra_config)) {
+        return false;
+    }
+
+    uint32_t num_beats = (uint32_t)get_prepacing_parameter(ode_extra_config, "prepacing_beats", 0.0);
+    real bcl = get_prepacing_parameter(ode_extra_config, "prepacing_bcl", PREPACING_DEFAULT_BCL);
+    real stim_duration = get_prepacing_parameter(ode_extra_config, "prepacing_stim_duration", PREPACING_DEFAULT_STIM_DURATION);
+    stim_current = get_prepacing_parameter(ode_extra_config, "prepacing_stim_current", stim_current);
+
+    uint32_t steps_per_beat = (uint32_t)round(bcl / dt);
+    uint32_t stim_steps = (uint32_t)round(stim_duration / dt);
+
+    if(stim_steps > steps_per_beat) {
+        stim_steps = steps_per_beat;
+    }
+
+    char *cache_value = get_string_parameter(ode_extra_config, "prepacing_cache");
+    bool use_cache = !cache_value || IS_TRUE(cache_value);
+
+    char *cache_dir = get_string_parameter(ode_extra_config, "prepacing_cache_dir");
+    if(!cache_dir) {
+        cache_dir = PREPACING_DEFAULT_CACHE_DIR;
+    }
+
+    uint64_t key = 14695981039346656037ULL;
+    key = fnv1a(key, model_name, strlen(model_name));
+    key = fnv1a(key, &neq, sizeof(neq));
+    key = fnv1a(key, &dt, sizeof(dt));
+    key = fnv1a(key, &num_beats, sizeof(num_beats));
+    key = fnv1a(key, &steps_per_beat, sizeof(steps_per_beat));
+    key = fnv1a(key, &stim_steps, sizeof(stim_steps));
+    key = fnv1a(key, &stim_current, sizeof(stim_current));
+    key = fnv1a(key, &label, sizeof(label));
+    key = fnv1a(key, parameters, num_parameters * sizeof(real));
+    key = fnv1a(key, sv, neq * sizeof(real));
+
+    char *file_name = cache_file_name(cache_dir, model_name, key);
+
+    if(use_cache && read_cache(file_name, sv, neq, num_beats, key)) {
+        log_info("Using the pre-paced initial conditions of the %s model (label %g) from %s\n", model_name, label, file_name);
+        free(file_name);
+        return true;
+    }
+
+    real *initial_sv = MALLOC_ARRAY_OF_TYPE(real, neq);
+    real *beat_start = MALLOC_ARRAY_OF_TYPE(real, neq);
+
+    memcpy(initial_sv, sv, neq * sizeof(real));
+
+    for(uint32_t beat = 0; beat < num_beats; beat++) {
+        memcpy(beat_start, sv, neq * sizeof(real));
+        steps(dt, sv, stim_current, stim_steps, label, parameters);
+        steps(dt, sv, 0.0, steps_per_beat - stim_steps, label, parameters);
+    }
+
+    // The change of the state in the last beat shows how close to the limit cycle the cell is
+    real max_change = 0.0;
+    for(uint32_t i = 0; i < neq; i++) {
+        real scale = fmax(fabs(beat_start[i]), fabs(sv[i]));
+        real change = (scale > 0.0) ? fabs(sv[i] - beat_start[i]) / scale : 0.0;
+        if(isnan(sv[i])) {
+            change = INFINITY;
+        }
+        max_change = fmax(max_change, change);
+    }
+
+    free(beat_start);
+
+    log_info("Pre-paced the %s model (label %g) for %u beats of %g ms. Maximum relative change of the state in the last beat: %e\n", model_name,
+             label, num_beats, bcl, max_change);
+
+    bool diverged = isinf(max_change);
+
+    if(diverged) {
+        log_warn("The pre-pacing of the %s model (label %g) diverged. Using the default initial conditions!\n", model_name, label);
+        memcpy(sv, initial_sv, neq * sizeof(real));
+    } else if(use_cache) {
+        write_cache(cache_dir, file_name, sv, neq, num_beats, key);
+    }
+
+    free(initial_sv);
+    free(file_name);
+
+    return !diverged;
+}
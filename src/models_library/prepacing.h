@@ -0,0 +1,24 @@
+//
+// Pre-pacing of the initial conditions of the CPU models. A single cell is paced to steady state for each combination
+// of parameters and label (e.g., the transmurality) and the result is cached on disk.
+//
+
+#ifndef MONOALG3D_C_PREPACING_H
+#define MONOALG3D_C_PREPACING_H
+
+#include "model_common.h"
+
+#define PREPACING_DEFAULT_BCL (1000.0)
+#define PREPACING_DEFAULT_STIM_DURATION (1.0)
+#define PREPACING_DEFAULT_CACHE_DIR "prepacing_cache"
+
+// Advances one cell num_steps fixed steps of size dt. label and parameters are the ones given to prepace_cell
+#define PREPACING_STEPS(name) void name(real dt, real *sv, real stim_current, uint32_t num_steps, real label, const real *parameters)
+typedef PREPACING_STEPS(prepacing_steps_fn);
+
+bool prepacing_enabled(struct string_hash_entry *ode_extra_config);
+
+bool prepace_cell(struct string_hash_entry *ode_extra_config, real dt, real *sv, uint32_t neq, real label, const real *parameters,
+                  uint32_t num_parameters, real stim_current, prepacing_steps_fn *steps, const char *model_name);
+
+#endif // MONOALG3D_C_PREPACING_H
@@ -0,0 +1,18 @@
+//
+// The code between this header and single_precision_cpu_end.h is compiled with float as real and with the single
+// precision math functions. It is used by the CPU models to build single precision versions of their kernels in the
+// same library, next to the double precision ones. The floating point literals of the model code used in these blocks
+// must be written as REAL_LIT(1.0) (see model_common.h), or the expressions are computed in double precision. This
+// header has no include guard, as it can be used more than once.
+//
+
+#define real float
+#define exp expf
+#define pow powf
+#define log logf
+#define sqrt sqrtf
+#define fabs fabsf
+#define expm1 expm1f
+
+#undef REAL_LIT
+#define REAL_LIT(x) x##f
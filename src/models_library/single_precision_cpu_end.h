@@ -0,0 +1,14 @@
+//
+// Ends a block of single precision code started with single_precision_cpu_begin.h
+//
+
+#undef real
+#undef exp
+#undef pow
+#undef log
+#undef sqrt
+#undef fabs
+#undef expm1
+
+#undef REAL_LIT
+#define REAL_LIT(x) x
@@ -16,16 +16,16 @@ COMPILE_MODEL_LIB "ten_tusscher_2004_endo" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "
 ##########################################################
 
 ############## TEN TUSCHER 3 ENDO ##############################
-MODEL_FILE_CPU="ten_tusscher_3_RS_CPU.c"
+MODEL_FILE_CPU="ten_tusscher_3_RS_CPU.c ../lookup_table.c"
 MODEL_FILE_GPU="ten_tusscher_3_RS_GPU.cu"
-COMMON_HEADERS="ten_tusscher_3_RS.h"
+COMMON_HEADERS="ten_tusscher_3_RS.h ../lookup_table.h ../single_precision_cpu_begin.h ../single_precision_cpu_end.h"
 COMPILE_MODEL_LIB "ten_tusscher_3_endo" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS" "-DENDO"
 ##########################################################
 
 ############## TEN TUSCHER 3 EPI ##############################
-MODEL_FILE_CPU="ten_tusscher_3_RS_CPU.c"
+MODEL_FILE_CPU="ten_tusscher_3_RS_CPU.c ../lookup_table.c"
 MODEL_FILE_GPU="ten_tusscher_3_RS_GPU.cu"
-COMMON_HEADERS="ten_tusscher_3_RS.h"
+COMMON_HEADERS="ten_tusscher_3_RS.h ../lookup_table.h ../single_precision_cpu_begin.h ../single_precision_cpu_end.h"
 COMPILE_MODEL_LIB "ten_tusscher_3_epi" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS" "-DEPI"
 ##########################################################
 
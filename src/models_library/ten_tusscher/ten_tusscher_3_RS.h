@@ -24,7 +24,12 @@ inline __device__ void RHS_gpu(real *sv_, real *rDY_, real stim_current, int thr
 
 #endif
 
+struct lookup_table;
+
 void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt, real fibrosis, real const *extra_parameters);
+void RHS_currents_cpu(const real *sv, real *rDY_, real stim_current, real dt, real fibrosis, real const *extra_parameters);
 void solve_model_ode_cpu(real dt, real *sv, real stim_current, real fibrosis, real *extra_parameters);
+void solve_model_ode_lookup_table_cpu(real dt, real *sv, real stim_current, real fibrosis, real *extra_parameters, const struct lookup_table *table);
+void solve_model_odes_single_precision_cpu(real dt, real *sv, real stim_current, real fibrosis, const float *extra_parameters, uint32_t num_steps);
 
 #endif //MONOALG3D_MODEL_TEN_TUSSCHER_3_H
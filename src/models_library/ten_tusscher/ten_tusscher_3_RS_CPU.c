@@ -1,6 +1,37 @@
 #include <assert.h>
 #include <stdlib.h>
 #include "ten_tusscher_3_RS.h"
+#include "../lookup_table.h"
+
+// Gates 1 to 8 store (inf, exp(-dt/tau)). D_INF, R_INF and Xr2_INF store only the steady state value
+#define NUM_LOOKUP_TABLE_COLUMNS 19
+
+static LOOKUP_TABLE_ROW(gates_lookup_table_row) {
+
+    const real svolt = v;
+
+    #include "ten_tusscher_3_RS_gates.inc"
+
+    row[0]  = M_INF;
+    row[1]  = exp(-dt/TAU_M);
+    row[2]  = H_INF;
+    row[3]  = exp(-dt/TAU_H);
+    row[4]  = J_INF;
+    row[5]  = exp(-dt/TAU_J);
+    row[6]  = Xr1_INF;
+    row[7]  = exp(-dt/TAU_Xr1);
+    row[8]  = Xs_INF;
+    row[9]  = exp(-dt/TAU_Xs);
+    row[10] = S_INF;
+    row[11] = exp(-dt/TAU_S);
+    row[12] = F_INF;
+    row[13] = exp(-dt/TAU_F);
+    row[14] = F2_INF;
+    row[15] = exp(-dt/TAU_F2);
+    row[16] = D_INF_new;
+    row[17] = R_INF_new;
+    row[18] = Xr2_INF_new;
+}
 
 GET_CELL_MODEL_DATA(init_cell_model_data) {
 
@@ -53,6 +84,19 @@ SET_ODE_INITIAL_CONDITIONS_CPU(set_model_initial_conditions_cpu) {
             sv[10] = 0.0; //R_INF
             sv[11] = 0.0; //Xr2_INF
         }
+
+    if(lookup_table_enabled(ode_extra_config, solver->adaptive)) {
+        solver->lookup_table = new_lookup_table_from_config(ode_extra_config, solver->min_dt, NUM_LOOKUP_TABLE_COLUMNS, gates_lookup_table_row, NULL,
+                                                            "ten Tusscher 3");
+    }
+
+    if(single_precision_enabled(ode_extra_config)) {
+        if(solver->lookup_table) {
+            log_warn("The single precision kernels are not used with the lookup table!\n");
+        } else {
+            log_info("Using the single precision ten Tusscher 3 kernels\n");
+        }
+    }
 }
 
 SOLVE_MODEL_ODES(solve_model_odes_cpu) {
@@ -65,6 +109,8 @@ SOLVE_MODEL_ODES(solve_model_odes_cpu) {
     real *sv = ode_solver->sv;
     real dt = ode_solver->min_dt;
     uint32_t num_steps = ode_solver->num_steps;
+    const struct lookup_table *table = ode_solver->lookup_table;
+    bool single_precision = !table && single_precision_enabled(ode_extra_config);
 
     int num_extra_parameters = 8;
     real extra_par[num_extra_parameters];
@@ -104,6 +150,11 @@ SOLVE_MODEL_ODES(solve_model_odes_cpu) {
         deallocate = true;
     }
 
+    float extra_par_single[num_extra_parameters];
+    for(int k = 0; k < num_extra_parameters; k++) {
+        extra_par_single[k] = (float)extra_par[k];
+    }
+
     int i;
 
     OMP(parallel for private(sv_id))
@@ -113,9 +164,18 @@ SOLVE_MODEL_ODES(solve_model_odes_cpu) {
         else
             sv_id = i;
 
-        for (int j = 0; j < num_steps; ++j) {
-            solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], fibrosis[i], extra_par);
-
+        if(table) {
+            for (int j = 0; j < num_steps; ++j) {
+                solve_model_ode_lookup_table_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], fibrosis[i], extra_par, table);
+            }
+        }
+        else if(single_precision) {
+            solve_model_odes_single_precision_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], fibrosis[i], extra_par_single, num_steps);
+        }
+        else {
+            for (int j = 0; j < num_steps; ++j) {
+                solve_model_ode_cpu(dt, sv + (sv_id * NEQ), stim_currents[i], fibrosis[i], extra_par);
+            }
         }
     }
 
@@ -149,6 +209,30 @@ void solve_model_ode_cpu(real dt, real *sv, real stim_current, real fibrosis, re
     sv[11]  = rDY[11];
 }
 
+// Same as solve_model_ode_cpu, but the gates are updated using the precomputed voltage lookup table
+void solve_model_ode_lookup_table_cpu(real dt, real *sv, real stim_current, real fibrosis, real *extra_parameters, const struct lookup_table *table) {
+
+    real rY[NEQ], rDY[NEQ];
+    real gates[NUM_LOOKUP_TABLE_COLUMNS];
+
+    for(int i = 0; i < NEQ; i++)
+        rY[i] = sv[i];
+
+    lookup_table_interpolate(table, rY[0], gates);
+
+    RHS_currents_cpu(rY, rDY, stim_current, dt, fibrosis, extra_parameters);
+
+    sv[0] = dt*rDY[0] + rY[0];
+
+    for(int i = 1; i <= 8; i++) {
+        const real inf = gates[2*(i - 1)];
+        sv[i] = inf - (inf - rY[i])*gates[2*i - 1];
+    }
+
+    sv[9]  = gates[16];
+    sv[10] = gates[17];
+    sv[11] = gates[18];
+}
 
 void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt, real fibrosis, real const *extra_parameters) {
 
@@ -170,3 +254,80 @@ void RHS_cpu(const real *sv, real *rDY_, real stim_current, real dt, real fibros
 
     #include "ten_tusscher_3_RS_common.inc"
 }
+
+// Only computes rDY_[0]. The gating kinetics come from the lookup table
+void RHS_currents_cpu(const real *sv, real *rDY_, real stim_current, real dt, real fibrosis, real const *extra_parameters) {
+
+    const real svolt    = sv[0];
+    const real sm       = sv[1];
+    const real sh       = sv[2];
+    const real sj       = sv[3];
+    const real sxr1     = sv[4];
+    const real sxs      = sv[5];
+    const real ss       = sv[6];
+    const real sf       = sv[7];
+    const real sf2      = sv[8];
+    const real D_INF    = sv[9];
+    const real R_INF    = sv[10];
+    const real Xr2_INF  = sv[11];
+
+    #define GATES_FROM_LOOKUP_TABLE
+    #include "ten_tusscher_3_RS_common.inc"
+    #undef GATES_FROM_LOOKUP_TABLE
+}
+
+#include "../single_precision_cpu_begin.h"
+
+// Single precision versions of RHS_cpu and solve_model_ode_cpu. REAL_LIT makes the literals of the model code float, so
+// no expression is promoted to double
+static void RHS_single_cpu(const real *sv, real *rDY_, real stim_current, real dt, real fibrosis, real const *extra_parameters) {
+
+    const real svolt    = sv[0];
+    const real sm       = sv[1];
+    const real sh       = sv[2];
+    const real sj       = sv[3];
+    const real sxr1     = sv[4];
+    const real sxs      = sv[5];
+    const real ss       = sv[6];
+    const real sf       = sv[7];
+    const real sf2      = sv[8];
+    const real D_INF    = sv[9];
+    const real R_INF    = sv[10];
+    const real Xr2_INF  = sv[11];
+
+    #include "ten_tusscher_3_RS_common.inc"
+}
+
+static void solve_model_ode_single_cpu(real dt, real *sv, real stim_current, real fibrosis, real const *extra_parameters) {
+
+    real rY[NEQ], rDY[NEQ];
+
+    for(int i = 0; i < NEQ; i++)
+        rY[i] = sv[i];
+
+    RHS_single_cpu(rY, rDY, stim_current, dt, fibrosis, extra_parameters);
+
+    sv[0] = dt*rDY[0] + rY[0];
+
+    for(int i = 1; i < NEQ; i++)
+        sv[i] = rDY[i];
+}
+
+#include "../single_precision_cpu_end.h"
+
+// Solves num_steps steps of one cell with the single precision kernels. The state is converted to float and back only
+// once for all the steps
+void solve_model_odes_single_precision_cpu(real dt, real *sv, real stim_current, real fibrosis, const float *extra_parameters, uint32_t num_steps) {
+
+    float sv_single[NEQ];
+
+    for(int i = 0; i < NEQ; i++)
+        sv_single[i] = (float)sv[i];
+
+    for(uint32_t j = 0; j < num_steps; j++) {
+        solve_model_ode_single_cpu((float)dt, sv_single, (float)stim_current, (float)fibrosis, extra_parameters);
+    }
+
+    for(int i = 0; i < NEQ; i++)
+        sv[i] = (real)sv_single[i];
+}
@@ -1,7 +1,7 @@
 ############## TROVATO_2019 ##############################
 MODEL_FILE_CPU="trovato_2019.c"
 MODEL_FILE_GPU="trovato_2019.cu"
-COMMON_HEADERS="trovato_2019.h"
+COMMON_HEADERS="trovato_2019.h ../adaptive_rush_larsen.h ../adaptive_rush_larsen.common.c"
 
 COMPILE_MODEL_LIB "trovato_2019" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS"
 ##########################################################
@@ -9,7 +9,7 @@ COMPILE_MODEL_LIB "trovato_2019" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HE
 ############## TROVATO_2020 ##############################
 MODEL_FILE_CPU="trovato_2020.c"
 MODEL_FILE_GPU="trovato_2020.cu"
-COMMON_HEADERS="trovato_2020.h"
+COMMON_HEADERS="trovato_2020.h ../adaptive_rush_larsen.h ../adaptive_rush_larsen.common.c"
 
 COMPILE_MODEL_LIB "trovato_2020" "$MODEL_FILE_CPU" "$MODEL_FILE_GPU" "$COMMON_HEADERS"
 ##########################################################
\ No newline at end of file
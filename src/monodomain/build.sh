@@ -1,4 +1,4 @@
-MONODOMAIN_SOURCE_FILES="monodomain_solver.c"
-MONODOMAIN_HEADER_FILES="monodomain_solver.h"
+MONODOMAIN_SOURCE_FILES="monodomain_solver.c ensemble.c"
+MONODOMAIN_HEADER_FILES="monodomain_solver.h ensemble.h"
 
 COMPILE_STATIC_LIB "monodomain" "$MONODOMAIN_SOURCE_FILES" "$MONODOMAIN_HEADER_FILES"
@@ -0,0 +1,441 @@
+//
+// Ensemble (population of models) mode. See ensemble.h
+//
+
+#include "ensemble.h"
+
+#include <dlfcn.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../3dparty/ini_parser/ini_file_sections.h"
+#include "../3dparty/sds/sds.h"
+#include "../3dparty/stb_ds.h"
+#include "../config/extra_data_config.h"
+#include "../config/linear_system_solver_config.h"
+#include "../config/update_monodomain_config.h"
+#include "../config_helpers/config_helpers.h"
+#include "../logger/logger.h"
+#include "../utils/file_utils.h"
+
+#define ENSEMBLE_VM_MATRIX_CHUNK_SIZE (16 * 1024 * 1024)
+
+bool ensemble_enabled(struct user_options *configs) {
+    return shlen(configs->ensemble_config) > 0;
+}
+
+// The solver for many right-hand sides is the function multi_rhs_function of the [linear_system_solver] section, or
+// the main function name followed by _multi_rhs. Returns NULL when the library has no such function
+static linear_system_solver_multi_rhs_fn *get_multi_rhs_solver(struct config *linear_system_solver_config) {
+
+    if(!linear_system_solver_config || !linear_system_solver_config->handle) {
+        return NULL;
+    }
+
+    char *function_name = NULL;
+    GET_PARAMETER_STRING_VALUE_OR_USE_DEFAULT(function_name, linear_system_solver_config, "multi_rhs_function");
+
+    sds name;
+    if(function_name) {
+        name = sdsnew(function_name);
+    } else {
+        name = sdscatfmt(sdsempty(), "%s_multi_rhs", linear_system_solver_config->main_function_name);
+    }
+
+    dlerror();
+    linear_system_solver_multi_rhs_fn *solver = (linear_system_solver_multi_rhs_fn *)dlsym(linear_system_solver_config->handle, name);
+
+    if(dlerror() != NULL) {
+        if(function_name) {
+            log_error_and_exit("'%s' function not found in the provided in library %s\n", name, linear_system_solver_config->library_file_path);
+        }
+        solver = NULL;
+    }
+
+    if(solver) {
+        log_info("Ensemble linear systems solved together by %s\n", name);
+    } else {
+        log_info("%s not found in %s. The ensemble linear systems will be solved one at a time\n", name, linear_system_solver_config->library_file_path);
+    }
+
+    sdsfree(name);
+    free(function_name);
+
+    return solver;
+}
+
+static enum vm_matrix_value_type get_vm_matrix_value_type(const char *precision) {
+
+    enum vm_matrix_value_type value_type = VM_MATRIX_FLOAT64;
+
+    if(precision) {
+        if(STRINGS_EQUAL(precision, "float")) {
+            value_type = VM_MATRIX_FLOAT32;
+        } else if(STRINGS_EQUAL(precision, "half")) {
+            value_type = VM_MATRIX_FLOAT16;
+        } else if(!STRINGS_EQUAL(precision, "double")) {
+            log_error_and_exit("Invalid vm_matrix_precision %s in the [%s] section. Valid values are double, float and half.\n", precision,
+                               ENSEMBLE_SECTION);
+        }
+    }
+
+    return value_type;
+}
+
+// The extra data of a member is created with its values in the [extra_data] section. The original values are restored
+// after that, so the next member starts from the configuration of the file
+static void set_member_extra_data(struct ensemble_member *member, struct config *extra_data_config, struct time_info *time_info, struct grid *the_grid) {
+
+    struct ode_solver *solver = member->ode_solver;
+
+    if(solver->ode_extra_data) {
+        CALL_FREE_EXTRA_DATA(extra_data_config, solver->ode_extra_data);
+        solver->ode_extra_data = NULL;
+    }
+
+    long num_parameters = arrlen(member->parameters);
+    char **original_values = MALLOC_ARRAY_OF_TYPE(char *, num_parameters);
+
+    for(long p = 0; p < num_parameters; p++) {
+        original_values[p] = shget(extra_data_config->config_data, member->parameters[p].name);
+        shput(extra_data_config->config_data, member->parameters[p].name, strdup(member->parameters[p].value));
+    }
+
+    solver->ode_extra_data = ((set_extra_data_fn *)extra_data_config->main_function)(time_info, extra_data_config, the_grid, &(solver->extra_data_size));
+
+    if(solver->ode_extra_data == NULL) {
+        log_warn("set_extra_data function was called but returned NULL!\n");
+    }
+
+    for(long p = 0; p < num_parameters; p++) {
+        char *name = member->parameters[p].name;
+        free(shget(extra_data_config->config_data, name));
+
+        if(original_values[p]) {
+            shput(extra_data_config->config_data, name, original_values[p]);
+        } else {
+            (void)shdel(extra_data_config->config_data, name);
+        }
+    }
+
+    free(original_values);
+}
+
+static void write_ensemble_members_file(struct ensemble *ensemble, char *out_dir_name) {
+
+    sds file_name = sdscatfmt(sdsempty(), "%s/ensemble_members.txt", out_dir_name);
+    FILE *f = fopen(file_name, "w");
+
+    if(!f) {
+        log_error_and_exit("Could not open %s!\n", file_name);
+    }
+
+    for(uint32_t k = 0; k < ensemble->num_members; k++) {
+        struct changed_parameters *parameters = ensemble->members[k].parameters;
+
+        fprintf(f, "member_%u", k);
+        for(long p = 0; p < arrlen(parameters); p++) {
+            fprintf(f, " %s|%s=%s", parameters[p].section, parameters[p].name, parameters[p].value);
+        }
+        fprintf(f, "\n");
+    }
+
+    fclose(f);
+    sdsfree(file_name);
+}
+
+// Creates the members after the initial conditions of the PDE were set. The first member uses the_ode_solver (its
+// extra data and initial conditions are set again with the values of the member) and the others use new ODE solvers
+// configured as the_ode_solver. When out_dir_name is not NULL the Vm of member k is saved in
+// out_dir_name/member_k/Vm_matrix.bin (see save_ensemble_vms) and the values of each member are listed in
+// out_dir_name/ensemble_members.txt
+struct ensemble *new_ensemble(struct user_options *configs, struct ode_solver *the_ode_solver, struct grid *the_grid, struct time_info *time_info,
+                              char *out_dir_name) {
+
+    struct string_hash_entry *directives = NULL;
+    sh_new_arena(directives);
+    shdefault(directives, NULL);
+
+    char *precision = NULL;
+
+    for(long i = 0; i < shlen(configs->ensemble_config); i++) {
+        char *name = configs->ensemble_config[i].key;
+        char *value = configs->ensemble_config[i].value;
+
+        if(strchr(name, '|')) {
+            shput(directives, name, value);
+        } else if(STRINGS_EQUAL(name, "vm_matrix_precision")) {
+            precision = value;
+        } else {
+            log_error_and_exit("Invalid name %s in the [%s] section!\n", name, ENSEMBLE_SECTION);
+        }
+    }
+
+    struct simulation *simulations = generate_all_simulations(directives, 1);
+    shfree(directives);
+
+    if(simulations == NULL) {
+        log_error_and_exit("Error parsing the [%s] section! The members are given by section|name = list|v1|v2|... or range|start|end|increment\n",
+                           ENSEMBLE_SECTION);
+    }
+
+    struct config *extra_data_config = configs->extra_data_config;
+
+    for(long i = 0; i < arrlen(simulations[0].parameters); i++) {
+        struct changed_parameters *parameter = &simulations[0].parameters[i];
+
+        if(!STRINGS_EQUAL(parameter->section, EXTRA_DATA_SECTION)) {
+            log_error_and_exit("Only the parameters of the [%s] section can change in an ensemble (%s|%s given)!\n", EXTRA_DATA_SECTION,
+                               parameter->section, parameter->name);
+        }
+
+        if(extra_data_config == NULL) {
+            log_error_and_exit("The ensemble changes the parameter %s of the [%s] section, but there is no [%s] section!\n", parameter->name,
+                               EXTRA_DATA_SECTION, EXTRA_DATA_SECTION);
+        }
+    }
+
+    enum vm_matrix_value_type value_type = get_vm_matrix_value_type(precision);
+
+    struct ensemble *ensemble = CALLOC_ONE_TYPE(struct ensemble);
+
+    uint32_t num_cells = the_grid->num_active_cells;
+    uint32_t num_members = (uint32_t)arrlen(simulations);
+
+    ensemble->num_members = num_members;
+    ensemble->num_cells = num_cells;
+    ensemble->simulations = simulations;
+    ensemble->members = CALLOC_ARRAY_OF_TYPE(struct ensemble_member, num_members);
+    ensemble->vms = MALLOC_ARRAY_OF_TYPE(real_cpu, (size_t)num_members * num_cells);
+    ensemble->bs = CALLOC_ARRAY_OF_TYPE(real_cpu, (size_t)num_members * num_cells);
+
+    log_info("Ensemble with %u members\n", num_members);
+
+    if(out_dir_name) {
+        log_warn("The ensemble saves the Vm of each member in %s/member_k/Vm_matrix.bin. Only output_dir, print_rate and start_saving_after_dt "
+                 "are used from the [%s] section. Its main function (%s) and other options are ignored!\n",
+                 out_dir_name, SAVE_RESULT_SECTION, configs->save_mesh_config->main_function_name);
+    }
+
+    ensemble->solve_linear_systems = get_multi_rhs_solver(configs->linear_system_solver_config);
+
+    if(ensemble->solve_linear_systems) {
+        ensemble->iterations = MALLOC_ARRAY_OF_TYPE(uint32_t, num_members);
+        ensemble->errors = MALLOC_ARRAY_OF_TYPE(real_cpu, num_members);
+    }
+
+    struct cell_node **ac = the_grid->active_cells;
+
+    for(uint32_t k = 0; k < num_members; k++) {
+
+        struct ensemble_member *member = &ensemble->members[k];
+
+        member->parameters = simulations[k].parameters;
+        member->vm = ensemble->vms + (size_t)k * num_cells;
+        member->b = ensemble->bs + (size_t)k * num_cells;
+
+        OMP(parallel for)
+        for(uint32_t i = 0; i < num_cells; i++) {
+            member->vm[i] = ac[i]->v;
+        }
+
+        if(k == 0) {
+            member->ode_solver = the_ode_solver;
+        } else {
+            member->ode_solver = new_ode_solver();
+            configure_ode_solver_from_options(member->ode_solver, configs);
+            init_ode_solver_with_cell_model(member->ode_solver);
+
+            member->ode_solver->original_num_cells = the_ode_solver->original_num_cells;
+            member->ode_solver->num_cells_to_solve = the_ode_solver->num_cells_to_solve;
+            member->ode_solver->num_steps = the_ode_solver->num_steps;
+        }
+
+        if(extra_data_config) {
+            set_member_extra_data(member, extra_data_config, time_info, the_grid);
+        }
+
+        set_ode_initial_conditions_for_all_volumes(member->ode_solver, configs->ode_extra_config);
+
+        if(out_dir_name) {
+            sds member_dir = sdscatprintf(sdsempty(), "%s/member_%u", out_dir_name, k);
+            create_dir(member_dir);
+
+            sds data_file = sdscatfmt(sdsempty(), "%s/Vm_matrix.bin", member_dir);
+            sds index_file = sdscatfmt(sdsempty(), "%s/Vm_matrix_index.bin", member_dir);
+
+            member->writer = new_vm_matrix_writer(data_file, index_file, value_type, 1, ENSEMBLE_VM_MATRIX_CHUNK_SIZE);
+
+            if(!member->writer) {
+                log_error_and_exit("Could not open %s!\n", data_file);
+            }
+
+            sdsfree(member_dir);
+            sdsfree(data_file);
+            sdsfree(index_file);
+        }
+    }
+
+    if(out_dir_name) {
+        write_ensemble_members_file(ensemble, out_dir_name);
+    }
+
+    return ensemble;
+}
+
+void free_ensemble(struct ensemble *ensemble, struct ode_solver *the_ode_solver) {
+
+    if(!ensemble) {
+        return;
+    }
+
+    for(uint32_t k = 0; k < ensemble->num_members; k++) {
+        struct ensemble_member *member = &ensemble->members[k];
+
+        if(member->writer) {
+            free_vm_matrix_writer(member->writer);
+        }
+
+        if(member->ode_solver != the_ode_solver) {
+            free_ode_solver(member->ode_solver);
+        }
+
+        for(long p = 0; p < arrlen(member->parameters); p++) {
+            free(member->parameters[p].section);
+            free(member->parameters[p].name);
+            free(member->parameters[p].value);
+        }
+
+        arrfree(member->parameters);
+    }
+
+    arrfree(ensemble->simulations);
+    free(ensemble->members);
+    free(ensemble->vms);
+    free(ensemble->bs);
+    free(ensemble->iterations);
+    free(ensemble->errors);
+    free(ensemble);
+}
+
+static void load_member_vm(struct ensemble_member *member, uint32_t num_cells, struct cell_node **ac) {
+    OMP(parallel for)
+    for(uint32_t i = 0; i < num_cells; i++) {
+        ac[i]->v = member->vm[i];
+    }
+}
+
+bool update_ensemble_state_vectors_and_check_for_activity(struct ensemble *ensemble, real_cpu vm_threshold, struct grid *the_grid) {
+
+    bool activity = false;
+
+    for(uint32_t k = 0; k < ensemble->num_members; k++) {
+        struct ensemble_member *member = &ensemble->members[k];
+        load_member_vm(member, ensemble->num_cells, the_grid->active_cells);
+        activity |= update_ode_state_vector_and_check_for_activity(vm_threshold, member->ode_solver, NULL, the_grid);
+    }
+
+    return activity;
+}
+
+// The stimuli are merged once for all members and the right-hand side of each member is kept in member->b
+void solve_ensemble_odes(struct ensemble *ensemble, struct time_info *time_info, struct config *update_monodomain_config, struct grid *the_grid,
+                         struct monodomain_solver *the_monodomain_solver, struct string_voidp_hash_entry *stim_configs,
+                         struct string_hash_entry *ode_extra_config) {
+
+    uint32_t num_cells = ensemble->num_cells;
+    struct cell_node **ac = the_grid->active_cells;
+
+    real *merged_stims = merge_stimuli(ensemble->members[0].ode_solver, time_info->current_t, stim_configs);
+
+    for(uint32_t k = 0; k < ensemble->num_members; k++) {
+        struct ensemble_member *member = &ensemble->members[k];
+
+        solve_all_volumes_odes_with_stimuli(member->ode_solver, time_info->current_t, merged_stims, ode_extra_config);
+
+        ((update_monodomain_fn *)update_monodomain_config->main_function)(time_info, update_monodomain_config, the_grid, the_monodomain_solver, num_cells,
+                                                                          ac, member->ode_solver, member->ode_solver->original_num_cells);
+
+        OMP(parallel for)
+        for(uint32_t i = 0; i < num_cells; i++) {
+            member->b[i] = ac[i]->b;
+        }
+    }
+
+    free(merged_stims);
+}
+
+// Solves the linear system of each member with the same matrix. number_of_iterations is the sum of the iterations of
+// all members and error is the largest error (NaN if the solution of any member has a NaN)
+void solve_ensemble_linear_systems(struct ensemble *ensemble, struct time_info *time_info, struct config *linear_system_solver_config,
+                                   struct grid *the_grid, uint32_t *number_of_iterations, real_cpu *error) {
+
+    uint32_t num_cells = ensemble->num_cells;
+    struct cell_node **ac = the_grid->active_cells;
+
+    *number_of_iterations = 0;
+    *error = 0.0;
+
+    if(ensemble->solve_linear_systems) {
+
+        ensemble->solve_linear_systems(time_info, linear_system_solver_config, the_grid, num_cells, ac, ensemble->num_members, ensemble->vms,
+                                       ensemble->bs, ensemble->iterations, ensemble->errors);
+
+        for(uint32_t k = 0; k < ensemble->num_members; k++) {
+            *number_of_iterations += ensemble->iterations[k];
+
+            if(isnan(ensemble->errors[k]) || ensemble->errors[k] > *error) {
+                *error = ensemble->errors[k];
+            }
+
+            if(isnan(*error)) {
+                break;
+            }
+        }
+
+        return;
+    }
+
+    for(uint32_t k = 0; k < ensemble->num_members; k++) {
+        struct ensemble_member *member = &ensemble->members[k];
+
+        OMP(parallel for)
+        for(uint32_t i = 0; i < num_cells; i++) {
+            ac[i]->v = member->vm[i];
+            ac[i]->b = member->b[i];
+        }
+
+        uint32_t member_iterations = 0;
+        real_cpu member_error = 0.0;
+
+        ((linear_system_solver_fn *)linear_system_solver_config->main_function)(time_info, linear_system_solver_config, the_grid, num_cells, ac,
+                                                                                &member_iterations, &member_error);
+
+        OMP(parallel for)
+        for(uint32_t i = 0; i < num_cells; i++) {
+            member->vm[i] = ac[i]->v;
+        }
+
+        *number_of_iterations += member_iterations;
+
+        if(isnan(member_error) || member_error > *error) {
+            *error = member_error;
+        }
+
+        if(isnan(*error)) {
+            break;
+        }
+    }
+}
+
+void save_ensemble_vms(struct ensemble *ensemble, struct time_info *time_info) {
+
+    for(uint32_t k = 0; k < ensemble->num_members; k++) {
+        struct ensemble_member *member = &ensemble->members[k];
+
+        if(member->writer) {
+            vm_matrix_writer_add_frame(member->writer, time_info->current_t, member->vm, ensemble->num_cells);
+        }
+    }
+}
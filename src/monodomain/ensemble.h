@@ -0,0 +1,67 @@
+//
+// Ensemble (population of models) mode. All members share the grid, the stimuli and the assembled matrix, and each one
+// has its own ODE state vectors, extra data and Vm. The members are the combinations of the values given in the
+// [ensemble] section, with the syntax of the batch runner:
+//
+// [ensemble]
+// extra_data|IKr_Multiplier = list|0.5|1.0|1.5
+// extra_data|ICaL_Multiplier = range|0.8|1.2|0.2
+//
+// When the linear system solver library has a SOLVE_LINEAR_SYSTEM_MULTI_RHS function (multi_rhs_function in the
+// [linear_system_solver] section, default <main_function>_multi_rhs), the systems of all members are solved by one call.
+// Otherwise, the main function is called for each member.
+//
+
+#ifndef MONOALG3D_ENSEMBLE_H
+#define MONOALG3D_ENSEMBLE_H
+
+#include "../alg/grid/grid.h"
+#include "../config/config_parser.h"
+#include "../config/linear_system_solver_config.h"
+#include "../ode_solver/ode_solver.h"
+#include "../utils/batch_utils.h"
+#include "../utils/vm_matrix.h"
+#include "monodomain_solver.h"
+
+struct ensemble_member {
+    struct ode_solver *ode_solver;
+    struct changed_parameters *parameters;
+    real_cpu *vm; // Indexed as the active cells of the grid
+    real_cpu *b;
+    struct vm_matrix_writer *writer;
+};
+
+struct ensemble {
+    uint32_t num_members;
+    uint32_t num_cells;
+    struct ensemble_member *members;
+    struct simulation *simulations;
+
+    // The Vm and the right-hand sides of all members, stored member after member
+    real_cpu *vms;
+    real_cpu *bs;
+
+    // NULL when the solver has no multi right-hand side function
+    linear_system_solver_multi_rhs_fn *solve_linear_systems;
+    uint32_t *iterations;
+    real_cpu *errors;
+};
+
+bool ensemble_enabled(struct user_options *configs);
+
+struct ensemble *new_ensemble(struct user_options *configs, struct ode_solver *the_ode_solver, struct grid *the_grid, struct time_info *time_info,
+                              char *out_dir_name);
+void free_ensemble(struct ensemble *ensemble, struct ode_solver *the_ode_solver);
+
+bool update_ensemble_state_vectors_and_check_for_activity(struct ensemble *ensemble, real_cpu vm_threshold, struct grid *the_grid);
+
+void solve_ensemble_odes(struct ensemble *ensemble, struct time_info *time_info, struct config *update_monodomain_config, struct grid *the_grid,
+                         struct monodomain_solver *the_monodomain_solver, struct string_voidp_hash_entry *stim_configs,
+                         struct string_hash_entry *ode_extra_config);
+
+void solve_ensemble_linear_systems(struct ensemble *ensemble, struct time_info *time_info, struct config *linear_system_solver_config,
+                                   struct grid *the_grid, uint32_t *number_of_iterations, real_cpu *error);
+
+void save_ensemble_vms(struct ensemble *ensemble, struct time_info *time_info);
+
+#endif // MONOALG3D_ENSEMBLE_H
@@ -17,6 +17,7 @@
 #include "../save_mesh_library/save_mesh_helper.h"
 #include "../utils/file_utils.h"
 #include "../utils/stop_watch.h"
+#include "ensemble.h"
 #include "monodomain_solver.h"
 #include <assert.h>
 #include <inttypes.h>
@@ -82,6 +83,8 @@ int solve_monodomain(struct monodomain_solver *the_monodomain_solver, struct ode
     bool has_extra_data = (extra_data_config != NULL);
     bool has_purkinje_extra_data = (purkinje_extra_data_config != NULL);
 
+    bool use_ensemble = ensemble_enabled(configs);
+
     real_cpu last_stimulus_time = -1.0;
     bool has_any_periodic_stim = false;
 
@@ -265,6 +268,18 @@ int solve_monodomain(struct monodomain_solver *the_monodomain_solver, struct ode
         init_config_functions(purkinje_extra_data_config, "./shared_libs/libdefault_extra_data.so", "extra_data");
     }
 
+    if(use_ensemble) {
+        if(purkinje_config || !domain_config || the_grid->adaptive || num_modify_domains || calc_ecg || save_checkpoint || restore_checkpoint) {
+            log_error_and_exit("The [ensemble] section can only be used in tissue simulations without Purkinje, adaptivity, domain modifications, "
+                               "ECG and checkpoints!\n");
+        }
+#ifdef COMPILE_GUI
+        if(configs->show_gui) {
+            log_error_and_exit("The [ensemble] section can not be used with the visualization!\n");
+        }
+#endif
+    }
+
     log_msg(LOG_LINE_SEPARATOR);
 
     bool restore_success = false;
@@ -285,6 +300,24 @@ int solve_monodomain(struct monodomain_solver *the_monodomain_solver, struct ode
     } else {
         log_error_and_exit("No update monodomain configuration provided! Exiting!\n");
     }
+
+    // The configuration is complete here. The values read by the GET_PARAMETER macros are parsed once, so the
+    // functions called on every time step do not run the expression parser.
+    STIM_CONFIG_HASH_FOR_EACH_KEY_APPLY_FN_IN_VALUE(stimuli_configs, fill_config_value_cache);
+    STIM_CONFIG_HASH_FOR_EACH_KEY_APPLY_FN_IN_VALUE(purkinje_stimuli_configs, fill_config_value_cache);
+    STIM_CONFIG_HASH_FOR_EACH_KEY_APPLY_FN_IN_VALUE(modify_domain_configs, fill_config_value_cache);
+    fill_config_value_cache(extra_data_config);
+    fill_config_value_cache(purkinje_extra_data_config);
+    fill_config_value_cache(domain_config);
+    fill_config_value_cache(purkinje_config);
+    fill_config_value_cache(assembly_matrix_config);
+    fill_config_value_cache(linear_system_solver_config);
+    fill_config_value_cache(purkinje_linear_system_solver_config);
+    fill_config_value_cache(save_mesh_config);
+    fill_config_value_cache(save_state_config);
+    fill_config_value_cache(restore_state_config);
+    fill_config_value_cache(update_monodomain_config);
+    fill_config_value_cache(calc_ecg_config);
     ///////MAIN CONFIGURATION END//////////////////
 
     int refine_each = the_monodomain_solver->refine_each;
@@ -550,6 +583,14 @@ int solve_monodomain(struct monodomain_solver *the_monodomain_solver, struct ode
 
     total_mat_time = stop_stop_watch(&stop_watch);
 
+    // The members of an ensemble replace the state vectors of the_ode_solver and the Vm of the cells. Each one is saved in
+    // its own directory, so the [save_result] function is not called
+    struct ensemble *the_ensemble = NULL;
+
+    if(use_ensemble) {
+        the_ensemble = new_ensemble(configs, the_ode_solver, the_grid, &time_info, save_to_file ? out_dir_name : NULL);
+    }
+
     start_stop_watch(&solver_time);
 
     int save_state_rate = 0;
@@ -647,7 +688,11 @@ int solve_monodomain(struct monodomain_solver *the_monodomain_solver, struct ode
 
         if(save_to_file && (count % print_rate == 0) && (cur_time >= start_saving_after_dt)) {
             start_stop_watch(&stop_watch);
-            ((save_mesh_fn *)save_mesh_config->main_function)(&time_info, save_mesh_config, the_grid, the_ode_solver, the_purkinje_ode_solver);
+            if(the_ensemble) {
+                save_ensemble_vms(the_ensemble, &time_info);
+            } else {
+                ((save_mesh_fn *)save_mesh_config->main_function)(&time_info, save_mesh_config, the_grid, the_ode_solver, the_purkinje_ode_solver);
+            }
             total_write_time += stop_stop_watch(&stop_watch);
         }
 
@@ -658,7 +703,11 @@ int solve_monodomain(struct monodomain_solver *the_monodomain_solver, struct ode
         }
 
         if(cur_time > 0.0) {
-            activity = update_ode_state_vector_and_check_for_activity(vm_threshold, the_ode_solver, the_purkinje_ode_solver, the_grid);
+            if(the_ensemble) {
+                activity = update_ensemble_state_vectors_and_check_for_activity(the_ensemble, vm_threshold, the_grid);
+            } else {
+                activity = update_ode_state_vector_and_check_for_activity(vm_threshold, the_ode_solver, the_purkinje_ode_solver, the_grid);
+            }
 
             if(abort_on_no_activity && cur_time > last_stimulus_time && cur_time > only_abort_after_dt) {
                 if(!activity) {
@@ -720,10 +769,15 @@ int solve_monodomain(struct monodomain_solver *the_monodomain_solver, struct ode
             start_stop_watch(&stop_watch);
 
             // REACTION
-            solve_all_volumes_odes(the_ode_solver, cur_time, stimuli_configs, configs->ode_extra_config);
-            ((update_monodomain_fn *)update_monodomain_config->main_function)(&time_info, update_monodomain_config, the_grid, the_monodomain_solver,
-                                                                              the_grid->num_active_cells, the_grid->active_cells, the_ode_solver,
-                                                                              original_num_cells);
+            if(the_ensemble) {
+                solve_ensemble_odes(the_ensemble, &time_info, update_monodomain_config, the_grid, the_monodomain_solver, stimuli_configs,
+                                    configs->ode_extra_config);
+            } else {
+                solve_all_volumes_odes(the_ode_solver, cur_time, stimuli_configs, configs->ode_extra_config);
+                ((update_monodomain_fn *)update_monodomain_config->main_function)(&time_info, update_monodomain_config, the_grid, the_monodomain_solver,
+                                                                                  the_grid->num_active_cells, the_grid->active_cells, the_ode_solver,
+                                                                                  original_num_cells);
+            }
 
             ode_total_time += stop_stop_watch(&stop_watch);
 
@@ -741,8 +795,12 @@ int solve_monodomain(struct monodomain_solver *the_monodomain_solver, struct ode
             }
 
             // DIFUSION: Tissue
-            ((linear_system_solver_fn *)linear_system_solver_config->main_function)(
-                &time_info, linear_system_solver_config, the_grid, the_grid->num_active_cells, the_grid->active_cells, &solver_iterations, &solver_error);
+            if(the_ensemble) {
+                solve_ensemble_linear_systems(the_ensemble, &time_info, linear_system_solver_config, the_grid, &solver_iterations, &solver_error);
+            } else {
+                ((linear_system_solver_fn *)linear_system_solver_config->main_function)(
+                    &time_info, linear_system_solver_config, the_grid, the_grid->num_active_cells, the_grid->active_cells, &solver_iterations, &solver_error);
+            }
             if(isnan(solver_error)) {
                 log_error("\nSimulation stopped due to NaN on time %lf. This is probably a problem with the cellular model solver.\n.", cur_time);
 #ifdef COMPILE_GUI
@@ -750,6 +808,7 @@ int solve_monodomain(struct monodomain_solver *the_monodomain_solver, struct ode
                     omp_unset_lock(&gui_config->draw_lock);
                 }
 #endif
+                free_ensemble(the_ensemble, the_ode_solver);
                 return SIMULATION_FINISHED;
             }
 
@@ -996,6 +1055,8 @@ int solve_monodomain(struct monodomain_solver *the_monodomain_solver, struct ode
     if(purkinje_linear_system_solver_config)
         CALL_END_LINEAR_SYSTEM(purkinje_linear_system_solver_config);
 
+    free_ensemble(the_ensemble, the_ode_solver);
+
     return SIMULATION_FINISHED;
 }
 
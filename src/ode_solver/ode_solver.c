@@ -36,6 +36,10 @@ struct ode_solver *new_ode_solver() {
     result->ode_extra_data = NULL;
     result->extra_data_size = 0;
 
+    result->lookup_table = NULL;
+    result->multirate_ratio = 1;
+    result->adaptive_rush_larsen = false;
+
     result->auto_dt = false;
 
     return result;
@@ -60,6 +64,11 @@ void free_ode_solver(struct ode_solver *solver) {
         free(solver->cells_to_solve);
     }
 
+    // The lookup table is allocated as a single block
+    if(solver->lookup_table) {
+        free(solver->lookup_table);
+    }
+
     if(solver->model_data.model_library_path) {
         free(solver->model_data.model_library_path);
     }
@@ -171,6 +180,14 @@ void set_ode_initial_conditions_for_all_volumes(struct ode_solver *solver, struc
             free(solver->sv);
         }
 
+        if(solver->lookup_table != NULL) {
+            free(solver->lookup_table);
+            solver->lookup_table = NULL;
+        }
+
+        solver->multirate_ratio = 1;
+        solver->adaptive_rush_larsen = false;
+
         // We do not malloc here sv anymore. This have to be done in the model solver
         soicc_fn_pt(solver, ode_extra_config);
     }
@@ -180,10 +197,9 @@ void set_ode_initial_conditions_for_all_volumes(struct ode_solver *solver, struc
     }
 }
 
-void solve_all_volumes_odes(struct ode_solver *the_ode_solver, real_cpu cur_time, struct string_voidp_hash_entry *stim_configs,
-                            struct string_hash_entry *ode_extra_config) {
-
-    assert(the_ode_solver->sv);
+// Sum of the stimuli applied to each cell in the ODE steps of this PDE step. The start of the periodic stimuli is
+// moved to the next period here, so this has to be called only once for each PDE step
+real *merge_stimuli(struct ode_solver *the_ode_solver, real_cpu cur_time, struct string_voidp_hash_entry *stim_configs) {
 
     size_t n_active = the_ode_solver->num_cells_to_solve;
 
@@ -234,6 +250,14 @@ void solve_all_volumes_odes(struct ode_solver *the_ode_solver, real_cpu cur_time
         }
     }
 
+    return merged_stims;
+}
+
+void solve_all_volumes_odes_with_stimuli(struct ode_solver *the_ode_solver, real_cpu cur_time, real *merged_stims,
+                                         struct string_hash_entry *ode_extra_config) {
+
+    assert(the_ode_solver->sv);
+
     if(the_ode_solver->gpu) {
 #ifdef COMPILE_CUDA
         solve_model_ode_gpu_fn *solve_odes_fn = the_ode_solver->solve_model_ode_gpu;
@@ -243,7 +267,13 @@ void solve_all_volumes_odes(struct ode_solver *the_ode_solver, real_cpu cur_time
         solve_model_ode_cpu_fn *solve_odes_fn = the_ode_solver->solve_model_ode_cpu;
         solve_odes_fn(the_ode_solver, ode_extra_config, cur_time, merged_stims);
     }
+}
+
+void solve_all_volumes_odes(struct ode_solver *the_ode_solver, real_cpu cur_time, struct string_voidp_hash_entry *stim_configs,
+                            struct string_hash_entry *ode_extra_config) {
 
+    real *merged_stims = merge_stimuli(the_ode_solver, cur_time, stim_configs);
+    solve_all_volumes_odes_with_stimuli(the_ode_solver, cur_time, merged_stims, ode_extra_config);
     free(merged_stims);
 }
 
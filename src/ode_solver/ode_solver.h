@@ -23,6 +23,7 @@ extern "C" {
 //Forward declaration
 struct user_options;
 struct ode_solver;
+struct lookup_table;
 
 struct cell_model_data {
     int number_of_ode_equations;
@@ -75,6 +76,15 @@ struct ode_solver {
 
     real *ode_dt, *ode_previous_dt, *ode_time_new;
 
+    //Optional voltage lookup table built by the cell model (see models_library/lookup_table.h)
+    struct lookup_table *lookup_table;
+
+    //Number of fast steps in each slow step of the models with multi-rate time stepping (see models_library/multirate.h)
+    uint32_t multirate_ratio;
+
+    //Adaptive method of the models that have both (see models_library/adaptive_rush_larsen.h)
+    bool adaptive_rush_larsen;
+
     //User provided functions
     get_cell_model_data_fn *get_cell_model_data;
     set_ode_initial_conditions_cpu_fn *set_ode_initial_conditions_cpu;
@@ -97,6 +107,10 @@ void solve_all_volumes_odes(struct ode_solver *the_ode_solver, real_cpu cur_time
                             struct string_voidp_hash_entry *stim_configs,
                             struct string_hash_entry *ode_extra_config);
 
+real *merge_stimuli(struct ode_solver *the_ode_solver, real_cpu cur_time, struct string_voidp_hash_entry *stim_configs);
+void solve_all_volumes_odes_with_stimuli(struct ode_solver *the_ode_solver, real_cpu cur_time, real *merged_stims,
+                                         struct string_hash_entry *ode_extra_config);
+
 void configure_ode_solver_from_options(struct ode_solver *solver, struct user_options *options);
 
 void configure_purkinje_ode_solver_from_options (struct ode_solver *purkinje_solver, struct user_options *options);
@@ -9,6 +9,7 @@
 #include "../alg/grid/grid.h"
 #include "../config/save_mesh_config.h"
 #include "../utils/utils.h"
+#include "../utils/vm_matrix.h"
 #include "../extra_data_library/helper_functions.h"
 
 #include "../domains_library/mesh_info_data.h"
@@ -130,21 +131,18 @@ INIT_SAVE_MESH(init_save_one_cell_state_variables) {
     ((struct save_one_cell_state_variables_persistent_data *)config->persistent_data)->file =
         fopen(((struct save_one_cell_state_variables_persistent_data *)config->persistent_data)->file_name, "w");
     ((struct save_one_cell_state_variables_persistent_data *)config->persistent_data)->cell_sv_position = -1;
+    ((struct save_one_cell_state_variables_persistent_data *)config->persistent_data)->cell_found = false;
 }
 
 SAVE_MESH(save_one_cell_state_variables) {
 
     struct save_one_cell_state_variables_persistent_data *params = ((struct save_one_cell_state_variables_persistent_data *)config->persistent_data);
 
-    if(params->cell_sv_position == -1) {
-        if(!the_grid->adaptive) {
-            FOR_EACH_CELL(the_grid) {
-                if(cell->center.x == params->cell_center_x && cell->center.y == params->cell_center_y && cell->center.z == params->cell_center_z) {
-                    params->cell_sv_position = cell->sv_position;
-                    break;
-                }
-            }
-        }
+    // The cells of adaptive meshes can change between two saves
+    if(!params->cell_found || the_grid->adaptive) {
+        real_cpu center[3] = {params->cell_center_x, params->cell_center_y, params->cell_center_z};
+        find_nearest_active_cells(the_grid, center, 1, &params->cell_sv_position);
+        params->cell_found = true;
     }
 
     if(ode_solver->gpu) {
@@ -205,6 +203,18 @@ END_SAVE_MESH(end_save_one_cell_state_variables) {
     config->persistent_data = NULL;
 }
 
+INIT_SAVE_MESH(init_save_as_text_or_binary) {
+    if(config->persistent_data == NULL) {
+        config->persistent_data = calloc(1, sizeof(struct common_persistent_data));
+    }
+}
+
+END_SAVE_MESH(end_save_as_text_or_binary) {
+    free_save_vm_matrix_persistent_data(((struct common_persistent_data *)config->persistent_data)->vm_matrix);
+    free(config->persistent_data);
+    config->persistent_data = NULL;
+}
+
 SAVE_MESH(save_as_text_or_binary) {
 
     int iteration_count = time_info->iteration;
@@ -383,12 +393,14 @@ INIT_SAVE_MESH(init_save_as_vtk_or_vtu) {
     if(config->persistent_data == NULL) {
         config->persistent_data = malloc(sizeof(struct common_persistent_data));
         ((struct common_persistent_data *)config->persistent_data)->grid = NULL;
+        ((struct common_persistent_data *)config->persistent_data)->vm_matrix = NULL;
         ((struct common_persistent_data *)config->persistent_data)->first_save_call = true;
     }
 }
 
 END_SAVE_MESH(end_save_as_vtk_or_vtu) {
     free_vtk_unstructured_grid(((struct common_persistent_data *)config->persistent_data)->grid);
+    free_save_vm_matrix_persistent_data(((struct common_persistent_data *)config->persistent_data)->vm_matrix);
     free(config->persistent_data);
     config->persistent_data = NULL;
 }
@@ -682,6 +694,7 @@ SAVE_MESH(save_as_ensight) {
 }
 
 END_SAVE_MESH(end_save_as_ensight) {
+    free_save_vm_matrix_persistent_data(((struct common_persistent_data *)config->persistent_data)->vm_matrix);
     free(config->persistent_data);
     config->persistent_data = NULL;
 }
@@ -706,6 +719,7 @@ INIT_SAVE_MESH(init_save_with_activation_times) {
 }
 
 END_SAVE_MESH(end_save_with_activation_times) {
+    free_save_vm_matrix_persistent_data(((struct common_persistent_data *)config->persistent_data)->vm_matrix);
     free(config->persistent_data);
     config->persistent_data = NULL;
 }
@@ -871,38 +885,78 @@ SAVE_MESH(save_with_activation_times) {
     CALL_EXTRA_FUNCTIONS(save_mesh_fn, time_info, config, the_grid, ode_solver, purkinje_ode_solver);
 }
 
+INIT_SAVE_MESH(init_save_vm_matrix) {
+    if(config->persistent_data == NULL) {
+        config->persistent_data = new_save_vm_matrix_persistent_data(config);
+    }
+}
+
+END_SAVE_MESH(end_save_vm_matrix) {
+    free_save_vm_matrix_persistent_data((struct save_vm_matrix_persistent_data *)config->persistent_data);
+    config->persistent_data = NULL;
+}
+
+// Saves the Vm of all active cells. By default each saved step is a frame of Vm_matrix.bin (see utils/vm_matrix.h)
+// and its time is added to Vm_matrix_index.bin. Options:
+//   vm_matrix_format = binary or text (the old Vm_matrix.txt with one line per step)
+//   vm_matrix_precision = double, float or half (binary format only)
+//   vm_matrix_decimation = n: saves only one in each n calls
+//   vm_matrix_chunk_size = size in MB of the frames kept in memory before being written
+//   start_saving_at = time of the first saved step
+// As the main function the files are opened by init_save_vm_matrix and closed by end_save_vm_matrix. As an extra
+// function of the save functions that use a common_persistent_data (text or binary, vtk, vtu, ensight and activation
+// times) they are opened in the first call and closed by the end function of the main one. A domain modification ends
+// and inits the save functions again, so it starts new matrices.
 SAVE_MESH(save_vm_matrix) {
 
-    static FILE *f = NULL;
+    struct save_vm_matrix_persistent_data *data = NULL;
 
-    real save_after = 0.0;
-    GET_PARAMETER_NUMERIC_VALUE_OR_USE_DEFAULT(real, save_after, config, "start_saving_at");
+    if(config->init_function == (void *)init_save_vm_matrix) {
+        data = (struct save_vm_matrix_persistent_data *)config->persistent_data;
+    } else if(config->init_function == (void *)init_save_as_text_or_binary || config->init_function == (void *)init_save_as_vtk_or_vtu ||
+              config->init_function == (void *)init_save_as_ensight || config->init_function == (void *)init_save_with_activation_times) {
 
-    if(time_info->current_t >= save_after) {
+        struct common_persistent_data *cpd = (struct common_persistent_data *)config->persistent_data;
 
-        if(f == NULL) {
-            GET_PARAMETER_STRING_VALUE_OR_REPORT_ERROR(output_dir, config, "output_dir");
-            sds output_dir_with_file = sdsnew(output_dir);
-            output_dir_with_file = sdscat(output_dir_with_file, "/Vm_matrix.txt");
-            f = fopen(output_dir_with_file, "w");
-            sdsfree(output_dir_with_file);
+        if(cpd->vm_matrix == NULL) {
+            cpd->vm_matrix = new_save_vm_matrix_persistent_data(config);
         }
 
-        uint32_t n_active = the_grid->num_active_cells;
+        data = cpd->vm_matrix;
+    } else {
+        log_error_and_exit("save_vm_matrix can only be the main function (with init_function=init_save_vm_matrix) or an extra function of "
+                           "save_as_text_or_binary, save_as_vtk, save_as_vtu, save_as_ensight or save_with_activation_times!\n");
+    }
+
+    if(time_info->current_t < data->save_after) {
+        return;
+    }
+
+    uint32_t n_active = the_grid->num_active_cells;
+    struct cell_node **ac = the_grid->active_cells;
 
-        fprintf(f, "%e ", time_info->current_t);
+    if(data->text_file) {
+        fprintf(data->text_file, "%e ", time_info->current_t);
 
         for(uint32_t i = 0; i < n_active; i++) {
-            fprintf(f, "%e ", the_grid->active_cells[i]->v);
+            fprintf(data->text_file, "%e ", ac[i]->v);
         }
-    }
 
-    fprintf(f, "\n");
+        fprintf(data->text_file, "\n");
+    } else {
+        if(data->num_calls % data->decimation == 0) {
+            data->values = (real_cpu *)realloc(data->values, sizeof(real_cpu) * n_active);
 
-    if(time_info->current_t >= time_info->final_t) {
-        fclose(f);
-    }
+            OMP(parallel for)
+            for(uint32_t i = 0; i < n_active; i++) {
+                data->values[i] = ac[i]->v;
+            }
+
+            vm_matrix_writer_add_frame(data->writer, time_info->current_t, data->values, n_active);
+        }
 
+        data->num_calls++;
+    }
 }
 
 SAVE_MESH(no_save) {
@@ -918,80 +972,217 @@ INIT_SAVE_MESH(init_save_multiple_cell_state_variables) {
     GET_PARAMETER_STRING_VALUE_OR_REPORT_ERROR(((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->file_name_prefix, config,
                                                "file_name_prefix");
 
-    uint32_t num_cells = ((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->num_cells;
-    char *file_name_prefix = ((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->file_name_prefix;
+    struct save_multiple_cell_state_variables_persistent_data *params = (struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data;
 
-    ((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->files = MALLOC_ARRAY_OF_TYPE(FILE*, num_cells);
-    ((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->cell_sv_positions = MALLOC_ARRAY_OF_TYPE(uint32_t, num_cells);
+    uint32_t num_cells = params->num_cells;
+    char *file_name_prefix = params->file_name_prefix;
 
-    for (int i = 0; i < num_cells; i++) {
+    // text (one file for each cell), csv or binary
+    char *output_format = NULL;
+    GET_PARAMETER_STRING_VALUE_OR_USE_DEFAULT(output_format, config, "output_format");
 
-        sds base_name = NULL;
-        base_name = create_base_name(file_name_prefix, i, "dat");
+    params->output_format = PROBE_OUTPUT_TEXT;
 
-        ((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->files[i] = fopen(base_name, "w");
-        ((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->cell_sv_positions[i] = -1;
+    if(output_format) {
+        if(STRINGS_EQUAL(output_format, "csv")) {
+            params->output_format = PROBE_OUTPUT_CSV;
+        } else if(STRINGS_EQUAL(output_format, "binary")) {
+            params->output_format = PROBE_OUTPUT_BINARY;
+        } else if(!STRINGS_EQUAL(output_format, "text")) {
+            log_error_and_exit("Invalid output_format %s. Valid formats are text, csv and binary.\n", output_format);
+        }
+        free(output_format);
+    }
+
+    // Indexes of the saved state variables. All of them are saved by default
+    params->num_state_variables = 0;
+    params->state_variables = NULL;
+    GET_PARAMETER_NUMERIC_VALUE_OR_USE_DEFAULT(uint32_t, params->num_state_variables, config, "num_state_variables");
+
+    if(params->num_state_variables > 0) {
+        real_cpu *state_variables = NULL;
+        GET_PARAMETER_VECTOR_VALUE_OR_USE_DEFAULT(state_variables, config, "state_variables", params->num_state_variables);
+
+        if(!state_variables) {
+            log_error_and_exit("num_state_variables was given without the state_variables vector!\n");
+        }
+
+        params->state_variables = MALLOC_ARRAY_OF_TYPE(uint32_t, params->num_state_variables);
+        for(uint32_t i = 0; i < params->num_state_variables; i++) {
+            params->state_variables[i] = (uint32_t)state_variables[i];
+        }
+        free(state_variables);
+    }
+
+    params->files = NULL;
+    params->file = NULL;
+    params->values = NULL;
+    params->cells_found = false;
+    params->cell_sv_positions = MALLOC_ARRAY_OF_TYPE(uint32_t, num_cells);
+
+    if(params->output_format == PROBE_OUTPUT_TEXT) {
+
+        params->files = MALLOC_ARRAY_OF_TYPE(FILE*, num_cells);
+
+        for (int i = 0; i < num_cells; i++) {
+
+            sds base_name = NULL;
+            base_name = create_base_name(file_name_prefix, i, "dat");
+
+            params->files[i] = fopen(base_name, "w");
+            sdsfree(base_name);
+        }
+    } else {
+        sds file_name = sdscatprintf(sdsempty(), "%s.%s", file_name_prefix, params->output_format == PROBE_OUTPUT_CSV ? "csv" : "bin");
+        params->file = fopen(file_name, params->output_format == PROBE_OUTPUT_CSV ? "w" : "wb");
+
+        if(!params->file) {
+            log_error_and_exit("Could not open %s!\n", file_name);
+        }
+
+        setvbuf(params->file, NULL, _IOFBF, 1 << 20);
+        sdsfree(file_name);
+    }
+}
+
+// The header is only written in the first save, when the number of state variables of the model is known.
+// The binary header is the "MAPROBES" magic, five uint32 (version, number of cells, number of saved state variables,
+// sizeof(real) and number of state variables of the model), the indexes of the saved state variables (uint32) and the
+// cell centers given in the configuration (3 doubles per cell). Each save then writes the time (double) followed by the
+// saved state variables of the first cell, of the second cell, and so on.
+static void write_probe_file_header(struct save_multiple_cell_state_variables_persistent_data *params, uint32_t num_variables, uint32_t num_odes) {
+
+    if(params->output_format == PROBE_OUTPUT_CSV) {
+        fprintf(params->file, "time");
+        for(uint32_t k = 0; k < params->num_cells; k++) {
+            for(uint32_t v = 0; v < num_variables; v++) {
+                fprintf(params->file, ",cell_%u_sv_%u", k, params->state_variables ? params->state_variables[v] : v);
+            }
+        }
+        fprintf(params->file, "\n");
+    } else {
+        const char magic[8] = {'M', 'A', 'P', 'R', 'O', 'B', 'E', 'S'};
+        uint32_t header[5] = {1, params->num_cells, num_variables, (uint32_t)sizeof(real), num_odes};
+
+        fwrite(magic, sizeof(magic), 1, params->file);
+        fwrite(header, sizeof(header), 1, params->file);
+
+        for(uint32_t v = 0; v < num_variables; v++) {
+            uint32_t sv = params->state_variables ? params->state_variables[v] : v;
+            fwrite(&sv, sizeof(uint32_t), 1, params->file);
+        }
+
+        fwrite(params->cell_centers, sizeof(real_cpu), params->num_cells * 3, params->file);
     }
 }
 
 SAVE_MESH(save_multiple_cell_state_variables) {
     struct save_multiple_cell_state_variables_persistent_data *params = ((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data);
 
-    for (uint32_t i = 0; i < params->num_cells; i++) {
-        if(params->cell_sv_positions[i] == -1) {
-            if(!the_grid->adaptive) {
-                FOR_EACH_CELL(the_grid) {
-                    if(cell->center.x == params->cell_centers[i*3] && cell->center.y == params->cell_centers[i*3+1] && cell->center.z == params->cell_centers[i*3+2]) {
-                        params->cell_sv_positions[i] = cell->sv_position;
-                        break;
-                    }
-                }
+    uint32_t num_odes = ode_solver->model_data.number_of_ode_equations;
+    uint32_t num_variables = params->num_state_variables > 0 ? params->num_state_variables : num_odes;
+    uint32_t num_cells = params->num_cells;
+
+    // The cells are found only once, unless the mesh is adaptive
+    if(!params->cells_found || the_grid->adaptive) {
+        real_cpu max_distance = find_nearest_active_cells(the_grid, params->cell_centers, num_cells, params->cell_sv_positions);
+
+        if(!params->cells_found) {
+            log_info("Saving the state variables of %u cells. Greatest distance to the given centers: %lf\n", num_cells, max_distance);
+        }
+    }
+
+    if(!params->values) {
+        for(uint32_t v = 0; v < params->num_state_variables; v++) {
+            if(params->state_variables[v] >= num_odes) {
+                log_error_and_exit("Invalid state variable %u. The model has %u state variables!\n", params->state_variables[v], num_odes);
             }
         }
+
+        params->values = MALLOC_ARRAY_OF_TYPE(real, (size_t)num_cells * num_variables);
+
+        if(params->file) {
+            write_probe_file_header(params, num_variables, num_odes);
+        }
     }
 
+    params->cells_found = true;
+
+    // Gathers the saved values of all cells
+    real *values = params->values;
+
     if(ode_solver->gpu) {
 #ifdef COMPILE_CUDA
-        for (uint32_t k = 0; k < params->num_cells; k++) {
-            real *cell_sv;
-
-            cell_sv = MALLOC_ARRAY_OF_TYPE(real, ode_solver->model_data.number_of_ode_equations);
+        real *cell_sv = MALLOC_ARRAY_OF_TYPE(real, num_odes);
 
+        for (uint32_t k = 0; k < num_cells; k++) {
             check_cuda_error(cudaMemcpy2D(cell_sv, sizeof(real), ode_solver->sv + params->cell_sv_positions[k], ode_solver->pitch, sizeof(real),
-                                        ode_solver->model_data.number_of_ode_equations, cudaMemcpyDeviceToHost));
+                                        num_odes, cudaMemcpyDeviceToHost));
 
-            fprintf(params->files[k], "%lf ", time_info->current_t);
-            for(int i = 0; i < ode_solver->model_data.number_of_ode_equations; i++) {
-                fprintf(params->files[k], "%lf ", cell_sv[i]);
+            for(uint32_t v = 0; v < num_variables; v++) {
+                values[k * num_variables + v] = cell_sv[params->state_variables ? params->state_variables[v] : v];
             }
-            fprintf(params->files[k], "\n");
-
-            free(cell_sv);
         }
 
+        free(cell_sv);
 #endif
     } else {
-        for (uint32_t k = 0; k < params->num_cells; k++) {
-            real *cell_sv = &ode_solver->sv[params->cell_sv_positions[k] * ode_solver->model_data.number_of_ode_equations];
+        OMP(parallel for)
+        for (uint32_t k = 0; k < num_cells; k++) {
+            real *cell_sv = &ode_solver->sv[params->cell_sv_positions[k] * num_odes];
+
+            for(uint32_t v = 0; v < num_variables; v++) {
+                values[k * num_variables + v] = cell_sv[params->state_variables ? params->state_variables[v] : v];
+            }
+        }
+    }
 
-            fprintf(params->files[k], "%lf ", time_info->current_t);
-            for(int i = 0; i < ode_solver->model_data.number_of_ode_equations; i++) {
-                fprintf(params->files[k], "%lf ", cell_sv[i]);
+    switch(params->output_format) {
+        case PROBE_OUTPUT_TEXT:
+            for (uint32_t k = 0; k < num_cells; k++) {
+                fprintf(params->files[k], "%lf ", time_info->current_t);
+                for(uint32_t v = 0; v < num_variables; v++) {
+                    fprintf(params->files[k], "%lf ", values[k * num_variables + v]);
+                }
+                fprintf(params->files[k], "\n");
+            }
+            break;
+        case PROBE_OUTPUT_CSV:
+            fprintf(params->file, "%lf", time_info->current_t);
+            for(size_t i = 0; i < (size_t)num_cells * num_variables; i++) {
+                fprintf(params->file, ",%g", values[i]);
             }
-            fprintf(params->files[k], "\n");
+            fprintf(params->file, "\n");
+            break;
+        case PROBE_OUTPUT_BINARY: {
+            double t = time_info->current_t;
+            fwrite(&t, sizeof(double), 1, params->file);
+            fwrite(values, sizeof(real), (size_t)num_cells * num_variables, params->file);
+            break;
         }
     }
 }
 
 END_SAVE_MESH(end_save_multiple_cell_state_variables) {
-    uint32_t num_cells = ((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->num_cells;
-    free(((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->file_name_prefix);
-    free(((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->cell_sv_positions);
-    free(((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->cell_centers);
-    for (uint32_t i = 0; i < num_cells; i++) {
-        fclose(((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->files[i]);
+    struct save_multiple_cell_state_variables_persistent_data *params = (struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data;
+
+    free(params->file_name_prefix);
+    free(params->cell_sv_positions);
+    free(params->cell_centers);
+    free(params->state_variables);
+    free(params->values);
+
+    if(params->files) {
+        for (uint32_t i = 0; i < params->num_cells; i++) {
+            fclose(params->files[i]);
+        }
+        free(params->files);
     }
-    free(((struct save_multiple_cell_state_variables_persistent_data *)config->persistent_data)->files);
+
+    if(params->file) {
+        fclose(params->file);
+    }
+
     free(config->persistent_data);
     config->persistent_data = NULL;
 }
@@ -1,5 +1,6 @@
 #include "save_mesh_helper.h"
 #include "../domains_library/mesh_info_data.h"
+#include "../utils/bucket_grid.h"
 
 static void write_pvd_header(FILE *pvd_file) {
     fprintf(pvd_file, "<VTKFile type=\"Collection\" version=\"0.1\" compressor=\"vtkZLibDataCompressor\">\n");
@@ -12,6 +13,129 @@ sds create_base_name(char *f_prefix, int iteration_count, char *extension) {
     return sdscatprintf(sdsempty(), "%s_it_%d.%s", f_prefix, iteration_count, extension);
 }
 
+struct save_vm_matrix_persistent_data *new_save_vm_matrix_persistent_data(struct config *config) {
+
+    struct save_vm_matrix_persistent_data *data = CALLOC_ONE_TYPE(struct save_vm_matrix_persistent_data);
+
+    GET_PARAMETER_NUMERIC_VALUE_OR_USE_DEFAULT(real, data->save_after, config, "start_saving_at");
+
+    data->decimation = 1;
+    GET_PARAMETER_NUMERIC_VALUE_OR_USE_DEFAULT(uint32_t, data->decimation, config, "vm_matrix_decimation");
+
+    if(data->decimation == 0) {
+        data->decimation = 1;
+    }
+
+    char *vm_output_dir = NULL;
+    GET_PARAMETER_STRING_VALUE_OR_REPORT_ERROR(vm_output_dir, config, "output_dir");
+
+    char *format = NULL;
+    GET_PARAMETER_STRING_VALUE_OR_USE_DEFAULT(format, config, "vm_matrix_format");
+
+    if(format && STRINGS_EQUAL(format, "text")) {
+        sds file_name = sdscatfmt(sdsempty(), "%s/Vm_matrix.txt", vm_output_dir);
+        data->text_file = fopen(file_name, "w");
+
+        if(!data->text_file) {
+            log_error_and_exit("Could not open %s!\n", file_name);
+        }
+
+        sdsfree(file_name);
+    } else {
+        enum vm_matrix_value_type value_type = VM_MATRIX_FLOAT64;
+
+        char *precision = NULL;
+        GET_PARAMETER_STRING_VALUE_OR_USE_DEFAULT(precision, config, "vm_matrix_precision");
+
+        if(precision) {
+            if(STRINGS_EQUAL(precision, "float")) {
+                value_type = VM_MATRIX_FLOAT32;
+            } else if(STRINGS_EQUAL(precision, "half")) {
+                value_type = VM_MATRIX_FLOAT16;
+            } else if(!STRINGS_EQUAL(precision, "double")) {
+                log_error_and_exit("Invalid vm_matrix_precision %s. Valid values are double, float and half.\n", precision);
+            }
+            free(precision);
+        }
+
+        real_cpu chunk_size = 16.0;
+        GET_PARAMETER_NUMERIC_VALUE_OR_USE_DEFAULT(real_cpu, chunk_size, config, "vm_matrix_chunk_size");
+
+        sds data_file = sdscatfmt(sdsempty(), "%s/Vm_matrix.bin", vm_output_dir);
+        sds index_file = sdscatfmt(sdsempty(), "%s/Vm_matrix_index.bin", vm_output_dir);
+
+        data->writer = new_vm_matrix_writer(data_file, index_file, value_type, data->decimation, (size_t)(chunk_size * 1024 * 1024));
+
+        if(!data->writer) {
+            log_error_and_exit("Could not open %s!\n", data_file);
+        }
+
+        sdsfree(data_file);
+        sdsfree(index_file);
+    }
+
+    free(format);
+    free(vm_output_dir);
+
+    return data;
+}
+
+void free_save_vm_matrix_persistent_data(struct save_vm_matrix_persistent_data *data) {
+
+    if(!data) return;
+
+    if(data->text_file) {
+        fclose(data->text_file);
+    }
+
+    free_vm_matrix_writer(data->writer);
+    free(data->values);
+    free(data);
+}
+
+// Finds, for each point (x, y, z), the active cell with the nearest center and stores its sv_position (see bucket_grid.h).
+// When two cells have the same distance, the first one in the active_cells array is used. Returns the greatest distance
+// between a point and the center of its cell.
+real_cpu find_nearest_active_cells(struct grid *the_grid, const real_cpu *points, uint32_t num_points, uint32_t *sv_positions) {
+
+    uint32_t num_active_cells = the_grid->num_active_cells;
+    struct cell_node **ac = the_grid->active_cells;
+
+    if(num_active_cells == 0) {
+        log_error_and_exit("No active cells to save the state variables!\n");
+    }
+
+    struct point_3d *centers = MALLOC_ARRAY_OF_TYPE(struct point_3d, num_active_cells);
+    real_cpu h = 0.0;
+
+    for(uint32_t i = 0; i < num_active_cells; i++) {
+        centers[i] = ac[i]->center;
+        h = fmax(h, fmax(ac[i]->discretization.x, fmax(ac[i]->discretization.y, ac[i]->discretization.z)));
+    }
+
+    struct bucket_grid *grid = new_bucket_grid(centers, num_active_cells, h);
+
+    real_cpu max_distance = 0.0;
+
+    OMP(parallel for reduction(max: max_distance))
+    for(uint32_t p = 0; p < num_points; p++) {
+
+        real_cpu distance;
+        uint32_t cell = bucket_grid_nearest_point(grid, POINT3D(points[p * 3], points[p * 3 + 1], points[p * 3 + 2]), &distance);
+
+        sv_positions[p] = ac[cell]->sv_position;
+
+        if(distance > max_distance) {
+            max_distance = distance;
+        }
+    }
+
+    free_bucket_grid(grid);
+    free(centers);
+
+    return max_distance;
+}
+
 void add_file_to_pvd(real_cpu current_t, const char *output_dir, const char *base_name, bool first_call) {
 
     sds pvd_name = sdsnew(output_dir);
@@ -703,47 +827,47 @@ void print_purkinje_propagation_velocity(struct config *config, struct grid *the
         (struct save_coupling_with_activation_times_persistent_data *)config->persistent_data;
     struct cell_node **purkinje_cells = the_grid->purkinje->purkinje_cells;
 
-    // Compute the shortest distance from the root to all other nodes
+    // Compute the shortest distance from the root to all terminals
     struct graph *the_network = the_grid->purkinje->network;
-    double *shortest_dist = dijkstra(the_network, 0);
+    uint32_t root = 0;
+    uint32_t *terminal_ids = NULL;
+    uint32_t num_terminals = 0;
+    double *shortest_dist = dijkstra_terminals(the_network, &root, 1, &terminal_ids, &num_terminals);
 
     // Calculate the propagation velocity of each terminal in the Purkinje network
-    struct node *n = the_network->list_nodes;
-    while(n != NULL) {
-        if(is_terminal(n)) {
-            struct point_3d cell_coordinates;
-            real_cpu center_x, center_y, center_z;
+    for(uint32_t t = 0; t < num_terminals; t++) {
+        struct point_3d cell_coordinates;
+        real_cpu center_x, center_y, center_z;
 
-            uint32_t id = n->id;
-            center_x = purkinje_cells[id]->center.x;
-            center_y = purkinje_cells[id]->center.y;
-            center_z = purkinje_cells[id]->center.z;
+        uint32_t id = terminal_ids[t];
+        center_x = purkinje_cells[id]->center.x;
+        center_y = purkinje_cells[id]->center.y;
+        center_z = purkinje_cells[id]->center.z;
 
-            cell_coordinates.x = center_x;
-            cell_coordinates.y = center_y;
-            cell_coordinates.z = center_z;
+        cell_coordinates.x = center_x;
+        cell_coordinates.y = center_y;
+        cell_coordinates.z = center_z;
 
-            // Get the total number of pulses
-            size_t n_pulses = hmget(persistent_data->purkinje_num_activations, cell_coordinates);
+        // Get the total number of pulses
+        size_t n_pulses = hmget(persistent_data->purkinje_num_activations, cell_coordinates);
 
-            // Get the terminal cell LAT
-            float *activation_times_array = (float *)hmget(persistent_data->purkinje_activation_times, cell_coordinates);
+        // Get the terminal cell LAT
+        float *activation_times_array = (float *)hmget(persistent_data->purkinje_activation_times, cell_coordinates);
 
-            // Calculate the stimulation period
-            float period = 0.0;
-            if (n_pulses > 1) {
-                period = activation_times_array[1] - activation_times_array[0];
-            }
-            for(size_t j = 0; j < n_pulses; j++) {
-                real_cpu delta_t = activation_times_array[j] - j*period;
-                real_cpu delta_s = shortest_dist[id];
-                real_cpu v = delta_s / delta_t;
+        // Calculate the stimulation period
+        float period = 0.0;
+        if (n_pulses > 1) {
+            period = activation_times_array[1] - activation_times_array[0];
+        }
+        for(size_t j = 0; j < n_pulses; j++) {
+            real_cpu delta_t = activation_times_array[j] - j*period;
+            real_cpu delta_s = shortest_dist[t];
+            real_cpu v = delta_s / delta_t;
 
-                log_info("[Pulse %u] Purkinje cell %u || Delta_s = %g um || Delta_t = %g ms || v = %g um/mm\n", j + 1, id, delta_s, delta_t, v);
-            }
+            log_info("[Pulse %u] Purkinje cell %u || Delta_s = %g um || Delta_t = %g ms || v = %g um/mm\n", j + 1, id, delta_s, delta_t, v);
         }
-        n = n->next;
     }
 
+    free(terminal_ids);
     free(shortest_dist);
 }
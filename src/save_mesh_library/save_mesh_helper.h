@@ -13,11 +13,22 @@
 #include "../alg/grid/grid.h"
 #include "../config/save_mesh_config.h"
 #include "../utils/utils.h"
+#include "../utils/vm_matrix.h"
 
 #include "../libraries_common/common_data_structures.h"
 #include "../vtk_utils/vtk_polydata_grid.h"
 #include "../vtk_utils/vtk_unstructured_grid.h"
 
+// Options of save_vm_matrix, read once, and its open matrix (text or binary)
+struct save_vm_matrix_persistent_data {
+    FILE *text_file;
+    struct vm_matrix_writer *writer;
+    real save_after;
+    uint32_t decimation;
+    uint64_t num_calls;
+    real_cpu *values;
+};
+
 struct common_persistent_data {
 
     //Ensigth
@@ -38,6 +49,9 @@ struct common_persistent_data {
     //VTK or VTK
     struct vtk_unstructured_grid *grid;
 
+    //save_vm_matrix as an extra function
+    struct save_vm_matrix_persistent_data *vm_matrix;
+
     bool first_save_call;
     int print_rate;
     int mesh_print_rate;
@@ -80,6 +94,13 @@ struct save_one_cell_state_variables_persistent_data {
     real_cpu cell_center_y;
     real_cpu cell_center_z;
     uint32_t cell_sv_position;
+    bool cell_found;
+};
+
+enum probe_output_format {
+    PROBE_OUTPUT_TEXT, // One text file for each cell
+    PROBE_OUTPUT_CSV,  // One csv file with a column for each state variable of each cell
+    PROBE_OUTPUT_BINARY,
 };
 
 struct save_multiple_cell_state_variables_persistent_data {
@@ -88,6 +109,14 @@ struct save_multiple_cell_state_variables_persistent_data {
     char *file_name_prefix;
     real_cpu *cell_centers;
     uint32_t *cell_sv_positions;
+    bool cells_found;
+
+    enum probe_output_format output_format;
+    FILE *file; // csv or binary output
+
+    uint32_t num_state_variables; // 0 means all the state variables of the model
+    uint32_t *state_variables;
+    real *values; // Saved values of all the cells, in the same order as in the csv or binary files
 };
 
 struct save_multiple_cell_state_variables_purkinje_coupling_persistent_data {
@@ -136,6 +165,9 @@ struct save_multiple_cell_state_variables_purkinje_coupling_with_activation_time
 
 void add_file_to_pvd(real_cpu current_t, const char *output_dir, const char *base_name, bool first_save_call);
 sds create_base_name(char *f_prefix, int iteration_count, char *extension);
+real_cpu find_nearest_active_cells(struct grid *the_grid, const real_cpu *points, uint32_t num_points, uint32_t *sv_positions);
+struct save_vm_matrix_persistent_data *new_save_vm_matrix_persistent_data(struct config *config);
+void free_save_vm_matrix_persistent_data(struct save_vm_matrix_persistent_data *data);
 
 // [PURKINJE]
 void calculate_purkinje_activation_time_and_apd(struct time_info *time_info, struct config *config, struct grid *the_grid, const real_cpu time_threshold,
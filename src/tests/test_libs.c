@@ -3,6 +3,8 @@
 ////
 #include <criterion/criterion.h>
 #include <criterion/internal/assert.h>
+#include <float.h>
+#include <math.h>
 #include <signal.h>
 
 #include "../alg/grid/grid.h"
@@ -11,6 +13,9 @@
 #include "../config/save_mesh_config.h"
 #include "../config/config_parser.h"
 #include "../utils/file_utils.h"
+#include "../utils/vm_matrix.h"
+#include "../utils/bucket_grid.h"
+#include "../graph/graph.h"
 #include "../3dparty/ini_parser/ini.h"
 #include "../3dparty/sds/sds.h"
 #include "../logger/logger.h"
@@ -160,3 +165,403 @@ Test (float_parser, fast_parser) {
     test_file("./tests_bin/float_neg.txt");
     test_file("./tests_bin/float_mixed.txt");
 }
+
+// Writes frames in chunks smaller than two frames, so the writer is flushed many times, and reads them back
+static void test_vm_matrix_roundtrip(enum vm_matrix_value_type value_type) {
+
+    const uint64_t num_cells = 5;
+    const uint64_t num_frames = 23;
+
+    create_dir("./tests_bin");
+
+    const char *data_path = "./tests_bin/vm_matrix_test.bin";
+    const char *index_path = "./tests_bin/vm_matrix_test.idx";
+
+    struct vm_matrix_writer *writer = new_vm_matrix_writer(data_path, index_path, value_type, 1, 48);
+    cr_assert(writer);
+
+    real_cpu values[num_frames][num_cells];
+
+    for(uint64_t f = 0; f < num_frames; f++) {
+        for(uint64_t i = 0; i < num_cells; i++) {
+            values[f][i] = -85.0 + 0.37 * f + 11.3 * i;
+        }
+        vm_matrix_writer_add_frame(writer, 0.5 * f, values[f], num_cells);
+    }
+
+    free_vm_matrix_writer(writer);
+
+    struct vm_matrix_file *file = open_vm_matrix_file(data_path, index_path);
+    cr_assert(file);
+    cr_assert_eq(file->value_type, value_type);
+    cr_assert_eq(file->num_frames, num_frames);
+
+    real_cpu read_values[num_cells];
+
+    for(uint64_t f = 0; f < num_frames; f++) {
+        cr_assert_eq(file->frames[f].offset % 8, 0);
+        cr_assert_eq(file->frames[f].num_cells, num_cells);
+        cr_assert_float_eq(file->frames[f].time, 0.5 * f, 1e-12);
+
+        vm_matrix_read_frame(file, f, read_values);
+
+        for(uint64_t i = 0; i < num_cells; i++) {
+            real_cpu expected = values[f][i];
+            if(value_type == VM_MATRIX_FLOAT32) {
+                expected = (float)expected;
+            } else if(value_type == VM_MATRIX_FLOAT16) {
+                expected = half_to_float(float_to_half((float)expected));
+            }
+            cr_assert_eq(read_values[i], expected);
+        }
+    }
+
+    real_cpu cell_values[num_frames];
+    cr_assert_eq(vm_matrix_read_cell(file, 3, cell_values), num_frames);
+
+    for(uint64_t f = 0; f < num_frames; f++) {
+        vm_matrix_read_frame(file, f, read_values);
+        cr_assert_eq(cell_values[f], read_values[3]);
+    }
+
+    close_vm_matrix_file(file);
+    remove(data_path);
+    remove(index_path);
+}
+
+Test (vm_matrix, roundtrip_float64) {
+    test_vm_matrix_roundtrip(VM_MATRIX_FLOAT64);
+}
+
+Test (vm_matrix, roundtrip_float32) {
+    test_vm_matrix_roundtrip(VM_MATRIX_FLOAT32);
+}
+
+Test (vm_matrix, roundtrip_float16) {
+    test_vm_matrix_roundtrip(VM_MATRIX_FLOAT16);
+}
+
+// Nearest point by brute force, with the lowest index in a tie (the result expected from bucket_grid_nearest_point)
+static uint32_t brute_force_nearest_point(const struct point_3d *points, uint32_t num_points, struct point_3d p, real_cpu *distance) {
+
+    uint32_t nearest = 0;
+    real_cpu best = DBL_MAX;
+
+    for(uint32_t i = 0; i < num_points; i++) {
+        struct point_3d q = points[i];
+        real_cpu d = sqrt((q.x - p.x) * (q.x - p.x) + (q.y - p.y) * (q.y - p.y) + (q.z - p.z) * (q.z - p.z));
+        if(d < best) {
+            best = d;
+            nearest = i;
+        }
+    }
+
+    *distance = best;
+    return nearest;
+}
+
+static real_cpu random_between(real_cpu min, real_cpu max) {
+    return min + (max - min) * ((real_cpu)rand() / RAND_MAX);
+}
+
+static void check_nearest_points(const struct point_3d *points, uint32_t num_points, struct point_3d min, struct point_3d max, uint32_t num_queries) {
+
+    struct bucket_grid *grid = new_bucket_grid(points, num_points, 0.0);
+
+    // The queries are in a box three times the size of the bounding box, so a part of them is outside of it
+    struct point_3d l = POINT3D(max.x - min.x, max.y - min.y, max.z - min.z);
+
+    for(uint32_t q = 0; q < num_queries; q++) {
+        struct point_3d p = POINT3D(random_between(min.x - l.x, max.x + l.x), random_between(min.y - l.y, max.y + l.y),
+                                    random_between(min.z - l.z, max.z + l.z));
+
+        real_cpu expected_distance, distance;
+        uint32_t expected = brute_force_nearest_point(points, num_points, p, &expected_distance);
+        uint32_t nearest = bucket_grid_nearest_point(grid, p, &distance);
+
+        cr_assert_eq(nearest, expected, "Query (%lf, %lf, %lf): found %u, expected %u", p.x, p.y, p.z, nearest, expected);
+        cr_assert_eq(distance, expected_distance);
+    }
+
+    free_bucket_grid(grid);
+}
+
+Test (bucket_grid, random_points) {
+
+    srand(42);
+
+    uint32_t sizes[] = {2, 10, 100, 5000};
+
+    for(int s = 0; s < 4; s++) {
+        uint32_t n = sizes[s];
+        struct point_3d *points = malloc(n * sizeof(struct point_3d));
+
+        for(uint32_t i = 0; i < n; i++) {
+            points[i] = POINT3D(random_between(0, 1000), random_between(-50, 50), random_between(0, 5000));
+        }
+
+        check_nearest_points(points, n, POINT3D(0, -50, 0), POINT3D(1000, 50, 5000), 2000);
+        free(points);
+    }
+}
+
+// Two small clusters in opposite corners of the bounding box, so most of the buckets are empty
+Test (bucket_grid, empty_buckets) {
+
+    srand(7);
+
+    uint32_t n = 400;
+    struct point_3d *points = malloc(n * sizeof(struct point_3d));
+
+    for(uint32_t i = 0; i < n; i++) {
+        real_cpu c = (i % 2) ? 10000.0 : 0.0;
+        points[i] = POINT3D(c + random_between(0, 10), c + random_between(0, 10), c + random_between(0, 10));
+    }
+
+    check_nearest_points(points, n, POINT3D(0, 0, 0), POINT3D(10010, 10010, 10010), 2000);
+    free(points);
+}
+
+// Points of a plane and of a line, whose bounding boxes have no volume
+Test (bucket_grid, flat_sets) {
+
+    srand(3);
+
+    uint32_t n = 500;
+    struct point_3d *points = malloc(n * sizeof(struct point_3d));
+
+    for(uint32_t i = 0; i < n; i++) {
+        points[i] = POINT3D(random_between(0, 100), random_between(0, 100), 5.0);
+    }
+    check_nearest_points(points, n, POINT3D(0, 0, 5.0), POINT3D(100, 100, 5.0), 1000);
+
+    for(uint32_t i = 0; i < n; i++) {
+        points[i] = POINT3D(random_between(0, 100), 1.0, 2.0);
+    }
+    check_nearest_points(points, n, POINT3D(0, 1.0, 2.0), POINT3D(100, 1.0, 2.0), 1000);
+
+    free(points);
+}
+
+Test (bucket_grid, single_point) {
+
+    struct point_3d point = POINT3D(1.0, 2.0, 3.0);
+    struct bucket_grid *grid = new_bucket_grid(&point, 1, 0.0);
+
+    struct point_3d queries[] = {POINT3D(1.0, 2.0, 3.0), POINT3D(-100.0, 2.0, 3.0), POINT3D(1e6, -1e6, 1e6)};
+
+    for(int q = 0; q < 3; q++) {
+        real_cpu distance, expected_distance;
+        brute_force_nearest_point(&point, 1, queries[q], &expected_distance);
+        cr_assert_eq(bucket_grid_nearest_point(grid, queries[q], &distance), 0);
+        cr_assert_eq(distance, expected_distance);
+    }
+
+    free_bucket_grid(grid);
+}
+
+Test (bucket_grid, no_points) {
+
+    struct bucket_grid *grid = new_bucket_grid(NULL, 0, 0.0);
+
+    real_cpu distance;
+    cr_assert_eq(bucket_grid_nearest_point(grid, POINT3D(1.0, 1.0, 1.0), &distance), 0);
+    cr_assert_eq(distance, DBL_MAX);
+
+    free_bucket_grid(grid);
+}
+
+// Points on an integer lattice, with repeated points, and queries on a half-integer lattice have many points at the
+// same distance of the query, in different buckets. The lowest index must be returned.
+Test (bucket_grid, ties) {
+
+    srand(11);
+
+    uint32_t n = 3000;
+    struct point_3d *points = malloc(n * sizeof(struct point_3d));
+
+    for(uint32_t i = 0; i < n; i++) {
+        points[i] = POINT3D(rand() % 21, rand() % 21, rand() % 21);
+    }
+
+    struct bucket_grid *grid = new_bucket_grid(points, n, 0.0);
+
+    for(uint32_t q = 0; q < 5000; q++) {
+        struct point_3d p = POINT3D(0.5 * (rand() % 81) - 10.0, 0.5 * (rand() % 81) - 10.0, 0.5 * (rand() % 81) - 10.0);
+
+        real_cpu expected_distance, distance;
+        uint32_t expected = brute_force_nearest_point(points, n, p, &expected_distance);
+        uint32_t nearest = bucket_grid_nearest_point(grid, p, &distance);
+
+        cr_assert_eq(nearest, expected, "Query (%lf, %lf, %lf): found %u, expected %u", p.x, p.y, p.z, nearest, expected);
+        cr_assert_eq(distance, expected_distance);
+    }
+
+    free_bucket_grid(grid);
+    free(points);
+}
+
+// Dijkstra as it was done before the adjacency array: the nearest node not visited yet is searched in all the nodes
+// and its edges are read from the lists of the graph. With positive weights the distances are the unique solution of
+// dist[v] = min(dist[u] + w(u, v)), so they must be equal to the ones of dijkstra_csr, not only near.
+static double *reference_dijkstra(struct graph *g, const uint32_t *src_ids, uint32_t num_sources) {
+
+    uint32_t n = g->total_nodes;
+    double *dist = malloc(n * sizeof(double));
+    bool *visited = calloc(n, sizeof(bool));
+    struct node **nodes = malloc(n * sizeof(struct node *));
+
+    uint32_t i = 0;
+    for(struct node *node = g->list_nodes; node != NULL; node = node->next) {
+        nodes[i++] = node;
+        dist[node->id] = __DBL_MAX__;
+    }
+
+    for(i = 0; i < num_sources; i++) {
+        dist[src_ids[i]] = 0.0;
+    }
+
+    while(true) {
+        uint32_t u = UINT32_MAX;
+        for(i = 0; i < n; i++) {
+            if(!visited[i] && dist[i] < __DBL_MAX__ && (u == UINT32_MAX || dist[i] < dist[u])) {
+                u = i;
+            }
+        }
+
+        if(u == UINT32_MAX) break;
+        visited[u] = true;
+
+        for(struct edge *e = nodes[u]->list_edges; e != NULL; e = e->next) {
+            if(dist[u] + e->w < dist[e->id]) {
+                dist[e->id] = dist[u] + e->w;
+            }
+        }
+    }
+
+    free(nodes);
+    free(visited);
+
+    return dist;
+}
+
+static void insert_random_node(struct graph *g) {
+    real_cpu pos[3] = {random_between(0, 1000), random_between(0, 1000), random_between(0, 1000)};
+    insert_node_graph(g, pos, 1.0);
+}
+
+// A random tree with both directions of each edge (as in the Purkinje networks), some extra edges that close cycles,
+// some edges in one direction only and a last node without edges
+static struct graph *new_random_graph(uint32_t num_nodes) {
+
+    struct graph *g = new_graph();
+
+    for(uint32_t i = 0; i < num_nodes; i++) {
+        insert_random_node(g);
+    }
+
+    for(uint32_t i = 1; i + 1 < num_nodes; i++) {
+        uint32_t j = rand() % i;
+        insert_edge_graph(g, i, j);
+        insert_edge_graph(g, j, i);
+    }
+
+    if(num_nodes > 2) {
+        for(uint32_t k = 0; k < num_nodes / 4; k++) {
+            uint32_t a = rand() % (num_nodes - 1);
+            uint32_t b = rand() % (num_nodes - 1);
+            insert_edge_graph(g, a, b);
+            if(k % 3) {
+                insert_edge_graph(g, b, a);
+            }
+        }
+    }
+
+    return g;
+}
+
+static void check_distances(struct graph *g, const uint32_t *src_ids, uint32_t num_sources) {
+
+    double *expected = reference_dijkstra(g, src_ids, num_sources);
+    double *dist = num_sources == 1 ? dijkstra(g, src_ids[0]) : dijkstra_multi_source(g, src_ids, num_sources);
+
+    for(uint32_t i = 0; i < g->total_nodes; i++) {
+        cr_assert_eq(dist[i], expected[i], "Node %u: distance %lf, expected %lf", i, dist[i], expected[i]);
+    }
+
+    uint32_t *terminal_ids, num_terminals;
+    double *terminal_dist = dijkstra_terminals(g, src_ids, num_sources, &terminal_ids, &num_terminals);
+
+    uint32_t t = 0;
+    for(struct node *node = g->list_nodes; node != NULL; node = node->next) {
+        if(is_terminal(node)) {
+            cr_assert_lt(t, num_terminals);
+            cr_assert_eq(terminal_ids[t], node->id);
+            cr_assert_eq(terminal_dist[t], expected[node->id]);
+            t++;
+        }
+    }
+    cr_assert_eq(t, num_terminals);
+
+    free(terminal_ids);
+    free(terminal_dist);
+    free(dist);
+    free(expected);
+}
+
+Test (graph, dijkstra_single_source) {
+
+    srand(5);
+
+    uint32_t sizes[] = {1, 2, 3, 50, 2000};
+
+    for(int s = 0; s < 5; s++) {
+        struct graph *g = new_random_graph(sizes[s]);
+
+        for(uint32_t k = 0; k < 10; k++) {
+            uint32_t src = k == 0 ? 0 : rand() % sizes[s];
+            check_distances(g, &src, 1);
+        }
+
+        free_graph(g);
+    }
+}
+
+Test (graph, dijkstra_multi_source) {
+
+    srand(9);
+
+    uint32_t n = 1000;
+    struct graph *g = new_random_graph(n);
+
+    // Repeated sources included
+    uint32_t src_ids[] = {0, 17, 17, 500, 999, 3};
+
+    for(uint32_t num_sources = 1; num_sources <= 6; num_sources++) {
+        check_distances(g, src_ids, num_sources);
+    }
+
+    free_graph(g);
+}
+
+// The adjacency array is kept between the calls, so it must be rebuilt when the graph changes
+Test (graph, dijkstra_after_graph_changes) {
+
+    srand(13);
+
+    uint32_t n = 200;
+    struct graph *g = new_random_graph(n);
+    uint32_t src = 0;
+
+    check_distances(g, &src, 1);
+
+    insert_edge_graph(g, 0, n - 1);
+    check_distances(g, &src, 1);
+
+    insert_random_node(g);
+    insert_edge_graph(g, n - 1, n);
+    insert_edge_graph(g, n, n - 1);
+    check_distances(g, &src, 1);
+
+    free_graph(g);
+}
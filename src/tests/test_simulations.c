@@ -166,6 +166,108 @@ static int check_output_vtp_equals(sds gold_output, sds tested_output, float tol
     return 1;
 }
 
+Test(run_generated_model_simulation, mitchell_shaeffer_generated_vs_hand_written) {
+
+    char *out_dir_hand_written = "tests_bin/cable_mitchell_shaeffer_hand_written";
+    char *out_dir_generated = "tests_bin/cable_mitchell_shaeffer_generated";
+
+    struct user_options *options = load_options_from_file("example_configs/cable_mesh_with_mitchell_shaeffer_generated.ini");
+    options->final_time = 100.0;
+
+    free(options->save_mesh_config->main_function_name);
+    options->save_mesh_config->main_function_name = strdup("save_as_text_or_binary");
+
+    free(options->save_mesh_config->init_function_name);
+    free(options->save_mesh_config->end_function_name);
+
+    options->save_mesh_config->init_function_name = NULL;
+    options->save_mesh_config->end_function_name = NULL;
+
+    shput_dup_value(options->save_mesh_config->config_data, "print_rate", "50");
+    shput_dup_value(options->save_mesh_config->config_data, "file_prefix", "V");
+
+    int success = run_simulation_with_config(options, out_dir_generated);
+    cr_assert(success);
+
+    free(options->model_file_path);
+    options->model_file_path = strdup("shared_libs/libmitchell_shaeffer_2003.so");
+
+    success = run_simulation_with_config(options, out_dir_hand_written);
+    cr_assert(success);
+
+    success = check_output_equals(out_dir_hand_written, out_dir_generated, 1e-4f);
+    cr_assert(success);
+
+    free_user_options(options);
+}
+
+Test(run_adaptive_ode_simulation, bondarenko_rosenbrock_vs_euler) {
+
+    char *out_dir_euler = "tests_bin/cable_bondarenko_adaptive_euler";
+    char *out_dir_rosenbrock = "tests_bin/cable_bondarenko_adaptive_rosenbrock";
+    char *out_dir_rosenbrock_fine = "tests_bin/cable_bondarenko_adaptive_rosenbrock_fine";
+
+    struct user_options *options = load_options_from_file("example_configs/cable_mesh_with_mitchell_shaeffer_generated.ini");
+    options->final_time = 30.0;
+    options->ode_adaptive = true;
+
+    // One thread, so the comparisons are reproducible (the upstroke amplifies the round off of the parallel sums)
+    options->num_threads = 1;
+
+    options->ode_reltol = 1e-7;
+    options->ode_abstol = 1e-7;
+
+    free(options->model_file_path);
+    options->model_file_path = strdup("shared_libs/libbondarenko_2004.so");
+
+    free(options->save_mesh_config->main_function_name);
+    options->save_mesh_config->main_function_name = strdup("save_as_text_or_binary");
+
+    free(options->save_mesh_config->init_function_name);
+    free(options->save_mesh_config->end_function_name);
+
+    options->save_mesh_config->init_function_name = NULL;
+    options->save_mesh_config->end_function_name = NULL;
+
+    shput_dup_value(options->save_mesh_config->config_data, "print_rate", "25");
+    shput_dup_value(options->save_mesh_config->config_data, "file_prefix", "V");
+
+    shput_dup_value(options->domain_config->config_data, "cable_length", "2000.0");
+
+    struct config *stim_config = (struct config *)shget(options->stim_configs, "stim_plain");
+    shput_dup_value(stim_config->config_data, "start", "1.0");
+    shput_dup_value(stim_config->config_data, "current", "-50.0");
+    shput_dup_value(stim_config->config_data, "x_limit", "300.0");
+
+    options->dt_ode = 0.00001;
+
+    int success = run_simulation_with_config(options, out_dir_euler);
+    cr_assert(success);
+
+    // dt is also the minimum step of the adaptive solvers. Explicit steps of this size are unstable in the upstroke
+    options->dt_ode = 0.002;
+    shput_dup_value(options->ode_extra_config, "method", "rosenbrock");
+
+    success = run_simulation_with_config(options, out_dir_rosenbrock);
+    cr_assert(success);
+
+    // The Rosenbrock solution is converged: a minimum step 10 times smaller changes it by less than 0.005 mV
+    options->dt_ode = 0.0002;
+
+    success = run_simulation_with_config(options, out_dir_rosenbrock_fine);
+    cr_assert(success);
+
+    success = check_output_equals(out_dir_rosenbrock_fine, out_dir_rosenbrock, 0.05f);
+    cr_assert(success);
+
+    // A frame each 0.5 ms, including the upstroke. The adaptive Euler solution is only accurate to about 1 mV there
+    // (it changes by up to 0.7 mV with tighter tolerances), so it only checks the Rosenbrock solution for large errors
+    success = check_output_equals(out_dir_euler, out_dir_rosenbrock, 1.0f);
+    cr_assert(success);
+
+    free_user_options(options);
+}
+
 #ifdef COMPILE_CUDA
 
 Test(run_circle_simulation, gc_gpu_vs_cg_no_cpu) {
@@ -6,6 +6,8 @@
 
 #include "../alg/grid/grid.h"
 #include "../config/linear_system_solver_config.h"
+#include "../config/domain_config.h"
+#include "../config/assembly_matrix_config.h"
 #include "../utils/file_utils.h"
 #include "../3dparty/ini_parser/ini.h"
 #include "../3dparty/sds/sds.h"
@@ -110,6 +112,268 @@ void test_solver(bool preconditioner, char *method_name, char *init_name, char *
     fclose(B);
 }
 
+// Cuboid mesh of 100 um cells with the matrix of the given assembly function and a smooth right hand side
+static struct grid *new_assembled_cuboid_grid(char *assembly_function_name, bool anisotropic, char *side_length_x, char *side_length_y, char *side_length_z) {
+
+    struct grid *grid = new_grid();
+    cr_assert(grid);
+
+    struct config *domain_config = alloc_and_init_config_data();
+    domain_config->main_function_name = strdup("initialize_grid_with_cuboid_mesh");
+    shput_dup_value(domain_config->config_data, "start_dx", "100.0");
+    shput_dup_value(domain_config->config_data, "start_dy", "100.0");
+    shput_dup_value(domain_config->config_data, "start_dz", "100.0");
+    shput_dup_value(domain_config->config_data, "side_length_x", side_length_x);
+    shput_dup_value(domain_config->config_data, "side_length_y", side_length_y);
+    shput_dup_value(domain_config->config_data, "side_length_z", side_length_z);
+
+    init_config_functions(domain_config, "./shared_libs/libdefault_domains.so", "domain");
+    int success = ((set_spatial_domain_fn *)domain_config->main_function)(domain_config, grid);
+    cr_assert(success);
+
+    order_grid_cells(grid);
+
+    struct monodomain_solver *monodomain_solver = new_monodomain_solver();
+    monodomain_solver->dt = 0.02;
+
+    struct config *assembly_config = alloc_and_init_config_data();
+    assembly_config->main_function_name = strdup(assembly_function_name);
+
+    if(anisotropic) {
+        shput_dup_value(assembly_config->config_data, "sigma_l", "0.00013");
+        shput_dup_value(assembly_config->config_data, "sigma_t", "0.00005");
+        shput_dup_value(assembly_config->config_data, "sigma_n", "0.00002");
+        shput_dup_value(assembly_config->config_data, "f", "[0.7071067811865476, 0.7071067811865476, 0]");
+        shput_dup_value(assembly_config->config_data, "s", "[-0.7071067811865476, 0.7071067811865476, 0]");
+    } else {
+        shput_dup_value(assembly_config->config_data, "sigma_x", "0.00013");
+        shput_dup_value(assembly_config->config_data, "sigma_y", "0.00005");
+        shput_dup_value(assembly_config->config_data, "sigma_z", "0.00002");
+    }
+
+    init_config_functions(assembly_config, "./shared_libs/libdefault_matrix_assembly.so", "assembly_matrix");
+    ((assembly_matrix_fn *)assembly_config->main_function)(assembly_config, monodomain_solver, grid);
+
+    for(uint32_t i = 0; i < grid->num_active_cells; i++) {
+        struct point_3d c = grid->active_cells[i]->center;
+        grid->active_cells[i]->b = sin(c.x / 300.0) + cos(c.y / 200.0) * c.z / 800.0;
+    }
+
+    free(monodomain_solver);
+    free_config_data(domain_config);
+    free_config_data(assembly_config);
+
+    return grid;
+}
+
+static real_cpu *solve_with_cg(struct grid *grid, bool preconditioner, bool matrix_free) {
+
+    struct config *linear_system_solver_config = alloc_and_init_config_data();
+    linear_system_solver_config->main_function_name = strdup("cpu_conjugate_gradient");
+    linear_system_solver_config->init_function_name = strdup("init_cpu_conjugate_gradient");
+    linear_system_solver_config->end_function_name = strdup("end_cpu_conjugate_gradient");
+
+    shput_dup_value(linear_system_solver_config->config_data, "tolerance", "1e-16");
+    shput_dup_value(linear_system_solver_config->config_data, "max_iterations", "500");
+    shput_dup_value(linear_system_solver_config->config_data, "use_preconditioner", preconditioner ? "yes" : "no");
+    shput_dup_value(linear_system_solver_config->config_data, "matrix_free", matrix_free ? "yes" : "no");
+
+    init_config_functions(linear_system_solver_config, "./shared_libs/libdefault_linear_system_solver.so", "linear_system_solver");
+
+    for(uint32_t i = 0; i < grid->num_active_cells; i++) {
+        grid->active_cells[i]->v = 0.0;
+    }
+
+    uint32_t n_iter;
+    real_cpu error;
+    struct time_info ti = ZERO_TIME_INFO;
+
+    CALL_INIT_LINEAR_SYSTEM(linear_system_solver_config, grid, false);
+
+    // The stencil is the first member of the CG persistent data and is NULL when the assembled matrix is used
+    cr_assert(linear_system_solver_config->persistent_data);
+    cr_assert_eq(*(void **)linear_system_solver_config->persistent_data != NULL, matrix_free);
+
+    ((linear_system_solver_fn*)linear_system_solver_config->main_function)(&ti, linear_system_solver_config, grid, grid->num_active_cells, grid->active_cells, &n_iter, &error);
+    CALL_END_LINEAR_SYSTEM(linear_system_solver_config);
+
+    cr_assert(n_iter < 500);
+
+    real_cpu *x = malloc(grid->num_active_cells * sizeof(real_cpu));
+
+    for(uint32_t i = 0; i < grid->num_active_cells; i++) {
+        x[i] = grid->active_cells[i]->v;
+    }
+
+    free_config_data(linear_system_solver_config);
+
+    return x;
+}
+
+void test_matrix_free_solver(bool preconditioner, char *assembly_function_name, bool anisotropic) {
+
+    struct grid *grid = new_assembled_cuboid_grid(assembly_function_name, anisotropic, "1200.0", "1000.0", "800.0");
+
+    real_cpu *x_assembled = solve_with_cg(grid, preconditioner, false);
+    real_cpu *x_matrix_free = solve_with_cg(grid, preconditioner, true);
+
+    for (uint32_t i = 0; i < grid->num_active_cells; i++) {
+        cr_assert_float_eq (x_assembled[i], x_matrix_free[i], 1e-8, "Found %lf, Expected %lf.", x_matrix_free[i], x_assembled[i]);
+    }
+
+    free(x_assembled);
+    free(x_matrix_free);
+    clean_and_free_grid(grid);
+}
+
+// The cable is a tree, so the direct solver is used unless the cells given to the solver are not the ones of the init
+// function. Then it falls back to the conjugate gradient
+void test_tree_direct_solver(bool fallback) {
+
+    struct grid *grid = new_assembled_cuboid_grid("homogeneous_sigma_assembly_matrix", false, "3000.0", "100.0", "100.0");
+
+    real_cpu *x_cg = solve_with_cg(grid, true, false);
+
+    struct config *linear_system_solver_config = alloc_and_init_config_data();
+    linear_system_solver_config->main_function_name = strdup("tree_direct_solver");
+    linear_system_solver_config->init_function_name = strdup("init_tree_direct_solver");
+    linear_system_solver_config->end_function_name = strdup("end_tree_direct_solver");
+
+    shput_dup_value(linear_system_solver_config->config_data, "tolerance", "1e-16");
+    shput_dup_value(linear_system_solver_config->config_data, "max_iterations", "500");
+    shput_dup_value(linear_system_solver_config->config_data, "use_preconditioner", "yes");
+
+    init_config_functions(linear_system_solver_config, "./shared_libs/libdefault_linear_system_solver.so", "linear_system_solver");
+
+    uint32_t num_cells = grid->num_active_cells;
+    struct cell_node **active_cells = grid->active_cells;
+
+    if(fallback) {
+        active_cells = malloc(num_cells * sizeof(struct cell_node *));
+        memcpy(active_cells, grid->active_cells, num_cells * sizeof(struct cell_node *));
+    }
+
+    for(uint32_t i = 0; i < num_cells; i++) {
+        grid->active_cells[i]->v = 0.0;
+    }
+
+    uint32_t n_iter;
+    real_cpu error;
+    struct time_info ti = ZERO_TIME_INFO;
+
+    CALL_INIT_LINEAR_SYSTEM(linear_system_solver_config, grid, false);
+    cr_assert(linear_system_solver_config->persistent_data);
+
+    ((linear_system_solver_fn*)linear_system_solver_config->main_function)(&ti, linear_system_solver_config, grid, num_cells, active_cells, &n_iter, &error);
+    CALL_END_LINEAR_SYSTEM(linear_system_solver_config);
+
+    if(fallback) {
+        cr_assert(n_iter > 1);
+    } else {
+        cr_assert_eq(n_iter, 1);
+    }
+
+    for (uint32_t i = 0; i < num_cells; i++) {
+        cr_assert_float_eq (x_cg[i], grid->active_cells[i]->v, 1e-6, "Found %lf, Expected %lf.", grid->active_cells[i]->v, x_cg[i]);
+    }
+
+    if(fallback) {
+        free(active_cells);
+    }
+
+    free(x_cg);
+    free_config_data(linear_system_solver_config);
+    clean_and_free_grid(grid);
+}
+
+// Solves three right-hand sides (b, b in the reverse order and b shifted by a third of the cells) with
+// cpu_conjugate_gradient_multi_rhs and compares each solution with the one of cpu_conjugate_gradient
+void test_multi_rhs_solver(struct grid *grid, bool preconditioner, bool matrix_free) {
+
+    const uint32_t num_rhs = 3;
+    uint32_t n = grid->num_active_cells;
+    struct cell_node **ac = grid->active_cells;
+
+    real_cpu *b = malloc(num_rhs * n * sizeof(real_cpu));
+    real_cpu *x = calloc(num_rhs * n, sizeof(real_cpu));
+
+    for(uint32_t i = 0; i < n; i++) {
+        uint32_t position = ac[i]->grid_position;
+        b[position] = ac[i]->b;
+        b[n + position] = ac[n - 1 - i]->b;
+        b[2 * n + position] = ac[(i + n / 3) % n]->b;
+    }
+
+    real_cpu *x_single[num_rhs];
+
+    for(uint32_t k = 0; k < num_rhs; k++) {
+        for(uint32_t i = 0; i < n; i++) {
+            ac[i]->b = b[k * n + ac[i]->grid_position];
+        }
+        x_single[k] = solve_with_cg(grid, preconditioner, matrix_free);
+    }
+
+    struct config *linear_system_solver_config = alloc_and_init_config_data();
+    linear_system_solver_config->main_function_name = strdup("cpu_conjugate_gradient_multi_rhs");
+    linear_system_solver_config->init_function_name = strdup("init_cpu_conjugate_gradient");
+    linear_system_solver_config->end_function_name = strdup("end_cpu_conjugate_gradient");
+
+    shput_dup_value(linear_system_solver_config->config_data, "tolerance", "1e-16");
+    shput_dup_value(linear_system_solver_config->config_data, "max_iterations", "500");
+    shput_dup_value(linear_system_solver_config->config_data, "use_preconditioner", preconditioner ? "yes" : "no");
+    shput_dup_value(linear_system_solver_config->config_data, "matrix_free", matrix_free ? "yes" : "no");
+
+    init_config_functions(linear_system_solver_config, "./shared_libs/libdefault_linear_system_solver.so", "linear_system_solver");
+
+    uint32_t n_iter[num_rhs];
+    real_cpu error[num_rhs];
+    struct time_info ti = ZERO_TIME_INFO;
+
+    CALL_INIT_LINEAR_SYSTEM(linear_system_solver_config, grid, false);
+    ((linear_system_solver_multi_rhs_fn*)linear_system_solver_config->main_function)(&ti, linear_system_solver_config, grid, n, ac, num_rhs, x, b, n_iter, error);
+    CALL_END_LINEAR_SYSTEM(linear_system_solver_config);
+
+    for(uint32_t k = 0; k < num_rhs; k++) {
+        cr_assert(n_iter[k] < 500);
+        for(uint32_t i = 0; i < n; i++) {
+            real_cpu expected = x_single[k][i];
+            real_cpu found = x[k * n + ac[i]->grid_position];
+            cr_assert_float_eq(expected, found, 1e-8, "Right-hand side %u: found %lf, Expected %lf.", k, found, expected);
+        }
+        free(x_single[k]);
+    }
+
+    free(b);
+    free(x);
+    free_config_data(linear_system_solver_config);
+}
+
+void test_multi_rhs_solver_with_file(bool preconditioner) {
+
+    FILE *A = fopen("tests_bin/A1.txt", "r");
+    FILE *B = fopen("tests_bin/B1.txt", "r");
+
+    cr_assert(A);
+    cr_assert(B);
+
+    struct grid *grid = new_grid();
+    cr_assert (grid);
+
+    construct_grid_from_file(grid, A, B);
+
+    test_multi_rhs_solver(grid, preconditioner, false);
+
+    clean_and_free_grid(grid);
+    fclose(A);
+    fclose(B);
+}
+
+void test_multi_rhs_solver_matrix_free(bool preconditioner) {
+    struct grid *grid = new_assembled_cuboid_grid("homogeneous_sigma_assembly_matrix", false, "1200.0", "1000.0", "800.0");
+    test_multi_rhs_solver(grid, preconditioner, true);
+    clean_and_free_grid(grid);
+}
+
 Test (solvers, cpu_cg_jacobi_preconditioner_1t) {
     test_solver(true, "cpu_conjugate_gradient", "init_cpu_conjugate_gradient", NULL, 1, 1);
 }
@@ -118,6 +382,38 @@ Test (solvers, cpu_cg_no_preconditioner_1t) {
     test_solver(false, "cpu_conjugate_gradient", "init_cpu_conjugate_gradient", NULL, 1, 1);
 }
 
+Test (solvers, cpu_cg_matrix_free_jacobi_preconditioner_1t) {
+    test_matrix_free_solver(true, "homogeneous_sigma_assembly_matrix", false);
+}
+
+Test (solvers, cpu_cg_matrix_free_no_preconditioner_1t) {
+    test_matrix_free_solver(false, "homogeneous_sigma_assembly_matrix", false);
+}
+
+Test (solvers, cpu_cg_matrix_free_anisotropic_1t) {
+    test_matrix_free_solver(true, "anisotropic_sigma_assembly_matrix", true);
+}
+
+Test (solvers, tree_direct_solver_1t) {
+    test_tree_direct_solver(false);
+}
+
+Test (solvers, tree_direct_solver_cg_fallback_1t) {
+    test_tree_direct_solver(true);
+}
+
+Test (solvers, cpu_cg_multi_rhs_jacobi_preconditioner_1t) {
+    test_multi_rhs_solver_with_file(true);
+}
+
+Test (solvers, cpu_cg_multi_rhs_no_preconditioner_1t) {
+    test_multi_rhs_solver_with_file(false);
+}
+
+Test (solvers, cpu_cg_multi_rhs_matrix_free_1t) {
+    test_multi_rhs_solver_matrix_free(true);
+}
+
 #ifdef COMPILE_CUDA
 
 Test (solvers, gpu_cg_jacobi_preconditioner_1t) {
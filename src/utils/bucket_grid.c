@@ -0,0 +1,159 @@
+#include "bucket_grid.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POINTS_PER_BUCKET 2.0
+
+static inline int64_t bucket_coordinate(real_cpu value, real_cpu min, real_cpu h, uint32_t n) {
+    real_cpu c = floor((value - min) / h);
+    if(c < 0.0) {
+        return 0;
+    }
+    if(c >= (real_cpu)n) {
+        return n - 1;
+    }
+    return (int64_t)c;
+}
+
+struct bucket_grid *new_bucket_grid(const struct point_3d *points, uint32_t num_points, real_cpu min_h) {
+
+    struct bucket_grid *grid = calloc(1, sizeof(struct bucket_grid));
+    grid->points = points;
+    grid->num_points = num_points;
+
+    struct point_3d min = POINT3D(DBL_MAX, DBL_MAX, DBL_MAX);
+    struct point_3d max = POINT3D(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+
+    for(uint32_t i = 0; i < num_points; i++) {
+        min.x = fmin(min.x, points[i].x);
+        min.y = fmin(min.y, points[i].y);
+        min.z = fmin(min.z, points[i].z);
+        max.x = fmax(max.x, points[i].x);
+        max.y = fmax(max.y, points[i].y);
+        max.z = fmax(max.z, points[i].z);
+    }
+
+    if(num_points == 0) {
+        min = max = POINT3D(0, 0, 0);
+    }
+
+    real_cpu lx = max.x - min.x;
+    real_cpu ly = max.y - min.y;
+    real_cpu lz = max.z - min.z;
+    real_cpu l_max = fmax(lx, fmax(ly, lz));
+
+    // Flat sets would have zero volume, so each side is at least 1e-3 of the largest one
+    real_cpu min_side = fmax(fmax(l_max * 1e-3, min_h), DBL_MIN);
+    real_cpu volume = fmax(lx, min_side) * fmax(ly, min_side) * fmax(lz, min_side);
+
+    grid->h = fmax(cbrt(volume * POINTS_PER_BUCKET / fmax(num_points, 1)), min_side);
+    grid->min = min;
+    grid->nx = (uint32_t)(lx / grid->h) + 1;
+    grid->ny = (uint32_t)(ly / grid->h) + 1;
+    grid->nz = (uint32_t)(lz / grid->h) + 1;
+
+    uint64_t num_buckets = (uint64_t)grid->nx * grid->ny * grid->nz;
+    grid->offsets = calloc(num_buckets + 1, sizeof(uint32_t));
+    grid->bucket_points = malloc(num_points * sizeof(uint32_t));
+
+    uint64_t *bucket_of = malloc(num_points * sizeof(uint64_t));
+
+    for(uint32_t i = 0; i < num_points; i++) {
+        int64_t bx = bucket_coordinate(points[i].x, min.x, grid->h, grid->nx);
+        int64_t by = bucket_coordinate(points[i].y, min.y, grid->h, grid->ny);
+        int64_t bz = bucket_coordinate(points[i].z, min.z, grid->h, grid->nz);
+        bucket_of[i] = ((uint64_t)bz * grid->ny + by) * grid->nx + bx;
+        grid->offsets[bucket_of[i] + 1]++;
+    }
+
+    for(uint64_t b = 0; b < num_buckets; b++) {
+        grid->offsets[b + 1] += grid->offsets[b];
+    }
+
+    uint32_t *next = malloc(num_buckets * sizeof(uint32_t));
+    memcpy(next, grid->offsets, num_buckets * sizeof(uint32_t));
+
+    // Filled in the order of the points, so the points of each bucket are sorted by index
+    for(uint32_t i = 0; i < num_points; i++) {
+        grid->bucket_points[next[bucket_of[i]]++] = i;
+    }
+
+    free(next);
+    free(bucket_of);
+
+    return grid;
+}
+
+void free_bucket_grid(struct bucket_grid *grid) {
+    if(grid == NULL) {
+        return;
+    }
+    free(grid->offsets);
+    free(grid->bucket_points);
+    free(grid);
+}
+
+uint32_t bucket_grid_nearest_point(const struct bucket_grid *grid, struct point_3d p, real_cpu *distance) {
+
+    real_cpu best = DBL_MAX;
+    uint32_t nearest = 0;
+
+    int64_t cx = bucket_coordinate(p.x, grid->min.x, grid->h, grid->nx);
+    int64_t cy = bucket_coordinate(p.y, grid->min.y, grid->h, grid->ny);
+    int64_t cz = bucket_coordinate(p.z, grid->min.z, grid->h, grid->nz);
+
+    int64_t max_ring = grid->nx;
+    if(grid->ny > max_ring) max_ring = grid->ny;
+    if(grid->nz > max_ring) max_ring = grid->nz;
+
+    // Visit the buckets in rings around the bucket of p. There are r - 1 whole buckets between the bucket of p and
+    // the ring r, so the points in the ring r (or after it) are at least (r - 1) * h away. The search stops when the
+    // nearest point found is nearer than that (with a margin for round off).
+    for(int64_t r = 0; r <= max_ring; r++) {
+
+        if(best < (r - 1) * grid->h * (1.0 - 1e-9)) {
+            break;
+        }
+
+        for(int64_t z = cz - r; z <= cz + r; z++) {
+            if(z < 0 || z >= grid->nz) continue;
+
+            for(int64_t y = cy - r; y <= cy + r; y++) {
+                if(y < 0 || y >= grid->ny) continue;
+
+                // Inside the ring only the first and the last bucket of a row are on its surface
+                bool inner_row = llabs(z - cz) != r && llabs(y - cy) != r;
+
+                for(int64_t x = cx - r; x <= cx + r; x += (inner_row ? 2 * r : 1)) {
+                    if(x >= 0 && x < grid->nx) {
+
+                        uint64_t bucket = ((uint64_t)z * grid->ny + y) * grid->nx + x;
+
+                        for(uint32_t b = grid->offsets[bucket]; b < grid->offsets[bucket + 1]; b++) {
+                            uint32_t i = grid->bucket_points[b];
+                            struct point_3d q = grid->points[i];
+
+                            real_cpu d = sqrt((q.x - p.x) * (q.x - p.x) + (q.y - p.y) * (q.y - p.y) + (q.z - p.z) * (q.z - p.z));
+
+                            if(d < best || (d == best && i < nearest)) {
+                                best = d;
+                                nearest = i;
+                            }
+                        }
+                    }
+
+                    if(r == 0) break;
+                }
+            }
+        }
+    }
+
+    if(distance) {
+        *distance = best;
+    }
+
+    return nearest;
+}
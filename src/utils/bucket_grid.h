@@ -0,0 +1,33 @@
+//
+// Uniform grid of buckets over a set of points, used to find the nearest point of the set to a query point.
+// Each bucket has the indexes of its points in increasing order, so a query returns the same point as a brute force
+// search (the nearest one, the lowest index in a tie).
+//
+
+#ifndef MONOALG3D_BUCKET_GRID_H
+#define MONOALG3D_BUCKET_GRID_H
+
+#include <stdint.h>
+
+#include "../common_types/common_types.h"
+
+struct bucket_grid {
+    const struct point_3d *points; // Not owned by the grid
+    uint32_t num_points;
+    struct point_3d min;
+    real_cpu h;
+    uint32_t nx, ny, nz;
+    uint32_t *offsets;       // CSR of the buckets (nx * ny * nz + 1 entries)
+    uint32_t *bucket_points;
+};
+
+// The buckets are cubes of side at least min_h, with about two points per bucket. The points must stay valid while
+// the grid is used.
+struct bucket_grid *new_bucket_grid(const struct point_3d *points, uint32_t num_points, real_cpu min_h);
+void free_bucket_grid(struct bucket_grid *grid);
+
+// Returns the index of the point nearest to p and stores its distance to p in distance (if not NULL).
+// Returns 0 when the grid has no points. Can be called from several threads at the same time.
+uint32_t bucket_grid_nearest_point(const struct bucket_grid *grid, struct point_3d p, real_cpu *distance);
+
+#endif // MONOALG3D_BUCKET_GRID_H
@@ -0,0 +1,375 @@
+//
+// Binary Vm matrix files (see vm_matrix.h)
+//
+
+#include "vm_matrix.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../3dparty/stb_ds.h"
+
+size_t vm_matrix_value_size(enum vm_matrix_value_type value_type) {
+    switch(value_type) {
+        case VM_MATRIX_FLOAT64:
+            return sizeof(double);
+        case VM_MATRIX_FLOAT32:
+            return sizeof(float);
+        case VM_MATRIX_FLOAT16:
+            return sizeof(uint16_t);
+    }
+    return 0;
+}
+
+// IEEE 754 half precision, rounded to the nearest value (ties to even)
+uint16_t float_to_half(float value) {
+
+    uint32_t x;
+    memcpy(&x, &value, sizeof(x));
+
+    uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+    uint32_t exponent = (x >> 23) & 0xff;
+    uint32_t mantissa = x & 0x7fffff;
+
+    // Inf and NaN
+    if(exponent == 0xff) {
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+
+    int32_t e = (int32_t)exponent - 127 + 15;
+
+    if(e >= 0x1f) {
+        return sign | 0x7c00;
+    }
+
+    if(e <= 0) {
+        // Subnormal half (or zero)
+        if(e < -10) {
+            return sign;
+        }
+
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - e);
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+
+        if(remainder > halfway || (remainder == halfway && (half_mantissa & 1))) {
+            half_mantissa++;
+        }
+
+        return sign | (uint16_t)half_mantissa;
+    }
+
+    uint16_t half = sign | (uint16_t)(e << 10) | (uint16_t)(mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+
+    // A carry into the exponent gives the right result (including the overflow to inf)
+    if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+
+    return half;
+}
+
+float half_to_float(uint16_t value) {
+
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t x;
+
+    if(exponent == 0) {
+        if(mantissa == 0) {
+            x = sign;
+        } else {
+            int32_t e = 127 - 15 + 1;
+            while(!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                e--;
+            }
+            x = sign | ((uint32_t)e << 23) | ((mantissa & 0x3ff) << 13);
+        }
+    } else if(exponent == 0x1f) {
+        x = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &x, sizeof(result));
+    return result;
+}
+
+struct vm_matrix_writer *new_vm_matrix_writer(const char *data_path, const char *index_path, enum vm_matrix_value_type value_type, uint32_t decimation,
+                                              size_t chunk_capacity) {
+
+    FILE *data_file = fopen(data_path, "wb");
+    FILE *index_file = fopen(index_path, "wb");
+
+    if(!data_file || !index_file) {
+        if(data_file) fclose(data_file);
+        if(index_file) fclose(index_file);
+        return NULL;
+    }
+
+    struct vm_matrix_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VM_MATRIX_MAGIC, sizeof(header.magic));
+    header.version = VM_MATRIX_VERSION;
+    header.value_type = value_type;
+    header.decimation = decimation;
+    fwrite(&header, sizeof(header), 1, data_file);
+
+    struct vm_matrix_index_header index_header;
+    memset(&index_header, 0, sizeof(index_header));
+    memcpy(index_header.magic, VM_MATRIX_INDEX_MAGIC, sizeof(index_header.magic));
+    index_header.version = VM_MATRIX_VERSION;
+    fwrite(&index_header, sizeof(index_header), 1, index_file);
+
+    struct vm_matrix_writer *writer = CALLOC_ONE_TYPE(struct vm_matrix_writer);
+    writer->data_file = data_file;
+    writer->index_file = index_file;
+    writer->value_type = value_type;
+    writer->offset = sizeof(header);
+    writer->chunk_capacity = chunk_capacity;
+    writer->chunk = (unsigned char *)malloc(chunk_capacity);
+
+    return writer;
+}
+
+void vm_matrix_writer_flush(struct vm_matrix_writer *writer) {
+
+    if(writer->chunk_size > 0) {
+        fwrite(writer->chunk, 1, writer->chunk_size, writer->data_file);
+        writer->offset += writer->chunk_size;
+        writer->chunk_size = 0;
+    }
+
+    size_t num_frames = arrlen(writer->pending_frames);
+
+    if(num_frames > 0) {
+        fwrite(writer->pending_frames, sizeof(struct vm_matrix_frame), num_frames, writer->index_file);
+        arrsetlen(writer->pending_frames, 0);
+    }
+
+    fflush(writer->data_file);
+    fflush(writer->index_file);
+}
+
+void vm_matrix_writer_add_frame(struct vm_matrix_writer *writer, double time, const real_cpu *values, uint64_t num_cells) {
+
+    size_t value_size = vm_matrix_value_size(writer->value_type);
+    size_t frame_size = num_cells * value_size;
+    // The frame starts at an offset of the file multiple of 8, so the padding depends on what was already flushed
+    size_t padding = (8 - ((writer->offset + writer->chunk_size) % 8)) % 8;
+
+    if(writer->chunk_size > 0 && writer->chunk_size + padding + frame_size > writer->chunk_capacity) {
+        vm_matrix_writer_flush(writer);
+        padding = (8 - (writer->offset % 8)) % 8;
+    }
+
+    if(padding + frame_size > writer->chunk_capacity) {
+        writer->chunk_capacity = padding + frame_size;
+        writer->chunk = (unsigned char *)realloc(writer->chunk, writer->chunk_capacity);
+    }
+
+    memset(writer->chunk + writer->chunk_size, 0, padding);
+    writer->chunk_size += padding;
+
+    struct vm_matrix_frame frame;
+    frame.time = time;
+    frame.offset = writer->offset + writer->chunk_size;
+    frame.num_cells = num_cells;
+    arrput(writer->pending_frames, frame);
+
+    unsigned char *out = writer->chunk + writer->chunk_size;
+
+    switch(writer->value_type) {
+        case VM_MATRIX_FLOAT64: {
+            double *out_values = (double *)out;
+            OMP(parallel for)
+            for(uint64_t i = 0; i < num_cells; i++) {
+                out_values[i] = (double)values[i];
+            }
+            break;
+        }
+        case VM_MATRIX_FLOAT32: {
+            float *out_values = (float *)out;
+            OMP(parallel for)
+            for(uint64_t i = 0; i < num_cells; i++) {
+                out_values[i] = (float)values[i];
+            }
+            break;
+        }
+        case VM_MATRIX_FLOAT16: {
+            uint16_t *out_values = (uint16_t *)out;
+            OMP(parallel for)
+            for(uint64_t i = 0; i < num_cells; i++) {
+                out_values[i] = float_to_half((float)values[i]);
+            }
+            break;
+        }
+    }
+
+    writer->chunk_size += frame_size;
+}
+
+void free_vm_matrix_writer(struct vm_matrix_writer *writer) {
+
+    if(!writer) return;
+
+    vm_matrix_writer_flush(writer);
+
+    fclose(writer->data_file);
+    fclose(writer->index_file);
+    free(writer->chunk);
+    arrfree(writer->pending_frames);
+    free(writer);
+}
+
+static const unsigned char *map_file(const char *path, size_t *size) {
+
+    int fd = open(path, O_RDONLY);
+
+    if(fd == -1) {
+        return NULL;
+    }
+
+    struct stat s;
+    if(fstat(fd, &s) != 0 || !S_ISREG(s.st_mode) || s.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(map == MAP_FAILED) {
+        return NULL;
+    }
+
+    *size = s.st_size;
+    return (const unsigned char *)map;
+}
+
+// Frames that were not completely written (e.g. if the simulation was interrupted) are not used
+struct vm_matrix_file *open_vm_matrix_file(const char *data_path, const char *index_path) {
+
+    size_t data_size = 0, index_size = 0;
+    const unsigned char *data = map_file(data_path, &data_size);
+    const unsigned char *index = map_file(index_path, &index_size);
+
+    struct vm_matrix_header header;
+    struct vm_matrix_index_header index_header;
+
+    bool valid = data && index && data_size >= sizeof(header) && index_size >= sizeof(index_header);
+
+    if(valid) {
+        memcpy(&header, data, sizeof(header));
+        memcpy(&index_header, index, sizeof(index_header));
+
+        valid = memcmp(header.magic, VM_MATRIX_MAGIC, sizeof(header.magic)) == 0 && header.version == VM_MATRIX_VERSION &&
+                header.value_type <= VM_MATRIX_FLOAT16 && memcmp(index_header.magic, VM_MATRIX_INDEX_MAGIC, sizeof(index_header.magic)) == 0 &&
+                index_header.version == VM_MATRIX_VERSION;
+    }
+
+    if(!valid) {
+        if(data) munmap((void *)data, data_size);
+        if(index) munmap((void *)index, index_size);
+        return NULL;
+    }
+
+    struct vm_matrix_file *file = CALLOC_ONE_TYPE(struct vm_matrix_file);
+
+    file->value_type = (enum vm_matrix_value_type)header.value_type;
+    file->decimation = header.decimation;
+    file->data = data;
+    file->data_size = data_size;
+    file->index = index;
+    file->index_size = index_size;
+    file->frames = (const struct vm_matrix_frame *)(index + sizeof(index_header));
+
+    uint64_t num_frames = (index_size - sizeof(index_header)) / sizeof(struct vm_matrix_frame);
+    size_t value_size = vm_matrix_value_size(file->value_type);
+
+    while(num_frames > 0) {
+        const struct vm_matrix_frame *last = &file->frames[num_frames - 1];
+        if(last->offset <= data_size && last->num_cells <= (data_size - last->offset) / value_size) {
+            break;
+        }
+        num_frames--;
+    }
+
+    file->num_frames = num_frames;
+
+    return file;
+}
+
+// Values of the frame as stored in the file (double, float or uint16_t with the half precision bits)
+const void *vm_matrix_frame_values(const struct vm_matrix_file *file, uint64_t frame) {
+    return file->data + file->frames[frame].offset;
+}
+
+void vm_matrix_read_frame(const struct vm_matrix_file *file, uint64_t frame, real_cpu *values) {
+
+    const void *frame_values = vm_matrix_frame_values(file, frame);
+    uint64_t num_cells = file->frames[frame].num_cells;
+
+    for(uint64_t i = 0; i < num_cells; i++) {
+        switch(file->value_type) {
+            case VM_MATRIX_FLOAT64:
+                values[i] = (real_cpu)((const double *)frame_values)[i];
+                break;
+            case VM_MATRIX_FLOAT32:
+                values[i] = (real_cpu)((const float *)frame_values)[i];
+                break;
+            case VM_MATRIX_FLOAT16:
+                values[i] = (real_cpu)half_to_float(((const uint16_t *)frame_values)[i]);
+                break;
+        }
+    }
+}
+
+// Time series of one cell. The values array needs num_frames elements. Frames with fewer cells (adaptive meshes) are
+// skipped. Returns the number of values read.
+uint64_t vm_matrix_read_cell(const struct vm_matrix_file *file, uint64_t cell, real_cpu *values) {
+
+    uint64_t n = 0;
+
+    for(uint64_t f = 0; f < file->num_frames; f++) {
+
+        if(cell >= file->frames[f].num_cells) {
+            continue;
+        }
+
+        const void *frame_values = vm_matrix_frame_values(file, f);
+
+        switch(file->value_type) {
+            case VM_MATRIX_FLOAT64:
+                values[n++] = (real_cpu)((const double *)frame_values)[cell];
+                break;
+            case VM_MATRIX_FLOAT32:
+                values[n++] = (real_cpu)((const float *)frame_values)[cell];
+                break;
+            case VM_MATRIX_FLOAT16:
+                values[n++] = (real_cpu)half_to_float(((const uint16_t *)frame_values)[cell]);
+                break;
+        }
+    }
+
+    return n;
+}
+
+void close_vm_matrix_file(struct vm_matrix_file *file) {
+
+    if(!file) return;
+
+    munmap((void *)file->data, file->data_size);
+    munmap((void *)file->index, file->index_size);
+    free(file);
+}
@@ -0,0 +1,91 @@
+//
+// Binary Vm matrix files written by the save_vm_matrix save function.
+//
+// The data file starts with a struct vm_matrix_header and then has the Vm of all active cells of each saved step
+// (a frame), stored as float64, float32 or float16. Each frame starts at an offset multiple of 8 bytes.
+// The index file starts with a struct vm_matrix_index_header and has one struct vm_matrix_frame for each frame,
+// so both files can be mapped in memory and a frame (or the time series of a cell) can be read without parsing.
+//
+
+#ifndef MONOALG3D_VM_MATRIX_H
+#define MONOALG3D_VM_MATRIX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../common_types/common_types.h"
+
+#define VM_MATRIX_MAGIC "MAVMDATA"
+#define VM_MATRIX_INDEX_MAGIC "MAVMINDX"
+#define VM_MATRIX_VERSION 1
+
+enum vm_matrix_value_type {
+    VM_MATRIX_FLOAT64 = 0,
+    VM_MATRIX_FLOAT32 = 1,
+    VM_MATRIX_FLOAT16 = 2,
+};
+
+struct vm_matrix_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t value_type;
+    uint32_t decimation; // Only one in each 'decimation' calls of the save function was saved
+    uint32_t reserved[3];
+};
+
+struct vm_matrix_index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct vm_matrix_frame {
+    double time;
+    uint64_t offset; // From the start of the data file
+    uint64_t num_cells;
+};
+
+struct vm_matrix_writer {
+    FILE *data_file;
+    FILE *index_file;
+    enum vm_matrix_value_type value_type;
+    uint64_t offset;
+
+    // Frames are written in chunks of about chunk_capacity bytes
+    unsigned char *chunk;
+    size_t chunk_size;
+    size_t chunk_capacity;
+    struct vm_matrix_frame *pending_frames;
+};
+
+struct vm_matrix_file {
+    enum vm_matrix_value_type value_type;
+    uint32_t decimation;
+    uint64_t num_frames;
+    const struct vm_matrix_frame *frames;
+
+    const unsigned char *data;
+    size_t data_size;
+    const unsigned char *index;
+    size_t index_size;
+};
+
+size_t vm_matrix_value_size(enum vm_matrix_value_type value_type);
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);
+
+struct vm_matrix_writer *new_vm_matrix_writer(const char *data_path, const char *index_path, enum vm_matrix_value_type value_type, uint32_t decimation,
+                                              size_t chunk_capacity);
+void vm_matrix_writer_add_frame(struct vm_matrix_writer *writer, double time, const real_cpu *values, uint64_t num_cells);
+void vm_matrix_writer_flush(struct vm_matrix_writer *writer);
+void free_vm_matrix_writer(struct vm_matrix_writer *writer);
+
+struct vm_matrix_file *open_vm_matrix_file(const char *data_path, const char *index_path);
+const void *vm_matrix_frame_values(const struct vm_matrix_file *file, uint64_t frame);
+void vm_matrix_read_frame(const struct vm_matrix_file *file, uint64_t frame, real_cpu *values);
+uint64_t vm_matrix_read_cell(const struct vm_matrix_file *file, uint64_t cell, real_cpu *values);
+void close_vm_matrix_file(struct vm_matrix_file *file);
+
+#endif // MONOALG3D_VM_MATRIX_H
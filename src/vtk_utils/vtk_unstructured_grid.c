@@ -1998,7 +1998,7 @@ static void new_vtk_unstructured_grid_from_vtk_file(struct vtk_unstructured_grid
 
     if(file_type == VTU_XML) {
         // VTK XML file
-        static char stack[8 * 1024];
+        char stack[8 * 1024];
         yxml_t *x = MALLOC_ONE_TYPE(yxml_t);
 
         yxml_init(x, stack, sizeof(stack));
@@ -2478,6 +2478,26 @@ struct vtk_unstructured_grid *new_vtk_unstructured_grid_from_file(const char *fi
     return new_vtk_unstructured_grid_from_file_with_progress(file_name, calc_max_min, &unused, NULL);
 }
 
+// TODO: Improve the file type inference
+static enum file_type_enum infer_file_type(const char *source, size_t size) {
+
+    if(source[0] == '#') {
+        return VTK_LEGACY;
+    } else if((source[0] == '0' || source[0] == '1') && (source[1] == '\n')) {
+        return ACTIVATION;
+    } else if(isdigit(source[0])) {
+        return ALG_PLAIN_TEXT;
+    } else if(source[0] == '<') {
+        return VTU_XML;
+    } else if(size > 8 && STRCMP(source, "C Binary", 8) == 0) {
+        return ENSIGHT_BINARY;
+    } else if(size > 4 && STRCMP(source, "Grid", 4) == 0) {
+        return ENSIGHT_ASCII;
+    }
+
+    return ALG_BINARY;
+}
+
 struct vtk_unstructured_grid *new_vtk_unstructured_grid_from_file_with_progress(const char *file_name, bool calc_max_min, size_t *bytes_read, size_t *file_size) {
 
     assert(bytes_read);
@@ -2493,27 +2513,8 @@ struct vtk_unstructured_grid *new_vtk_unstructured_grid_from_file_with_progress(
         return NULL;
     }
 
-    enum file_type_enum file_type;
-
     char *source = tmp;
-
-    // TODO: Improve the file type inference
-    // TRYING TO INFER THE FILE TYPE//////////////////////
-    if(source[0] == '#') {
-        file_type = VTK_LEGACY;
-    } else if((source[0] == '0' || source[0] == '1') && (source[1] == '\n')) {
-        file_type = ACTIVATION;
-    } else if(isdigit(source[0])) {
-        file_type = ALG_PLAIN_TEXT;
-    } else if(source[0] == '<') {
-        file_type = VTU_XML;
-    } else if(size > 8 && STRCMP(source, "C Binary", 8) == 0) {
-        file_type = ENSIGHT_BINARY;
-    } else if(size > 4 && STRCMP(source, "Grid", 4) == 0) {
-        file_type = ENSIGHT_ASCII;
-    } else {
-        file_type = ALG_BINARY;
-    }
+    enum file_type_enum file_type = infer_file_type(source, size);
 
     if(file_type == VTK_LEGACY || file_type == VTU_XML) {
         new_vtk_unstructured_grid_from_vtk_file(&vtk_grid, file_type, source, size, calc_max_min, bytes_read);
@@ -2533,6 +2534,142 @@ struct vtk_unstructured_grid *new_vtk_unstructured_grid_from_file_with_progress(
     return vtk_grid;
 }
 
+static inline void hash_geometry_bytes(uint64_t *hash, const char *bytes, size_t n) {
+    for(size_t i = 0; i < n; i++) {
+        *hash ^= (unsigned char)bytes[i];
+        *hash *= 1099511628211ULL;
+    }
+}
+
+// Reads the values of an alg file (cx, cy, cz, dx, dy, dz, v in each line or record) and the FNV-1a hash of its
+// geometry columns. Returns false for other formats (e.g. files with extra values)
+static bool read_alg_values_and_geometry_hash(const char *source, size_t size, bool binary, f32_array *values, uint64_t *geometry_hash) {
+
+    uint64_t hash = 14695981039346656037ULL;
+    const char *end = source + size;
+
+    if(binary) {
+        const size_t record_size = 7 * sizeof(real_cpu);
+
+        if(size % record_size != 0) {
+            return false;
+        }
+
+        for(const char *record = source; record < end; record += record_size) {
+            real_cpu v;
+            memcpy(&v, record + 6 * sizeof(real_cpu), sizeof(real_cpu));
+            hash_geometry_bytes(&hash, record, 6 * sizeof(real_cpu));
+            arrput(*values, (float)v);
+        }
+    } else {
+        const char *line = source;
+
+        while(line < end) {
+
+            const char *line_end = memchr(line, '\n', end - line);
+            if(!line_end) {
+                line_end = end;
+            }
+
+            // The value starts after the sixth comma
+            const char *value_start = line;
+            for(int commas = 0; commas < 6; commas++) {
+                value_start = memchr(value_start, ',', line_end - value_start);
+                if(!value_start) {
+                    return false;
+                }
+                value_start++;
+            }
+
+            if(memchr(value_start, ',', line_end - value_start)) {
+                return false;
+            }
+
+            double v;
+            if(!parse_number(value_start, &v)) {
+                return false;
+            }
+
+            hash_geometry_bytes(&hash, line, value_start - line);
+            arrput(*values, (float)v);
+
+            line = line_end + 1;
+        }
+    }
+
+    *geometry_hash = hash ^ (uint64_t)arrlen(*values);
+
+    return true;
+}
+
+// Reads a file as new_vtk_unstructured_grid_from_file, but when it is an alg file with the same geometry (same
+// geometry_hash) of the grid read before in *vtk_grid (e.g. consecutive steps of a simulation without adaptivity),
+// only the values are read and the points and cells are reused. *vtk_grid is freed and replaced otherwise.
+void read_vtk_unstructured_grid_reusing_geometry(struct vtk_unstructured_grid **vtk_grid, uint64_t *geometry_hash, const char *file_name) {
+
+    size_t size;
+    char *tmp = read_entire_file_with_mmap(file_name, &size);
+
+    if(tmp == NULL || size == 0) {
+        free_vtk_unstructured_grid(*vtk_grid);
+        *vtk_grid = NULL;
+        *geometry_hash = 0;
+        return;
+    }
+
+    enum file_type_enum file_type = infer_file_type(tmp, size);
+    bool binary = (file_type == ALG_BINARY);
+
+    f32_array values = NULL;
+    uint64_t hash = 0;
+    bool is_alg = (file_type == ALG_PLAIN_TEXT || file_type == ALG_BINARY);
+
+    if(is_alg && read_alg_values_and_geometry_hash(tmp, size, binary, &values, &hash)) {
+
+        struct vtk_unstructured_grid *grid = *vtk_grid;
+
+        if(grid && hash == *geometry_hash && grid->num_cells == arrlen(values) && !grid->extra_values) {
+
+            arrfree(grid->values);
+            grid->values = values;
+            grid->max_v = FLT_MIN;
+            grid->min_v = FLT_MAX;
+
+            for(uint32_t i = 0; i < grid->num_cells; i++) {
+                real_cpu v = values[i];
+                if(v > grid->max_v)
+                    grid->max_v = (float)v;
+                if(v < grid->min_v)
+                    grid->min_v = (float)v;
+            }
+
+            munmap(tmp, size);
+            return;
+        }
+    } else {
+        is_alg = false;
+    }
+
+    arrfree(values);
+    free_vtk_unstructured_grid(*vtk_grid);
+    *vtk_grid = NULL;
+    *geometry_hash = 0;
+
+    if(is_alg) {
+        size_t bytes_read = 0;
+        new_vtk_unstructured_grid_from_string(vtk_grid, tmp, size, binary, false, &bytes_read);
+        if(*vtk_grid) {
+            *geometry_hash = hash;
+        }
+    }
+
+    munmap(tmp, size);
+
+    if(!is_alg) {
+        *vtk_grid = new_vtk_unstructured_grid_from_file(file_name, false);
+    }
+}
+
 void set_vtk_grid_visibility(struct vtk_unstructured_grid **vtk_grid) {
 
     int64_t *cells = (*vtk_grid)->cells;
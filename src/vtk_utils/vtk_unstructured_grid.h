@@ -63,6 +63,7 @@ void free_vtk_unstructured_grid(struct vtk_unstructured_grid *vtk_grid);
 
 struct vtk_unstructured_grid * new_vtk_unstructured_grid_from_file(const char *vtu_file_name, bool calc_max_min);
 struct vtk_unstructured_grid * new_vtk_unstructured_grid_from_file_with_progress(const char *file_name, bool calc_max_min, size_t *bytes_read, size_t *file_size);
+void read_vtk_unstructured_grid_reusing_geometry(struct vtk_unstructured_grid **vtk_grid, uint64_t *geometry_hash, const char *file_name);
 
 void new_vtk_unstructured_grid_from_string_with_activation_info(struct vtk_unstructured_grid **vtk_grid, char* source, size_t source_size);
 void set_vtk_grid_values_from_ensight_file(struct vtk_unstructured_grid *grid, const char *file_name);